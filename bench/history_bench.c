@@ -0,0 +1,90 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#include <history.h>
+
+#define BENCH_SAMPLES 10000000 /* samples encoded unless given */
+#define BENCH_START 1700000000 /* timestamp of the first sample */
+#define BENCH_PAGE 4096 /* memory changes by whole pages */
+
+/**
+ * current monotonic time
+ * @return seconds
+ */
+static double now_s(void) {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/**
+ * memory of a job sampled once a second: one sample in ten changes by up
+ * to 32 pages either way, the others repeat the previous one
+ * @param seed state of the generator
+ * @param val previous value
+ * @return next value
+ */
+static uint64_t next_value(unsigned *seed, uint64_t val) {
+    if (rand_r(seed) % 10) {
+        return val;
+    }
+
+    int64_t pages = rand_r(seed) % 65 - 32;
+    return (int64_t) val + pages * BENCH_PAGE > 0 ? val + pages * BENCH_PAGE : val;
+}
+
+/**
+ * measure the size of a memory history and the speed of its encoding and
+ * decoding, then check the decoded samples are the ones appended
+ * usage: history_bench [samples]
+ */
+int main(int argc, char **argv) {
+    long samples = argc > 1 ? atol(argv[1]) : BENCH_SAMPLES;
+    series_t *a_series = hist_new(1, false);
+    unsigned seed = 1;
+    uint64_t val = 256 << 20, decoded_val;
+    int64_t ts, decoded_ts;
+    hist_iter_t iter;
+    long n = 0, errors = 0;
+
+    if (samples <= 0 || !a_series) {
+        fprintf(stderr, "usage: history_bench [samples]\n");
+        return EXIT_FAILURE;
+    }
+
+    double start = now_s();
+    for (long i = 0; i < samples; i++) {
+        val = next_value(&seed, val);
+        if (!hist_append(a_series, BENCH_START + i, val)) {
+            fprintf(stderr, "history_bench: out of memory after %ld samples\n", i);
+            return EXIT_FAILURE;
+        }
+    }
+    double encode = now_s() - start;
+
+    start = now_s();
+    hist_iter_init(&iter, a_series);
+    while (hist_next(&iter, &ts, &decoded_val)) n++;
+    double decode = now_s() - start;
+
+    /* replay the generator against a second decoding */
+    seed = 1;
+    val = 256 << 20;
+    hist_iter_init(&iter, a_series);
+    for (long i = 0; i < samples; i++) {
+        val = next_value(&seed, val);
+        if (!hist_next(&iter, &decoded_ts, &decoded_val) || decoded_ts != BENCH_START + i || decoded_val != val) {
+            errors++;
+        }
+    }
+
+    printf("memory history: %ld samples, 1s apart, 10%% changing by up to 32 pages\n", samples);
+    printf("  size   %6.2f bytes/sample, blocks included\n", (double) hist_bytes(a_series) / samples);
+    printf("  encode %6.1f M samples/s\n", samples / encode / 1e6);
+    printf("  decode %6.1f M samples/s\n", n / decode / 1e6);
+    printf("  round trip: %s\n", errors || n != samples ? "MISMATCH" : "exact");
+
+    hist_free(a_series);
+    return errors || n != samples ? EXIT_FAILURE : EXIT_SUCCESS;
+}
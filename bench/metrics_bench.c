@@ -0,0 +1,97 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <metrics.h>
+
+#define BENCH_MAPPINGS 1000 /* mappings of the sampled process */
+#define BENCH_SAMPLES 20000 /* samples per metric unless given */
+
+/**
+ * current monotonic time
+ * @return seconds
+ */
+static double now_s(void) {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/**
+ * start a process holding BENCH_MAPPINGS mappings, every page touched.
+ * Neighbouring mappings alternate their protection so the kernel can't
+ * merge them, smaps_rollup then walks each of them
+ * @return pid of the process
+ */
+static pid_t start_target(void) {
+    int ready[2];
+    char byte;
+    pid_t pid;
+
+    if (pipe(ready) == -1 || (pid = fork()) == -1) {
+        perror("start_target");
+        exit(EXIT_FAILURE);
+    }
+    if (pid == 0) {
+        long page = sysconf(_SC_PAGESIZE);
+        char *area = mmap(NULL, page * BENCH_MAPPINGS, PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (area == MAP_FAILED) {
+            _exit(EXIT_FAILURE);
+        }
+        for (int i = 0; i < BENCH_MAPPINGS; i++) {
+            area[i * page] = 1;
+        }
+        for (int i = 1; i < BENCH_MAPPINGS; i += 2) {
+            mprotect(area + i * page, page, PROT_READ);
+        }
+        write(ready[1], "", 1);
+        pause();
+        _exit(EXIT_SUCCESS);
+    }
+
+    close(ready[1]);
+    if (read(ready[0], &byte, 1) != 1) {
+        fprintf(stderr, "start_target: the process could not map its memory\n");
+        exit(EXIT_FAILURE);
+    }
+    close(ready[0]);
+    return pid;
+}
+
+/**
+ * measure the cost of one sample of every memory metric, read the way the
+ * overseer reads a job it samples on its own: one open and read of statm
+ * for rss and anon, of smaps_rollup for pss and uss
+ * usage: metrics_bench [samples]
+ */
+int main(int argc, char **argv) {
+    int samples = argc > 1 ? atoi(argv[1]) : BENCH_SAMPLES;
+
+    if (samples <= 0) {
+        fprintf(stderr, "usage: metrics_bench [samples]\n");
+        return EXIT_FAILURE;
+    }
+    pid_t pid = start_target();
+
+    printf("metric sampling: process with %d mappings, %d samples per metric\n", BENCH_MAPPINGS, samples);
+    for (enum mem_metric metric = metric_rss; metric <= metric_uss; metric++) {
+        uint64_t value = 0;
+        double start = now_s();
+
+        for (int i = 0; i < samples; i++) {
+            value = metric_sample(pid, metric);
+        }
+        printf("  %-4s %8.1fus  (%llu bytes)\n", metric_name(metric), (now_s() - start) * 1e6 / samples,
+               (unsigned long long) value);
+    }
+
+    kill(pid, SIGKILL);
+    waitpid(pid, NULL, 0);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,137 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <metrics.h>
+
+#define BENCH_PROCESSES 10000 /* processes sampled unless given */
+#define BENCH_TICKS 20 /* ticks measured per way of reading */
+
+/**
+ * current monotonic time
+ * @return seconds
+ */
+static double now_s(void) {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/**
+ * time a tick sampling every process with open/read/close, as the
+ * overseer did before the reader
+ * @param pids processes
+ * @param values receives their memory
+ * @param count number of processes
+ * @param metric metric sampled
+ * @return milliseconds per tick
+ */
+static double tick_open(const pid_t *pids, uint64_t *values, int count, enum mem_metric metric) {
+    double start = now_s();
+
+    for (int t = 0; t < BENCH_TICKS; t++) {
+        for (int i = 0; i < count; i++) {
+            values[i] = metric_sample(pids[i], metric);
+        }
+    }
+    return (now_s() - start) * 1e3 / BENCH_TICKS;
+}
+
+/**
+ * time a tick sampling every process with a reader, once its descriptors
+ * are cached as they are in a running sampler
+ * @param pids processes
+ * @param values receives their memory
+ * @param count number of processes
+ * @param metric metric sampled
+ * @param uring read through io_uring
+ * @return milliseconds per tick, or -1 if io_uring was asked for but is unavailable
+ */
+static double tick_reader(const pid_t *pids, uint64_t *values, int count, enum mem_metric metric, bool uring) {
+    metric_reader_t reader;
+
+    if (!metric_reader_init(&reader, metric, uring)) {
+        exit(EXIT_FAILURE);
+    }
+    if (uring && !reader.use_uring) {
+        metric_reader_close(&reader);
+        return -1;
+    }
+
+    metric_reader_sample(&reader, pids, values, count);
+    double start = now_s();
+    for (int t = 0; t < BENCH_TICKS; t++) {
+        metric_reader_sample(&reader, pids, values, count);
+    }
+    double ms = (now_s() - start) * 1e3 / BENCH_TICKS;
+
+    metric_reader_close(&reader);
+    return ms;
+}
+
+/**
+ * measure a sampler tick over many paused processes, reading their metric
+ * file with open/read/close, with a cached descriptor and pread, and with
+ * a cached descriptor through io_uring
+ * usage: sampler_bench [processes]
+ */
+int main(int argc, char **argv) {
+    int count = argc > 1 ? atoi(argv[1]) : BENCH_PROCESSES;
+    static const enum mem_metric metrics[] = {metric_rss, metric_pss};
+    static const char *files[] = {"statm", "smaps_rollup"};
+    struct rlimit nofile;
+
+    if (count <= 0) {
+        fprintf(stderr, "usage: sampler_bench [processes]\n");
+        return EXIT_FAILURE;
+    }
+
+    /* the reader keeps a descriptor per process, like the overseer */
+    if (getrlimit(RLIMIT_NOFILE, &nofile) == 0 && nofile.rlim_cur < nofile.rlim_max) {
+        nofile.rlim_cur = nofile.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &nofile);
+    }
+
+    pid_t *pids = (pid_t *) malloc(sizeof(pid_t) * count);
+    uint64_t *values = (uint64_t *) malloc(sizeof(uint64_t) * count);
+    int started = 0;
+    for (; started < count; started++) {
+        if ((pids[started] = fork()) == 0) {
+            pause();
+            _exit(EXIT_SUCCESS);
+        }
+        if (pids[started] == -1) {
+            perror("fork");
+            break;
+        }
+    }
+
+    if (started == count) {
+        printf("sampler tick: %d paused processes, ms per tick\n", count);
+        printf("  %-13s %15s %13s %9s\n", "", "open/read/close", "cached pread", "io_uring");
+        for (int m = 0; m < 2; m++) {
+            double uring = tick_reader(pids, values, count, metrics[m], true);
+            printf("  %-13s %15.1f %13.1f", files[m], tick_open(pids, values, count, metrics[m]),
+                   tick_reader(pids, values, count, metrics[m], false));
+            if (uring < 0) {
+                printf(" %9s\n", "n/a");
+            } else {
+                printf(" %9.1f\n", uring);
+            }
+        }
+    }
+
+    for (int i = 0; i < started; i++) {
+        kill(pids[i], SIGKILL);
+    }
+    for (int i = 0; i < started; i++) {
+        waitpid(pids[i], NULL, 0);
+    }
+    free(pids);
+    free(values);
+    return started == count ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,161 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <client.h>
+
+#define BENCH_REQUESTS 20000 /* load commands sent per transport unless given */
+#define BENCH_RUNS 300 /* controller runs per transport */
+#define BENCH_PORT 47300 /* port of the overseer started for the benchmark */
+#define BENCH_SOCKET "/tmp/overseer_bench.sock" /* its unix socket */
+
+/**
+ * current monotonic time
+ * @return microseconds
+ */
+static double now_us(void) {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1e6 + now.tv_nsec / 1e3;
+}
+
+/**
+ * order two latencies
+ * @param a first latency
+ * @param b second latency
+ * @return their comparison
+ */
+static int compare_latency(const void *a, const void *b) {
+    double x = *(const double *) a, y = *(const double *) b;
+    return x < y ? -1 : x > y;
+}
+
+/**
+ * connect to the overseer over tcp or its unix socket
+ * @param local use the unix socket
+ * @return client or NULL
+ */
+static oc_client_t *connect_overseer(bool local) {
+    return local ? oc_open_local(BENCH_SOCKET, 1) : oc_open("127.0.0.1", BENCH_PORT, 1);
+}
+
+/**
+ * send one load command on a new connection and wait for its answer, as
+ * the controller does
+ * @param local use the unix socket
+ * @return
+ *  true: if the overseer answered
+ *  false: otherwise
+ */
+static bool round_trip(bool local) {
+    oc_client_t *client = connect_overseer(local);
+    if (!client) {
+        return false;
+    }
+
+    oc_request_t *request = oc_query(client, cmd5, NULL, NULL, NULL);
+    bool answered = request && oc_wait(client, request) == oc_ok;
+    if (request) {
+        oc_free(request);
+    }
+    oc_close(client);
+    return answered;
+}
+
+/**
+ * run a command with its output discarded
+ * @param argv command
+ * @return exit status, -1 if it could not run
+ */
+static int run(char *const argv[]) {
+    int status;
+    pid_t pid = fork();
+
+    if (pid == 0) {
+        int null_fd = open("/dev/null", O_WRONLY);
+        dup2(null_fd, STDOUT_FILENO);
+        dup2(null_fd, STDERR_FILENO);
+        execv(argv[0], argv);
+        _exit(127);
+    }
+    return pid == -1 || waitpid(pid, &status, 0) == -1 ? -1 : WEXITSTATUS(status);
+}
+
+/**
+ * measure the round trip of a load command over loopback tcp and over the
+ * unix socket, a connection per request, then the time of a whole
+ * controller run over each. An overseer is started for it from the binary
+ * built in the tree
+ * usage: transport_bench [requests]
+ */
+int main(int argc, char **argv) {
+    int requests = argc > 1 ? atoi(argv[1]) : BENCH_REQUESTS;
+    static const char *names[] = {"loopback tcp", "unix socket"};
+    char port[16];
+
+    if (requests <= 0) {
+        fprintf(stderr, "usage: transport_bench [requests]\n");
+        return EXIT_FAILURE;
+    }
+
+    sprintf(port, "%d", BENCH_PORT);
+    char *overseer[] = {"./overseer", "-unix", BENCH_SOCKET, port, NULL};
+    pid_t pid = fork();
+    if (pid == 0) {
+        int null_fd = open("/dev/null", O_WRONLY);
+        dup2(null_fd, STDOUT_FILENO);
+        execv(overseer[0], overseer);
+        perror("execv ./overseer");
+        _exit(EXIT_FAILURE);
+    }
+
+    /* wait for both listen sockets */
+    int tries = 0;
+    while ((!round_trip(false) || !round_trip(true)) && ++tries < 50) {
+        usleep(100000);
+    }
+    if (tries == 50) {
+        fprintf(stderr, "transport_bench: the overseer did not start\n");
+        kill(pid, SIGKILL);
+        waitpid(pid, NULL, 0);
+        return EXIT_FAILURE;
+    }
+
+    double *latency = (double *) malloc(sizeof(double) * requests);
+    int failed = 0;
+
+    printf("load round trip: %d requests, a connection each\n", requests);
+    for (int local = 0; local < 2; local++) {
+        for (int i = 0; i < requests; i++) {
+            double start = now_us();
+            failed += !round_trip(local);
+            latency[i] = now_us() - start;
+        }
+        qsort(latency, requests, sizeof(double), compare_latency);
+        printf("  %-12s p50 %6.0fus  p99 %6.0fus\n", names[local], latency[requests / 2],
+               latency[(int) (requests * 0.99)]);
+    }
+
+    printf("controller run: %d runs of load\n", BENCH_RUNS);
+    for (int local = 0; local < 2; local++) {
+        char *controller[] = {"./controller", local ? BENCH_SOCKET : "127.0.0.1", port, "load", NULL};
+        double start = now_us();
+        for (int i = 0; i < BENCH_RUNS; i++) {
+            failed += run(controller) != 0;
+        }
+        printf("  %-12s %6.2fms\n", names[local], (now_us() - start) / 1e3 / BENCH_RUNS);
+    }
+    if (failed) {
+        printf("  %d requests failed\n", failed);
+    }
+
+    kill(pid, SIGINT);
+    waitpid(pid, NULL, 0);
+    free(latency);
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,714 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/un.h>
+#include <client.h>
+#include <resolve.h>
+
+#define OC_EVENTS 64 /* events taken by one epoll_wait */
+
+/* state of a connection of the pool */
+enum oc_state {
+    oc_closed, /* no socket */
+    oc_connecting, /* connect in progress */
+    oc_sending, /* writing a command */
+    oc_passing, /* passing stdout and stderr after the command */
+    oc_receiving, /* reading the answer */
+    oc_idle /* kept open by the overseer for the next command */
+};
+
+/* connection of the pool */
+typedef struct oc_conn {
+    int fd;
+    enum oc_state state;
+    bool reused; /* carried an earlier command, the overseer may have closed it since */
+    oc_request_t *request; /* command being sent or answered */
+    char header[sizeof(uint32_t)]; /* length of the answer */
+    size_t got; /* bytes of the header and answer received */
+    size_t reply_len; /* length of the answer with its NUL */
+} oc_conn_t;
+
+struct oc_request {
+    char *buf; /* encoded command */
+    size_t len, sent; /* its length and the bytes written */
+    bool expects_reply; /* memkill and cpukill are not answered */
+    bool keep; /* the command asks the overseer to keep the connection */
+    bool passes_stdio; /* stdout and stderr follow the command */
+    int stdio_fds[2];
+    bool retried; /* sent again after a kept connection turned out closed */
+    bool orphan; /* freed by oc_free before completing */
+    oc_callback_t callback;
+    void *arg;
+    enum oc_status status;
+    char *reply;
+    oc_request_t *next; /* next request waiting for a connection */
+};
+
+struct oc_client {
+    struct sockaddr_storage addr; /* address of the overseer, a sockaddr_un for a local one */
+    socklen_t addr_len;
+    int epoll_fd; /* every connection of the pool */
+    int pool; /* most connections */
+    oc_conn_t conns[OC_MAX_POOL];
+    oc_request_t *queue, *queue_tail; /* requests waiting for a connection */
+    int completed; /* requests completed, counted by oc_process */
+};
+
+/**
+ * create a client of the overseer at the given address
+ * @param addr address of the overseer, tcp or unix
+ * @param len length of the address
+ * @param pool most connections, OC_POOL if 0 or less
+ * @return the client, NULL if failed
+ */
+oc_client_t *oc_open_addr(const struct sockaddr *addr, socklen_t len, int pool) {
+    oc_client_t *client;
+
+    if (len > sizeof(struct sockaddr_storage) || !(client = (oc_client_t *) calloc(1, sizeof(oc_client_t)))) {
+        return NULL;
+    }
+    if ((client->epoll_fd = epoll_create1(EPOLL_CLOEXEC)) == -1) {
+        perror("epoll_create1");
+        free(client);
+        return NULL;
+    }
+
+    memcpy(&client->addr, addr, len);
+    client->addr_len = len;
+    client->pool = pool <= 0 ? OC_POOL : pool > OC_MAX_POOL ? OC_MAX_POOL : pool;
+    for (int i = 0; i < OC_MAX_POOL; i++) {
+        client->conns[i].fd = -1;
+    }
+
+    return client;
+}
+
+/**
+ * create a client of the overseer at the given host and port
+ * @param host IPv4 or IPv6 literal, or host name
+ * @param port port of the overseer
+ * @param pool most connections, OC_POOL if 0 or less
+ * @return the client, NULL if the host is unknown or failed
+ */
+oc_client_t *oc_open(const char *host, uint16_t port, int pool) {
+    struct sockaddr_storage addr;
+
+    if (!rs_resolve(host, port, &addr)) {
+        return NULL;
+    }
+    return oc_open_addr((struct sockaddr *) &addr, rs_len(&addr), pool);
+}
+
+/**
+ * create a client of the overseer listening on a unix socket
+ * @param path path of the socket
+ * @param pool most connections, OC_POOL if 0 or less
+ * @return the client, NULL if the path is too long or failed
+ */
+oc_client_t *oc_open_local(const char *path, int pool) {
+    struct sockaddr_un addr;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        return NULL;
+    }
+    strcpy(addr.sun_path, path);
+
+    return oc_open_addr((struct sockaddr *) &addr, sizeof(addr), pool);
+}
+
+/**
+ * free a request
+ * @param request request
+ */
+static void oc_destroy(oc_request_t *request) {
+    free(request->buf);
+    free(request->reply);
+    free(request);
+}
+
+/**
+ * complete a request: run its callback and free it, or keep it for its
+ * owner unless it was already let go
+ * @param client client
+ * @param request request
+ * @param status how it ended
+ * @param reply answer of the overseer, owned by the request
+ */
+static void oc_complete(oc_client_t *client, oc_request_t *request, enum oc_status status, char *reply) {
+    request->status = status;
+    request->reply = reply;
+    client->completed++;
+
+    if (request->callback && !request->orphan) {
+        request->callback(request, status, reply, request->arg);
+    }
+    if (request->callback || request->orphan) {
+        oc_destroy(request);
+    }
+}
+
+/**
+ * close a connection of the pool
+ * @param conn connection
+ */
+static void oc_disconnect(oc_conn_t *conn) {
+    if (conn->fd != -1) {
+        close(conn->fd); /* also removes it from the epoll set */
+    }
+    conn->fd = -1;
+    conn->state = oc_closed;
+    conn->reused = false;
+    conn->request = NULL;
+}
+
+/**
+ * change the events a connection waits for
+ * @param client client
+ * @param conn connection
+ * @param events EPOLLIN or EPOLLOUT
+ */
+static void oc_watch(oc_client_t *client, oc_conn_t *conn, uint32_t events) {
+    struct epoll_event event = {.events = events, .data.ptr = conn};
+    epoll_ctl(client->epoll_fd, EPOLL_CTL_MOD, conn->fd, &event);
+}
+
+/**
+ * give up a connection whose command failed. A command sent on a kept
+ * connection the overseer closed meanwhile never reached it, the overseer
+ * reading a command only to answer it, and is sent again once on a new one
+ * @param client client
+ * @param conn connection
+ * @param status status of the request if it isn't sent again
+ */
+static void oc_fail(oc_client_t *client, oc_conn_t *conn, enum oc_status status) {
+    oc_request_t *request = conn->request;
+    bool again = request && conn->reused && !request->retried && conn->got == 0;
+
+    oc_disconnect(conn);
+    if (again) {
+        request->retried = true;
+        request->sent = 0;
+        request->next = client->queue;
+        client->queue = request;
+        if (!client->queue_tail) {
+            client->queue_tail = request;
+        }
+    } else if (request) {
+        free(request->reply); /* part of an answer */
+        oc_complete(client, request, status, NULL);
+    }
+}
+
+/**
+ * the command of a connection is sent: wait for its answer, or complete it
+ * and keep or close the connection if it has none
+ * @param client client
+ * @param conn connection
+ */
+static void oc_sent(oc_client_t *client, oc_conn_t *conn) {
+    oc_request_t *request = conn->request;
+
+    if (request->expects_reply) {
+        conn->state = oc_receiving;
+        conn->got = 0;
+        oc_watch(client, conn, EPOLLIN);
+        return;
+    }
+
+    conn->request = NULL;
+    if (request->keep) {
+        conn->state = oc_idle;
+        conn->reused = true;
+        oc_watch(client, conn, EPOLLIN);
+    } else {
+        oc_disconnect(conn);
+    }
+    oc_complete(client, request, oc_ok, NULL);
+}
+
+/**
+ * pass stdout and stderr after the command once the socket has room for
+ * them, send_fds sending them at once
+ * @param client client
+ * @param conn connection
+ */
+static void oc_pass(oc_client_t *client, oc_conn_t *conn) {
+    struct pollfd writable = {.fd = conn->fd, .events = POLLOUT};
+
+    if (poll(&writable, 1, 0) != 1) {
+        oc_watch(client, conn, EPOLLOUT);
+        return;
+    }
+    if (!(writable.revents & POLLOUT) || !send_fds(conn->fd, conn->request->stdio_fds, 2)) {
+        oc_fail(client, conn, oc_failed);
+        return;
+    }
+    oc_sent(client, conn);
+}
+
+/**
+ * write as much of the command of a connection as the socket takes
+ * @param client client
+ * @param conn connection
+ */
+static void oc_write(oc_client_t *client, oc_conn_t *conn) {
+    oc_request_t *request = conn->request;
+
+    while (request->sent < request->len) {
+        ssize_t n = send(conn->fd, request->buf + request->sent, request->len - request->sent,
+                         MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (n == -1 && errno == EINTR) {
+            continue;
+        }
+        if (n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            oc_watch(client, conn, EPOLLOUT);
+            return;
+        }
+        if (n <= 0) {
+            oc_fail(client, conn, oc_failed);
+            return;
+        }
+        request->sent += n;
+    }
+
+    if (request->passes_stdio) {
+        conn->state = oc_passing;
+        oc_pass(client, conn);
+    } else {
+        oc_sent(client, conn);
+    }
+}
+
+/**
+ * read what arrived of the answer on a connection, its length first
+ * @param client client
+ * @param conn connection
+ */
+static void oc_read(oc_client_t *client, oc_conn_t *conn) {
+    oc_request_t *request = conn->request;
+
+    for (;;) {
+        size_t header = sizeof(conn->header);
+        ssize_t n;
+
+        if (conn->got < header) {
+            n = recv(conn->fd, conn->header + conn->got, header - conn->got, MSG_DONTWAIT);
+        } else {
+            n = recv(conn->fd, request->reply + conn->got - header, conn->reply_len - (conn->got - header),
+                     MSG_DONTWAIT);
+        }
+        if (n == -1 && errno == EINTR) {
+            continue;
+        }
+        if (n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return;
+        }
+        if (n <= 0) {
+            oc_fail(client, conn, oc_failed);
+            return;
+        }
+
+        conn->got += n;
+        if (conn->got == header) {
+            uint32_t net_len;
+            memcpy(&net_len, conn->header, sizeof(net_len));
+            conn->reply_len = ntohl(net_len);
+            if (!conn->reply_len || !(request->reply = (char *) malloc(conn->reply_len))) {
+                oc_fail(client, conn, oc_failed);
+                return;
+            }
+        }
+        if (conn->got > header && conn->got == header + conn->reply_len) {
+            break;
+        }
+    }
+
+    /* the answer is complete, a NUL ends it whatever the overseer sent */
+    char *reply = request->reply;
+    reply[conn->reply_len - 1] = '\0';
+    request->reply = NULL;
+    conn->request = NULL;
+    conn->got = 0;
+    if (request->keep) {
+        conn->state = oc_idle;
+        conn->reused = true;
+    } else {
+        oc_disconnect(conn);
+    }
+    oc_complete(client, request, oc_ok, reply);
+}
+
+/**
+ * open a connection of the pool without waiting for it
+ * @param client client
+ * @param conn closed connection
+ * @return
+ *  true: if it is connected or connecting
+ *  false: if the overseer is unreachable
+ */
+static bool oc_connect(oc_client_t *client, oc_conn_t *conn) {
+    struct epoll_event event = {.events = EPOLLOUT, .data.ptr = conn};
+    int one = 1;
+
+    if ((conn->fd = socket(client->addr.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0)) == -1) {
+        return false;
+    }
+    if (client->addr.ss_family != AF_UNIX) {
+        /* every command is written at once, nothing is gained by delaying it */
+        setsockopt(conn->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+    if (epoll_ctl(client->epoll_fd, EPOLL_CTL_ADD, conn->fd, &event) == -1) {
+        oc_disconnect(conn);
+        return false;
+    }
+
+    if (connect(conn->fd, (struct sockaddr *) &client->addr, client->addr_len) == 0) {
+        conn->state = oc_sending;
+    } else if (errno == EINPROGRESS) {
+        conn->state = oc_connecting;
+    } else {
+        oc_disconnect(conn);
+        return false;
+    }
+    conn->reused = false;
+    conn->got = 0;
+
+    return true;
+}
+
+/**
+ * hand the waiting requests to idle connections, opening new ones up to
+ * the size of the pool
+ * @param client client
+ */
+static void oc_dispatch(oc_client_t *client) {
+    while (client->queue) {
+        oc_conn_t *conn = NULL, *closed = NULL;
+        for (int i = 0; i < client->pool && !conn; i++) {
+            if (client->conns[i].state == oc_idle) {
+                conn = client->conns + i;
+            } else if (client->conns[i].state == oc_closed && !closed) {
+                closed = client->conns + i;
+            }
+        }
+        if (!conn && !closed) {
+            return; /* every connection is busy */
+        }
+
+        oc_request_t *request = client->queue;
+        if (!(client->queue = request->next)) {
+            client->queue_tail = NULL;
+        }
+        request->next = NULL;
+
+        if (!conn) {
+            conn = closed;
+            if (!oc_connect(client, conn)) {
+                oc_complete(client, request, oc_unreachable, NULL);
+                continue;
+            }
+        } else {
+            conn->state = oc_sending;
+        }
+
+        conn->request = request;
+        if (conn->state == oc_sending) {
+            oc_write(client, conn);
+        }
+    }
+}
+
+/**
+ * close a client, its connections and the requests still pending: those
+ * with a callback are freed, the others are left to their owner failed
+ * @param client client
+ */
+void oc_close(oc_client_t *client) {
+    if (!client) {
+        return;
+    }
+
+    for (int i = 0; i < OC_MAX_POOL; i++) {
+        oc_request_t *request = client->conns[i].request;
+        oc_disconnect(client->conns + i);
+        if (request) {
+            request->next = client->queue;
+            client->queue = request;
+        }
+    }
+
+    while (client->queue) {
+        oc_request_t *request = client->queue;
+        client->queue = request->next;
+        request->status = oc_failed;
+        if (request->callback || request->orphan) {
+            oc_destroy(request);
+        }
+    }
+
+    close(client->epoll_fd);
+    free(client);
+}
+
+/**
+ * get the descriptor to wait on for a client, readable when a connection
+ * of the client has something for oc_process
+ * @param client client
+ * @return the descriptor
+ */
+int oc_fd(oc_client_t *client) {
+    return client->epoll_fd;
+}
+
+/**
+ * move the requests of a client forward: send the waiting ones, write and
+ * read what their connections allow, waiting up to timeout_ms for them.
+ * The callbacks of the completed requests run here
+ * @param client client
+ * @param timeout_ms longest wait, 0 not to wait and -1 without limit
+ * @return the number of completed requests, -1 if failed
+ */
+int oc_process(oc_client_t *client, int timeout_ms) {
+    struct epoll_event events[OC_EVENTS];
+    int num_events;
+
+    client->completed = 0;
+    oc_dispatch(client);
+    if (client->completed) {
+        timeout_ms = 0; /* report these before waiting on the others */
+    }
+
+    if ((num_events = epoll_wait(client->epoll_fd, events, OC_EVENTS, timeout_ms)) == -1) {
+        return errno == EINTR ? client->completed : -1;
+    }
+
+    for (int i = 0; i < num_events; i++) {
+        oc_conn_t *conn = events[i].data.ptr;
+        int error = 0;
+        socklen_t error_len = sizeof(error);
+
+        switch (conn->state) {
+            case oc_connecting:
+                if (getsockopt(conn->fd, SOL_SOCKET, SO_ERROR, &error, &error_len) == -1 || error) {
+                    oc_fail(client, conn, oc_unreachable);
+                    break;
+                }
+                conn->state = oc_sending;
+                oc_write(client, conn);
+                break;
+            case oc_sending:
+                oc_write(client, conn);
+                break;
+            case oc_passing:
+                oc_pass(client, conn);
+                break;
+            case oc_receiving:
+                oc_read(client, conn);
+                break;
+            case oc_idle: /* nothing is due on a kept connection but its end */
+                oc_disconnect(conn);
+                break;
+            default:
+                break;
+        }
+    }
+
+    oc_dispatch(client);
+    return client->completed;
+}
+
+/**
+ * send a command. It is encoded at once with the keepalive flag, except
+ * for wait and memkill --free whose connections the overseer parks until
+ * the jobs end, and waits for a connection of the pool
+ * @param client client
+ * @param cmd command, the stdio flag passing cmd->stdio_fds to a local overseer
+ * @param callback called when the request completes, NULL to use oc_wait
+ * @param arg passed to the callback
+ * @return the request, NULL if out of memory or the command has too many flags
+ */
+oc_request_t *oc_send(oc_client_t *client, cmd_t *cmd, oc_callback_t callback, void *arg) {
+    flag_t flags[MAX_FLAGS];
+    cmd_t sent = *cmd;
+    oc_request_t *request;
+
+    if (cmd->flag_size > MAX_FLAGS || !(request = (oc_request_t *) calloc(1, sizeof(oc_request_t)))) {
+        return NULL;
+    }
+
+    request->keep = cmd->type != cmd6 && !get_flag(cmd, memfree) && cmd->flag_size < MAX_FLAGS;
+    request->expects_reply = has_reply(cmd);
+    request->passes_stdio = client->addr.ss_family == AF_UNIX && get_flag(cmd, stdio);
+    request->stdio_fds[0] = cmd->stdio_fds[0];
+    request->stdio_fds[1] = cmd->stdio_fds[1];
+    request->callback = callback;
+    request->arg = arg;
+    request->status = oc_pending;
+
+    if (request->keep) {
+        memcpy(flags, cmd->flag_arg, sizeof(flag_t) * cmd->flag_size);
+        flags[cmd->flag_size].type = keepalive;
+        flags[cmd->flag_size].value = NULL;
+        sent.flag_arg = flags;
+        sent.flag_size++;
+    }
+    if (!(request->buf = encode_cmd(&sent, &request->len))) {
+        free(request);
+        return NULL;
+    }
+
+    if (client->queue_tail) {
+        client->queue_tail->next = request;
+    } else {
+        client->queue = request;
+    }
+    client->queue_tail = request;
+
+    return request;
+}
+
+/**
+ * run a file
+ * @param client client
+ * @param argv file and its arguments, NULL terminated
+ * @param out_file file receiving the output of the job, NULL for the log of the overseer
+ * @param callback called with the job id, NULL to use oc_wait
+ * @param arg passed to the callback
+ * @return the request, NULL if failed
+ */
+oc_request_t *oc_submit(oc_client_t *client, char *const argv[], const char *out_file, oc_callback_t callback,
+                        void *arg) {
+    flag_t flag = {.type = o, .value = (char *) out_file};
+    cmd_t cmd = {.type = cmd1, .local_path = NULL, .stdio_fds = {-1, -1}, .flag_size = out_file ? 1 : 0,
+                 .flag_arg = &flag, .file_size = 0, .file_arg = (char **) argv};
+
+    while (argv[cmd.file_size]) cmd.file_size++;
+    if (!cmd.file_size) {
+        return NULL;
+    }
+
+    return oc_send(client, &cmd, callback, arg);
+}
+
+/**
+ * ask the overseer about its jobs
+ * @param client client
+ * @param type cmd2 (mem), cmd5 (load), cmd7 (cpu), cmd9 (top) or cmd10 (stats)
+ * @param value pid or @array of mem and cpu, number of jobs of top, job or file of stats, NULL if none
+ * @param callback called with the answer, NULL to use oc_wait
+ * @param arg passed to the callback
+ * @return the request, NULL if type is not a query or failed
+ */
+oc_request_t *oc_query(oc_client_t *client, enum cmd_type type, const char *value, oc_callback_t callback,
+                       void *arg) {
+    flag_t flag = {.value = (char *) value};
+    cmd_t cmd = {.type = type, .local_path = NULL, .stdio_fds = {-1, -1}, .flag_size = 1, .flag_arg = &flag,
+                 .file_size = 0, .file_arg = NULL};
+
+    if (type == cmd2) {
+        flag.type = mem;
+    } else if (type == cmd7) {
+        flag.type = cpu;
+    } else if (type == cmd9) {
+        flag.type = top;
+    } else if (type == cmd10) {
+        flag.type = stats;
+    } else if (type == cmd5) {
+        cmd.flag_size = 0;
+    } else {
+        return NULL;
+    }
+
+    return oc_send(client, &cmd, callback, arg);
+}
+
+/**
+ * kill the jobs of an array
+ * @param client client
+ * @param array_ref @id of the array
+ * @param callback called with the number of jobs killed, NULL to use oc_wait
+ * @param arg passed to the callback
+ * @return the request, NULL if failed
+ */
+oc_request_t *oc_kill(oc_client_t *client, const char *array_ref, oc_callback_t callback, void *arg) {
+    flag_t flag = {.type = killjob, .value = (char *) array_ref};
+    cmd_t cmd = {.type = cmd4, .local_path = NULL, .stdio_fds = {-1, -1}, .flag_size = 1, .flag_arg = &flag,
+                 .file_size = 0, .file_arg = NULL};
+
+    return oc_send(client, &cmd, callback, arg);
+}
+
+/**
+ * suspend or resume a job or the jobs of an array
+ * @param client client
+ * @param ref job id or @id of the array
+ * @param suspend true to suspend, false to resume
+ * @param callback called with the number of jobs suspended or resumed, NULL to use oc_wait
+ * @param arg passed to the callback
+ * @return the request, NULL if failed
+ */
+oc_request_t *oc_suspend(oc_client_t *client, const char *ref, bool suspend, oc_callback_t callback, void *arg) {
+    flag_t flag = {.type = suspend ? suspendjob : resumejob, .value = (char *) ref};
+    cmd_t cmd = {.type = suspend ? cmd11 : cmd12, .local_path = NULL, .stdio_fds = {-1, -1}, .flag_size = 1,
+                 .flag_arg = &flag, .file_size = 0, .file_arg = NULL};
+
+    return oc_send(client, &cmd, callback, arg);
+}
+
+/**
+ * process the requests of a client until the given one completes
+ * @param client client
+ * @param request request sent without a callback
+ * @return its status, oc_failed if the client failed
+ */
+enum oc_status oc_wait(oc_client_t *client, oc_request_t *request) {
+    while (request->status == oc_pending) {
+        if (oc_process(client, -1) == -1) {
+            return oc_failed;
+        }
+    }
+
+    return request->status;
+}
+
+/**
+ * get the status of a request
+ * @param request request sent without a callback
+ * @return its status
+ */
+enum oc_status oc_status(const oc_request_t *request) {
+    return request->status;
+}
+
+/**
+ * get the answer to a request
+ * @param request completed request
+ * @return the answer, NULL if it failed or has none
+ */
+const char *oc_reply(const oc_request_t *request) {
+    return request->reply;
+}
+
+/**
+ * free a request sent without a callback. A pending one is freed when it
+ * completes, its connection being kept
+ * @param request request
+ */
+void oc_free(oc_request_t *request) {
+    if (!request) {
+        return;
+    }
+    if (request->status == oc_pending) {
+        request->orphan = true;
+    } else {
+        oc_destroy(request);
+    }
+}
@@ -0,0 +1,79 @@
+#ifndef PROCESS_OVERSEER_CLIENT_H
+#define PROCESS_OVERSEER_CLIENT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/socket.h>
+#include <helpers.h>
+
+#define OC_POOL 4 /* connections of a client unless told otherwise */
+#define OC_MAX_POOL 64 /* most connections of a client */
+
+/* client of one overseer, the library behind the controller. It keeps a
+ * pool of connections the overseer leaves open between commands and sends
+ * every command without blocking; a client is used by one thread at a time */
+typedef struct oc_client oc_client_t;
+
+/* command sent by a client, answered once */
+typedef struct oc_request oc_request_t;
+
+/* how far a request got */
+enum oc_status {
+    oc_pending, /* not answered yet */
+    oc_ok, /* answered, or sent for memkill and cpukill which have no answer */
+    oc_unreachable, /* could not connect to the overseer */
+    oc_failed /* the connection failed before the answer came */
+};
+
+/* called when a request completes: reply is the answer of the overseer,
+ * NULL for memkill and cpukill or if the request failed, and is freed with
+ * the request once the callback returns */
+typedef void (*oc_callback_t)(oc_request_t *, enum oc_status, const char *reply, void *arg);
+
+/* client of the overseer at host (IPv4 or IPv6 literal, or name) and port, with up to pool connections */
+oc_client_t *oc_open(const char *host, uint16_t port, int pool);
+
+/* client of the overseer listening on a unix socket */
+oc_client_t *oc_open_local(const char *path, int pool);
+
+/* client of the overseer at a resolved address of any family */
+oc_client_t *oc_open_addr(const struct sockaddr *, socklen_t, int pool);
+
+/* close every connection, requests still pending fail without their callback */
+void oc_close(oc_client_t *);
+
+/* descriptor readable when oc_process has something to do, for poll, select or epoll */
+int oc_fd(oc_client_t *);
+
+/* move requests forward for up to timeout_ms (-1 without limit), running the callbacks of those completed; returns how many */
+int oc_process(oc_client_t *, int timeout_ms);
+
+/* send a command, it is encoded at once so cmd may be freed on return. With a
+ * callback the request is freed after it, otherwise by oc_free. NULL if out of memory */
+oc_request_t *oc_send(oc_client_t *, cmd_t *cmd, oc_callback_t, void *arg);
+
+/* run argv[0] with its arguments, its output going to out_file if not NULL */
+oc_request_t *oc_submit(oc_client_t *, char *const argv[], const char *out_file, oc_callback_t, void *arg);
+
+/* ask mem (cmd2), load (cmd5), cpu (cmd7), top (cmd9) or stats (cmd10), value being the optional pid, @array, n or job */
+oc_request_t *oc_query(oc_client_t *, enum cmd_type, const char *value, oc_callback_t, void *arg);
+
+/* kill the jobs of an array */
+oc_request_t *oc_kill(oc_client_t *, const char *array_ref, oc_callback_t, void *arg);
+
+/* suspend, or resume, a job or the jobs of an array given as id or @id */
+oc_request_t *oc_suspend(oc_client_t *, const char *ref, bool suspend, oc_callback_t, void *arg);
+
+/* process requests until this one completes, returns its status */
+enum oc_status oc_wait(oc_client_t *, oc_request_t *);
+
+/* status of a request */
+enum oc_status oc_status(const oc_request_t *);
+
+/* reply of a completed request, NULL if it failed or has none */
+const char *oc_reply(const oc_request_t *);
+
+/* free a request sent without a callback, a pending one completes unseen */
+void oc_free(oc_request_t *);
+
+#endif //PROCESS_OVERSEER_CLIENT_H
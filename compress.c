@@ -0,0 +1,337 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <lz.h>
+#include <handoff.h>
+#include <compress.h>
+
+#define CZ_EVENTS 64 /* events taken per wait */
+
+/* output of a job being compressed */
+typedef struct cz_stream {
+    int pipe_fd; /* read end of the pipe the job writes to, non blocking */
+    int file_fd; /* compressed output file */
+    char *file; /* path of the file, for errors */
+    uint8_t buf[LZ_BLOCK]; /* output not written yet */
+    size_t len; /* bytes in buf */
+    long long since; /* when the oldest byte in buf came, monotonic milliseconds */
+    bool failed; /* the file could not be written, the output is read and dropped */
+    struct cz_stream *next;
+} cz_stream_t;
+
+static cz_stream_t *streams = NULL; /* streams being compressed */
+static pthread_mutex_t stream_mutex = PTHREAD_MUTEX_INITIALIZER; /* guards the list, the thread removes */
+static int epoll_fd = -1; /* pipes of the streams and stop_fd */
+static int stop_fd = -1; /* wakes the thread up to stop */
+static pthread_t thread; /* compressing thread */
+static bool running = false; /* whether the thread runs */
+static uint8_t block[LZ_BOUND(LZ_BLOCK) + LZ_HEADER + LZ_TRAILER]; /* block being written, by one thread at a time */
+
+/**
+ * current monotonic time
+ * @return milliseconds
+ */
+static long long cz_now_ms(void) {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000LL + now.tv_nsec / 1000000;
+}
+
+/**
+ * write all bytes to the file of a stream. A stream failing once drops
+ * the rest of its output, the job keeps running
+ * @param a_stream stream
+ * @param data bytes to write
+ * @param n number of bytes
+ */
+static void cz_write(cz_stream_t *a_stream, const void *data, size_t n) {
+    while (n && !a_stream->failed) {
+        ssize_t written = write(a_stream->file_fd, data, n);
+        if (written == -1 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            fprintf(stderr, "cz_write: %s: %s, dropping its output\n", a_stream->file,
+                    written ? strerror(errno) : "nothing written");
+            a_stream->failed = true;
+            return;
+        }
+        data = (const uint8_t *) data + written;
+        n -= written;
+    }
+}
+
+/**
+ * write the output held by a stream as one block
+ * @param a_stream stream
+ */
+static void cz_flush(cz_stream_t *a_stream) {
+    if (a_stream->len) {
+        cz_write(a_stream, block, lz_block(a_stream->buf, a_stream->len, block));
+        a_stream->len = 0;
+    }
+}
+
+/**
+ * read what the pipe of a stream has, up to a full block which is then
+ * written
+ * @param a_stream stream
+ * @return bytes read, 0 once every writer closed the pipe, -1 on error (EAGAIN if it is empty)
+ */
+static ssize_t cz_read(cz_stream_t *a_stream) {
+    ssize_t n = read(a_stream->pipe_fd, a_stream->buf + a_stream->len, LZ_BLOCK - a_stream->len);
+
+    if (n > 0) {
+        if (!a_stream->len) {
+            a_stream->since = cz_now_ms();
+        }
+        a_stream->len += n;
+        if (a_stream->len == LZ_BLOCK) {
+            cz_flush(a_stream);
+        }
+    }
+    return n;
+}
+
+/**
+ * end a stream: write what it holds and the block ending the output, then
+ * close the pipe and file and forget the stream
+ * @param a_stream stream
+ */
+static void cz_end(cz_stream_t *a_stream) {
+    cz_flush(a_stream);
+    cz_write(a_stream, block, lz_block(a_stream->buf, 0, block));
+    close(a_stream->pipe_fd);
+    close(a_stream->file_fd);
+
+    pthread_mutex_lock(&stream_mutex);
+    cz_stream_t **link = &streams;
+    while (*link != a_stream) link = &(*link)->next;
+    *link = a_stream->next;
+    pthread_mutex_unlock(&stream_mutex);
+
+    free(a_stream->file);
+    free(a_stream);
+}
+
+/**
+ * start compressing a pipe into a file
+ * @param pipe_fd read end of the pipe
+ * @param file_fd file, its header already written
+ * @param file path of the file
+ * @return
+ *  true: if the pipe is watched
+ *  false: if out of memory or the pipe can't be watched
+ */
+static bool cz_track(int pipe_fd, int file_fd, const char *file) {
+    cz_stream_t *a_stream = (cz_stream_t *) malloc(sizeof(cz_stream_t));
+    if (!a_stream || !(a_stream->file = strdup(file ? file : ""))) {
+        fprintf(stderr, "cz_track: out of memory\n");
+        free(a_stream);
+        return false;
+    }
+    a_stream->pipe_fd = pipe_fd;
+    a_stream->file_fd = file_fd;
+    a_stream->len = 0;
+    a_stream->failed = false;
+    fcntl(pipe_fd, F_SETFL, fcntl(pipe_fd, F_GETFL) | O_NONBLOCK);
+
+    /* the thread ends a stream under the lock, so it can't see the pipe before the stream is listed */
+    struct epoll_event event = {.events = EPOLLIN, .data.ptr = a_stream};
+    pthread_mutex_lock(&stream_mutex);
+    bool watched = epoll_ctl(epoll_fd, EPOLL_CTL_ADD, pipe_fd, &event) == 0;
+    if (watched) {
+        a_stream->next = streams;
+        streams = a_stream;
+    }
+    pthread_mutex_unlock(&stream_mutex);
+
+    if (!watched) {
+        perror("epoll_ctl");
+        free(a_stream->file);
+        free(a_stream);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * set up the compression of the output of a job: write the header of the
+ * file and make the pipe the job writes to. The pipe is asked to be large
+ * so a burst of output doesn't stop the job while the thread catches up
+ * @param file_fd output file, opened for writing
+ * @param file path of the file
+ * @return write end of the pipe, close on exec, or -1 if the stream could not be set up
+ */
+int cz_open(int file_fd, const char *file) {
+    int pipe_fds[2];
+
+    if (write(file_fd, LZ_MAGIC, LZ_MAGIC_LEN) != LZ_MAGIC_LEN) {
+        fprintf(stderr, "cz_open: %s: %s\n", file, strerror(errno));
+        close(file_fd);
+        return -1;
+    }
+    if (pipe2(pipe_fds, O_CLOEXEC) == -1) {
+        perror("pipe2");
+        close(file_fd);
+        return -1;
+    }
+    fcntl(pipe_fds[1], F_SETPIPE_SZ, CZ_PIPE_SIZE);
+
+    if (!cz_track(pipe_fds[0], file_fd, file)) {
+        close(pipe_fds[0]);
+        close(pipe_fds[1]);
+        close(file_fd);
+        return -1;
+    }
+    return pipe_fds[1];
+}
+
+/**
+ * wait for output on the pipes and compress it. A block is written once
+ * full, or CZ_FLUSH_MS after its first byte came so a reader tailing the
+ * file sees slow output; the wait only has a timeout while some output is
+ * held
+ * @param data unused
+ * @return NULL
+ */
+static void *cz_loop(void *data) {
+    struct epoll_event events[CZ_EVENTS];
+
+    for (;;) {
+        int timeout = -1;
+        long long now = cz_now_ms();
+
+        pthread_mutex_lock(&stream_mutex);
+        for (cz_stream_t *a_stream = streams; a_stream; a_stream = a_stream->next) {
+            if (!a_stream->len) {
+                continue;
+            }
+            if (a_stream->since + CZ_FLUSH_MS <= now) {
+                cz_flush(a_stream);
+            } else if (timeout == -1 || a_stream->since + CZ_FLUSH_MS - now < timeout) {
+                timeout = (int) (a_stream->since + CZ_FLUSH_MS - now);
+            }
+        }
+        pthread_mutex_unlock(&stream_mutex);
+
+        int n = epoll_wait(epoll_fd, events, CZ_EVENTS, timeout);
+        if (n == -1 && errno != EINTR) {
+            perror("epoll_wait");
+            return NULL;
+        }
+
+        for (int i = 0; i < n; i++) {
+            cz_stream_t *a_stream = (cz_stream_t *) events[i].data.ptr;
+            if (!a_stream) {
+                return NULL;
+            }
+
+            ssize_t got = cz_read(a_stream);
+            if (got == 0 || (got == -1 && errno != EAGAIN && errno != EINTR)) {
+                if (got == -1) {
+                    fprintf(stderr, "cz_loop: %s: %s\n", a_stream->file, strerror(errno));
+                }
+                cz_end(a_stream);
+            }
+        }
+    }
+}
+
+/**
+ * start the compressing thread
+ * @return
+ *  true: if the thread runs
+ *  false: otherwise
+ */
+bool cz_start(void) {
+    if ((epoll_fd == -1 && (epoll_fd = epoll_create1(EPOLL_CLOEXEC)) == -1) ||
+        (stop_fd == -1 && (stop_fd = eventfd(0, EFD_CLOEXEC)) == -1)) {
+        perror("cz_start");
+        return false;
+    }
+
+    struct epoll_event event = {.events = EPOLLIN, .data.ptr = NULL};
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, stop_fd, &event) == -1 ||
+        pthread_create(&thread, NULL, cz_loop, NULL)) {
+        fprintf(stderr, "cz_start: could not create compressing thread\n");
+        return false;
+    }
+    running = true;
+    return true;
+}
+
+/**
+ * stop the compressing thread and write every block it held. On a hot
+ * restart the pipes and files stay open for the next image, which goes on
+ * where this one stopped: the pipes keep what wasn't read. Otherwise the
+ * jobs are gone, what is left in the pipes is compressed and every file
+ * ended
+ * @param finish whether to end the streams
+ */
+void cz_stop(bool finish) {
+    uint64_t one = 1;
+
+    if (running) {
+        if (write(stop_fd, &one, sizeof(one)) != sizeof(one)) {
+            perror("write eventfd");
+        }
+        pthread_join(thread, NULL);
+        running = false;
+    }
+
+    for (cz_stream_t *a_stream = streams, *next; a_stream; a_stream = next) {
+        next = a_stream->next;
+        if (!finish) {
+            cz_flush(a_stream);
+            continue;
+        }
+        ssize_t got;
+        while ((got = cz_read(a_stream)) > 0 || (got == -1 && errno == EINTR)) {}
+        cz_end(a_stream);
+    }
+}
+
+/**
+ * save the streams for a hot restart: their pipe, file and path
+ * @param state hot restart state
+ */
+void cz_save(FILE *state) {
+    int count = 0;
+
+    for (cz_stream_t *a_stream = streams; a_stream; a_stream = a_stream->next) count++;
+    ho_put_int(state, count);
+    for (cz_stream_t *a_stream = streams; a_stream; a_stream = a_stream->next) {
+        ho_put_fd(state, a_stream->pipe_fd);
+        ho_put_fd(state, a_stream->file_fd);
+        ho_put_str(state, a_stream->file);
+    }
+}
+
+/**
+ * take over the streams of the previous image, which appends to their files
+ * @param state hot restart state
+ */
+void cz_load(FILE *state) {
+    for (int n = (int) ho_get_int(state); n > 0 && ho_ok(state); n--) {
+        int pipe_fd = ho_get_fd(state), file_fd = ho_get_fd(state);
+        char *file = ho_get_str(state);
+
+        if (pipe_fd == -1 || file_fd == -1 || !cz_track(pipe_fd, file_fd, file)) {
+            fprintf(stderr, "cz_load: could not take %s over\n", file ? file : "a stream");
+            if (pipe_fd != -1) close(pipe_fd);
+            if (file_fd != -1) close(file_fd);
+        }
+        free(file);
+    }
+}
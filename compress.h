@@ -0,0 +1,27 @@
+#ifndef PROCESS_OVERSEER_COMPRESS_H
+#define PROCESS_OVERSEER_COMPRESS_H
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#define CZ_FLUSH_MS 1000 /* output is written at the latest this long after it came, so it can be tailed */
+#define CZ_PIPE_SIZE (1 << 20) /* pipe buffer asked for, a job only blocks once this much is waiting */
+
+/* start the thread compressing the output of the jobs run with -oz */
+bool cz_start(void);
+
+/* compress what is written to the returned pipe into file_fd, closed once every writer
+ * closed the pipe; -1 if the stream could not be set up, file_fd being closed then */
+int cz_open(int file_fd, const char *file);
+
+/* stop the thread, writing out what it holds. With finish, read the pipes
+ * dry and end every file; otherwise they stay open for cz_save */
+void cz_stop(bool finish);
+
+/* save the streams for a hot restart, once the thread stopped */
+void cz_save(FILE *state);
+
+/* take the streams saved by cz_save back */
+void cz_load(FILE *state);
+
+#endif //PROCESS_OVERSEER_COMPRESS_H
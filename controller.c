@@ -1,146 +1,207 @@
-//
-// Created by n10327622 on 12/09/2020.
-//
-
-#include <stdlib.h>
-#include <stdio.h>
-#include <unistd.h>
-#include <netinet/in.h>
-#include <memory.h>
-#include <helpers.h>
-#include <arpa/inet.h>
-
-/* send cmd from client to server*/
-void send_cmd(int, cmd_t *);
-
-/* send flag from client to server */
-void send_flag(int, flag_t *);
-
-/**
- * main method
- * @param argc number of arguments passed from cli
- * @param argv array of arguments passed from cli
- * @return exit successful or fail
- */
-int main(int argc, char **argv) {
-    int sock_fd; /* socket file descriptor */
-    struct sockaddr_in serverAddr; /* server address's information */
-    flag_t flag_arg[3];
-    cmd_t cmd_arg = {
-        .flag_size =  0,
-        .flag_arg =  flag_arg,
-        .file_size =  0,
-        .file_arg =  NULL
-    }; /* store arguments and options */
-
-    /* handle the arguments */
-    handle_args(argc, argv, &cmd_arg);
-
-    /* set up the socket */
-    if ((sock_fd = socket(AF_INET, SOCK_STREAM, 0)) == -1) {
-        perror("socket\n");
-        exit(EXIT_FAILURE);
-    }
-
-    /* set server's address information */
-    serverAddr.sin_addr = cmd_arg.host_addr; /* server address */
-    serverAddr.sin_port = htons(cmd_arg.port); /* server port */
-    serverAddr.sin_family = AF_INET; /* ipv4 family */
-    memset(&serverAddr.sin_zero, 0, sizeof(serverAddr.sin_zero)); /* pad 0s to sin_zero partition of the struct */
-
-    /* connect to server */
-    if (connect(sock_fd, (struct sockaddr *) &serverAddr, sizeof(struct sockaddr)) == -1) {
-        fprintf(stderr, "Could not connect to overseer at %s %d\n",
-                inet_ntoa(cmd_arg.host_addr), cmd_arg.port);
-        exit(EXIT_FAILURE);
-    }
-
-    /* send command set to server */
-    send_cmd(sock_fd, &cmd_arg);
-
-    /* receive the response if cmd type is 2 */
-    if (cmd_arg.type == cmd2) {
-        char *ret = recv_str(sock_fd);
-        printf("%s", ret);
-        free(ret);
-    }
-
-    /* close connection and exit */
-    close(sock_fd);
-    exit(EXIT_SUCCESS);
-}
-
-/**
- * send command argument struct from client to server
- * @param sock_fd server socket
- * @param cmd_arg command argument
- */
-void send_cmd(int sock_fd, cmd_t *cmd_arg) {
-    /* send command type */
-
-    uint32_t type = htonl(cmd_arg->type);
-    if (send(sock_fd, &type, sizeof(type), 0) == -1) {
-        perror("send");
-        exit(EXIT_FAILURE);
-    }
-
-    /* send flags */
-    /* send flag size */
-    uint32_t flag_size = htonl(cmd_arg->flag_size);
-    if (send(sock_fd, &flag_size, sizeof(flag_size), 0) == -1) {
-        perror("send");
-        exit(EXIT_FAILURE);
-    }
-
-    /* send flags arguments */
-    /* send if flag exist or not */
-    for (int i = 0; i < cmd_arg->flag_size; i++) {
-        if (cmd_arg->flag_arg) send_flag(sock_fd, cmd_arg->flag_arg + i);
-    }
-
-    /* send file arguments */
-    /* send file size */
-    uint32_t file_size = htonl(cmd_arg->file_size);
-    if (send(sock_fd, &file_size, sizeof(file_size), 0) == -1) {
-        perror("send");
-        exit(EXIT_FAILURE);
-    }
-
-    /* send file arguments */
-    for (int i = 0; i < cmd_arg->file_size; i++) {
-        if (!send_str(sock_fd, cmd_arg->file_arg[i])) {
-            fprintf(stderr, "error sending file arguments\n");
-            exit(EXIT_FAILURE);
-        }
-    }
-}
-
-/**
- * send flag struct from client to server
- * @param sock_fd server socket
- * @param flag_arg flag argument
- */
-void send_flag(int sock_fd, flag_t *flag_arg) {
-    /* send type */
-    uint32_t type = htonl(flag_arg->type);
-    if (send(sock_fd, &type, sizeof(type), 0) == -1) {
-        perror("send");
-        exit(EXIT_FAILURE);
-    }
-
-    /* send value */
-    /* send if value argument exist (in case of optional argument) */
-    uint16_t value_exist = flag_arg->value ? 1 : 0;
-    uint16_t netLen = htons(value_exist);
-    if (send(sock_fd, &netLen, sizeof(netLen), 0) == -1) {
-        perror("send");
-        exit(EXIT_FAILURE);
-    }
-
-    if (value_exist) {
-        if (!send_str(sock_fd, flag_arg->value)) {
-            fprintf(stderr, "error sending flag arguments\n");
-            exit(EXIT_FAILURE);
-        }
-    }
-}
\ No newline at end of file
+//
+// Created by n10327622 on 12/09/2020.
+//
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <memory.h>
+#include <helpers.h>
+#include <inttypes.h>
+#include <time.h>
+#include <jobtable.h>
+#include <resolve.h>
+#include <client.h>
+
+#define SUBMIT_ATTEMPTS 5 /* submissions of a job rejected by a full queue before giving up */
+
+/**
+ * print the job table a local overseer publishes in shared memory, without
+ * connecting to it: one line per running or recently finished job with its
+ * pid, latest and peak memory, job id (@array[index] for jobs of an array),
+ * state with the time spent suspended, start time and file
+ * @param port port of the overseer
+ * @return
+ *  true: if the table was read
+ *  false: if the overseer publishes no table
+ */
+static bool print_job_table(uint16_t port) {
+    const jt_table_t *table;
+    jt_slot_t job;
+    char id[32], state[64], start[TIME_BUFFER];
+    struct tm tm_info;
+
+    if (!port || !(table = jt_attach(port))) {
+        fprintf(stderr, "No job table of an overseer on port %u on this host\n", port);
+        return false;
+    }
+
+    for (uint32_t i = 0; i < table->num_slots; i++) {
+        if (!jt_read(table->slots + i, &job)) {
+            continue;
+        }
+
+        if (job.array_id) {
+            sprintf(id, "@%d[%d]", job.array_id, job.array_index);
+        } else {
+            sprintf(id, "%d", job.job_id);
+        }
+
+        int len;
+        if (job.state == jt_exited) {
+            len = sprintf(state, "exited:%d", job.status);
+        } else if (job.state == jt_signaled) {
+            len = sprintf(state, "killed:%d", job.status);
+        } else if (job.state == jt_suspended) {
+            len = sprintf(state, "suspended");
+        } else {
+            len = sprintf(state, "running");
+        }
+
+        /* time spent suspended so far, the current suspension included */
+        int64_t suspended = (int64_t) job.suspended_ms / 1000;
+        if (job.suspended_at) {
+            suspended += time(NULL) - job.suspended_at;
+        }
+        if (suspended || job.state == jt_suspended) {
+            sprintf(state + len, job.state == jt_suspended ? ":%" PRId64 "s" : ",suspended:%" PRId64 "s", suspended);
+        }
+
+        time_t started = (time_t) job.start;
+        localtime_r(&started, &tm_info);
+        strftime(start, TIME_BUFFER, "%Y-%m-%d %H:%M:%S", &tm_info);
+
+        printf("%d %" PRIu64 " %" PRIu64 " %s %s %s %s\n",
+               job.pid, job.mem, job.peak_mem, id, state, start, job.name);
+    }
+
+    jt_detach(table);
+    return true;
+}
+
+/**
+ * wait before submitting again to an overloaded overseer: at least the
+ * wait it suggested, up to half as long again so the controllers it
+ * rejected together don't all come back at once
+ * @param seconds wait suggested by the overseer
+ */
+static void back_off(int seconds) {
+    static bool seeded = false;
+    struct timespec delay;
+
+    if (!seeded) {
+        struct timespec now;
+        clock_gettime(CLOCK_REALTIME, &now);
+        srand((unsigned) (now.tv_nsec ^ getpid()));
+        seeded = true;
+    }
+
+    double wait = seconds * (1.0 + 0.5 * rand() / RAND_MAX);
+    delay.tv_sec = (time_t) wait;
+    delay.tv_nsec = (long) ((wait - (double) delay.tv_sec) * 1e9);
+    fprintf(stderr, "Overseer overloaded, submitting again in %.1fs\n", wait);
+    while (nanosleep(&delay, &delay) == -1);
+}
+
+/**
+ * main method
+ * @param argc number of arguments passed from cli
+ * @param argv array of arguments passed from cli
+ * @return exit successful or fail
+ */
+int main(int argc, char **argv) {
+    oc_client_t *client; /* connection to the overseer */
+    oc_request_t *request;
+    flag_t flag_arg[MAX_FLAGS];
+    cmd_t cmd_arg = {
+        .local_path = NULL,
+        .stdio_fds = {STDOUT_FILENO, STDERR_FILENO},
+        .flag_size =  0,
+        .flag_arg =  flag_arg,
+        .file_size =  0,
+        .file_arg =  NULL
+    }; /* store arguments and options */
+
+    /* handle the arguments */
+    handle_args(argc, argv, &cmd_arg);
+
+    /* mem --shm reads the job table of a local overseer, no connection needed */
+    flag_t *mem_flag = get_flag(&cmd_arg, mem);
+    if (mem_flag && mem_flag->value && strcmp(mem_flag->value, "--shm") == 0) {
+        exit(print_job_table(cmd_arg.port) ? EXIT_SUCCESS : EXIT_FAILURE);
+    }
+
+    if (cmd_arg.local_path) {
+        /* the local server's socket */
+        if (!(client = oc_open_local(cmd_arg.local_path, 1))) {
+            fprintf(stderr, "Socket path is too long: %s\n", cmd_arg.local_path);
+            exit(EXIT_FAILURE);
+        }
+
+        /* a job without out_file writes straight to our stdout and stderr */
+        if (cmd_arg.type == cmd1 && !get_flag(&cmd_arg, o) && !get_flag(&cmd_arg, oz) &&
+            !get_flag(&cmd_arg, array)) {
+            cmd_arg.flag_arg[cmd_arg.flag_size].type = stdio;
+            cmd_arg.flag_arg[cmd_arg.flag_size].value = NULL;
+            cmd_arg.flag_size++;
+        }
+    } else if (!(client = oc_open_addr((struct sockaddr *) &cmd_arg.host_addr, rs_len(&cmd_arg.host_addr), 1))) {
+        /* its address and port were set by handle_args */
+        exit(EXIT_FAILURE);
+    }
+
+    /* send command set to server and receive the response if the command
+     * has one, submitting again while a full queue rejects the job */
+    enum oc_status status;
+    for (int attempt = 1;; attempt++) {
+        if (!(request = oc_send(client, &cmd_arg, NULL, NULL))) {
+            fprintf(stderr, "out of memory\n");
+            exit(EXIT_FAILURE);
+        }
+
+        status = oc_wait(client, request);
+        int seconds = status == oc_ok ? retry_after(oc_reply(request)) : 0;
+        if (!seconds || attempt == SUBMIT_ATTEMPTS) {
+            break;
+        }
+        oc_free(request);
+        back_off(seconds);
+    }
+    if (status == oc_unreachable && cmd_arg.local_path) {
+        fprintf(stderr, "Could not connect to overseer at %s\n", cmd_arg.local_path);
+        exit(EXIT_FAILURE);
+    } else if (status == oc_unreachable) {
+        char address[RS_ADDRSTRLEN];
+        rs_format(&cmd_arg.host_addr, address);
+        fprintf(stderr, "Could not connect to overseer at %s %d\n", address, cmd_arg.port);
+        exit(EXIT_FAILURE);
+    } else if (status != oc_ok) {
+        fprintf(stderr, "Connection to overseer lost\n");
+        exit(EXIT_FAILURE);
+    }
+
+    const char *ret = oc_reply(request);
+    if (ret) {
+        /* errors reported by the overseer go to stderr */
+        if (strncmp(ret, "error:", 6) == 0) {
+            fprintf(stderr, "%s", ret);
+            exit(EXIT_FAILURE);
+        }
+        printf("%s", ret);
+
+        /* wait exits like the job did so scripts can test it */
+        int job_status;
+        if (cmd_arg.type == cmd6 && sscanf(ret, "exited with status %d", &job_status) == 1) {
+            exit(job_status);
+        } else if (cmd_arg.type == cmd6 && sscanf(ret, "killed by signal %d", &job_status) == 1) {
+            exit(128 + job_status);
+        } else if (cmd_arg.type == cmd6) { /* not executed or cancelled */
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    /* close connection and exit */
+    oc_free(request);
+    oc_close(client);
+    exit(EXIT_SUCCESS);
+}
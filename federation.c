@@ -0,0 +1,685 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <poll.h>
+#include <memory.h>
+#include <netdb.h>
+#include <pthread.h>
+#include <arpa/inet.h>
+#include <federation.h>
+#include <sketch.h>
+
+/* overseer a front routes jobs to */
+typedef struct backend {
+    char *name; /* host:port as given on the command line */
+    struct sockaddr_in addr; /* address of the backend */
+    bool up; /* answered the last health check */
+    unsigned long free_mem; /* available memory at the last health check */
+    int running; /* running jobs at the last health check */
+    int routed; /* jobs routed to it since the last health check */
+} backend_t;
+
+static backend_t backends[MAX_BACKENDS]; /* every backend of the front */
+static int num_backends = 0; /* number of backends, 0 unless federated */
+static pthread_mutex_t backend_mutex = PTHREAD_MUTEX_INITIALIZER; /* protects the backend state */
+static pthread_t health_thread; /* health check thread */
+static int health_quit_fd = -1; /* readable once the overseer quits */
+
+/**
+ * add a backend overseer given as host:port
+ * @param spec host:port of the backend
+ * @return
+ *  true: if the backend was added
+ *  false: if the spec is invalid or there are too many backends
+ */
+bool fed_add_backend(char *spec) {
+    struct hostent *he; /* host entry */
+    char host[MAX_BUFFER];
+    char *colon = strrchr(spec, ':');
+    long port;
+
+    if (num_backends == MAX_BACKENDS) {
+        fprintf(stderr, "Too many backends, at most %d\n", MAX_BACKENDS);
+        return false;
+    }
+
+    if (!colon || colon - spec >= MAX_BUFFER || (port = strtol(colon + 1, NULL, BASE10)) <= 0 || port > 65535) {
+        fprintf(stderr, "Backend must be given as host:port\n");
+        return false;
+    }
+    memcpy(host, spec, colon - spec);
+    host[colon - spec] = '\0';
+
+    if ((he = gethostbyname(host)) == NULL) {
+        herror("gethostbyname");
+        return false;
+    }
+
+    backend_t *b = backends + num_backends++;
+    b->name = spec;
+    b->addr.sin_family = AF_INET;
+    b->addr.sin_port = htons(port);
+    b->addr.sin_addr = *((struct in_addr *) he->h_addr);
+    memset(&b->addr.sin_zero, 0, sizeof(b->addr.sin_zero));
+    b->up = true; /* until the first health check says otherwise */
+
+    return true;
+}
+
+/**
+ * check if this overseer is a front routing to backends
+ * @return true if at least one backend is configured
+ */
+bool fed_enabled(void) {
+    return num_backends > 0;
+}
+
+/**
+ * connect to a backend, giving up after BACKEND_TIMEOUT_MS
+ * @param b backend to connect to
+ * @param timeout_ms give up on responses taking longer, -1 to wait for them
+ * @return the connected socket or -1 if the backend is unreachable
+ */
+static int backend_connect(backend_t *b, int timeout_ms) {
+    int sock_fd;
+
+    if ((sock_fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0)) == -1) {
+        perror("socket");
+        return -1;
+    }
+
+    if (connect(sock_fd, (struct sockaddr *) &b->addr, sizeof(b->addr)) == -1) {
+        struct pollfd pfd = {.fd = sock_fd, .events = POLLOUT};
+        int err = errno;
+        socklen_t len = sizeof(err);
+
+        /* wait for the connection to complete */
+        if (err != EINPROGRESS || poll(&pfd, 1, BACKEND_TIMEOUT_MS) != 1 ||
+            getsockopt(sock_fd, SOL_SOCKET, SO_ERROR, &err, &len) == -1 || err) {
+            close(sock_fd);
+            return -1;
+        }
+    }
+
+    /* the protocol helpers expect a blocking socket */
+    fcntl(sock_fd, F_SETFL, fcntl(sock_fd, F_GETFL) & ~O_NONBLOCK);
+
+    if (timeout_ms != -1) {
+        struct timeval tv = {.tv_sec = timeout_ms / 1000, .tv_usec = timeout_ms % 1000 * 1000};
+        setsockopt(sock_fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    }
+    return sock_fd;
+}
+
+/**
+ * longest time a backend may take to answer a command: a wait lasts as
+ * long as its job and memkill --free waits for the jobs it killed to exit
+ * @param cmd_arg command sent
+ * @return milliseconds, -1 for no bound
+ */
+static int reply_timeout(cmd_t *cmd_arg) {
+    if (cmd_arg->type == cmd6) {
+        return -1;
+    }
+    return get_flag(cmd_arg, memfree) ? BACKEND_TIMEOUT_MS + MEMKILL_TIMEOUT_MS : BACKEND_TIMEOUT_MS;
+}
+
+/**
+ * send a command to a backend and receive its response if it has one,
+ * giving up once the backend takes longer than the command allows so an
+ * accepting thread is never held by a stuck backend
+ * @param b backend
+ * @param cmd_arg command to send
+ * @param reply set to the response, NULL if the command has none
+ * @return
+ *  true: if the backend processed the command
+ *  false: if the backend is unreachable or too slow, it is then marked down
+ */
+static bool backend_call(backend_t *b, cmd_t *cmd_arg, char **reply) {
+    int sock_fd;
+    bool ok;
+
+    *reply = NULL;
+    if ((sock_fd = backend_connect(b, reply_timeout(cmd_arg))) == -1) {
+        ok = false;
+    } else {
+        ok = send_cmd(sock_fd, cmd_arg) && (!has_reply(cmd_arg) || (*reply = recv_str(sock_fd)));
+        close(sock_fd);
+    }
+
+    if (!ok) {
+        pthread_mutex_lock(&backend_mutex);
+        if (b->up) {
+            printf("%s - backend %s is down\n", get_time(), b->name);
+        }
+        b->up = false;
+        pthread_mutex_unlock(&backend_mutex);
+    }
+
+    return ok;
+}
+
+/**
+ * ask a backend for its load and update its state
+ * @param b backend to check
+ */
+static void check_backend(backend_t *b) {
+    cmd_t load_cmd = {.type = cmd5, .flag_size = 0, .file_size = 0};
+    unsigned long free_mem;
+    int running;
+    char *reply;
+
+    if (!backend_call(b, &load_cmd, &reply)) {
+        return;
+    }
+
+    if (sscanf(reply, "%lu %d", &free_mem, &running) == 2) {
+        pthread_mutex_lock(&backend_mutex);
+        if (!b->up) {
+            printf("%s - backend %s is up\n", get_time(), b->name);
+        }
+        b->up = true;
+        b->free_mem = free_mem;
+        b->running = running;
+        b->routed = 0;
+        pthread_mutex_unlock(&backend_mutex);
+    }
+    free(reply);
+}
+
+/**
+ * check every backend every HEALTH_INTERVAL_MS until the overseer quits
+ * @param data unused
+ * @return NULL
+ */
+static void *health_loop(void *data) {
+    struct pollfd quit_poll = {.fd = health_quit_fd, .events = POLLIN};
+
+    do {
+        for (int i = 0; i < num_backends; i++) {
+            check_backend(backends + i);
+        }
+    } while (poll(&quit_poll, 1, HEALTH_INTERVAL_MS) == 0);
+
+    return NULL;
+}
+
+/**
+ * start the health check thread
+ * @param quit_fd descriptor which becomes readable once the overseer quits
+ * @return
+ *  true: if the thread is running
+ *  false: if it could not be created
+ */
+bool fed_start(int quit_fd) {
+    health_quit_fd = quit_fd;
+
+    if (pthread_create(&health_thread, NULL, health_loop, NULL)) {
+        fprintf(stderr, "fed_start: could not create health check thread\n");
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * wait for the health check thread to stop
+ */
+void fed_stop(void) {
+    pthread_join(health_thread, NULL);
+}
+
+/**
+ * pick the least loaded backend which is up: fewest jobs, counting the ones
+ * routed since the last health check, then most available memory
+ * @param tried backends which already failed for this command
+ * @return the index of the backend or -1 if none is up
+ */
+static int pick_backend(bool *tried) {
+    int best = -1;
+
+    pthread_mutex_lock(&backend_mutex);
+    for (int i = 0; i < num_backends; i++) {
+        backend_t *b = backends + i;
+        if (!b->up || tried[i]) {
+            continue;
+        }
+
+        if (best == -1) {
+            best = i;
+            continue;
+        }
+
+        int load = b->running + b->routed;
+        int best_load = backends[best].running + backends[best].routed;
+        if (load < best_load || (load == best_load && b->free_mem > backends[best].free_mem)) {
+            best = i;
+        }
+    }
+
+    if (best != -1) {
+        backends[best].routed++;
+    }
+    pthread_mutex_unlock(&backend_mutex);
+
+    return best;
+}
+
+/**
+ * send a response to the client, an error if there is none
+ * @param client_fd client socket
+ * @param reply response of a backend, freed afterwards
+ */
+static void relay_reply(int client_fd, char *reply) {
+    if (!send_str(client_fd, reply ? reply : "error: no backend available\n")) {
+        fprintf(stderr, "error relaying backend response\n");
+    }
+    free(reply);
+}
+
+/**
+ * find the backend holding the jobs a job runs after and write their ids
+ * as the backend knows them. A backend only holds a job until its own jobs
+ * ended, so they must all run on the same one
+ * @param after ids given to -after, id[:ok|:any][,...]
+ * @param local receives the ids of the backend
+ * @param len size of local
+ * @return the backend or -1 if the ids are invalid or run on different backends
+ */
+static int after_backend(const char *after, char *local, size_t len) {
+    int idx = -1, used = 0;
+    char *end;
+
+    do {
+        long fed_id = strtol(after, &end, BASE10);
+        size_t cond_len = strcspn(end, ",");
+        if (fed_id <= 0 || FED_BACKEND(fed_id) >= num_backends || (idx != -1 && FED_BACKEND(fed_id) != idx)) {
+            return -1;
+        }
+        idx = FED_BACKEND(fed_id);
+        used += snprintf(local + used, len - used, "%s%ld%.*s", used ? "," : "", FED_LOCAL_ID(fed_id),
+                         (int) cond_len, end);
+        if ((size_t) used >= len) {
+            return -1;
+        }
+        end += cond_len;
+        after = end + 1;
+    } while (*end);
+
+    return idx;
+}
+
+/**
+ * route a run command to the least loaded backend, trying the next one if
+ * it turns out to be down or its queue is full. Job and job array ids are
+ * made unique across backends. A job run after other jobs goes to the
+ * backend running them, with their ids rewritten
+ * @param cmd_arg run command
+ * @param client_fd client socket
+ */
+static void route_job(cmd_t *cmd_arg, int client_fd) {
+    bool tried[MAX_BACKENDS] = {false};
+    char *reply = NULL, *overloaded = NULL, local_after[MAX_BUFFER];
+    flag_t *after = get_flag(cmd_arg, afterjob), flags[MAX_FLAGS];
+    cmd_t local_cmd = *cmd_arg;
+    int idx;
+
+    if (after) {
+        if ((idx = after_backend(after->value ? after->value : "", local_after, sizeof(local_after))) == -1) {
+            relay_reply(client_fd, strdup("error: -after names jobs of different backends or no job\n"));
+            return;
+        }
+
+        /* only that backend can hold the job */
+        memcpy(flags, cmd_arg->flag_arg, sizeof(flag_t) * cmd_arg->flag_size);
+        flags[after - cmd_arg->flag_arg].value = local_after;
+        local_cmd.flag_arg = flags;
+        for (int i = 0; i < num_backends; i++) {
+            tried[i] = i != idx;
+        }
+        cmd_arg = &local_cmd;
+    }
+
+    while ((idx = pick_backend(tried)) != -1) {
+        tried[idx] = true;
+        if (!backend_call(backends + idx, cmd_arg, &reply)) {
+            continue;
+        }
+        if (!retry_after(reply)) {
+            break;
+        }
+
+        /* a full backend rejected the job, keep the shortest wait in case every one does */
+        if (!overloaded || retry_after(reply) < retry_after(overloaded)) {
+            free(overloaded);
+            overloaded = reply;
+        } else {
+            free(reply);
+        }
+        reply = NULL;
+    }
+
+    if (idx == -1 && overloaded) {
+        reply = overloaded;
+        overloaded = NULL;
+    } else if (idx == -1) {
+        fprintf(stderr, "%s - no backend available for %s\n", get_time(), cmd_arg->file_arg[0]);
+    }
+    free(overloaded);
+
+    if (!has_reply(cmd_arg)) {
+        return;
+    }
+
+    /* rewrite the job or job array id of the backend */
+    char *end;
+    long id;
+    if (reply && (id = strtol(reply, &end, BASE10)) > 0 && *end == '\n') {
+        reply = realloc(reply, MAX_BUFFER);
+        sprintf(reply, "%ld\n", FED_ID(id, idx));
+    }
+    relay_reply(client_fd, reply);
+}
+
+/**
+ * forward a command about one job array (@id) or job (id) to the backend
+ * running it
+ * @param cmd_arg mem, cpu, kill, suspend, resume or wait command with an id value
+ * @param client_fd client socket
+ */
+static void route_ref(cmd_t *cmd_arg, int client_fd) {
+    char *ref = cmd_arg->flag_arg[0].value;
+    bool is_array = ref[0] == '@';
+    long fed_id = strtol(ref + is_array, NULL, BASE10);
+    char local_ref[MAX_BUFFER], *reply = NULL;
+
+    if (fed_id <= 0 || FED_BACKEND(fed_id) >= num_backends) {
+        relay_reply(client_fd, strdup(is_array ? "error: no such job array\n" : "error: no such job\n"));
+        return;
+    }
+
+    /* send the id the backend knows, with the other flags as they came */
+    flag_t flags[MAX_FLAGS];
+    cmd_t local_cmd = *cmd_arg;
+    sprintf(local_ref, is_array ? "@%ld" : "%ld", FED_LOCAL_ID(fed_id));
+    memcpy(flags, cmd_arg->flag_arg, sizeof(flag_t) * cmd_arg->flag_size);
+    flags[0].value = local_ref;
+    local_cmd.flag_arg = flags;
+
+    backend_call(backends + FED_BACKEND(fed_id), &local_cmd, &reply);
+    relay_reply(client_fd, reply);
+}
+
+/* wait forwarded to a backend by its own thread */
+typedef struct fed_wait {
+    int client_fd; /* client waiting for the job */
+    flag_t flag; /* wait flag holding the job id */
+} fed_wait_t;
+
+/**
+ * forward a wait to the backend running the job and relay the status once
+ * the job ended, then close the client
+ * @param data the forwarded wait
+ * @return NULL
+ */
+static void *wait_loop(void *data) {
+    fed_wait_t *a_wait = data;
+    cmd_t wait_cmd = {.type = cmd6, .flag_size = 1, .flag_arg = &a_wait->flag, .file_size = 0};
+
+    route_ref(&wait_cmd, a_wait->client_fd);
+
+    close(a_wait->client_fd);
+    free(a_wait->flag.value);
+    free(a_wait);
+    return NULL;
+}
+
+/**
+ * forward a wait without blocking the caller, the backend only answers
+ * once the job ended
+ * @param cmd_arg wait command
+ * @param client_fd client socket, owned by the waiting thread afterwards
+ * @return
+ *  true: if the client is handed to the waiting thread
+ *  false: if the client was answered and can be closed
+ */
+static bool route_wait(cmd_t *cmd_arg, int client_fd) {
+    fed_wait_t *a_wait = (fed_wait_t *) malloc(sizeof(fed_wait_t));
+    pthread_attr_t attr;
+    pthread_t thread;
+
+    if (!a_wait) {
+        relay_reply(client_fd, strdup("error: out of memory\n"));
+        return false;
+    }
+    a_wait->client_fd = client_fd;
+    a_wait->flag.type = waitjob;
+    a_wait->flag.value = strdup(cmd_arg->flag_arg[0].value);
+
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    bool started = pthread_create(&thread, &attr, wait_loop, a_wait) == 0;
+    pthread_attr_destroy(&attr);
+
+    if (!started) {
+        free(a_wait->flag.value);
+        free(a_wait);
+        relay_reply(client_fd, strdup("error: could not wait for job\n"));
+    }
+    return started;
+}
+
+/* line of a merged top list with the value it is ranked by */
+typedef struct top_line {
+    char *line;
+    double value;
+} top_line_t;
+
+/**
+ * order the lines of a top list, largest value first
+ * @param a first line
+ * @param b second line
+ * @return the comparison of their values
+ */
+static int compare_lines(const void *a, const void *b) {
+    double x = ((const top_line_t *) a)->value, y = ((const top_line_t *) b)->value;
+    return x < y ? 1 : x > y ? -1 : 0;
+}
+
+/**
+ * rank the top lists of every backend as one: the lines are ordered by the
+ * column of the key (memory, cpu, growth after the pid) and the first n kept
+ * @param merged concatenated lists, freed
+ * @param cmd_arg top command
+ * @return the merged list
+ */
+static char *merge_top(char *merged, cmd_t *cmd_arg) {
+    flag_t *key_flag = get_flag(cmd_arg, topkey);
+    int column = !key_flag || !key_flag->value || strcmp(key_flag->value, "cpu") ? 1 : 2;
+    long n = strtol(cmd_arg->flag_arg[0].value, NULL, BASE10);
+    int count = 0, capacity = 64;
+    top_line_t *lines = (top_line_t *) malloc(sizeof(top_line_t) * capacity);
+    char *save, *result;
+    size_t len = 0;
+
+    if (key_flag && key_flag->value && strcmp(key_flag->value, "growth") == 0) {
+        column = 3;
+    }
+
+    for (char *line = strtok_r(merged, "\n", &save); line; line = strtok_r(NULL, "\n", &save)) {
+        char *field = line;
+        for (int i = 0; i < column && field; i++) {
+            if ((field = strchr(field, ' '))) field++;
+        }
+        if (count == capacity) {
+            capacity *= 2;
+            lines = (top_line_t *) realloc(lines, sizeof(top_line_t) * capacity);
+        }
+        lines[count].line = line;
+        lines[count++].value = field ? strtod(field, NULL) : 0;
+    }
+    qsort(lines, count, sizeof(top_line_t), compare_lines);
+
+    result = calloc(1, 1);
+    for (int i = 0; i < count && i < n; i++) {
+        size_t line_len = strlen(lines[i].line);
+        result = realloc(result, len + line_len + 2);
+        memcpy(result + len, lines[i].line, line_len);
+        len += line_len;
+        result[len++] = '\n';
+        result[len] = '\0';
+    }
+
+    free(lines);
+    free(merged);
+    return result;
+}
+
+/* memory samples of a file merged over the backends */
+typedef struct stats_line {
+    char *file;
+    int jobs;
+    sketch_t sketch;
+} stats_line_t;
+
+/**
+ * merge the sketches every backend sent for stats, file by file, and write
+ * the quantiles of the merged ones like an overseer does
+ * @param merged concatenated lines of a sketch, number of jobs and file, freed
+ * @return the quantiles of every file
+ */
+static char *merge_stats(char *merged) {
+    int count = 0, capacity = 16;
+    stats_line_t *lines = (stats_line_t *) malloc(sizeof(stats_line_t) * capacity);
+    char *save, *end, *result;
+    size_t len = 0;
+    sketch_t sketch;
+
+    for (char *line = strtok_r(merged, "\n", &save); line; line = strtok_r(NULL, "\n", &save)) {
+        int jobs, i;
+        if (!sk_decode(&sketch, line, &end) || *end != ' ') continue;
+        jobs = (int) strtol(end + 1, &end, BASE10);
+        if (*end != ' ') continue;
+
+        for (i = 0; i < count && strcmp(lines[i].file, end + 1) != 0; i++);
+        if (i == count) {
+            if (count == capacity) {
+                capacity *= 2;
+                lines = (stats_line_t *) realloc(lines, sizeof(stats_line_t) * capacity);
+            }
+            lines[count].file = end + 1;
+            lines[count].jobs = 0;
+            sk_init(&lines[count++].sketch);
+        }
+        lines[i].jobs += jobs;
+        sk_merge(&lines[i].sketch, &sketch);
+    }
+
+    result = calloc(1, 1);
+    for (int i = 0; i < count; i++) {
+        result = realloc(result, len + strlen(lines[i].file) + 128);
+        len += sk_summary(&lines[i].sketch, result + len);
+        len += sprintf(result + len, " %d %s\n", lines[i].jobs, lines[i].file);
+    }
+
+    free(lines);
+    free(merged);
+    return result;
+}
+
+/**
+ * send a command to every backend which is up and merge their responses
+ * @param cmd_arg command to fan out
+ * @param client_fd client socket
+ */
+static void fan_out(cmd_t *cmd_arg, int client_fd) {
+    size_t len = 0;
+    char *merged = calloc(1, 1), *reply;
+    unsigned long total_free = 0;
+    int total_running = 0;
+    flag_t flags[MAX_FLAGS + 1];
+    cmd_t stats_cmd;
+
+    if (cmd_arg->type == cmd10) {
+        /* quantiles don't merge, ask for the sketches */
+        stats_cmd = *cmd_arg;
+        memcpy(flags, cmd_arg->flag_arg, sizeof(flag_t) * cmd_arg->flag_size);
+        flags[stats_cmd.flag_size].type = sketches;
+        flags[stats_cmd.flag_size++].value = NULL;
+        stats_cmd.flag_arg = flags;
+        cmd_arg = &stats_cmd;
+    }
+
+    for (int i = 0; i < num_backends; i++) {
+        pthread_mutex_lock(&backend_mutex);
+        bool up = backends[i].up;
+        pthread_mutex_unlock(&backend_mutex);
+
+        if (!up || !backend_call(backends + i, cmd_arg, &reply) || !reply) {
+            continue;
+        }
+
+        if (cmd_arg->type == cmd5) {
+            /* the load of the federation is the sum of its backends */
+            unsigned long free_mem;
+            int running;
+            if (sscanf(reply, "%lu %d", &free_mem, &running) == 2) {
+                total_free += free_mem;
+                total_running += running;
+            }
+        } else if (strncmp(reply, "error:", 6) != 0) {
+            size_t reply_len = strlen(reply);
+            merged = realloc(merged, len + reply_len + 1);
+            memcpy(merged + len, reply, reply_len + 1);
+            len += reply_len;
+        }
+        free(reply);
+    }
+
+    if (cmd_arg->type == cmd5) {
+        merged = realloc(merged, MAX_BUFFER);
+        sprintf(merged, "%lu %d\n", total_free, total_running);
+    } else if (cmd_arg->type == cmd9) {
+        merged = merge_top(merged, cmd_arg);
+    } else if (cmd_arg->type == cmd10) {
+        merged = merge_stats(merged);
+    }
+
+    if (has_reply(cmd_arg)) {
+        relay_reply(client_fd, merged);
+    } else {
+        free(merged);
+    }
+}
+
+/**
+ * process a command received by a front overseer: run commands go to the
+ * least loaded backend, commands about a job or job array go to the backend
+ * running it and everything else is fanned out to every backend
+ * @param cmd_arg command received from the client
+ * @param client_fd client socket
+ * @return
+ *  true: if the client is answered later and must be left open
+ *  false: if the client was answered and can be closed
+ */
+bool fed_process(cmd_t *cmd_arg, int client_fd) {
+    char *value = cmd_arg->flag_size ? cmd_arg->flag_arg[0].value : NULL;
+
+    if (cmd_arg->type == cmd1) {
+        route_job(cmd_arg, client_fd);
+    } else if (cmd_arg->type == cmd6 && value) {
+        return route_wait(cmd_arg, client_fd);
+    } else if ((cmd_arg->type == cmd2 || cmd_arg->type == cmd4 || cmd_arg->type == cmd7) && value && value[0] == '@') {
+        route_ref(cmd_arg, client_fd);
+    } else if ((cmd_arg->type == cmd11 || cmd_arg->type == cmd12) && value) {
+        route_ref(cmd_arg, client_fd);
+    } else if (cmd_arg->type == cmd10 && value && value[0] >= '0' && value[0] <= '9') {
+        /* the quantiles of a job come from the backend which ran it */
+        route_ref(cmd_arg, client_fd);
+    } else {
+        fan_out(cmd_arg, client_fd);
+    }
+    return false;
+}
@@ -0,0 +1,32 @@
+#ifndef PROCESS_OVERSEER_FEDERATION_H
+#define PROCESS_OVERSEER_FEDERATION_H
+
+#include <stdbool.h>
+#include <helpers.h>
+
+#define MAX_BACKENDS 16 /* maximum number of backends of a front overseer */
+#define HEALTH_INTERVAL_MS 2000 /* time between two health checks */
+#define BACKEND_TIMEOUT_MS 1000 /* connect and health check timeout */
+
+/* ids of a backend are made unique across the federation by the front */
+#define FED_ID(id, backend) ((id) * MAX_BACKENDS + (backend))
+#define FED_LOCAL_ID(fed_id) ((fed_id) / MAX_BACKENDS)
+#define FED_BACKEND(fed_id) ((fed_id) % MAX_BACKENDS)
+
+/* add a backend given as host:port */
+bool fed_add_backend(char *spec);
+
+/* check if this overseer is a front routing to backends */
+bool fed_enabled(void);
+
+/* start the health check thread, it stops once quit_fd is readable */
+bool fed_start(int quit_fd);
+
+/* wait for the health check thread to stop */
+void fed_stop(void);
+
+/* route or fan out a command received by the front, the caller frees it.
+ * Returns true if the client is answered later and must be left open */
+bool fed_process(cmd_t *cmd_arg, int client_fd);
+
+#endif //PROCESS_OVERSEER_FEDERATION_H
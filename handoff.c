@@ -0,0 +1,294 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <handoff.h>
+
+/**
+ * create the state of a hot restart. A memfd has no size limit and needs no
+ * reader while it is written, the new image only exists after execve
+ * @return the state open for writing or NULL if failed
+ */
+FILE *ho_create(void) {
+    int fd;
+    FILE *state;
+
+    /* close on exec until ho_exec hands it over */
+    if ((fd = memfd_create("overseer-handoff", MFD_CLOEXEC)) == -1) {
+        perror("memfd_create");
+        return NULL;
+    }
+    if (!(state = fdopen(fd, "w+"))) {
+        perror("fdopen");
+        close(fd);
+        return NULL;
+    }
+
+    ho_put_int(state, HO_MAGIC);
+    ho_put_int(state, HO_VERSION);
+    return state;
+}
+
+/**
+ * open the state written by the old overseer
+ * @param fd inherited memfd
+ * @return the state open for reading or NULL if it isn't one
+ */
+FILE *ho_open(int fd) {
+    FILE *state;
+
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    if (!(state = fdopen(fd, "r"))) {
+        perror("fdopen");
+        return NULL;
+    }
+
+    if (ho_get_int(state) != HO_MAGIC) {
+        fprintf(stderr, "descriptor %d holds no hot restart state\n", fd);
+        fclose(state);
+        return NULL;
+    }
+    if (ho_get_int(state) != HO_VERSION) {
+        fprintf(stderr, "the hot restart state was written by an incompatible overseer\n");
+        fclose(state);
+        return NULL;
+    }
+    return state;
+}
+
+/**
+ * write an integer
+ * @param state state being written
+ * @param n value
+ */
+void ho_put_int(FILE *state, int64_t n) {
+    fwrite(&n, sizeof(n), 1, state);
+}
+
+/**
+ * write a string as its length and bytes, -1 for NULL
+ * @param state state being written
+ * @param str string or NULL
+ */
+void ho_put_str(FILE *state, const char *str) {
+    ho_put_int(state, str ? (int64_t) strlen(str) : -1);
+    if (str) {
+        fwrite(str, 1, strlen(str), state);
+    }
+}
+
+/**
+ * write raw bytes
+ * @param state state being written
+ * @param data bytes
+ * @param len number of bytes
+ */
+void ho_put_bytes(FILE *state, const void *data, size_t len) {
+    fwrite(data, 1, len, state);
+}
+
+/**
+ * write a descriptor and keep it open across execve
+ * @param state state being written
+ * @param fd descriptor, -1 for none
+ */
+void ho_put_fd(FILE *state, int fd) {
+    if (fd != -1) {
+        fcntl(fd, F_SETFD, 0);
+    }
+    ho_put_int(state, fd);
+}
+
+/**
+ * write a command: its type, flags and file arguments. Passed descriptors
+ * are not part of it
+ * @param state state being written
+ * @param cmd_arg command
+ */
+void ho_put_cmd(FILE *state, cmd_t *cmd_arg) {
+    ho_put_int(state, cmd_arg->type);
+    ho_put_int(state, cmd_arg->flag_size);
+    for (int i = 0; i < cmd_arg->flag_size; i++) {
+        ho_put_int(state, cmd_arg->flag_arg[i].type);
+        ho_put_str(state, cmd_arg->flag_arg[i].value);
+    }
+    ho_put_int(state, cmd_arg->file_size);
+    for (int i = 0; i < cmd_arg->file_size; i++) {
+        ho_put_str(state, cmd_arg->file_arg[i]);
+    }
+}
+
+/**
+ * read an integer
+ * @param state state being read
+ * @return the value, 0 once the state is exhausted
+ */
+int64_t ho_get_int(FILE *state) {
+    int64_t n = 0;
+
+    if (fread(&n, sizeof(n), 1, state) != 1) {
+        return 0;
+    }
+    return n;
+}
+
+/**
+ * read a string
+ * @param state state being read
+ * @return the string to free, NULL if it was NULL or missing
+ */
+char *ho_get_str(FILE *state) {
+    int64_t len = ho_get_int(state);
+    char *str;
+
+    if (len < 0 || !(str = (char *) malloc(len + 1))) {
+        return NULL;
+    }
+    if (fread(str, 1, len, state) != (size_t) len) {
+        free(str);
+        return NULL;
+    }
+    str[len] = '\0';
+
+    return str;
+}
+
+/**
+ * read raw bytes
+ * @param state state being read
+ * @param data receives the bytes
+ * @param len number of bytes
+ */
+void ho_get_bytes(FILE *state, void *data, size_t len) {
+    if (fread(data, 1, len, state) != len) {
+        memset(data, 0, len);
+    }
+}
+
+/**
+ * read an inherited descriptor, it is close on exec again
+ * @param state state being read
+ * @return the descriptor, -1 for none
+ */
+int ho_get_fd(FILE *state) {
+    int fd = (int) ho_get_int(state);
+
+    if (fd >= 0) {
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+    }
+    return fd >= 0 ? fd : -1;
+}
+
+/**
+ * read a command written by ho_put_cmd
+ * @param state state being read
+ * @return the command, allocated like recv_cmd does
+ */
+cmd_t *ho_get_cmd(FILE *state) {
+    cmd_t *cmd_arg = (cmd_t *) calloc(1, sizeof(cmd_t));
+
+    cmd_arg->stdio_fds[0] = cmd_arg->stdio_fds[1] = -1;
+    cmd_arg->type = (enum cmd_type) ho_get_int(state);
+    cmd_arg->flag_size = (int) ho_get_int(state);
+    if (cmd_arg->flag_size < 0 || cmd_arg->flag_size > MAX_FLAGS) {
+        cmd_arg->flag_size = 0;
+    }
+    cmd_arg->flag_arg = (flag_t *) malloc(sizeof(flag_t) * MAX_FLAGS);
+    for (int i = 0; i < cmd_arg->flag_size; i++) {
+        cmd_arg->flag_arg[i].type = (enum flag_type) ho_get_int(state);
+        cmd_arg->flag_arg[i].value = ho_get_str(state);
+    }
+
+    cmd_arg->file_size = (int) ho_get_int(state);
+    if (cmd_arg->file_size < 0) {
+        cmd_arg->file_size = 0;
+    }
+    cmd_arg->file_arg = (char **) malloc(sizeof(char *) * (cmd_arg->file_size + 1));
+    for (int i = 0; i < cmd_arg->file_size; i++) {
+        if (!(cmd_arg->file_arg[i] = ho_get_str(state))) {
+            cmd_arg->file_arg[i] = strdup("");
+        }
+    }
+    cmd_arg->file_arg[cmd_arg->file_size] = NULL;
+
+    return cmd_arg;
+}
+
+/**
+ * write a quantile sketch
+ * @param state state being written
+ * @param sk sketch
+ */
+void ho_put_sketch(FILE *state, const sketch_t *sk) {
+    ho_put_int(state, (int64_t) sk->count);
+    ho_put_int(state, (int64_t) sk->zeros);
+    ho_put_int(state, (int64_t) sk->min);
+    ho_put_int(state, (int64_t) sk->max);
+    ho_put_int(state, sk->offset);
+    ho_put_bytes(state, sk->counts, sizeof(sk->counts));
+}
+
+/**
+ * read a quantile sketch written by ho_put_sketch
+ * @param state state being read
+ * @param sk receives the sketch
+ */
+void ho_get_sketch(FILE *state, sketch_t *sk) {
+    sk->count = (uint64_t) ho_get_int(state);
+    sk->zeros = (uint64_t) ho_get_int(state);
+    sk->min = (uint64_t) ho_get_int(state);
+    sk->max = (uint64_t) ho_get_int(state);
+    sk->offset = (int32_t) ho_get_int(state);
+    ho_get_bytes(state, sk->counts, sizeof(sk->counts));
+}
+
+/**
+ * check that no read ran past the end of the state
+ * @param state state being read
+ * @return
+ *  true: if the state was complete so far
+ *  false: if it was truncated or unreadable
+ */
+bool ho_ok(FILE *state) {
+    return !ferror(state) && !feof(state);
+}
+
+/**
+ * replace the process with a new image of the overseer. It gets the same
+ * arguments plus -takeover <fd> and keeps the pid, so the jobs stay its
+ * children. The old -takeover of a restarted overseer is dropped
+ * @param state complete state, still open for writing
+ * @param path binary to run
+ * @param argv arguments the overseer was started with
+ */
+void ho_exec(FILE *state, const char *path, char **argv) {
+    char fd_arg[16];
+    int argc = 0, n = 0;
+
+    if (fflush(state) || fseek(state, 0, SEEK_SET)) {
+        perror("handoff state");
+        return;
+    }
+    fcntl(fileno(state), F_SETFD, 0);
+    sprintf(fd_arg, "%d", fileno(state));
+
+    while (argv[argc]) argc++;
+    char **args = (char **) malloc(sizeof(char *) * (argc + 3));
+    args[n++] = argv[0];
+    args[n++] = "-takeover";
+    args[n++] = fd_arg;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-takeover") == 0 || strcmp(argv[i], "--takeover") == 0) {
+            i++;
+            continue;
+        }
+        args[n++] = argv[i];
+    }
+    args[n] = NULL;
+
+    execv(path, args);
+    perror("execv");
+    free(args);
+}
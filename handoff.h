@@ -0,0 +1,62 @@
+#ifndef PROCESS_OVERSEER_HANDOFF_H
+#define PROCESS_OVERSEER_HANDOFF_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <helpers.h>
+#include <sketch.h>
+
+#define HO_MAGIC 0x6f76686f /* first word of a hot restart state */
+#define HO_VERSION 8 /* second word, bumped whenever the layout of the state changes */
+
+/* state of a hot restart: written by the old overseer into a memfd which
+ * the new image reads back after execve. Descriptors are inherited */
+FILE *ho_create(void);
+
+/* open the state passed to the new image */
+FILE *ho_open(int fd);
+
+/* write an integer */
+void ho_put_int(FILE *, int64_t);
+
+/* write a string, NULL included */
+void ho_put_str(FILE *, const char *);
+
+/* write raw bytes */
+void ho_put_bytes(FILE *, const void *, size_t);
+
+/* write a descriptor kept open across execve */
+void ho_put_fd(FILE *, int fd);
+
+/* write a command */
+void ho_put_cmd(FILE *, cmd_t *);
+
+/* read an integer, 0 once the state is exhausted */
+int64_t ho_get_int(FILE *);
+
+/* read a string, NULL if it was NULL */
+char *ho_get_str(FILE *);
+
+/* read raw bytes */
+void ho_get_bytes(FILE *, void *, size_t);
+
+/* read an inherited descriptor, close on exec again */
+int ho_get_fd(FILE *);
+
+/* read a command, freed like a received one */
+cmd_t *ho_get_cmd(FILE *);
+
+/* write a quantile sketch */
+void ho_put_sketch(FILE *, const sketch_t *);
+
+/* read a quantile sketch */
+void ho_get_sketch(FILE *, sketch_t *);
+
+/* check that everything read so far was there */
+bool ho_ok(FILE *);
+
+/* replace the process with path, passing it the state. Returns only on failure */
+void ho_exec(FILE *, const char *path, char **argv);
+
+#endif //PROCESS_OVERSEER_HANDOFF_H
@@ -0,0 +1,202 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <heap.h>
+
+/**
+ * swap two entries and the positions their items keep
+ * @param entries entries of a heap
+ * @param i first entry
+ * @param j second entry
+ */
+static void heap_swap(heap_entry_t *entries, int i, int j) {
+    heap_entry_t tmp = entries[i];
+
+    entries[i] = entries[j];
+    entries[j] = tmp;
+    *entries[i].pos = i;
+    *entries[j].pos = j;
+}
+
+/**
+ * move an entry towards the root while its key is larger than its parent's
+ * @param a_heap heap
+ * @param i entry
+ * @return the new position of the entry
+ */
+static int sift_up(heap_t *a_heap, int i) {
+    while (i > 0 && a_heap->entries[(i - 1) / 2].key < a_heap->entries[i].key) {
+        heap_swap(a_heap->entries, i, (i - 1) / 2);
+        i = (i - 1) / 2;
+    }
+
+    return i;
+}
+
+/**
+ * move an entry towards the leaves while a child has a larger key
+ * @param a_heap heap
+ * @param i entry
+ */
+static void sift_down(heap_t *a_heap, int i) {
+    for (;;) {
+        int largest = i, left = 2 * i + 1, right = left + 1;
+
+        if (left < a_heap->size && a_heap->entries[left].key > a_heap->entries[largest].key) {
+            largest = left;
+        }
+        if (right < a_heap->size && a_heap->entries[right].key > a_heap->entries[largest].key) {
+            largest = right;
+        }
+        if (largest == i) {
+            return;
+        }
+
+        heap_swap(a_heap->entries, i, largest);
+        i = largest;
+    }
+}
+
+/**
+ * insert an item
+ * @param a_heap heap
+ * @param item item
+ * @param key key of the item
+ * @param pos where the item keeps its position
+ * @return
+ *  true: if the item was inserted
+ *  false: if out of memory
+ */
+bool heap_insert(heap_t *a_heap, void *item, double key, int *pos) {
+    if (a_heap->size == a_heap->capacity) {
+        int capacity = a_heap->capacity ? a_heap->capacity * 2 : 64;
+        heap_entry_t *entries = (heap_entry_t *) realloc(a_heap->entries, capacity * sizeof(heap_entry_t));
+        if (!entries) {
+            fprintf(stderr, "heap_insert: out of memory\n");
+            return false;
+        }
+        a_heap->entries = entries;
+        a_heap->capacity = capacity;
+    }
+
+    heap_entry_t *entry = a_heap->entries + a_heap->size;
+    entry->key = key;
+    entry->item = item;
+    entry->pos = pos;
+    *pos = a_heap->size++;
+    sift_up(a_heap, *pos);
+
+    return true;
+}
+
+/**
+ * change the key of an item
+ * @param a_heap heap
+ * @param pos position of the item
+ * @param key new key
+ */
+void heap_update(heap_t *a_heap, int pos, double key) {
+    double old = a_heap->entries[pos].key;
+
+    a_heap->entries[pos].key = key;
+    if (key > old) {
+        sift_up(a_heap, pos);
+    } else if (key < old) {
+        sift_down(a_heap, pos);
+    }
+}
+
+/**
+ * remove an item, the last entry takes its place
+ * @param a_heap heap
+ * @param pos position of the item
+ */
+void heap_remove(heap_t *a_heap, int pos) {
+    int last = --a_heap->size;
+
+    *a_heap->entries[pos].pos = -1;
+    if (pos == last) {
+        return;
+    }
+
+    a_heap->entries[pos] = a_heap->entries[last];
+    *a_heap->entries[pos].pos = pos;
+    if (sift_up(a_heap, pos) == pos) {
+        sift_down(a_heap, pos);
+    }
+}
+
+/**
+ * copy the n largest entries without changing the heap. The candidates are
+ * the children of the entries taken so far, kept in a second heap of
+ * positions, so this takes O(n log n) whatever the size of the heap
+ * @param a_heap heap
+ * @param n number of entries wanted
+ * @param top receives the entries, largest first
+ * @return the number of entries copied, less than n if the heap is smaller
+ */
+int heap_top(const heap_t *a_heap, int n, heap_entry_t *top) {
+    int count = 0, num_candidates = 0;
+
+    if (n > a_heap->size) {
+        n = a_heap->size;
+    }
+    if (n <= 0) {
+        return 0;
+    }
+
+    /* every entry taken adds at most one candidate net, n + 1 of them at most */
+    int *candidates = (int *) malloc(sizeof(int) * (n + 1));
+    if (!candidates) {
+        fprintf(stderr, "heap_top: out of memory\n");
+        return 0;
+    }
+    candidates[num_candidates++] = 0;
+
+    while (count < n && num_candidates) {
+        /* take the largest candidate */
+        int best = candidates[0];
+        top[count++] = a_heap->entries[best];
+        candidates[0] = candidates[--num_candidates];
+        for (int i = 0;;) {
+            int largest = i, left = 2 * i + 1, right = left + 1;
+            if (left < num_candidates &&
+                a_heap->entries[candidates[left]].key > a_heap->entries[candidates[largest]].key) {
+                largest = left;
+            }
+            if (right < num_candidates &&
+                a_heap->entries[candidates[right]].key > a_heap->entries[candidates[largest]].key) {
+                largest = right;
+            }
+            if (largest == i) break;
+            int tmp = candidates[i];
+            candidates[i] = candidates[largest];
+            candidates[largest] = tmp;
+            i = largest;
+        }
+
+        /* its children become candidates */
+        for (int child = 2 * best + 1; child <= 2 * best + 2 && child < a_heap->size; child++) {
+            int i = num_candidates++;
+            candidates[i] = child;
+            while (i > 0 && a_heap->entries[candidates[(i - 1) / 2]].key < a_heap->entries[candidates[i]].key) {
+                int tmp = candidates[i];
+                candidates[i] = candidates[(i - 1) / 2];
+                candidates[(i - 1) / 2] = tmp;
+                i = (i - 1) / 2;
+            }
+        }
+    }
+
+    free(candidates);
+    return count;
+}
+
+/**
+ * free the entries of a heap, the items are left alone
+ * @param a_heap heap
+ */
+void heap_free(heap_t *a_heap) {
+    free(a_heap->entries);
+    a_heap->entries = NULL;
+    a_heap->size = a_heap->capacity = 0;
+}
@@ -0,0 +1,35 @@
+#ifndef PROCESS_OVERSEER_HEAP_H
+#define PROCESS_OVERSEER_HEAP_H
+
+#include <stdbool.h>
+
+/* entry of a heap, the item keeps its position in pos */
+typedef struct heap_entry {
+    double key;
+    void *item;
+    int *pos; /* index of the entry, -1 once removed */
+} heap_entry_t;
+
+/* indexed binary max-heap: items know their position so their key can
+ * change or they can leave in O(log n) */
+typedef struct heap {
+    heap_entry_t *entries;
+    int size, capacity;
+} heap_t;
+
+/* insert an item, false if out of memory */
+bool heap_insert(heap_t *, void *item, double key, int *pos);
+
+/* change the key of the item at pos */
+void heap_update(heap_t *, int pos, double key);
+
+/* remove the item at pos */
+void heap_remove(heap_t *, int pos);
+
+/* copy the n largest entries in decreasing order, returns how many were copied */
+int heap_top(const heap_t *, int n, heap_entry_t *top);
+
+/* free the entries */
+void heap_free(heap_t *);
+
+#endif //PROCESS_OVERSEER_HEAP_H
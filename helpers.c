@@ -1,296 +1,850 @@
-//
-// Created by Asus on 9/12/2020.
-//
-
-#include <stdlib.h>
-#include <stdio.h>
-#include <stdbool.h>
-#include <memory.h>
-#include <netdb.h>
-#include <getopt.h>
-#include <helpers.h>
-#include <time.h>
-
-char current_time[TIME_BUFFER]; /* time buffer */
-
-/**
- * print usage on error or help
- * @param msg error message to be display
- * @param type
- *  if type is error: print to stderr
- *  if type is help: print to stdout
- */
-void print_usage(char *msg, enum usage type) {
-    char *usage = "Usage: controller <address> <port> "
-                  "{[-o out_file] [-log log_file] [-t seconds] <file> [arg...] | "
-                  "mem [pid] | memkill <percent>}";
-
-    if (type == help) {
-        printf("%s\n%s\n", msg, usage);
-    } else if (type == error) {
-        fprintf(stderr, "%s\n%s\n", msg, usage);
-    }
-}
-
-/**
- * pass command argument into the cmd_t struct based on the given
- * arguments and option flags from command line
- * @param argc number of arguments
- * @param argv array of arguments
- * @param cmd_arg command argument struct
- */
-void handle_args(int argc, char **argv, cmd_t *cmd_arg) {
-    struct hostent *he; /* host entry */
-    uint16_t port; /* host's port */
-
-    /* if not help there must be at least 4 arguments */
-    if (argc < 4) {
-        print_usage("Too few arguments", error);
-        exit(EXIT_FAILURE);
-    }
-
-    /* if there is only 2 argument and it's --help */
-    if (strcmp(argv[1], "--help") == 0) {
-        if (argc == 2) {
-            print_usage("Help Menu:", help);
-            exit(EXIT_SUCCESS);
-        } else {
-            print_usage("Too many arguments for 'help' cmd", error);
-            exit(EXIT_FAILURE);
-        }
-    }
-
-    /* get the address */
-    if ((he = gethostbyname(argv[1])) == NULL) {
-        herror("gethostbyname\n");
-        exit(EXIT_FAILURE);
-    }
-    cmd_arg->host_addr = *((struct in_addr *) he->h_addr);
-
-    /* get the port from second argument */
-    if (!(port = strtol(argv[2], NULL, BASE10))) {
-        print_usage("Port must between 1 to 65535", error);
-        exit(EXIT_FAILURE);
-    }
-
-    cmd_arg->port = port;
-
-    /* check if third argument is mem kill or mem */
-    if (strcmp(argv[3], "mem") == 0) {
-        /* set up mem flag's value */
-        cmd_arg->type = cmd2;
-        cmd_arg->flag_arg->type = mem;
-        cmd_arg->flag_arg->value = NULL;
-        cmd_arg->flag_size++;
-
-        if (argv[4]) { /* get the optional argument */
-            cmd_arg->flag_arg->value = argv[4];
-        }
-
-        /* return */
-        if (argc < 6) return;
-        else {
-            print_usage("Too many arguments for 'mem' cmd", error);
-            exit(EXIT_FAILURE);
-        }
-    } else if (strcmp(argv[3], "memkill") == 0) {
-        /* setup mem kill flag */
-        cmd_arg->type = cmd3;
-        cmd_arg->flag_arg->type = memkill;
-        cmd_arg->flag_arg->value = NULL;
-        cmd_arg->flag_size++;
-
-        if (argv[4]) { /* get the required argument */
-            cmd_arg->flag_arg->value = argv[4];
-        } else {
-            print_usage("Please specify percentage for memkill", error);
-            exit(EXIT_FAILURE);
-        }
-
-        /* return */
-
-        if (argc < 6) return;
-        else {
-            print_usage("Too many arguments for 'memkill' cmd", error);
-            exit(EXIT_FAILURE);
-        }
-    }
-
-    /* When we get here we know that cmd set 2 and 3 is not set, we only consider cmd set 1 */
-
-    opterr = 0; /* disable error message for get opt in case there is argument from the executable file */
-    int ch; /* character value when iterating through argv */
-    bool isFlag = false; /* track if any flag in the first command group is set */
-    int cmd1_args = 0; /* arguments counter for first command set to determine the position of the file */
-    int oFlag = 0, lFlag = 0, tFlag = 0; /* position of flags in first command set */
-
-    /* Executable file pointer */
-    cmd_arg->file_size = 0;
-
-    flag_t *first_arg = cmd_arg->flag_arg; /* head of flag_arg array */
-
-    /* option string for get opt method*/
-    const char *const short_options = "o:t:";
-    static struct option long_options[] = {
-            {"log", required_argument, NULL, 'l'},
-            {NULL, 0,                  NULL, 0}
-    };
-
-    while ((ch = getopt_long_only(argc, argv, short_options, long_options, NULL)) != -1) {
-        switch (ch) {
-            case 'o':
-                /* create flag for output */
-                cmd_arg->flag_arg->type = o;
-                cmd_arg->flag_arg->value = optarg;
-                cmd_arg->flag_arg++;
-                cmd_arg->flag_size++;
-
-                isFlag = true; /* set the command set 1 to true */
-                oFlag = optind - 1; /* set the position of output flag */
-                cmd1_args += 2; /* increment argument counter for first command set */
-
-                /* if log flag or time flag exist before o flag return error */
-                if (lFlag || tFlag) {
-                    print_usage("Wrong command syntax", error);
-                    exit(EXIT_FAILURE);
-                }
-
-                break;
-            case 'l':
-                /* create flag for log */
-                cmd_arg->flag_arg->type = log;
-                cmd_arg->flag_arg->value = optarg;
-                cmd_arg->flag_arg++;
-                cmd_arg->flag_size++;
-
-                isFlag = true; /* set command set 1 to true */
-                lFlag = optind - 1;  /* set the position of lflag */
-                cmd1_args += 2; /* increment argument counter for command set 1*/
-
-                /* if out flag is already created before its next flag is going to be log flag*/
-
-
-                /* check if time flag exists or if
-                 * there is anything between log flag and output flag if output flag exists*/
-                if (tFlag || (oFlag && oFlag != lFlag - 2)) {
-                    print_usage("Wrong command syntax", error);
-                    exit(EXIT_FAILURE);
-                }
-
-                break;
-            case 't':
-                /* create flag for time */
-                cmd_arg->flag_arg->type = t;
-                cmd_arg->flag_arg->value = optarg;
-                cmd_arg->flag_arg++;
-                cmd_arg->flag_size++;
-
-                isFlag = true; /* set the first command set to true */
-                tFlag = optind - 1; /* store the position of the time flag */
-                cmd1_args += 2; /* increment the argument counter of first command set */
-
-                /* check if there is anything between the time flag and any other previous flags */
-                if (oFlag && lFlag) { /* if output flag and log flag exist */
-                    if (oFlag != tFlag - 4 && lFlag != tFlag - 2) { /* check if it's in right order */
-                        print_usage("Wrong command syntax", error);
-                        exit(EXIT_FAILURE);
-                    }
-                } else if ((oFlag && oFlag != tFlag - 2) || (lFlag && lFlag != tFlag - 2)) { /* if only output flag exist */
-                    print_usage("Wrong command syntax", error);
-                    exit(EXIT_FAILURE);
-                }
-
-                break;
-            default:
-                break;
-        }
-    }
-
-    /* index of file arguments after retrieving all of the arguments */
-    int file_index = cmd1_args + 3;
-
-    /* if cmd 1 is set, flags must be in right position */
-    if (isFlag && oFlag != 4 && lFlag != 4 && tFlag != 4) {
-        print_usage("Wrong command syntax", error);
-        exit(EXIT_FAILURE);
-    }
-
-    /* there must be file passing in the end of all option arguments */
-    if (file_index == argc) {
-        print_usage("Please specify file to run", error);
-        exit(EXIT_FAILURE);
-    }
-
-    /* set up first command group and return */
-    cmd_arg->type = cmd1;
-    cmd_arg->flag_arg = first_arg;
-    cmd_arg->file_size = argc - file_index;
-    cmd_arg->file_arg = argv + file_index;
-}
-
-/**
- * send given string to given socket
- * @param sock_fd given socket
- * @param msg given message
- * @return
- *  true: if successfully sent
- *  false: if failed
- */
-bool send_str(int sock_fd, char *msg) {
-    /* send the length of the string */
-    int msgLen = (int) strlen(msg) + 1;
-    uint32_t netLen = htonl(msgLen);
-    if (send(sock_fd, &netLen, sizeof(netLen), 0) == -1) {
-        perror("send");
-        return false;
-    }
-
-    /* send the message */
-    if (send(sock_fd, msg, msgLen, 0) != msgLen) {
-        fprintf(stderr, "send did not send all data\n");
-        return false;
-    }
-
-    return true;
-}
-
-/**
- * receive string from given socket
- * @param sock_fd given socket
- * @return the string received from socket
- */
-char *recv_str(int sock_fd) {
-    /* get the length of the message*/
-    uint32_t netLen;
-    if (recv(sock_fd, &netLen, sizeof(netLen), 0) != sizeof(netLen)) {
-        fprintf(stderr, "recv got invalid len value\n");
-        return NULL;
-    }
-    int msgLen = ntohl(netLen);
-
-    /* get the message */
-    char *msg = (char *) malloc(sizeof(char) * msgLen);
-    if (recv(sock_fd, msg, msgLen, 0) != msgLen) {
-        fprintf(stderr, "recv got invalid message\n");
-        free(msg);
-        return NULL;
-    }
-
-    return msg;
-}
-
-/**
- * get current time
- * @return formatted time string
- */
-char *get_time() {
-    time_t timer;
-    struct tm *tm_info;
-
-    timer = time(NULL);
-    tm_info = localtime(&timer);
-
-    strftime(current_time, TIME_BUFFER, "%Y-%m-%d %H:%M:%S", tm_info);
-
-    return current_time;
+//
+// Created by Asus on 9/12/2020.
+//
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <memory.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <errno.h>
+#include <getopt.h>
+#include <helpers.h>
+#include <resolve.h>
+#include <time.h>
+
+char current_time[TIME_BUFFER]; /* time buffer */
+
+/**
+ * print usage on error or help
+ * @param msg error message to be display
+ * @param type
+ *  if type is error: print to stderr
+ *  if type is help: print to stdout
+ */
+void print_usage(char *msg, enum usage type) {
+    char *usage = "Usage: controller {<address> <port> | <socket path> -} "
+                  "{[-o out_file | -oz out_file] [-log log_file] [-t seconds] [-cpus list|auto[:n]] [-nice n] "
+                  "[-ioprio class[:level]] [-after jobid[:ok|:any][,...]] [-array spec] <file> [arg...] | "
+                  "mem [pid [--since T] [--until T] [--step S] | @array | --shm] | memkill <percent> | "
+                  "memkill --free <bytes[K|M|G]|percent%> | "
+                  "cpu [pid [--since T] [--until T] [--step S] | @array] | cpukill <percent> | "
+                  "top <n> [--by mem|cpu|growth] | stats [jobid | file] | kill <@array> | "
+                  "suspend <jobid | @array> | resume <jobid | @array> | wait <jobid> | load}";
+
+    if (type == help) {
+        printf("%s\n%s\n", msg, usage);
+    } else if (type == error) {
+        fprintf(stderr, "%s\n%s\n", msg, usage);
+    }
+}
+
+/**
+ * pass the --since, --until and --step options that follow the pid of a
+ * mem or cpu cmd into the cmd_t struct, in any order and once each
+ * @param argc number of arguments
+ * @param argv array of arguments, the pid is argv[4]
+ * @param cmd_arg command argument struct
+ * @param name name of the cmd for error messages
+ */
+static void handle_range(int argc, char **argv, cmd_t *cmd_arg, char *name) {
+    static char *options[] = {"--since", "--until", "--step"};
+    static enum flag_type types[] = {since, until, step};
+    char msg[64];
+
+    if (argc > 5 && !(argv[4][0] >= '0' && argv[4][0] <= '9')) {
+        snprintf(msg, sizeof(msg), "A time range of '%s' needs a pid", name);
+        print_usage(msg, error);
+        exit(EXIT_FAILURE);
+    }
+
+    for (int i = 5; i < argc; i += 2) {
+        int option = 0;
+        while (option < 3 && strcmp(argv[i], options[option]) != 0) option++;
+
+        if (option == 3 || i + 1 == argc || get_flag(cmd_arg, types[option])) {
+            snprintf(msg, sizeof(msg), "Wrong arguments for '%s' cmd", name);
+            print_usage(msg, error);
+            exit(EXIT_FAILURE);
+        }
+
+        cmd_arg->flag_arg[cmd_arg->flag_size].type = types[option];
+        cmd_arg->flag_arg[cmd_arg->flag_size].value = argv[i + 1];
+        cmd_arg->flag_size++;
+    }
+}
+
+/**
+ * pass command argument into the cmd_t struct based on the given
+ * arguments and option flags from command line
+ * @param argc number of arguments
+ * @param argv array of arguments
+ * @param cmd_arg command argument struct
+ */
+void handle_args(int argc, char **argv, cmd_t *cmd_arg) {
+    uint16_t port; /* host's port */
+
+    /* if not help there must be at least 4 arguments */
+    if (argc < 4) {
+        print_usage("Too few arguments", error);
+        exit(EXIT_FAILURE);
+    }
+
+    /* if there is only 2 argument and it's --help */
+    if (strcmp(argv[1], "--help") == 0) {
+        if (argc == 2) {
+            print_usage("Help Menu:", help);
+            exit(EXIT_SUCCESS);
+        } else {
+            print_usage("Too many arguments for 'help' cmd", error);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    /* a path is the unix socket of a local overseer, its port argument is
+     * only used by mem --shm to find the shared job table */
+    cmd_arg->local_path = strchr(argv[1], '/') ? argv[1] : NULL;
+    cmd_arg->port = (uint16_t) strtol(argv[2], NULL, BASE10);
+
+    /* get the address, literals and cached names skip the resolver */
+    if (!cmd_arg->local_path) {
+        /* get the port from second argument */
+        if (!(port = strtol(argv[2], NULL, BASE10))) {
+            print_usage("Port must between 1 to 65535", error);
+            exit(EXIT_FAILURE);
+        }
+
+        if (!rs_resolve(argv[1], port, &cmd_arg->host_addr)) {
+            fprintf(stderr, "Unknown host %s\n", argv[1]);
+            exit(EXIT_FAILURE);
+        }
+
+        cmd_arg->port = port;
+    }
+
+    /* check if third argument is mem kill or mem */
+    if (strcmp(argv[3], "mem") == 0) {
+        /* set up mem flag's value */
+        cmd_arg->type = cmd2;
+        cmd_arg->flag_arg->type = mem;
+        cmd_arg->flag_arg->value = NULL;
+        cmd_arg->flag_size++;
+
+        if (argv[4]) { /* get the optional argument */
+            cmd_arg->flag_arg->value = argv[4];
+        }
+
+        handle_range(argc, argv, cmd_arg, "mem");
+        return;
+    } else if (strcmp(argv[3], "memkill") == 0) {
+        /* setup mem kill flag */
+        cmd_arg->type = cmd3;
+        cmd_arg->flag_arg->type = memkill;
+        cmd_arg->flag_arg->value = NULL;
+        cmd_arg->flag_size++;
+
+        if (argv[4] && strcmp(argv[4], "--free") == 0) { /* or the memory to make available */
+            cmd_arg->flag_arg->type = memfree;
+            if (!(cmd_arg->flag_arg->value = argv[5])) {
+                print_usage("Please specify the memory to free for memkill --free", error);
+                exit(EXIT_FAILURE);
+            }
+            argc--;
+        } else if (argv[4]) { /* get the required argument */
+            cmd_arg->flag_arg->value = argv[4];
+        } else {
+            print_usage("Please specify percentage for memkill", error);
+            exit(EXIT_FAILURE);
+        }
+
+        /* return */
+
+        if (argc < 6) return;
+        else {
+            print_usage("Too many arguments for 'memkill' cmd", error);
+            exit(EXIT_FAILURE);
+        }
+    } else if (strcmp(argv[3], "cpu") == 0) {
+        /* set up cpu flag's value */
+        cmd_arg->type = cmd7;
+        cmd_arg->flag_arg->type = cpu;
+        cmd_arg->flag_arg->value = NULL;
+        cmd_arg->flag_size++;
+
+        if (argv[4]) { /* get the optional argument */
+            cmd_arg->flag_arg->value = argv[4];
+        }
+
+        handle_range(argc, argv, cmd_arg, "cpu");
+        return;
+    } else if (strcmp(argv[3], "cpukill") == 0) {
+        /* setup cpu kill flag */
+        cmd_arg->type = cmd8;
+        cmd_arg->flag_arg->type = cpukill;
+        cmd_arg->flag_arg->value = NULL;
+        cmd_arg->flag_size++;
+
+        if (argv[4]) { /* get the required argument */
+            cmd_arg->flag_arg->value = argv[4];
+        } else {
+            print_usage("Please specify percentage for cpukill", error);
+            exit(EXIT_FAILURE);
+        }
+
+        /* return */
+        if (argc < 6) return;
+        else {
+            print_usage("Too many arguments for 'cpukill' cmd", error);
+            exit(EXIT_FAILURE);
+        }
+    } else if (strcmp(argv[3], "top") == 0) {
+        /* setup top flag and the optional key */
+        cmd_arg->type = cmd9;
+        cmd_arg->flag_arg[0].type = top;
+        cmd_arg->flag_arg[0].value = NULL;
+        cmd_arg->flag_size++;
+
+        if (argv[4]) { /* get the required argument */
+            cmd_arg->flag_arg[0].value = argv[4];
+        } else {
+            print_usage("Please specify how many jobs to list", error);
+            exit(EXIT_FAILURE);
+        }
+
+        if (argc == 7 && strcmp(argv[5], "--by") == 0) {
+            cmd_arg->flag_arg[1].type = topkey;
+            cmd_arg->flag_arg[1].value = argv[6];
+            cmd_arg->flag_size++;
+        } else if (argc != 5) {
+            print_usage("Wrong arguments for 'top' cmd", error);
+            exit(EXIT_FAILURE);
+        }
+
+        return;
+    } else if (strcmp(argv[3], "stats") == 0) {
+        /* setup stats flag */
+        cmd_arg->type = cmd10;
+        cmd_arg->flag_arg->type = stats;
+        cmd_arg->flag_arg->value = NULL;
+        cmd_arg->flag_size++;
+
+        if (argv[4]) { /* get the optional argument */
+            cmd_arg->flag_arg->value = argv[4];
+        }
+
+        /* return */
+        if (argc < 6) return;
+        else {
+            print_usage("Too many arguments for 'stats' cmd", error);
+            exit(EXIT_FAILURE);
+        }
+    } else if (strcmp(argv[3], "kill") == 0) {
+        /* setup kill flag */
+        cmd_arg->type = cmd4;
+        cmd_arg->flag_arg->type = killjob;
+        cmd_arg->flag_arg->value = NULL;
+        cmd_arg->flag_size++;
+
+        if (argv[4]) { /* get the required argument */
+            cmd_arg->flag_arg->value = argv[4];
+        } else {
+            print_usage("Please specify what to kill", error);
+            exit(EXIT_FAILURE);
+        }
+
+        /* return */
+        if (argc < 6) return;
+        else {
+            print_usage("Too many arguments for 'kill' cmd", error);
+            exit(EXIT_FAILURE);
+        }
+    } else if (strcmp(argv[3], "suspend") == 0 || strcmp(argv[3], "resume") == 0) {
+        /* setup suspend or resume flag */
+        bool suspend = strcmp(argv[3], "suspend") == 0;
+        cmd_arg->type = suspend ? cmd11 : cmd12;
+        cmd_arg->flag_arg->type = suspend ? suspendjob : resumejob;
+        cmd_arg->flag_arg->value = NULL;
+        cmd_arg->flag_size++;
+
+        if (argv[4]) { /* get the required argument */
+            cmd_arg->flag_arg->value = argv[4];
+        } else {
+            print_usage(suspend ? "Please specify what to suspend" : "Please specify what to resume", error);
+            exit(EXIT_FAILURE);
+        }
+
+        /* return */
+        if (argc < 6) return;
+        else {
+            print_usage(suspend ? "Too many arguments for 'suspend' cmd" : "Too many arguments for 'resume' cmd",
+                        error);
+            exit(EXIT_FAILURE);
+        }
+    } else if (strcmp(argv[3], "wait") == 0) {
+        /* setup wait flag */
+        cmd_arg->type = cmd6;
+        cmd_arg->flag_arg->type = waitjob;
+        cmd_arg->flag_arg->value = NULL;
+        cmd_arg->flag_size++;
+
+        if (argv[4]) { /* get the required argument */
+            cmd_arg->flag_arg->value = argv[4];
+        } else {
+            print_usage("Please specify the job to wait for", error);
+            exit(EXIT_FAILURE);
+        }
+
+        /* return */
+        if (argc < 6) return;
+        else {
+            print_usage("Too many arguments for 'wait' cmd", error);
+            exit(EXIT_FAILURE);
+        }
+    } else if (strcmp(argv[3], "load") == 0) {
+        /* load takes no flag */
+        cmd_arg->type = cmd5;
+
+        if (argc < 5) return;
+        else {
+            print_usage("Too many arguments for 'load' cmd", error);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    /* When we get here we know that cmd set 2 and 3 is not set, we only consider cmd set 1 */
+
+    opterr = 0; /* disable error message for get opt in case there is argument from the executable file */
+    int ch; /* character value when iterating through argv */
+    bool isFlag = false; /* track if any flag in the first command group is set */
+    int cmd1_args = 0; /* arguments counter for first command set to determine the position of the file */
+    int oFlag = 0, lFlag = 0, tFlag = 0, aFlag = 0; /* position of flags in first command set */
+    int cFlag = 0, nFlag = 0, iFlag = 0; /* position of the placement flags, between time and array */
+    int dFlag = 0; /* position of the after flag, between the placement flags and array */
+    int lastFlag = 0; /* position of the latest flag */
+
+    /* Executable file pointer */
+    cmd_arg->file_size = 0;
+
+    flag_t *first_arg = cmd_arg->flag_arg; /* head of flag_arg array */
+
+    /* option string for get opt method, options stop at the file so the
+     * arguments of the job are never taken for ours */
+    const char *const short_options = "+o:t:";
+    static struct option long_options[] = {
+            {"oz",    required_argument, NULL, 'z'},
+            {"log",   required_argument, NULL, 'l'},
+            {"array", required_argument, NULL, 'a'},
+            {"cpus", required_argument, NULL, 'c'},
+            {"nice", required_argument, NULL, 'n'},
+            {"ioprio", required_argument, NULL, 'i'},
+            {"after", required_argument, NULL, 'd'},
+            {NULL, 0,                  NULL, 0}
+    };
+
+    int opt_index = optind = 3; /* options follow the address and port */
+    int long_index = -1; /* long option found by get opt */
+    while ((ch = getopt_long_only(argc, argv, short_options, long_options, &long_index)) != -1) {
+        /* long options are given in full, an abbreviation such as -c is more likely a mistake */
+        if (long_index != -1) {
+            const char *name = argv[opt_index] + (argv[opt_index][1] == '-' ? 2 : 1);
+            if (strcspn(name, "=") != strlen(long_options[long_index].name)) {
+                print_usage("Wrong command syntax", error);
+                exit(EXIT_FAILURE);
+            }
+        }
+        opt_index = optind;
+        long_index = -1;
+
+        switch (ch) {
+            case 'o':
+            case 'z':
+                /* create flag for output, compressed with -oz */
+                cmd_arg->flag_arg->type = ch == 'o' ? o : oz;
+                cmd_arg->flag_arg->value = optarg;
+                cmd_arg->flag_arg++;
+                cmd_arg->flag_size++;
+
+                isFlag = true; /* set the command set 1 to true */
+                oFlag = optind - 1; /* set the position of output flag */
+                cmd1_args += 2; /* increment argument counter for first command set */
+
+                /* the output flag comes first, once: return error if any flag exists before it */
+                if (lastFlag) {
+                    print_usage("Wrong command syntax", error);
+                    exit(EXIT_FAILURE);
+                }
+
+                break;
+            case 'l':
+                /* create flag for log */
+                cmd_arg->flag_arg->type = log;
+                cmd_arg->flag_arg->value = optarg;
+                cmd_arg->flag_arg++;
+                cmd_arg->flag_size++;
+
+                isFlag = true; /* set command set 1 to true */
+                lFlag = optind - 1;  /* set the position of lflag */
+                cmd1_args += 2; /* increment argument counter for command set 1*/
+
+                /* if out flag is already created before its next flag is going to be log flag*/
+
+
+                /* check if time flag exists or if
+                 * there is anything between log flag and output flag if output flag exists*/
+                if (tFlag || cFlag || nFlag || iFlag || dFlag || aFlag || (oFlag && oFlag != lFlag - 2)) {
+                    print_usage("Wrong command syntax", error);
+                    exit(EXIT_FAILURE);
+                }
+
+                break;
+            case 't':
+                /* create flag for time */
+                cmd_arg->flag_arg->type = t;
+                cmd_arg->flag_arg->value = optarg;
+                cmd_arg->flag_arg++;
+                cmd_arg->flag_size++;
+
+                isFlag = true; /* set the first command set to true */
+                tFlag = optind - 1; /* store the position of the time flag */
+                cmd1_args += 2; /* increment the argument counter of first command set */
+
+                /* placement, after and array flags must come after the time flag */
+                if (cFlag || nFlag || iFlag || dFlag || aFlag) {
+                    print_usage("Wrong command syntax", error);
+                    exit(EXIT_FAILURE);
+                }
+
+                /* check if there is anything between the time flag and any other previous flags */
+                if (oFlag && lFlag) { /* if output flag and log flag exist */
+                    if (oFlag != tFlag - 4 && lFlag != tFlag - 2) { /* check if it's in right order */
+                        print_usage("Wrong command syntax", error);
+                        exit(EXIT_FAILURE);
+                    }
+                } else if ((oFlag && oFlag != tFlag - 2) || (lFlag && lFlag != tFlag - 2)) { /* if only output flag exist */
+                    print_usage("Wrong command syntax", error);
+                    exit(EXIT_FAILURE);
+                }
+
+                break;
+            case 'a':
+                /* create flag for job array */
+                cmd_arg->flag_arg->type = array;
+                cmd_arg->flag_arg->value = optarg;
+                cmd_arg->flag_arg++;
+                cmd_arg->flag_size++;
+
+                isFlag = true; /* set the first command set to true */
+                aFlag = optind - 1; /* store the position of the array flag */
+                cmd1_args += 2; /* increment the argument counter of first command set */
+
+                /* array flag is the last flag, it must directly follow the previous one */
+                if (lastFlag && lastFlag != aFlag - 2) {
+                    print_usage("Wrong command syntax", error);
+                    exit(EXIT_FAILURE);
+                }
+
+                break;
+            case 'c':
+            case 'n':
+            case 'i':
+                /* create flag for the placement of the job */
+                cmd_arg->flag_arg->type = ch == 'c' ? cpuset : ch == 'n' ? niceness : ioprio;
+                cmd_arg->flag_arg->value = optarg;
+                cmd_arg->flag_arg++;
+                cmd_arg->flag_size++;
+
+                isFlag = true; /* set the first command set to true */
+                cmd1_args += 2; /* increment the argument counter of first command set */
+
+                /* placement flags come in the order cpus, nice, ioprio, right after the previous flag */
+                if (aFlag || dFlag || (ch == 'c' && (cFlag || nFlag || iFlag)) || (ch == 'n' && (nFlag || iFlag)) ||
+                    (ch == 'i' && iFlag) || (lastFlag && lastFlag != optind - 3)) {
+                    print_usage("Wrong command syntax", error);
+                    exit(EXIT_FAILURE);
+                }
+                *(ch == 'c' ? &cFlag : ch == 'n' ? &nFlag : &iFlag) = optind - 1;
+
+                break;
+            case 'd':
+                /* create flag for the jobs this one runs after */
+                cmd_arg->flag_arg->type = afterjob;
+                cmd_arg->flag_arg->value = optarg;
+                cmd_arg->flag_arg++;
+                cmd_arg->flag_size++;
+
+                isFlag = true; /* set the first command set to true */
+                cmd1_args += 2; /* increment the argument counter of first command set */
+
+                /* the after flag comes once, before the array flag and right after the previous flag */
+                if (dFlag || aFlag || (lastFlag && lastFlag != optind - 3)) {
+                    print_usage("Wrong command syntax", error);
+                    exit(EXIT_FAILURE);
+                }
+                dFlag = optind - 1;
+
+                break;
+            default:
+                break;
+        }
+        if (ch == 'o' || ch == 'z' || ch == 'l' || ch == 't' || ch == 'a' || ch == 'c' || ch == 'n' || ch == 'i' ||
+            ch == 'd') {
+            lastFlag = optind - 1;
+        }
+    }
+
+    /* index of file arguments after retrieving all of the arguments */
+    int file_index = cmd1_args + 3;
+
+    /* if cmd 1 is set, flags must be in right position */
+    if (isFlag && oFlag != 4 && lFlag != 4 && tFlag != 4 && cFlag != 4 && nFlag != 4 && iFlag != 4 && dFlag != 4 &&
+        aFlag != 4) {
+        print_usage("Wrong command syntax", error);
+        exit(EXIT_FAILURE);
+    }
+
+    /* there must be file passing in the end of all option arguments */
+    if (file_index == argc) {
+        print_usage("Please specify file to run", error);
+        exit(EXIT_FAILURE);
+    }
+
+    /* set up first command group and return */
+    cmd_arg->type = cmd1;
+    cmd_arg->flag_arg = first_arg;
+    cmd_arg->file_size = argc - file_index;
+    cmd_arg->file_arg = argv + file_index;
+}
+
+/**
+ * find the flag of the given type in a command
+ * @param cmd_arg command argument
+ * @param type flag type to look for
+ * @return the flag or NULL if the command doesn't have it
+ */
+flag_t *get_flag(cmd_t *cmd_arg, enum flag_type type) {
+    for (int i = 0; i < cmd_arg->flag_size; i++) {
+        if (cmd_arg->flag_arg[i].type == type) {
+            return cmd_arg->flag_arg + i;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * send given string to given socket
+ * @param sock_fd given socket
+ * @param msg given message
+ * @return
+ *  true: if successfully sent
+ *  false: if failed
+ */
+bool send_str(int sock_fd, char *msg) {
+    /* send the length of the string and the message at once, a kept
+     * connection would otherwise hold the message back until the length is
+     * acknowledged */
+    int msgLen = (int) strlen(msg) + 1;
+    uint32_t netLen = htonl(msgLen);
+    struct iovec iov[2] = {{.iov_base = &netLen, .iov_len = sizeof(netLen)}, {.iov_base = msg, .iov_len = msgLen}};
+    struct msghdr header = {.msg_iov = iov, .msg_iovlen = 2};
+    ssize_t sent = sendmsg(sock_fd, &header, MSG_NOSIGNAL);
+
+    if (sent == -1) {
+        perror("send");
+        return false;
+    }
+
+    /* a large message may be sent in parts */
+    while (sent < (ssize_t) (sizeof(netLen) + msgLen)) {
+        ssize_t n;
+        if (sent < (ssize_t) sizeof(netLen)) {
+            n = send(sock_fd, (char *) &netLen + sent, sizeof(netLen) - sent, MSG_NOSIGNAL);
+        } else {
+            n = send(sock_fd, msg + sent - sizeof(netLen), msgLen - (sent - sizeof(netLen)), MSG_NOSIGNAL);
+        }
+        if (n <= 0 && !(n == -1 && errno == EINTR)) {
+            fprintf(stderr, "send did not send all data\n");
+            return false;
+        }
+        sent += n > 0 ? n : 0;
+    }
+
+    return true;
+}
+
+/**
+ * append bytes to a growing buffer
+ * @param buf buffer, reallocated when full
+ * @param len bytes used
+ * @param capacity bytes allocated
+ * @param data bytes to append
+ * @param n number of bytes
+ * @return
+ *  true: if appended
+ *  false: if out of memory
+ */
+static bool buf_put(char **buf, size_t *len, size_t *capacity, const void *data, size_t n) {
+    if (*len + n > *capacity) {
+        size_t size = *capacity ? *capacity : 256;
+        while (size < *len + n) size *= 2;
+        char *grown = (char *) realloc(*buf, size);
+        if (!grown) {
+            return false;
+        }
+        *buf = grown;
+        *capacity = size;
+    }
+    memcpy(*buf + *len, data, n);
+    *len += n;
+
+    return true;
+}
+
+/**
+ * append a string as send_str sends it: its length with the NUL, then the string
+ * @param buf buffer
+ * @param len bytes used
+ * @param capacity bytes allocated
+ * @param str string
+ * @return
+ *  true: if appended
+ *  false: if out of memory
+ */
+static bool buf_put_str(char **buf, size_t *len, size_t *capacity, const char *str) {
+    size_t str_len = strlen(str) + 1;
+    uint32_t net_len = htonl((uint32_t) str_len);
+
+    return buf_put(buf, len, capacity, &net_len, sizeof(net_len)) && buf_put(buf, len, capacity, str, str_len);
+}
+
+/**
+ * encode a command as it travels to the overseer: its type, number of
+ * flags, each flag with its type, whether it has a value and the value,
+ * then the number of file arguments and each of them
+ * @param cmd_arg command argument
+ * @param len receives the length of the encoded command
+ * @return the encoded command to be freed, NULL if out of memory
+ */
+char *encode_cmd(cmd_t *cmd_arg, size_t *len) {
+    char *buf = NULL;
+    size_t capacity = 0;
+    uint32_t type = htonl(cmd_arg->type), flag_size = htonl(cmd_arg->flag_size);
+    uint32_t file_size = htonl(cmd_arg->file_size);
+    bool ok;
+
+    *len = 0;
+    ok = buf_put(&buf, len, &capacity, &type, sizeof(type)) &&
+         buf_put(&buf, len, &capacity, &flag_size, sizeof(flag_size));
+
+    for (int i = 0; ok && i < cmd_arg->flag_size; i++) {
+        flag_t *flag_arg = cmd_arg->flag_arg + i;
+        uint32_t flag_type = htonl(flag_arg->type);
+        uint16_t value_exist = htons(flag_arg->value ? 1 : 0);
+        ok = buf_put(&buf, len, &capacity, &flag_type, sizeof(flag_type)) &&
+             buf_put(&buf, len, &capacity, &value_exist, sizeof(value_exist)) &&
+             (!flag_arg->value || buf_put_str(&buf, len, &capacity, flag_arg->value));
+    }
+
+    ok = ok && buf_put(&buf, len, &capacity, &file_size, sizeof(file_size));
+    for (int i = 0; ok && i < cmd_arg->file_size; i++) {
+        ok = buf_put_str(&buf, len, &capacity, cmd_arg->file_arg[i]);
+    }
+
+    if (!ok) {
+        free(buf);
+        return NULL;
+    }
+    return buf;
+}
+
+/**
+ * send command argument struct to the other end (client to server, or
+ * a federated overseer to its backend). It is encoded first and sent with
+ * as few calls as the socket allows instead of one per field
+ * @param sock_fd server socket
+ * @param cmd_arg command argument
+ * @return
+ *  true: if successfully sent
+ *  false: if failed
+ */
+bool send_cmd(int sock_fd, cmd_t *cmd_arg) {
+    size_t len, sent = 0;
+    char *buf = encode_cmd(cmd_arg, &len);
+
+    if (!buf) {
+        fprintf(stderr, "out of memory encoding command\n");
+        return false;
+    }
+
+    while (sent < len) {
+        ssize_t n = send(sock_fd, buf + sent, len - sent, MSG_NOSIGNAL);
+        if (n == -1 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            perror("send");
+            free(buf);
+            return false;
+        }
+        sent += n;
+    }
+
+    free(buf);
+    return true;
+}
+
+/**
+ * check if the overseer sends a response for the given command:
+ * only memkill without --free and cpukill are not answered, submissions get
+ * their job or job array id
+ * @param cmd_arg command argument
+ * @return
+ *  true: if a response must be received
+ *  false: if the command has no response
+ */
+bool has_reply(cmd_t *cmd_arg) {
+    return (cmd_arg->type != cmd3 || get_flag(cmd_arg, memfree)) && cmd_arg->type != cmd8;
+}
+
+/**
+ * check if the overseer rejected a job because its queue is full
+ * @param reply reply of the overseer
+ * @return the seconds it suggests to wait before submitting again, 0 if
+ *  the reply is not an overloaded reply
+ */
+int retry_after(const char *reply) {
+    int seconds;
+
+    if (!reply || sscanf(reply, OVERLOADED_REPLY, &seconds) != 1 || seconds < 1) {
+        return 0;
+    }
+    return seconds;
+}
+
+/**
+ * receive string from given socket
+ * @param sock_fd given socket
+ * @return the string received from socket
+ */
+char *recv_str(int sock_fd) {
+    /* get the length of the message*/
+    uint32_t netLen;
+    if (recv(sock_fd, &netLen, sizeof(netLen), 0) != sizeof(netLen)) {
+        fprintf(stderr, "recv got invalid len value\n");
+        return NULL;
+    }
+    int msgLen = ntohl(netLen);
+
+    /* get the message */
+    char *msg = (char *) malloc(sizeof(char) * msgLen);
+    if (recv(sock_fd, msg, msgLen, MSG_WAITALL) != msgLen) {
+        fprintf(stderr, "recv got invalid message\n");
+        free(msg);
+        return NULL;
+    }
+
+    return msg;
+}
+
+/**
+ * pass file descriptors to the other end of a unix socket. They travel as
+ * SCM_RIGHTS ancillary data of a single byte
+ * @param sock_fd unix socket
+ * @param fds descriptors to pass
+ * @param n number of descriptors, at most 2
+ * @return
+ *  true: if successfully sent
+ *  false: if failed
+ */
+bool send_fds(int sock_fd, const int *fds, int n) {
+    char byte = 0;
+    struct iovec iov = {.iov_base = &byte, .iov_len = 1};
+    union {
+        struct cmsghdr hdr;
+        char buf[CMSG_SPACE(2 * sizeof(int))];
+    } control;
+    struct msghdr msg = {
+            .msg_iov = &iov,
+            .msg_iovlen = 1,
+            .msg_control = control.buf,
+            .msg_controllen = CMSG_SPACE(n * sizeof(int))
+    };
+
+    memset(&control, 0, sizeof(control));
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(n * sizeof(int));
+    memcpy(CMSG_DATA(cmsg), fds, n * sizeof(int));
+
+    if (sendmsg(sock_fd, &msg, MSG_NOSIGNAL) != 1) {
+        perror("sendmsg");
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * receive file descriptors passed by send_fds
+ * @param sock_fd unix socket
+ * @param fds receives the descriptors, close on exec
+ * @param n number of descriptors expected, at most 2
+ * @return
+ *  true: if all of them were received
+ *  false: if failed, none is left open
+ */
+bool recv_fds(int sock_fd, int *fds, int n) {
+    char byte;
+    struct iovec iov = {.iov_base = &byte, .iov_len = 1};
+    union {
+        struct cmsghdr hdr;
+        char buf[CMSG_SPACE(2 * sizeof(int))];
+    } control;
+    struct msghdr msg = {
+            .msg_iov = &iov,
+            .msg_iovlen = 1,
+            .msg_control = control.buf,
+            .msg_controllen = sizeof(control.buf)
+    };
+
+    if (recvmsg(sock_fd, &msg, MSG_CMSG_CLOEXEC | MSG_WAITALL) != 1) {
+        fprintf(stderr, "recvmsg got no descriptors\n");
+        return false;
+    }
+
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    if (!cmsg || cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) {
+        fprintf(stderr, "recvmsg got no descriptors\n");
+        return false;
+    }
+
+    int got = (int) ((cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int));
+    memcpy(fds, CMSG_DATA(cmsg), got * sizeof(int));
+    if (got != n) {
+        fprintf(stderr, "recvmsg got %d descriptors instead of %d\n", got, n);
+        for (int i = 0; i < got; i++) {
+            close(fds[i]);
+        }
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * get current time
+ * @return formatted time string
+ */
+char *get_time() {
+    time_t timer;
+    struct tm *tm_info;
+
+    timer = time(NULL);
+    tm_info = localtime(&timer);
+
+    strftime(current_time, TIME_BUFFER, "%Y-%m-%d %H:%M:%S", tm_info);
+
+    return current_time;
 }
\ No newline at end of file
@@ -1,64 +1,110 @@
-//
-// Created by Asus on 9/12/2020.
-//
-
-#ifndef PROCESS_OVERSEER_HELPERS_H
-#define PROCESS_OVERSEER_HELPERS_H
-#define TIME_BUFFER 20
-#define MAX_BUFFER 512
-#define MAX_ARRAY_SIZE 100
-#define BASE10 10
-#define BASE16 16
-#define INODE_OFFSET 21 /* offset from 'address' to 'inode' in /proc/pid/maps */
-
-#include <netinet/in.h>
-#include <stdbool.h>
-
-/* enum for option flag type */
-enum flag_type {
-    o, log, t, mem, memkill
-};
-
-/* create struct for flags */
-typedef struct flag {
-    enum flag_type type; /* position of the flag */
-    char *value; /* value of the flag */
-} flag_t;
-
-/* enum for command type */
-enum cmd_type {
-    cmd1, cmd2, cmd3
-};
-
-/* struct for command group argument */
-typedef struct cmd {
-    enum cmd_type type;
-    uint16_t port;
-    struct in_addr host_addr;
-    int flag_size;
-    flag_t *flag_arg;
-    int file_size;
-    char **file_arg;
-} cmd_t;
-
-/* enum for print usage (err vs help) */
-enum usage {
-    help, error
-};
-
-/* print usage if error or help from cli argument */
-void print_usage(char *, enum usage);
-
-/* handle commandline argument */
-void handle_args(int argc, char **argv, cmd_t *cmd_arg);
-
-/* send string over tcp/ip */
-bool send_str(int, char *);
-
-/* receive string over tcp/ip */
-char *recv_str(int);
-
-/* return the current time in %Y-%m-%d %H:%M:%S format */
-char *get_time();
-
-#endif //PROCESS_OVERSEER_HELPERS_H
+//
+// Created by Asus on 9/12/2020.
+//
+
+#ifndef PROCESS_OVERSEER_HELPERS_H
+#define PROCESS_OVERSEER_HELPERS_H
+#define TIME_BUFFER 20
+#define MAX_BUFFER 512
+#define MAX_FLAGS 10 /* maximum number of flags in one command */
+#define MAX_FILE_ARGS 65536 /* maximum number of file arguments in one command */
+#define BASE10 10
+#define OVERLOADED_REPLY "error: overloaded, retry after %d seconds\n" /* a full queue rejected a job */
+#define MEMKILL_TIMEOUT_MS 2000 /* longest wait for the jobs killed by memkill --free to exit */
+
+#include <netinet/in.h>
+#include <stdbool.h>
+
+/* enum for option flag type */
+enum flag_type {
+    o, log, t, mem, memkill, array, killjob, waitjob,
+    stdio, /* the local controller passes its stdout and stderr after the command */
+    cpuset, niceness, ioprio, /* placement of a job: cpu list or auto[:n], nice level, io priority */
+    cpu, cpukill, top, topkey,
+    since, until, step, /* time range and step of the history of mem pid and cpu pid */
+    stats, /* job id or file whose memory quantiles are asked */
+    sketches, /* a front asks its backends for their sketches instead of quantiles */
+    keepalive, /* the client sends its next command on the same connection */
+    memfree, /* memory memkill --free makes available, in bytes or percent */
+    suspendjob, resumejob, /* job id or @array to suspend or resume */
+    oz, /* out_file the output of the job is compressed into */
+    afterjob /* ids of the jobs a job runs after, id[:ok|:any][,...] */
+};
+
+/* create struct for flags */
+typedef struct flag {
+    enum flag_type type; /* position of the flag */
+    char *value; /* value of the flag */
+} flag_t;
+
+/* enum for command type */
+enum cmd_type {
+    cmd1, /* run a file, or a job array when the array flag is set */
+    cmd2, /* mem */
+    cmd3, /* memkill, answered only with --free */
+    cmd4, /* kill */
+    cmd5, /* load */
+    cmd6, /* wait */
+    cmd7, /* cpu */
+    cmd8, /* cpukill */
+    cmd9, /* top */
+    cmd10, /* stats */
+    cmd11, /* suspend */
+    cmd12 /* resume */
+};
+
+/* struct for command group argument */
+typedef struct cmd {
+    enum cmd_type type;
+    uint16_t port;
+    struct sockaddr_storage host_addr; /* address and port of the overseer, IPv4 or IPv6 */
+    char *local_path; /* unix socket of the overseer, NULL to connect over tcp */
+    int stdio_fds[2]; /* stdout and stderr passed by a local controller, -1 if none */
+    int flag_size;
+    flag_t *flag_arg;
+    int file_size;
+    char **file_arg;
+} cmd_t;
+
+/* enum for print usage (err vs help) */
+enum usage {
+    help, error
+};
+
+/* print usage if error or help from cli argument */
+void print_usage(char *, enum usage);
+
+/* handle commandline argument */
+void handle_args(int argc, char **argv, cmd_t *cmd_arg);
+
+/* find the flag of the given type in a command */
+flag_t *get_flag(cmd_t *, enum flag_type);
+
+/* encode a command as it is sent, to be freed */
+char *encode_cmd(cmd_t *, size_t *len);
+
+/* send cmd over tcp/ip */
+bool send_cmd(int, cmd_t *);
+
+/* check if the overseer answers the given command */
+bool has_reply(cmd_t *);
+
+/* send string over tcp/ip */
+bool send_str(int, char *);
+
+/* receive string over tcp/ip */
+char *recv_str(int);
+
+/* pass file descriptors over a unix socket */
+bool send_fds(int, const int *fds, int n);
+
+/* receive file descriptors passed over a unix socket, close on exec */
+bool recv_fds(int, int *fds, int n);
+
+/* seconds to wait before submitting again after an overloaded reply, 0 for any other reply */
+int retry_after(const char *reply);
+
+/* return the current time in %Y-%m-%d %H:%M:%S format */
+char *get_time();
+
+#endif //PROCESS_OVERSEER_HELPERS_H
@@ -0,0 +1,359 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <history.h>
+#include <handoff.h>
+
+/**
+ * map a signed value to an unsigned one so small magnitudes stay small
+ * @param n signed value
+ * @return zigzag encoded value
+ */
+static inline uint64_t zigzag(int64_t n) {
+    return ((uint64_t) n << 1) ^ (uint64_t) (n >> 63);
+}
+
+/**
+ * reverse zigzag
+ * @param n zigzag encoded value
+ * @return signed value
+ */
+static inline int64_t unzigzag(uint64_t n) {
+    return (int64_t) (n >> 1) ^ -(int64_t) (n & 1);
+}
+
+/**
+ * write a varint, 7 bits per byte, high bit set while more bytes follow
+ * @param buf destination
+ * @param n value
+ * @return number of bytes written
+ */
+static inline uint32_t put_varint(uint8_t *buf, uint64_t n) {
+    uint32_t len = 0;
+
+    while (n >= 0x80) {
+        buf[len++] = (uint8_t) (n | 0x80);
+        n >>= 7;
+    }
+    buf[len++] = (uint8_t) n;
+
+    return len;
+}
+
+/**
+ * read a varint
+ * @param buf source
+ * @param pos offset in buf, advanced past the varint
+ * @return value
+ */
+static inline uint64_t get_varint(const uint8_t *buf, uint32_t *pos) {
+    uint64_t n = 0;
+    int shift = 0;
+    uint8_t byte;
+
+    do {
+        byte = buf[(*pos)++];
+        n |= (uint64_t) (byte & 0x7f) << shift;
+        shift += 7;
+    } while (byte & 0x80);
+
+    return n;
+}
+
+/**
+ * unit the values of a series are stored in: memory loses the bytes below
+ * a KiB, cpu time keeps every microsecond
+ * @param a_series series
+ * @return divisor of the values
+ */
+static inline uint64_t hist_unit(const series_t *a_series) {
+    return a_series->cpu ? 1 : HIST_UNIT;
+}
+
+/**
+ * create an empty series
+ * @param pid pid of the job
+ * @param cpu the series holds cpu time rather than memory
+ * @return the series or NULL if out of memory
+ */
+series_t *hist_new(pid_t pid, bool cpu) {
+    series_t *a_series = (series_t *) calloc(1, sizeof(series_t));
+    if (!a_series) {
+        fprintf(stderr, "hist_new: out of memory\n");
+        return NULL;
+    }
+    a_series->pid = pid;
+    a_series->cpu = cpu;
+
+    return a_series;
+}
+
+/**
+ * add a block at the end of a series
+ * @param a_series series
+ * @param block block, its next is NULL
+ * @return
+ *  true: if the block was added
+ *  false: if out of memory, the block is not added
+ */
+static bool add_block(series_t *a_series, hist_block_t *block) {
+    if (a_series->num_blocks == a_series->blocks_capacity) {
+        size_t capacity = a_series->blocks_capacity ? a_series->blocks_capacity * 2 : 8;
+        hist_block_t **blocks = (hist_block_t **) realloc(a_series->blocks, capacity * sizeof(hist_block_t *));
+        if (!blocks) {
+            return false;
+        }
+        a_series->blocks = blocks;
+        a_series->blocks_capacity = capacity;
+    }
+    a_series->blocks[a_series->num_blocks++] = block;
+
+    if (a_series->tail) {
+        a_series->tail->next = block;
+    } else {
+        a_series->head = block;
+    }
+    a_series->tail = block;
+
+    return true;
+}
+
+/**
+ * append a sample. Once a second with a steady value this takes two bytes:
+ * a zero delta-of-delta and a zero value delta. Every block starts with a
+ * raw sample so blocks decode on their own.
+ * @param a_series series
+ * @param ts timestamp in seconds, should not decrease
+ * @param val value in bytes, stored in HIST_UNIT, or in microseconds, stored as is
+ * @return
+ *  true: if the sample was stored
+ *  false: if out of memory
+ */
+bool hist_append(series_t *a_series, int64_t ts, uint64_t val) {
+    hist_block_t *block = a_series->tail;
+    val /= hist_unit(a_series);
+
+    /* start a new block when the worst case sample would not fit */
+    if (!block || block->len + HIST_MAX_SAMPLE > HIST_BLOCK_BYTES) {
+        if (!(block = (hist_block_t *) malloc(sizeof(hist_block_t)))) {
+            fprintf(stderr, "hist_append: out of memory\n");
+            return false;
+        }
+        block->first_ts = block->last_ts = ts;
+        block->first_val = val;
+        block->count = 1;
+        block->len = 0;
+        block->next = NULL;
+        if (!add_block(a_series, block)) {
+            fprintf(stderr, "hist_append: out of memory\n");
+            free(block);
+            return false;
+        }
+
+        a_series->prev_ts = ts;
+        a_series->prev_delta = 0;
+        a_series->prev_val = val;
+        return true;
+    }
+
+    int64_t delta = ts - a_series->prev_ts;
+    block->len += put_varint(block->data + block->len, zigzag(delta - a_series->prev_delta));
+    block->len += put_varint(block->data + block->len, zigzag((int64_t) (val - a_series->prev_val)));
+    block->last_ts = ts;
+    block->count++;
+
+    a_series->prev_ts = ts;
+    a_series->prev_delta = delta;
+    a_series->prev_val = val;
+    return true;
+}
+
+/**
+ * start decoding a series from its first sample
+ * @param iter iterator
+ * @param a_series series to decode
+ */
+void hist_iter_init(hist_iter_t *iter, series_t *a_series) {
+    iter->block = a_series->head;
+    iter->pos = 0;
+    iter->index = 0;
+    iter->unit = hist_unit(a_series);
+}
+
+/**
+ * start decoding a series from the first block whose last sample is at or
+ * after ts, found by binary search. The samples of that block before ts are
+ * decoded first, at most a block of them
+ * @param iter iterator
+ * @param a_series series to decode
+ * @param ts timestamp to start from
+ */
+void hist_iter_seek(hist_iter_t *iter, series_t *a_series, int64_t ts) {
+    size_t low = 0, high = a_series->num_blocks;
+
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        if (a_series->blocks[mid]->last_ts < ts) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    iter->block = low < a_series->num_blocks ? a_series->blocks[low] : NULL;
+    iter->pos = 0;
+    iter->index = 0;
+    iter->unit = hist_unit(a_series);
+}
+
+/**
+ * decode the next sample
+ * @param iter iterator
+ * @param ts set to the timestamp of the sample
+ * @param val set to the value of the sample in bytes or microseconds
+ * @return
+ *  true: if a sample was decoded
+ *  false: if the series is exhausted
+ */
+bool hist_next(hist_iter_t *iter, int64_t *ts, uint64_t *val) {
+    hist_block_t *block = iter->block;
+    if (!block) {
+        return false;
+    }
+
+    if (!iter->index) {
+        iter->ts = block->first_ts;
+        iter->delta = 0;
+        iter->val = block->first_val;
+        iter->pos = 0;
+    } else {
+        iter->delta += unzigzag(get_varint(block->data, &iter->pos));
+        iter->ts += iter->delta;
+        iter->val += (uint64_t) unzigzag(get_varint(block->data, &iter->pos));
+    }
+
+    if (++iter->index == block->count) {
+        iter->block = block->next;
+        iter->index = 0;
+    }
+
+    *ts = iter->ts;
+    *val = iter->val * iter->unit;
+    return true;
+}
+
+/**
+ * count the samples of a series
+ * @param a_series series
+ * @return number of samples
+ */
+size_t hist_count(series_t *a_series) {
+    size_t count = 0;
+
+    for (hist_block_t *block = a_series->head; block; block = block->next) {
+        count += block->count;
+    }
+
+    return count;
+}
+
+/**
+ * get the memory used by a series
+ * @param a_series series
+ * @return bytes of the series and its blocks
+ */
+size_t hist_bytes(series_t *a_series) {
+    size_t bytes = sizeof(series_t);
+
+    for (hist_block_t *block = a_series->head; block; block = block->next) {
+        bytes += sizeof(hist_block_t);
+    }
+
+    return bytes;
+}
+
+/**
+ * write a series into a hot restart state: its encoder state, then every
+ * block as it is encoded
+ * @param state hot restart state
+ * @param a_series series
+ */
+void hist_save(FILE *state, series_t *a_series) {
+    int num_blocks = 0;
+
+    ho_put_int(state, a_series->pid);
+    ho_put_int(state, a_series->cpu);
+    ho_put_int(state, a_series->ended);
+    ho_put_int(state, a_series->prev_ts);
+    ho_put_int(state, a_series->prev_delta);
+    ho_put_int(state, (int64_t) a_series->prev_val);
+
+    for (hist_block_t *block = a_series->head; block; block = block->next) num_blocks++;
+    ho_put_int(state, num_blocks);
+    for (hist_block_t *block = a_series->head; block; block = block->next) {
+        ho_put_int(state, block->first_ts);
+        ho_put_int(state, (int64_t) block->first_val);
+        ho_put_int(state, block->last_ts);
+        ho_put_int(state, block->count);
+        ho_put_int(state, block->len);
+        ho_put_bytes(state, block->data, block->len);
+    }
+}
+
+/**
+ * read a series written by hist_save
+ * @param state hot restart state
+ * @return the series or NULL if out of memory
+ */
+series_t *hist_load(FILE *state) {
+    pid_t pid = (pid_t) ho_get_int(state);
+    series_t *a_series = hist_new(pid, ho_get_int(state) != 0);
+    if (!a_series) {
+        return NULL;
+    }
+    a_series->ended = ho_get_int(state) != 0;
+    a_series->prev_ts = ho_get_int(state);
+    a_series->prev_delta = ho_get_int(state);
+    a_series->prev_val = (uint64_t) ho_get_int(state);
+
+    for (int n = (int) ho_get_int(state); n > 0; n--) {
+        hist_block_t *block = (hist_block_t *) malloc(sizeof(hist_block_t));
+        if (!block) {
+            fprintf(stderr, "hist_load: out of memory\n");
+            hist_free(a_series);
+            return NULL;
+        }
+        block->first_ts = ho_get_int(state);
+        block->first_val = (uint64_t) ho_get_int(state);
+        block->last_ts = ho_get_int(state);
+        block->count = (uint32_t) ho_get_int(state);
+        block->len = (uint32_t) ho_get_int(state);
+        if (block->len > HIST_BLOCK_BYTES) {
+            block->len = 0; /* corrupt, keep its first sample only */
+            block->count = 1;
+        }
+        ho_get_bytes(state, block->data, block->len);
+        block->next = NULL;
+        if (!add_block(a_series, block)) {
+            fprintf(stderr, "hist_load: out of memory\n");
+            free(block);
+            hist_free(a_series);
+            return NULL;
+        }
+    }
+
+    return a_series;
+}
+
+/**
+ * free a series and its blocks
+ * @param a_series series
+ */
+void hist_free(series_t *a_series) {
+    while (a_series->head) {
+        hist_block_t *block = a_series->head;
+        a_series->head = block->next;
+        free(block);
+    }
+    free(a_series->blocks);
+    free(a_series);
+}
@@ -0,0 +1,79 @@
+#ifndef PROCESS_OVERSEER_HISTORY_H
+#define PROCESS_OVERSEER_HISTORY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <sys/types.h>
+
+#define HIST_BLOCK_BYTES 256 /* encoded bytes per block */
+#define HIST_MAX_SAMPLE 20 /* worst case encoded size of one sample */
+#define HIST_UNIT 1024 /* memory is stored in KiB, every memory metric is a multiple; cpu time is kept in microseconds */
+
+/* block of samples: the first one is kept raw, the others are encoded as
+ * zigzag varints of the timestamp delta-of-delta and the value delta */
+typedef struct hist_block {
+    int64_t first_ts; /* timestamp of the first sample */
+    uint64_t first_val; /* value of the first sample in the unit of its series */
+    int64_t last_ts; /* timestamp of the last sample */
+    uint32_t count; /* number of samples in the block */
+    uint32_t len; /* encoded bytes used */
+    struct hist_block *next;
+    uint8_t data[HIST_BLOCK_BYTES];
+} hist_block_t;
+
+/* memory or cpu history of one job */
+typedef struct series {
+    pid_t pid; /* pid of the job */
+    bool cpu; /* values are the cpu time used so far in microseconds, not memory in bytes */
+    bool ended; /* the job ended, nothing is appended any more */
+    hist_block_t *head, *tail; /* blocks, oldest first */
+    hist_block_t **blocks; /* the same blocks in an array, binary searched by time */
+    size_t num_blocks, blocks_capacity; /* blocks in the array and room for them */
+    int64_t prev_ts, prev_delta; /* encoder state: last timestamp and its delta */
+    uint64_t prev_val; /* encoder state: last value in the unit of the series */
+    struct series *next;
+} series_t;
+
+/* sequential decoder over a series */
+typedef struct hist_iter {
+    hist_block_t *block; /* block being decoded */
+    uint32_t pos; /* offset of the next sample in the block */
+    uint32_t index; /* index of the next sample in the block */
+    int64_t ts, delta; /* last decoded timestamp and its delta */
+    uint64_t val; /* last decoded value in the unit of the series */
+    uint64_t unit; /* HIST_UNIT for memory, 1 for cpu time */
+} hist_iter_t;
+
+/* create an empty series */
+series_t *hist_new(pid_t, bool cpu);
+
+/* append a sample, timestamps must not decrease */
+bool hist_append(series_t *, int64_t ts, uint64_t val);
+
+/* start decoding a series from its first sample */
+void hist_iter_init(hist_iter_t *, series_t *);
+
+/* start decoding a series from the block holding ts, earlier samples of the block come first */
+void hist_iter_seek(hist_iter_t *, series_t *, int64_t ts);
+
+/* decode the next sample, false once the series is exhausted */
+bool hist_next(hist_iter_t *, int64_t *ts, uint64_t *val);
+
+/* number of samples in a series */
+size_t hist_count(series_t *);
+
+/* encoded bytes of a series, blocks included */
+size_t hist_bytes(series_t *);
+
+/* write a series into a hot restart state */
+void hist_save(FILE *, series_t *);
+
+/* read a series written by hist_save, NULL if out of memory */
+series_t *hist_load(FILE *);
+
+/* free a series and its blocks */
+void hist_free(series_t *);
+
+#endif //PROCESS_OVERSEER_HISTORY_H
@@ -0,0 +1,284 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <jobtable.h>
+
+static jt_table_t *table = NULL; /* table published by this overseer */
+static char table_name[32]; /* shared memory name of the table */
+static int next_slot = 0; /* where the search for a slot starts */
+static pthread_mutex_t table_mutex = PTHREAD_MUTEX_INITIALIZER; /* protects slot allocation */
+
+/**
+ * get the shared memory name of the table of an overseer
+ * @param port port the overseer listens on
+ * @param name receives the name, 32 bytes are enough
+ */
+static void jt_name(uint16_t port, char *name) {
+    sprintf(name, "/overseer-%u", port);
+}
+
+/**
+ * start writing a slot, readers retry until jt_write_end
+ * @param slot slot written by a single thread at a time
+ */
+static void jt_write_begin(jt_slot_t *slot) {
+    atomic_store_explicit(&slot->seq, atomic_load_explicit(&slot->seq, memory_order_relaxed) + 1,
+                          memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+}
+
+/**
+ * finish writing a slot
+ * @param slot slot being written
+ */
+static void jt_write_end(jt_slot_t *slot) {
+    atomic_store_explicit(&slot->seq, atomic_load_explicit(&slot->seq, memory_order_relaxed) + 1,
+                          memory_order_release);
+}
+
+/**
+ * create the shared job table, replacing the one of a previous overseer on
+ * the same port
+ * @param port port the overseer listens on, names the table
+ * @param metric name of the memory metric sampled
+ * @return
+ *  true: if the table is published
+ *  false: if shared memory is unavailable
+ */
+bool jt_create(uint16_t port, const char *metric) {
+    int fd;
+
+    jt_name(port, table_name);
+    if ((fd = shm_open(table_name, O_CREAT | O_RDWR | O_CLOEXEC, 0644)) == -1) {
+        perror("shm_open");
+        return false;
+    }
+
+    /* truncating first zeroes a table left behind */
+    if (ftruncate(fd, 0) == -1 || ftruncate(fd, sizeof(jt_table_t)) == -1) {
+        perror("ftruncate");
+        close(fd);
+        shm_unlink(table_name);
+        return false;
+    }
+
+    table = mmap(NULL, sizeof(jt_table_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (table == MAP_FAILED) {
+        perror("mmap");
+        table = NULL;
+        shm_unlink(table_name);
+        return false;
+    }
+
+    table->num_slots = JT_SLOTS;
+    table->overseer = getpid();
+    strncpy(table->metric, metric, sizeof(table->metric) - 1);
+    atomic_store_explicit(&table->magic, JT_MAGIC, memory_order_release);
+
+    return true;
+}
+
+/**
+ * unpublish and unmap the table, once no job can be published anymore
+ */
+void jt_destroy(void) {
+    if (!table) {
+        return;
+    }
+
+    shm_unlink(table_name);
+    munmap(table, sizeof(jt_table_t));
+    table = NULL;
+}
+
+/**
+ * publish a job once it started. A free slot is taken first, otherwise the
+ * finished job published the longest ago is replaced
+ * @param pid pid of the job
+ * @param job_id job id, 0 for a job of an array
+ * @param array_id job array id, 0 for a single job
+ * @param array_index index of the job in its array
+ * @param file file run by the job
+ * @param start start time of the job
+ * @return the slot of the job or NULL if the table is unavailable or full
+ */
+jt_slot_t *jt_start(pid_t pid, int job_id, int array_id, int array_index, const char *file, time_t start) {
+    jt_slot_t *slot = NULL;
+
+    if (!table) {
+        return NULL;
+    }
+
+    /* slots are claimed and released under the lock, a claimed slot is then written by its job only */
+    pthread_mutex_lock(&table_mutex);
+    for (int pass = 0; pass < 2 && !slot; pass++) {
+        for (int i = 0; i < JT_SLOTS; i++) {
+            jt_slot_t *candidate = table->slots + (next_slot + i) % JT_SLOTS;
+            if (candidate->state == jt_free ||
+                (pass && candidate->state != jt_running && candidate->state != jt_suspended)) {
+                slot = candidate;
+                next_slot = (next_slot + i + 1) % JT_SLOTS;
+                break;
+            }
+        }
+    }
+    if (slot) {
+        /* readers skip the slot from its claim until it is filled in */
+        jt_write_begin(slot);
+        slot->state = jt_running;
+    }
+    pthread_mutex_unlock(&table_mutex);
+
+    if (!slot) {
+        return NULL;
+    }
+
+    const char *base = strrchr(file, '/');
+
+    slot->pid = pid;
+    slot->job_id = job_id;
+    slot->array_id = array_id;
+    slot->array_index = array_index;
+    slot->status = 0;
+    slot->start = start;
+    slot->mem = slot->peak_mem = 0;
+    slot->suspended_ms = 0;
+    slot->suspended_at = 0;
+    strncpy(slot->name, base ? base + 1 : file, JT_NAME - 1);
+    slot->name[JT_NAME - 1] = '\0';
+    jt_write_end(slot);
+
+    return slot;
+}
+
+/**
+ * publish a memory sample of a running job
+ * @param slot slot of the job, NULL if unpublished
+ * @param mem latest memory sample in bytes
+ * @param peak_mem highest memory sample in bytes
+ */
+void jt_update(jt_slot_t *slot, uint64_t mem, uint64_t peak_mem) {
+    if (!slot) {
+        return;
+    }
+
+    jt_write_begin(slot);
+    slot->mem = mem;
+    slot->peak_mem = peak_mem;
+    jt_write_end(slot);
+}
+
+/**
+ * publish that a job was stopped or continued
+ * @param slot slot of the job, NULL if unpublished
+ * @param suspended the job is suspended
+ * @param suspended_ms time it spent suspended before, in milliseconds
+ * @param since start of the current suspension
+ */
+void jt_suspend(jt_slot_t *slot, bool suspended, uint64_t suspended_ms, time_t since) {
+    if (!slot) {
+        return;
+    }
+
+    jt_write_begin(slot);
+    slot->state = suspended ? jt_suspended : jt_running;
+    slot->suspended_ms = suspended_ms;
+    slot->suspended_at = suspended ? since : 0;
+    jt_write_end(slot);
+}
+
+/**
+ * publish how a job ended. It stays visible until its slot is needed
+ * @param slot slot of the job, NULL if unpublished
+ * @param signaled the job was killed by a signal
+ * @param status exit code or signal number
+ */
+void jt_finish(jt_slot_t *slot, bool signaled, int status) {
+    if (!slot) {
+        return;
+    }
+
+    pthread_mutex_lock(&table_mutex);
+    jt_write_begin(slot);
+    slot->state = signaled ? jt_signaled : jt_exited;
+    slot->status = status;
+    slot->mem = 0;
+    jt_write_end(slot);
+    pthread_mutex_unlock(&table_mutex);
+}
+
+/**
+ * map the table of a local overseer
+ * @param port port the overseer listens on
+ * @return the table or NULL if there is none
+ */
+const jt_table_t *jt_attach(uint16_t port) {
+    char name[32];
+    struct stat st;
+    const jt_table_t *a_table;
+    int fd;
+
+    jt_name(port, name);
+    if ((fd = shm_open(name, O_RDONLY | O_CLOEXEC, 0)) == -1) {
+        return NULL;
+    }
+    if (fstat(fd, &st) == -1 || st.st_size < (off_t) sizeof(jt_table_t)) {
+        close(fd);
+        return NULL;
+    }
+
+    a_table = mmap(NULL, sizeof(jt_table_t), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (a_table == MAP_FAILED) {
+        return NULL;
+    }
+
+    if (atomic_load_explicit(&a_table->magic, memory_order_acquire) != JT_MAGIC) {
+        munmap((void *) a_table, sizeof(jt_table_t));
+        return NULL;
+    }
+
+    return a_table;
+}
+
+/**
+ * unmap a table mapped by jt_attach
+ * @param a_table table
+ */
+void jt_detach(const jt_table_t *a_table) {
+    munmap((void *) a_table, sizeof(jt_table_t));
+}
+
+/**
+ * copy a slot without locking: the copy is retried until the sequence
+ * number was even and unchanged around it
+ * @param slot slot in a mapped table
+ * @param copy receives the slot
+ * @return
+ *  true: if the copy is consistent and holds a job
+ *  false: if the slot is free or kept changing
+ */
+bool jt_read(const jt_slot_t *slot, jt_slot_t *copy) {
+    for (int i = 0; i < JT_RETRIES; i++) {
+        unsigned before = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        if (before & 1) {
+            continue;
+        }
+
+        memcpy(copy, slot, sizeof(jt_slot_t));
+        atomic_thread_fence(memory_order_acquire);
+
+        if (atomic_load_explicit(&slot->seq, memory_order_relaxed) == before) {
+            return copy->state != jt_free;
+        }
+    }
+
+    return false;
+}
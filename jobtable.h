@@ -0,0 +1,72 @@
+#ifndef PROCESS_OVERSEER_JOBTABLE_H
+#define PROCESS_OVERSEER_JOBTABLE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <sys/types.h>
+#include <time.h>
+
+#define JT_SLOTS 4096 /* jobs published at once, running or recently finished */
+#define JT_MAGIC 0x6f76726b /* set once the table is ready, changed with the layout of the slots */
+#define JT_NAME 32 /* bytes of the file name kept per job */
+#define JT_RETRIES 1000 /* reads of a slot before giving up on a busy writer */
+
+/* state of a published job */
+enum jt_state {
+    jt_free, jt_running, jt_exited, jt_signaled, jt_suspended
+};
+
+/* one job, written by the overseer under a seqlock */
+typedef struct jt_slot {
+    atomic_uint seq; /* odd while the slot is written */
+    int32_t state; /* enum jt_state */
+    pid_t pid;
+    int32_t job_id; /* 0 for a job of an array */
+    int32_t array_id, array_index; /* array_id is 0 for a single job */
+    int32_t status; /* exit code or signal once finished */
+    int64_t start; /* start time in seconds since the epoch */
+    uint64_t mem; /* latest memory sample in bytes */
+    uint64_t peak_mem; /* highest memory sample in bytes */
+    uint64_t suspended_ms; /* time spent suspended, not counting the current suspension */
+    int64_t suspended_at; /* start of the current suspension in seconds since the epoch, 0 if none */
+    char name[JT_NAME]; /* file run by the job, NUL terminated */
+} jt_slot_t;
+
+/* shared memory segment /overseer-<port>, read-only for everyone but the overseer */
+typedef struct jt_table {
+    atomic_uint magic; /* JT_MAGIC once the table is ready */
+    uint32_t num_slots;
+    pid_t overseer; /* pid of the overseer publishing the table */
+    char metric[8]; /* memory metric of the samples */
+    jt_slot_t slots[JT_SLOTS];
+} jt_table_t;
+
+/* create the table of the overseer listening on port */
+bool jt_create(uint16_t port, const char *metric);
+
+/* remove the table */
+void jt_destroy(void);
+
+/* publish a started job, NULL if the table is unavailable or full */
+jt_slot_t *jt_start(pid_t, int job_id, int array_id, int array_index, const char *file, time_t start);
+
+/* publish a memory sample of a job */
+void jt_update(jt_slot_t *, uint64_t mem, uint64_t peak_mem);
+
+/* publish that a job was suspended since a given time, or resumed, with the time it spent suspended before */
+void jt_suspend(jt_slot_t *, bool suspended, uint64_t suspended_ms, time_t since);
+
+/* publish how a job ended, its slot may be reused afterwards */
+void jt_finish(jt_slot_t *, bool signaled, int status);
+
+/* map the table of the overseer listening on port, read-only */
+const jt_table_t *jt_attach(uint16_t port);
+
+/* unmap a table */
+void jt_detach(const jt_table_t *);
+
+/* copy a consistent snapshot of a slot, false if it is free or busy */
+bool jt_read(const jt_slot_t *, jt_slot_t *copy);
+
+#endif //PROCESS_OVERSEER_JOBTABLE_H
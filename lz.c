@@ -0,0 +1,242 @@
+#include <string.h>
+#include <lz.h>
+
+#define LZ_MIN_MATCH 4 /* shortest match, the length of the hashed sequence */
+#define LZ_MAX_OFFSET 65535 /* farthest match, offsets take 16 bits */
+#define LZ_HASH_BITS 13 /* size of the table of the latest position of each sequence */
+#define LZ_SKIP_SHIFT 6 /* step up the search after every 64 bytes without a match */
+
+/**
+ * read 32 bits little endian
+ * @param p bytes
+ * @return value
+ */
+uint32_t lz_get32(const uint8_t *p) {
+    return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t) p[3] << 24;
+}
+
+/**
+ * write 32 bits little endian
+ * @param p bytes
+ * @param v value
+ */
+void lz_put32(uint8_t *p, uint32_t v) {
+    p[0] = v;
+    p[1] = v >> 8;
+    p[2] = v >> 16;
+    p[3] = v >> 24;
+}
+
+/**
+ * hash the 4 bytes at a position into the table
+ * @param p bytes
+ * @return index in the table
+ */
+static uint32_t lz_hash(const uint8_t *p) {
+    uint32_t v;
+
+    memcpy(&v, p, sizeof(v));
+    return (v * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+/**
+ * write a length beyond what its 4 bits of the token hold: 255 per byte
+ * until the last one
+ * @param out output
+ * @param len length left after the 15 of the token
+ * @return output after the length
+ */
+static uint8_t *lz_put_len(uint8_t *out, size_t len) {
+    for (; len >= 255; len -= 255) {
+        *out++ = 255;
+    }
+    *out++ = len;
+    return out;
+}
+
+/**
+ * write a sequence: its token, literals and, unless it is the last one,
+ * the offset and length of the match following them
+ * @param out output
+ * @param literals literal bytes
+ * @param lit_len number of literals
+ * @param offset distance back to the match, 0 for the last sequence
+ * @param match_len length of the match
+ * @return output after the sequence
+ */
+static uint8_t *lz_put_sequence(uint8_t *out, const uint8_t *literals, size_t lit_len, size_t offset,
+                                size_t match_len) {
+    uint8_t *token = out++;
+    size_t extra = offset ? match_len - LZ_MIN_MATCH : 0;
+
+    *token = (lit_len < 15 ? lit_len : 15) << 4 | (extra < 15 ? extra : 15);
+    if (lit_len >= 15) {
+        out = lz_put_len(out, lit_len - 15);
+    }
+    memcpy(out, literals, lit_len);
+    out += lit_len;
+
+    if (offset) {
+        *out++ = offset;
+        *out++ = offset >> 8;
+        if (extra >= 15) {
+            out = lz_put_len(out, extra - 15);
+        }
+    }
+    return out;
+}
+
+/**
+ * compress a block with greedy matching: the latest position of every 4
+ * byte sequence is kept in a hash table and a match taken as soon as it is
+ * found. Sequences are a token with the number of literals and the match
+ * length in 4 bits each, the literals, then the 16 bit offset of the match,
+ * as in LZ4; the last sequence has literals only. The search steps faster
+ * through data that doesn't match, so output that can't be compressed
+ * costs little time
+ * @param in bytes to compress
+ * @param n number of bytes, LZ_BLOCK at most
+ * @param out output sized LZ_BOUND(n)
+ * @return compressed length
+ */
+size_t lz_compress(const uint8_t *in, size_t n, uint8_t *out) {
+    uint32_t table[1 << LZ_HASH_BITS]; /* position + 1 of the latest sequence of each hash, 0 if none */
+    size_t pos = 0, anchor = 0; /* position searched, first literal not written yet */
+    uint8_t *start = out;
+
+    memset(table, 0, sizeof(table));
+    while (pos + LZ_MIN_MATCH <= n) {
+        uint32_t hash = lz_hash(in + pos);
+        size_t candidate = table[hash];
+        table[hash] = pos + 1;
+
+        if (!candidate || pos - (candidate - 1) > LZ_MAX_OFFSET ||
+            memcmp(in + candidate - 1, in + pos, LZ_MIN_MATCH) != 0) {
+            pos += 1 + ((pos - anchor) >> LZ_SKIP_SHIFT);
+            continue;
+        }
+
+        size_t ref = candidate - 1, len = LZ_MIN_MATCH;
+        while (pos + len < n && in[ref + len] == in[pos + len]) len++;
+        out = lz_put_sequence(out, in + anchor, pos - anchor, pos - ref, len);
+        pos += len;
+        anchor = pos;
+    }
+
+    out = lz_put_sequence(out, in + anchor, n - anchor, 0, 0);
+    return out - start;
+}
+
+/**
+ * read a length beyond the 15 of its token
+ * @param in input, moved past the length
+ * @param end end of the input
+ * @param len length, increased by what was read
+ * @return
+ *  true: if the length was complete
+ *  false: if the input ended within it
+ */
+static bool lz_get_len(const uint8_t **in, const uint8_t *end, size_t *len) {
+    uint8_t byte;
+
+    do {
+        if (*in == end) {
+            return false;
+        }
+        byte = *(*in)++;
+        *len += byte;
+    } while (byte == 255);
+    return true;
+}
+
+/**
+ * decompress a block written by lz_compress, checking every length and
+ * offset against the input and output so corrupt data can't overrun
+ * @param in compressed bytes
+ * @param n number of compressed bytes
+ * @param out output
+ * @param cap size of the output
+ * @return output length or -1 if the data is corrupt
+ */
+long lz_decompress(const uint8_t *in, size_t n, uint8_t *out, size_t cap) {
+    const uint8_t *end = in + n;
+    size_t len = 0;
+
+    while (in < end) {
+        uint8_t token = *in++;
+        size_t lit_len = token >> 4, match_len = token & 15;
+
+        if ((lit_len == 15 && !lz_get_len(&in, end, &lit_len)) || lit_len > (size_t) (end - in) ||
+            lit_len > cap - len) {
+            return -1;
+        }
+        memcpy(out + len, in, lit_len);
+        in += lit_len;
+        len += lit_len;
+        if (in == end) {
+            break;
+        }
+
+        if (end - in < 2) {
+            return -1;
+        }
+        size_t offset = in[0] | in[1] << 8;
+        in += 2;
+        if ((match_len == 15 && !lz_get_len(&in, end, &match_len)) || !offset || offset > len ||
+            (match_len += LZ_MIN_MATCH) > cap - len) {
+            return -1;
+        }
+
+        /* a match may overlap the bytes it writes, repeating them */
+        uint8_t *dst = out + len, *src = dst - offset;
+        if (offset >= match_len) {
+            memcpy(dst, src, match_len);
+        } else {
+            for (size_t i = 0; i < match_len; i++) dst[i] = src[i];
+        }
+        len += match_len;
+    }
+    return (long) len;
+}
+
+/**
+ * frame a block: header, data compressed unless that doesn't make it
+ * smaller, and trailer
+ * @param in output of a job
+ * @param n number of bytes, LZ_BLOCK at most, 0 for the block ending the output
+ * @param out block sized LZ_BOUND(n) + LZ_HEADER + LZ_TRAILER
+ * @return size of the block
+ */
+size_t lz_block(const uint8_t *in, size_t n, uint8_t *out) {
+    size_t stored = n ? lz_compress(in, n, out + LZ_HEADER) : 0;
+    uint32_t flag = 0;
+
+    if (stored >= n) {
+        memcpy(out + LZ_HEADER, in, n);
+        stored = n;
+        flag = n ? LZ_STORED : 0;
+    }
+    lz_put32(out, n);
+    lz_put32(out + 4, stored | flag);
+    lz_put32(out + LZ_HEADER + stored, LZ_HEADER + stored + LZ_TRAILER);
+    return LZ_HEADER + stored + LZ_TRAILER;
+}
+
+/**
+ * read a block header
+ * @param header LZ_HEADER bytes
+ * @param raw_len receives the number of output bytes in the block
+ * @param stored_len receives the number of data bytes
+ * @param compressed receives whether the data must be decompressed
+ * @return
+ *  true: if the lengths are possible
+ *  false: if this is not a block header
+ */
+bool lz_header(const uint8_t *header, uint32_t *raw_len, uint32_t *stored_len, bool *compressed) {
+    uint32_t stored = lz_get32(header + 4);
+
+    *raw_len = lz_get32(header);
+    *stored_len = stored & ~LZ_STORED;
+    *compressed = !(stored & LZ_STORED) && *raw_len;
+    return *raw_len <= LZ_BLOCK && (*compressed ? *stored_len < *raw_len : *stored_len == *raw_len);
+}
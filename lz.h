@@ -0,0 +1,39 @@
+#ifndef PROCESS_OVERSEER_LZ_H
+#define PROCESS_OVERSEER_LZ_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* compressed output file: LZ_MAGIC, then blocks each holding up to
+ * LZ_BLOCK bytes of output and read on their own:
+ *   header: raw length and stored length (LZ_STORED set if not compressed), 32 bits little endian each
+ *   data: stored length bytes
+ *   trailer: size of the whole block, header and trailer included, so a reader walks back from the end
+ * A block of raw length 0 ends the output, a file without it is still written */
+#define LZ_MAGIC "OVZ1" /* first bytes of a compressed output file */
+#define LZ_MAGIC_LEN 4
+#define LZ_BLOCK 65536 /* most output bytes in a block */
+#define LZ_HEADER 8 /* bytes before the data of a block */
+#define LZ_TRAILER 4 /* bytes after the data of a block */
+#define LZ_STORED 0x80000000u /* stored length flag: the data is the output itself */
+#define LZ_BOUND(n) ((n) + (n) / 255 + 16) /* most bytes lz_compress writes for n bytes */
+
+/* compress n bytes (n <= LZ_BLOCK) into out, sized LZ_BOUND(n); returns the compressed length */
+size_t lz_compress(const uint8_t *in, size_t n, uint8_t *out);
+
+/* decompress n bytes into out of size cap; returns the output length or -1 if the data is corrupt */
+long lz_decompress(const uint8_t *in, size_t n, uint8_t *out, size_t cap);
+
+/* write a block of n raw bytes (n may be 0 to end the output) into out, sized LZ_BOUND(n) + LZ_HEADER +
+ * LZ_TRAILER; returns the size of the block */
+size_t lz_block(const uint8_t *in, size_t n, uint8_t *out);
+
+/* read a block header: raw length, stored length and whether the data is compressed; false if invalid */
+bool lz_header(const uint8_t *header, uint32_t *raw_len, uint32_t *stored_len, bool *compressed);
+
+/* read and write 32 bits little endian */
+uint32_t lz_get32(const uint8_t *);
+void lz_put32(uint8_t *, uint32_t);
+
+#endif //PROCESS_OVERSEER_LZ_H
@@ -0,0 +1,340 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <metrics.h>
+
+static const char *metric_names[] = {"rss", "anon", "pss", "uss", "cpu"};
+
+/**
+ * parse a metric name
+ * @param name rss, anon, pss or uss
+ * @param metric set to the parsed metric
+ * @return
+ *  true: if the name is known
+ *  false: otherwise
+ */
+bool metric_parse(const char *name, enum mem_metric *metric) {
+    for (int i = 0; i <= metric_uss; i++) {
+        if (strcmp(name, metric_names[i]) == 0) {
+            *metric = (enum mem_metric) i;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * get the name of a metric
+ * @param metric memory metric
+ * @return its name
+ */
+const char *metric_name(enum mem_metric metric) {
+    return metric_names[metric];
+}
+
+/**
+ * read a small /proc file with a single open and read, no stdio
+ * @param path file to read
+ * @param buf receives the content, NUL terminated
+ * @return
+ *  true: if something was read
+ *  false: if the file could not be read, the process is gone
+ */
+static bool read_proc(const char *path, char *buf) {
+    int fd;
+    ssize_t len;
+
+    if ((fd = open(path, O_RDONLY | O_CLOEXEC)) == -1) {
+        return false;
+    }
+    len = read(fd, buf, METRIC_BUFFER - 1);
+    close(fd);
+
+    if (len <= 0) {
+        return false;
+    }
+    buf[len] = '\0';
+    return true;
+}
+
+/**
+ * get the /proc file a metric is read from
+ * @param pid process
+ * @param metric memory metric
+ * @param path receives the path, 64 bytes are enough
+ */
+static void metric_path(pid_t pid, enum mem_metric metric, char *path) {
+    sprintf(path, metric == metric_pss || metric == metric_uss ? "/proc/%d/smaps_rollup" :
+                  metric == metric_cpu ? "/proc/%d/stat" : "/proc/%d/statm", pid);
+}
+
+/**
+ * parse resident or resident anonymous memory from /proc/pid/statm, the
+ * cheapest source: a few counters the kernel keeps per process
+ * @param buf content of statm
+ * @param anon only count anonymous pages (resident minus file and shmem)
+ * @return memory in bytes
+ */
+static uint64_t parse_statm(const char *buf, bool anon) {
+    static long page_size = 0;
+    unsigned long long resident, shared;
+
+    if (!page_size) {
+        page_size = sysconf(_SC_PAGESIZE);
+    }
+
+    if (sscanf(buf, "%*u %llu %llu", &resident, &shared) != 2) {
+        return 0;
+    }
+
+    return (uint64_t) (anon ? resident - shared : resident) * page_size;
+}
+
+/**
+ * parse proportional or private memory from /proc/pid/smaps_rollup, the
+ * kernel walks every mapping of the process to produce it
+ * @param buf content of smaps_rollup
+ * @param uss sum the private fields instead of Pss
+ * @return memory in bytes
+ */
+static uint64_t parse_rollup(const char *buf, bool uss) {
+    unsigned long long kb, total = 0;
+
+    for (const char *line = strchr(buf, '\n'); line; line = strchr(line, '\n')) {
+        line++;
+        if (uss ? sscanf(line, "Private_Clean: %llu kB", &kb) == 1 || sscanf(line, "Private_Dirty: %llu kB", &kb) == 1
+                : sscanf(line, "Pss: %llu kB", &kb) == 1) {
+            total += kb;
+        }
+    }
+
+    return (uint64_t) total * 1024;
+}
+
+/**
+ * parse the cpu time from /proc/pid/stat: user and system time of the
+ * process plus those of the children it reaped, so the time of a process
+ * tree carries over as its processes exit
+ * @param buf content of stat
+ * @return cpu time in microseconds
+ */
+static uint64_t parse_stat(const char *buf) {
+    static long ticks = 0;
+    unsigned long utime, stime;
+    long cutime, cstime;
+
+    if (!ticks) {
+        ticks = sysconf(_SC_CLK_TCK);
+    }
+
+    /* the command name may hold spaces and parentheses, the fields follow the last one */
+    const char *fields = strrchr(buf, ')');
+    if (!fields || sscanf(fields + 1, " %*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu %ld %ld",
+                          &utime, &stime, &cutime, &cstime) != 4) {
+        return 0;
+    }
+
+    return (uint64_t) (utime + stime + cutime + cstime) * 1000000 / ticks;
+}
+
+/**
+ * parse the content of the metric file of a process
+ * @param buf content of the file
+ * @param metric memory metric
+ * @return memory in bytes
+ */
+static uint64_t metric_parse_buf(const char *buf, enum mem_metric metric) {
+    switch (metric) {
+        case metric_anon:
+            return parse_statm(buf, true);
+        case metric_pss:
+            return parse_rollup(buf, false);
+        case metric_uss:
+            return parse_rollup(buf, true);
+        case metric_cpu:
+            return parse_stat(buf);
+        default:
+            return parse_statm(buf, false);
+    }
+}
+
+/**
+ * sample the memory or cpu time of a process
+ * @param pid process
+ * @param metric memory metric or metric_cpu
+ * @return memory in bytes or cpu time in microseconds, 0 if the process is gone
+ */
+uint64_t metric_sample(pid_t pid, enum mem_metric metric) {
+    char path[64], buf[METRIC_BUFFER];
+
+    metric_path(pid, metric, path);
+    if (!read_proc(path, buf)) {
+        return 0;
+    }
+
+    return metric_parse_buf(buf, metric);
+}
+
+/**
+ * set up a reader
+ * @param reader reader to set up
+ * @param metric memory metric it samples
+ * @param uring submit the reads of a batch through io_uring if available
+ * @return
+ *  true: if the reader is ready, maybe without io_uring
+ *  false: if out of memory
+ */
+bool metric_reader_init(metric_reader_t *reader, enum mem_metric metric, bool uring) {
+    memset(reader->buckets, 0, sizeof(reader->buckets));
+    reader->metric = metric;
+    reader->gen = 0;
+    reader->buf_size = metric == metric_pss || metric == metric_uss ? 2048 : metric == metric_cpu ? 512 : 128;
+    if (!(reader->bufs = (char *) malloc(reader->buf_size * READER_CHUNK))) {
+        fprintf(stderr, "metric_reader_init: out of memory\n");
+        return false;
+    }
+
+    reader->use_uring = uring && uring_init(&reader->ring, READER_CHUNK);
+    return true;
+}
+
+/**
+ * get the cached descriptor of the metric file of a process, opening it
+ * the first time the process is sampled
+ * @param reader reader
+ * @param pid process
+ * @return the descriptor, -1 if the process is gone or -2 if it can't be cached
+ */
+static int reader_fd(metric_reader_t *reader, pid_t pid) {
+    metric_fd_t **bucket = &reader->buckets[(unsigned) pid % READER_BUCKETS], *cached;
+    char path[64];
+    int fd;
+
+    for (cached = *bucket; cached; cached = cached->next) {
+        if (cached->pid == pid) {
+            cached->gen = reader->gen;
+            return cached->fd;
+        }
+    }
+
+    metric_path(pid, reader->metric, path);
+    if ((fd = open(path, O_RDONLY | O_CLOEXEC)) == -1) {
+        return errno == EMFILE || errno == ENFILE ? -2 : -1;
+    }
+
+    if (!(cached = (metric_fd_t *) malloc(sizeof(metric_fd_t)))) {
+        close(fd);
+        return -2;
+    }
+    cached->pid = pid;
+    cached->fd = fd;
+    cached->gen = reader->gen;
+    cached->next = *bucket;
+    *bucket = cached;
+
+    return fd;
+}
+
+/**
+ * close the cached descriptors matching a filter
+ * @param reader reader
+ * @param pid process whose descriptor is closed, 0 to close every descriptor
+ * not read by the current batch
+ */
+static void reader_drop(metric_reader_t *reader, pid_t pid) {
+    for (int i = 0; i < READER_BUCKETS; i++) {
+        if (pid) {
+            i = (int) ((unsigned) pid % READER_BUCKETS);
+        }
+
+        metric_fd_t **link = &reader->buckets[i];
+        while (*link) {
+            metric_fd_t *cached = *link;
+            if (pid ? cached->pid == pid : cached->gen != reader->gen) {
+                *link = cached->next;
+                close(cached->fd);
+                free(cached);
+            } else {
+                link = &cached->next;
+            }
+        }
+
+        if (pid) {
+            break;
+        }
+    }
+}
+
+/**
+ * sample a batch of processes. The metric files stay open from one batch
+ * to the next, so a process costs one read per batch: a pread each, or
+ * with io_uring one io_uring_enter per READER_CHUNK processes. Files of
+ * processes missing from the batch are closed.
+ * @param reader reader
+ * @param pids processes to sample, may repeat
+ * @param values receives the memory of every process in bytes, 0 if gone
+ * @param count number of processes
+ */
+void metric_reader_sample(metric_reader_t *reader, const pid_t *pids, uint64_t *values, int count) {
+    reader->gen++;
+
+    for (int base = 0; base < count; base += READER_CHUNK) {
+        int chunk = count - base < READER_CHUNK ? count - base : READER_CHUNK, n = 0;
+
+        for (int i = base; i < base + chunk; i++) {
+            int fd = reader_fd(reader, pids[i]);
+            values[i] = 0;
+            if (fd == -2) { /* out of descriptors, read it the slow way */
+                values[i] = metric_sample(pids[i], reader->metric);
+            } else if (fd != -1) {
+                reader->fds[n] = fd;
+                reader->slots[n++] = i;
+            }
+        }
+
+        if (reader->use_uring &&
+            !uring_pread_batch(&reader->ring, reader->fds, reader->bufs, reader->buf_size, reader->results, n)) {
+            fprintf(stderr, "io_uring batch failed, sampling with pread\n");
+            uring_close(&reader->ring);
+            reader->use_uring = false;
+        }
+        if (!reader->use_uring) {
+            for (int j = 0; j < n; j++) {
+                reader->results[j] = pread(reader->fds[j], reader->bufs + j * reader->buf_size,
+                                           reader->buf_size - 1, 0);
+                if (reader->results[j] == -1) {
+                    reader->results[j] = -errno;
+                }
+            }
+        }
+
+        for (int j = 0; j < n; j++) {
+            char *buf = reader->bufs + j * reader->buf_size;
+            if (reader->results[j] > 0) {
+                buf[reader->results[j]] = '\0';
+                values[reader->slots[j]] = metric_parse_buf(buf, reader->metric);
+            } else {
+                reader_drop(reader, pids[reader->slots[j]]); /* the process is gone */
+            }
+        }
+    }
+
+    reader_drop(reader, 0);
+}
+
+/**
+ * close every cached descriptor and the ring
+ * @param reader reader
+ */
+void metric_reader_close(metric_reader_t *reader) {
+    reader->gen++;
+    reader_drop(reader, 0);
+    if (reader->use_uring) {
+        uring_close(&reader->ring);
+    }
+    free(reader->bufs);
+}
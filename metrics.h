@@ -0,0 +1,63 @@
+#ifndef PROCESS_OVERSEER_METRICS_H
+#define PROCESS_OVERSEER_METRICS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <uring.h>
+
+#define METRIC_BUFFER 4096 /* large enough for /proc/pid/statm, stat and smaps_rollup */
+#define READER_CHUNK 1024 /* reads submitted at once, also the ring size */
+#define READER_BUCKETS 4096 /* buckets of the descriptor cache */
+
+/* memory metric sampled for every job */
+enum mem_metric {
+    metric_rss, /* resident set size, from statm */
+    metric_anon, /* resident anonymous memory, from statm */
+    metric_pss, /* proportional set size, from smaps_rollup */
+    metric_uss, /* private memory, from smaps_rollup */
+    metric_cpu /* not a memory metric: cpu time of the process and its reaped children in microseconds, from stat */
+};
+
+/* parse a memory metric name (rss, anon, pss or uss) */
+bool metric_parse(const char *, enum mem_metric *);
+
+/* name of a metric */
+const char *metric_name(enum mem_metric);
+
+/* memory of a process in bytes or its cpu time in microseconds, 0 if it is gone */
+uint64_t metric_sample(pid_t, enum mem_metric);
+
+/* cached descriptor of the metric file of a process */
+typedef struct metric_fd {
+    pid_t pid;
+    int fd;
+    unsigned long gen; /* batch which last read it */
+    struct metric_fd *next;
+} metric_fd_t;
+
+/* samples many processes per batch: metric files stay open between batches
+ * and are read with one pread each, or all at once through io_uring */
+typedef struct metric_reader {
+    enum mem_metric metric;
+    bool use_uring; /* ring is set up and healthy */
+    uring_t ring;
+    metric_fd_t *buckets[READER_BUCKETS]; /* open metric files by pid */
+    unsigned long gen; /* number of batches so far */
+    size_t buf_size; /* bytes read per process */
+    char *bufs; /* READER_CHUNK buffers of buf_size bytes */
+    int fds[READER_CHUNK]; /* descriptors of the chunk being read */
+    int slots[READER_CHUNK]; /* index in the batch of every descriptor */
+    ssize_t results[READER_CHUNK]; /* bytes read or -errno */
+} metric_reader_t;
+
+/* set up a reader, io_uring is used if asked for and available */
+bool metric_reader_init(metric_reader_t *, enum mem_metric, bool uring);
+
+/* sample a batch of processes, values of gone processes are 0 */
+void metric_reader_sample(metric_reader_t *, const pid_t *pids, uint64_t *values, int count);
+
+/* close every cached descriptor and the ring */
+void metric_reader_close(metric_reader_t *);
+
+#endif //PROCESS_OVERSEER_METRICS_H
@@ -0,0 +1,198 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <sys/stat.h>
+#include <lz.h>
+
+#define FOLLOW_WAIT_US 200000 /* time between two looks at a file being written */
+#define BLOCK_SIZE (LZ_BOUND(LZ_BLOCK) + LZ_HEADER + LZ_TRAILER) /* largest block in a file */
+
+/* how a block could be read */
+enum block_status {
+    block_ok, /* complete */
+    block_partial, /* the file ends within it, it is still being written */
+    block_corrupt /* not a block */
+};
+
+static uint8_t block[BLOCK_SIZE]; /* block read */
+
+/**
+ * print usage on error
+ * @param msg error message
+ */
+static void print_outcat_usage(const char *msg) {
+    fprintf(stderr, "%s\nUsage: outcat [-f] [-n lines] <file>\n", msg);
+}
+
+/**
+ * read a block of a compressed output file and decompress it
+ * @param fd file
+ * @param off offset of the block
+ * @param out receives the output, LZ_BLOCK bytes
+ * @param raw_len receives the output length, 0 for the block ending the output
+ * @param size receives the size of the block
+ * @return status of the block
+ */
+static enum block_status read_block(int fd, off_t off, uint8_t *out, uint32_t *raw_len, uint32_t *size) {
+    uint32_t stored_len;
+    bool compressed;
+    ssize_t n = pread(fd, block, LZ_HEADER, off);
+
+    if (n >= 0 && n < LZ_HEADER) {
+        return block_partial;
+    }
+    if (n == -1 || !lz_header(block, raw_len, &stored_len, &compressed)) {
+        return block_corrupt;
+    }
+
+    *size = LZ_HEADER + stored_len + LZ_TRAILER;
+    n = pread(fd, block + LZ_HEADER, stored_len + LZ_TRAILER, off + LZ_HEADER);
+    if (n >= 0 && n < (ssize_t) (stored_len + LZ_TRAILER)) {
+        return block_partial;
+    }
+    if (n == -1 || lz_get32(block + LZ_HEADER + stored_len) != *size) {
+        return block_corrupt;
+    }
+
+    if (!compressed) {
+        memcpy(out, block + LZ_HEADER, *raw_len);
+    } else if (lz_decompress(block + LZ_HEADER, stored_len, out, LZ_BLOCK) != *raw_len) {
+        return block_corrupt;
+    }
+    return block_ok;
+}
+
+/**
+ * find the block holding the first of the last lines of the output,
+ * walking back from the end of the file through the trailers. A block
+ * still being written at the end breaks the walk, the complete blocks are
+ * then found from the start reading their headers
+ * @param fd file
+ * @param lines number of lines wanted
+ * @param skip receives the number of newlines to skip in that block
+ * @return offset of the block
+ */
+static off_t find_tail(int fd, long lines, long *skip) {
+    static uint8_t out[LZ_BLOCK];
+    uint8_t trailer[LZ_TRAILER];
+    uint32_t raw_len, size;
+    struct stat st;
+    off_t end, off;
+    long newlines = 0;
+    bool last = true; /* whether the blocks seen so far hold no output */
+
+    fstat(fd, &st);
+    end = st.st_size;
+
+    /* a trailer must lead to a block ending right before it */
+    if (pread(fd, trailer, LZ_TRAILER, end - LZ_TRAILER) != LZ_TRAILER ||
+        (off = end - lz_get32(trailer)) < LZ_MAGIC_LEN ||
+        read_block(fd, off, out, &raw_len, &size) != block_ok || off + size != end) {
+        for (end = LZ_MAGIC_LEN; read_block(fd, end, out, &raw_len, &size) == block_ok; end += size) {}
+    }
+
+    /* the lines wanted start after the newline before them, the last line may or may not end with one */
+    for (off = end; off > LZ_MAGIC_LEN && newlines < lines; off -= size) {
+        if (pread(fd, trailer, LZ_TRAILER, off - LZ_TRAILER) != LZ_TRAILER ||
+            read_block(fd, off - lz_get32(trailer), out, &raw_len, &size) != block_ok) {
+            break;
+        }
+        for (uint32_t i = 0; i < raw_len; i++) {
+            newlines += out[i] == '\n';
+        }
+        if (last && raw_len) {
+            newlines -= out[raw_len - 1] == '\n';
+            last = false;
+        }
+    }
+
+    *skip = off < end && newlines >= lines ? newlines + 1 - lines : 0;
+    return off;
+}
+
+/**
+ * print a compressed output file written by the overseer for a job run
+ * with -oz. -n prints its last lines only, found from the end of the file
+ * so a large output isn't decompressed whole; -f waits for the blocks the
+ * overseer writes until the output ends, like tail -f
+ */
+int main(int argc, char **argv) {
+    static uint8_t out[LZ_BLOCK];
+    char magic[LZ_MAGIC_LEN] = "";
+    bool follow = false, ended = false;
+    long lines = -1, skip = 0;
+    uint32_t raw_len, size;
+    off_t off = LZ_MAGIC_LEN;
+    int ch, fd;
+    char *rest;
+
+    while ((ch = getopt(argc, argv, "fn:")) != -1) {
+        switch (ch) {
+            case 'f':
+                follow = true;
+                break;
+            case 'n':
+                if ((lines = strtol(optarg, &rest, 10)) < 0 || *rest) {
+                    print_outcat_usage("Lines must be a positive number");
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            default:
+                print_outcat_usage("Wrong command syntax");
+                exit(EXIT_FAILURE);
+        }
+    }
+    if (optind != argc - 1) {
+        print_outcat_usage("Please specify the file to print");
+        exit(EXIT_FAILURE);
+    }
+
+    if ((fd = open(argv[optind], O_RDONLY)) == -1) {
+        perror(argv[optind]);
+        exit(EXIT_FAILURE);
+    }
+
+    /* the overseer writes the magic before the job runs */
+    while (pread(fd, magic, LZ_MAGIC_LEN, 0) != LZ_MAGIC_LEN && follow) {
+        usleep(FOLLOW_WAIT_US);
+    }
+    if (memcmp(magic, LZ_MAGIC, LZ_MAGIC_LEN) != 0) {
+        fprintf(stderr, "%s is not a compressed output\n", argv[optind]);
+        exit(EXIT_FAILURE);
+    }
+
+    if (lines >= 0) {
+        off = find_tail(fd, lines, &skip);
+    }
+
+    while (!ended) {
+        enum block_status status = read_block(fd, off, out, &raw_len, &size);
+        if (status == block_corrupt) {
+            fprintf(stderr, "%s: corrupt block at offset %lld\n", argv[optind], (long long) off);
+            exit(EXIT_FAILURE);
+        }
+        if (status == block_partial) {
+            if (!follow) {
+                break;
+            }
+            fflush(stdout);
+            usleep(FOLLOW_WAIT_US);
+            continue;
+        }
+
+        /* the first block of the tail starts after the lines skipped */
+        uint8_t *data = out;
+        for (; skip > 0 && data < out + raw_len; data++) {
+            skip -= *data == '\n';
+        }
+        fwrite(data, 1, out + raw_len - data, stdout);
+        ended = raw_len == 0;
+        off += size;
+    }
+
+    close(fd);
+    return ferror(stdout) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
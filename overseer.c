@@ -1,844 +1,4043 @@
-//
-// Created by n10327622 on 12/09/2020.
-//
-
-#define _GNU_SOURCE
-
-#include <fcntl.h>
-#include <unistd.h>
-#include <stdlib.h>
-#include <stdbool.h>
-#include <stdio.h>
-#include <netinet/in.h>
-#include <memory.h>
-#include <arpa/inet.h>
-#include <helpers.h>
-#include <wait.h>
-#include <errno.h>
-#include <pthread.h>
-#include <stdatomic.h>
-#include <sys/sysinfo.h>
-
-#define BACKLOG 10
-#define NUM_THREADS 5
-
-/* create request struct */
-typedef struct request {
-    cmd_t *cmd_arg;
-    struct request *next;
-} request_t;
-
-/* request pool global variables */
-request_t *requests = NULL;     /* head of linked list of requests */
-request_t *last_request = NULL; /* pointer to the last request */
-int num_request = 0;            /* number of pending requests, initially none */
-pthread_mutex_t request_mutex; /* global mutex for request pool */
-pthread_cond_t got_request; /* global condition variable for our program. */
-
-/* add request to list */
-request_t *add_request(cmd_t *cmd_arg);
-
-/* get 1 request from list */
-request_t *get_request();
-
-/* handle requests loop for threads */
-void *handle_requests_loop(void *);
-
-/* process cmd1 */
-void process_cmd1(cmd_t *cmd_arg);
-
-/* process cmd2 */
-void process_cmd2(cmd_t *cmd_arg, int client_fd);
-
-/* process cmd3 */
-void process_cmd3(cmd_t *cmd_arg);
-
-/* get child pid*/
-int get_child_pid(pid_t pid);
-
-/* create request struct */
-typedef struct entry {
-    pid_t pid;
-    char current_time[TIME_BUFFER];
-    unsigned int mem;
-    int argc;
-    char **argv;
-    struct entry *next;
-} entry_t;
-
-/* entry global variables */
-entry_t *entry = NULL;      /* head of linked list of entries */
-entry_t *last_entry = NULL; /* pointer to the last entries */
-int num_entry = 0;          /* number of process entry, initially none */
-pthread_mutex_t entry_mutex; /* global mutex for entry pool */
-
-/* get available memory */
-unsigned long mem_avail(void);
-
-/* get 1 entry from list */
-entry_t *get_entry();
-
-/* add entry to list */
-entry_t *add_entry(pid_t pid, unsigned int mem, cmd_t *cmd_arg);
-
-/* Print all processes that are running */
-void send_current_process(entry_t *node, char *mem_time, int client_fd);
-
-/* Print information of a specified process */
-void send_process_info(entry_t *node, pid_t pid, int client_fd);
-
-/* Kill process using more than threshold memory */
-void kill_overhead_process(entry_t *, double);
-
-/* Calculate total memory of a process */
-unsigned int process_memory(pid_t);
-
-cmd_t *recv_cmd(int); /* receive commands from clients */
-
-bool recv_flag(int, flag_t *); /* receive flags from client */
-
-void handler(int, siginfo_t *, void *); /* signal handler */
-
-void free_cmd(cmd_t *cmd_arg); /* free addresses for 1 request */
-
-static atomic_bool quit = ATOMIC_VAR_INIT(false); /* atomic bool variable for quitting */
-
-/**
- * signal handler
- * @param sig signal to be handled
- * @param siginfo signal info
- * @param context stack context
- */
-void handler(int sig, siginfo_t *siginfo, void *context) {
-    if (sig == SIGINT) {
-        quit = true;
-        printf("%s - received SIGINT\n", get_time());
-        printf("%s - Cleaning up and terminating\n", get_time());
-        sleep(1);
-        pthread_cond_broadcast(&got_request);
-
-        /* free memory left if exist */
-        request_t *a_request;
-        while ((a_request = get_request())) {
-            free_cmd(a_request->cmd_arg);
-            free(a_request);
-        }
-
-        entry_t *a_entry;
-        while ((a_entry = get_entry())) {
-            free(a_entry);
-        }
-    }
-}
-
-/**
- * main
- * @param argc number of passed arguments from cli
- * @param argv passed arguments from cli
- * @return exit success or failure
- */
-int main(int argc, char **argv) {
-    setvbuf(stdout, NULL, _IONBF, 0); /* set no buffer for stdout */
-    setvbuf(stderr, NULL, _IONBF, 0); /* set no buffer for stderr */
-    cmd_t *cmd_arg; /* command group's information */
-
-    /* check for arguments */
-    if (argc != 2) {
-        fprintf(stderr, "usage: overseer <port>\n");
-        exit(EXIT_FAILURE);
-    }
-
-    struct sigaction sa;
-    sa.sa_flags = SA_SIGINFO;
-    sigemptyset(&sa.sa_mask);
-    sa.sa_sigaction = &handler;
-    sigaction(SIGINT, &sa, NULL);
-
-
-    /* start threads */
-    pthread_t p_threads[NUM_THREADS]; /* threads */
-
-    /* initialize the mutex and condition variable */
-    pthread_mutex_init(&request_mutex, NULL);
-    pthread_cond_init(&got_request, NULL);
-
-    pthread_mutex_init(&entry_mutex, NULL);
-
-    /* create the request-handling threads */
-    for (int i = 0; i < NUM_THREADS; i++) {
-        pthread_create(&p_threads[i], NULL, (void *(*)(void *)) handle_requests_loop, NULL);
-    }
-
-
-    /* setup networking */
-    int server_fd, client_fd;
-    uint16_t port;
-    struct sockaddr_in server_addr, client_addr;
-    socklen_t sin_size;
-
-    /* get port number to listen on */
-    if (!(port = strtol(argv[1], NULL, BASE10))) {
-        fprintf(stderr, "Port must be between 1 and 65535\nUsage: overseer <port>\n");
-        exit(EXIT_FAILURE);
-    }
-
-    /* set up socket */
-    if ((server_fd = socket(AF_INET, SOCK_STREAM, 0)) == -1) {
-        perror("socket");
-        exit(EXIT_FAILURE);
-    }
-
-    /* enable address and port reuse */
-    int opt_enable = 1;
-    setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, &opt_enable, sizeof(opt_enable));
-    setsockopt(server_fd, SOL_SOCKET, SO_REUSEPORT, &opt_enable, sizeof(opt_enable));
-
-    /* setup endpoint */
-    server_addr.sin_addr.s_addr = INADDR_ANY;
-    server_addr.sin_port = htons(port);
-    server_addr.sin_family = AF_INET;
-    memset(&server_addr.sin_zero, 0, sizeof(server_addr.sin_zero));
-
-    /* bind the socket to the end point */
-    if (bind(server_fd, (struct sockaddr *) &server_addr, sizeof(struct sockaddr)) == -1) {
-        perror("bind");
-        exit(EXIT_FAILURE);
-    }
-
-    /* start listening */
-    if (listen(server_fd, BACKLOG)) {
-        perror("listen");
-        exit(EXIT_FAILURE);
-    }
-    printf("Server starts listening on port %u...\n", port);
-    printf("%s - Total ram: %lu\n", get_time(), mem_avail());
-
-    /* repeat: accept, execute, close connection */
-    while (!quit) {
-        sin_size = sizeof(struct sockaddr_in);
-
-        /* accept connection */
-        if ((client_fd = accept(server_fd, (struct sockaddr *) &client_addr, &sin_size)) == -1) {
-            if (errno == EINTR) {
-                continue;
-            } else {
-                perror("accept");
-                continue;
-            }
-        }
-
-        printf("%s - connection received from %s\n", get_time(), inet_ntoa(client_addr.sin_addr));
-
-        /* receive command from client */
-        if (!(cmd_arg = recv_cmd(client_fd))) {
-            close(client_fd);
-            continue;
-        }
-
-        if (cmd_arg->type == cmd1) { // add request cmd1 to request pool
-            /* add request to the linked list */
-            add_request(cmd_arg);
-        } else if (cmd_arg->type == cmd2) { // process cmd2 and cmd3 and free afterwards
-            process_cmd2(cmd_arg, client_fd);
-            free_cmd(cmd_arg);
-        } else {
-            process_cmd3(cmd_arg);
-            free_cmd(cmd_arg);
-        }
-
-        /* close connection */
-        close(client_fd);
-    }
-    close(server_fd);
-
-    /* join threads */
-    for (int i = 0; i < NUM_THREADS; i++) {
-        pthread_join(p_threads[i], NULL);
-    }
-
-    /* exit gracefully */
-    exit(EXIT_SUCCESS);
-}
-
-/**
- * add request to request pool
- * @param cmd_arg cmd to be added to request pool
- * @return the added request
- */
-request_t *add_request(cmd_t *cmd_arg) {
-    request_t *a_request; /* pointer to newly added request */
-
-    /* create a new request */
-    a_request = (request_t *) malloc(sizeof(request_t));
-    if (!a_request) {
-        fprintf(stderr, "add_request: out of memory\n");
-        return NULL;
-    }
-
-    a_request->cmd_arg = cmd_arg;
-    a_request->next = NULL;
-
-    /* modify the linked list of requests */
-    pthread_mutex_lock(&request_mutex); /* get exclusive access to the list */
-
-    /* add the request to the end of the list */
-    if (!num_request) { /* the request list is empty */
-        requests = a_request;
-        last_request = a_request;
-    } else {
-        last_request->next = a_request;
-        last_request = a_request;
-    }
-
-    /* increase the total of pending requests */
-    num_request++;
-
-    /* unlock the mutex */
-    pthread_mutex_unlock(&request_mutex);
-
-    /* signal the condition variable */
-    pthread_cond_signal(&got_request);
-
-    return a_request;
-}
-
-/**
- * get request from the end of the request pool (FIFO)
- * @return the request from the end of the request pool
- */
-request_t *get_request() {
-    request_t *a_request; /* pointer to a request */
-
-    if (num_request > 0) {
-        /* get request from the head of the list */
-        a_request = requests;
-        requests = a_request->next;
-
-        /* if request is the last request on the list */
-        if (requests == NULL) {
-            last_request = NULL;
-        }
-
-        /* decrement the number of pending requests */
-        num_request--;
-    } else {
-        a_request = NULL;
-    }
-
-    /* return the request to the caller */
-    return a_request;
-}
-
-/**
- * continuously handle request from the request pool
- * @param data data passed in from pthread_create if exist
- * @return void pointer data if exist
- */
-void *handle_requests_loop(void *data) {
-
-    request_t *a_request; /* pointer to a request */
-
-    /* do forever... */
-    while (!quit) {
-        /* lock the mutex, to access the requests list exclusively. */
-        pthread_mutex_lock(&request_mutex);
-
-        /* wait for a request to arrive. Note the mutex will be
-         * unlocked here for other threads to access the requests list.
-         * After getting request and acquire mutex, it will automatically
-         * locked the mutex (require unlock explicitly) */
-        if (num_request <= 0) {
-            pthread_cond_wait(&got_request, &request_mutex);
-        }
-
-        /* get request */
-        a_request = get_request();
-
-        /* unlock lock other threads to get request */
-        pthread_mutex_unlock(&request_mutex);
-
-        if (a_request) {
-            /* handle request */
-            process_cmd1(a_request->cmd_arg);
-
-            /* free request and its resources */
-            free_cmd(a_request->cmd_arg);
-            free(a_request);
-        }
-    }
-    return NULL;
-}
-
-/**
- * process cmd_1 and exec the given file
- * @param cmd_arg command argument to be processed
- */
-void process_cmd1(cmd_t *cmd_arg) {
-    int status;
-    pid_t pid;
-
-    /* fork and execute file */
-    pid = fork();
-    if (pid == -1) {
-        perror("fork");
-    } else if (pid == 0) { /* child */
-        /* flag argument value */
-        char *outFile = "",
-                *logFile = "",
-                *exec_timeout = "10",
-                *term_timeout = "5";
-
-        /* process flags */
-        for (int i = 0; i < cmd_arg->flag_size; i++) {
-            switch (cmd_arg->flag_arg[i].type) {
-                case o:
-                    outFile = cmd_arg->flag_arg[i].value;
-                    break;
-                case log:
-                    logFile = cmd_arg->flag_arg[i].value;
-                    break;
-                case t:
-                    exec_timeout = cmd_arg->flag_arg[i].value;
-                    break;
-                default:
-                    break;
-            }
-        }
-
-        int arg_size = cmd_arg->file_size + 5;
-        char *args[arg_size + 1];
-        args[0] = "./exec";
-        args[1] = exec_timeout;
-        args[2] = term_timeout;
-        args[3] = outFile;
-        args[4] = logFile;
-
-        for (int i = 5; i < arg_size; i++) {
-            args[i] = cmd_arg->file_arg[i - 5];
-        }
-        args[arg_size] = NULL;
-
-        execv(args[0], args);
-
-        _exit(EXIT_SUCCESS);
-    } else { /* parent */
-        unsigned int mem;
-        sleep(1);
-        int child_pid = get_child_pid(pid);
-        if (!child_pid) {
-            return;
-        }
-
-        while (!quit) {
-            if ((mem = process_memory(child_pid)) > 0) {
-                if (!add_entry(child_pid, mem, cmd_arg)) {
-                    fprintf(stderr, "error adding entry\n");
-                };
-                sleep(1);
-            }
-
-            int result;
-            result = waitpid(pid, &status, WNOHANG);
-            if (result > 0) {
-                break;
-            } else if (result < 0) {
-                perror("waitpid");
-                break;
-            }
-        }
-    }
-}
-
-/**
- * process the cmd2 which is mem regulation:
- *  send entry info of all running processes to given client if no pid is passed
- *  send entry info of specific process id to given client if pid is passed
- * @param cmd_arg command argument to be processed
- * @param client_fd client to send info
- */
-void process_cmd2(cmd_t *cmd_arg, int client_fd) {
-    // print_entry(entry);
-    if (cmd_arg->flag_arg[0].value) {
-        pid_t mem_pid;
-        if (!(mem_pid = strtol(cmd_arg->flag_arg[0].value, NULL, 10))) {
-            fprintf(stderr, "invalid pid");
-            return;
-        }
-        send_process_info(entry, mem_pid, client_fd);
-    } else {
-        char mem_time[TIME_BUFFER];
-        /* get current time and offset 1 second so that we can get
-         * the current running process entry while it's being added */
-        strcpy(mem_time, get_time()); /* store current time */
-
-        /* offset 1 second */
-        struct tm tm_info;
-        strptime(mem_time, "%Y-%m-%d %H:%M:%S", &tm_info);
-        tm_info.tm_sec -= 1;
-        mktime(&tm_info);
-        strftime(mem_time, TIME_BUFFER, "%Y-%m-%d %H:%M:%S", &tm_info);
-
-        /* send the entry info of current running process */
-        send_current_process(entry, mem_time, client_fd);
-    }
-}
-
-/**
- * process cmd3 (mem kill):
- *  kill process using more than given percentage of memory
- * @param cmd_arg command argument to be processed
- */
-void process_cmd3(cmd_t *cmd_arg) {
-    if (cmd_arg->flag_arg[0].value) {
-        double mem_percent = strtod(cmd_arg->flag_arg[0].value, NULL);
-        kill_overhead_process(entry, mem_percent);
-    }
-}
-
-/**
- * get total usable memory
- * @return total usable memory
- */
-unsigned long mem_avail() {
-    struct sysinfo info;
-
-    if (sysinfo(&info) < 0)
-        return 0;
-
-    return info.totalram;
-}
-
-/**
- * get the total memory usage of given pid by reading through the /proc/pid/maps
- * @param pid given pid
- * @return total memory usage of given pid
- */
-unsigned int process_memory(pid_t pid) {
-    char buf[MAX_BUFFER];
-    FILE *f;
-
-    // Read the /proc/self/maps
-    sprintf(buf, "/proc/%d/maps", pid);
-    f = fopen(buf, "rt");
-    if (f == NULL) {
-        return 0;
-    }
-
-    unsigned long int from[MAX_ARRAY_SIZE],
-            to[MAX_ARRAY_SIZE],
-            ino[MAX_ARRAY_SIZE] = {[0 ... MAX_ARRAY_SIZE - 1] = 1};
-    int count = 0;
-    unsigned int total = 0;
-
-    // Loop through the file line by line
-    while (fgets(buf, MAX_BUFFER, f)) {
-
-        // Parse data of each line
-        char *ptr;
-        from[count] = strtoul(buf, &ptr, BASE16);
-        to[count] =  -strtoul(ptr, &ptr, BASE16);
-        ptr += INODE_OFFSET; /* shift ptr from address to inode position */
-        ino[count] = strtoul(ptr, &ptr, BASE10);
-        if (!(from[count] && to[count])) {
-            fprintf(stderr, "error reading from /proc/pid/maps\n");
-            return 0;
-        }
-
-        /* calculate total memory usage */
-        if (!ino[count]) {
-            total += to[count] - from[count];
-        }
-
-        count++;
-    }
-
-    fclose(f);
-    return total;
-}
-
-/**
- * add an entry of given process to entry list
- * @param pid given process id
- * @param mem memory usage of process
- * @param cmd_arg command argument
- * @return added entry
- */
-entry_t *add_entry(pid_t pid, unsigned int mem, cmd_t *cmd_arg) {
-
-    entry_t *a_entry; /* pointer to newly added entry */
-
-    /* create a new request */
-    a_entry = (entry_t *) malloc(sizeof(entry_t));
-    if (!a_entry) {
-        fprintf(stderr, "add_entry: out of memory\n");
-        return NULL;
-    }
-
-    a_entry->pid = pid;
-    a_entry->mem = mem; // Convert kilobytes to bytes
-    strcpy(a_entry->current_time, get_time());
-    a_entry->argc = cmd_arg->file_size;
-    a_entry->argv = cmd_arg->file_arg;
-    a_entry->next = NULL;
-
-    /* modify the linked list of entries */
-    pthread_mutex_lock(&entry_mutex); /* get exclusive access to the list */
-
-    /* add the entry to the end of the list */
-    if (!num_entry) { /* the entry list is empty */
-        entry = a_entry;
-        last_entry = a_entry;
-    } else {
-        last_entry->next = a_entry;
-        last_entry = a_entry;
-    }
-
-    /* increase the total of pending entry */
-    num_entry++;
-
-    /* unlock the mutex */
-    pthread_mutex_unlock(&entry_mutex);
-
-    return a_entry;
-}
-
-/**
- * get entry from the front of the list (FIFO)
- * @return entry from the head of the linked list
- */
-entry_t *get_entry() {
-    entry_t *a_entry; /* pointer to a request */
-
-    if (num_entry > 0) {
-        /* get request from the head of the list */
-        a_entry = entry;
-        entry = a_entry->next;
-
-        /* if request is the last request on the list */
-        if (entry == NULL) {
-            last_entry = NULL;
-        }
-
-        /* decrement the number of pending requests */
-        num_entry--;
-    } else {
-        a_entry = NULL;
-    }
-
-    /* return the request to the caller */
-    return a_entry;
-}
-
-/**
- * send info of current running process to client, including:
- * pid, mem usage and arguments, depends on given time
- * @param node head of the entry
- * @param mem_time time to query the process
- * @param client_fd the client socket
- */
-void send_current_process(entry_t *node, char *mem_time, int client_fd) {
-    int max_buffer = (num_entry + 1) * MAX_BUFFER;
-    char *buff = (char *) malloc(sizeof(char) * max_buffer);
-    memset(buff, 0, max_buffer);
-
-    for (int len = 0; node != NULL && len <= max_buffer; node = node->next) {
-        if (strcmp(node->current_time, mem_time) == 0) {
-            len += sprintf(buff + len, "%d %d ", node->pid, node->mem);
-            for (int i = 0; i < node->argc; i++) {
-                len += sprintf(buff + len, "%s ", node->argv[i]);
-            }
-            len += sprintf(buff + len, "\n");
-        }
-    }
-
-    if (!send_str(client_fd, buff)) {
-        fprintf(stderr, "error sending current process entries\n");
-    }
-    free(buff);
-}
-
-/**
- * send entire memory usage history of given pid
- * @param node the head of the entry
- * @param pid given pid to query
- * @param client_fd socket of client
- */
-void send_process_info(entry_t *node, pid_t pid, int client_fd) {
-    int max_buffer = (num_entry + 1) * MAX_BUFFER;
-    char *buff = (char *) malloc(sizeof(char) * max_buffer);
-    memset(buff, 0, max_buffer);
-
-    for (int len = 0; node != NULL && len <= max_buffer; node = node->next) {
-        if (node->pid == pid) {
-            len += sprintf(buff + len, "%s- PID:%d - Mem:%d\n", node->current_time, node->pid, node->mem);
-        }
-    }
-
-    if (!send_str(client_fd, buff)) {
-        fprintf(stderr, "error sending %d's info\n", pid);
-    }
-
-    free(buff);
-}
-
-/**
- * kill processes using over a given percentage of total usable memory
- * @param node head of the entry
- * @param mem_percent memory threshold
- */
-void kill_overhead_process(entry_t *node, double mem_percent) {
-    for (; node != NULL; node = node->next) {
-        double process_percent = (double) node->mem / (double) mem_avail() * 100.0;
-        if (process_percent > mem_percent) {
-            kill(node->pid, SIGKILL);
-        }
-    }
-}
-
-/**
- * receive the command arguments from client
- * @param client_fd socket of client
- * @return the received command argument or NULL if failed
- */
-cmd_t *recv_cmd(int client_fd) {
-    /* allocate memory for the newly created command */
-    cmd_t *cmd_arg = (cmd_t *) malloc(sizeof(cmd_t));
-
-    /* receive type of the command */
-    uint32_t type;
-    if (recv(client_fd, &type, sizeof(type), 0) != sizeof(type)) {
-        fprintf(stderr, "recv got invalid size value\n");
-        return NULL;
-    }
-    cmd_arg->type = ntohl(type);
-
-    /* receive flag size */
-    uint32_t flag_size;
-    if (recv(client_fd, &flag_size, sizeof(flag_size), 0) != sizeof(flag_size)) {
-        fprintf(stderr, "recv got invalid size value\n");
-        return NULL;
-    }
-    cmd_arg->flag_size = ntohl(flag_size);
-
-    /* receive all flags */
-    cmd_arg->flag_arg = (flag_t *) malloc(sizeof(flag_t) * 3);
-    for (int i = 0; i < cmd_arg->flag_size; i++) {
-        if (!recv_flag(client_fd, cmd_arg->flag_arg + i)) {
-            fprintf(stderr, "error receiving flag argument\n");
-            return NULL;
-        };
-    }
-
-    /* receive file arguments */
-    /* receive file size */
-    uint32_t file_size;
-    if (recv(client_fd, &file_size, sizeof(file_size), 0) != sizeof(file_size)) {
-        fprintf(stderr, "recv got invalid size value\n");
-        return NULL;
-    }
-
-    /* receive file arguments */
-    cmd_arg->file_size = ntohl(file_size);
-    cmd_arg->file_arg = (char **) malloc(sizeof(char *) * (cmd_arg->file_size + 1));
-    for (int i = 0; i < cmd_arg->file_size; i++) {
-        if (!(cmd_arg->file_arg[i] = recv_str(client_fd))) {
-            fprintf(stderr, "error receiving file arguments\n");
-            return NULL;
-        }
-    }
-    /* add null pointer to the end of the array */
-    cmd_arg->file_arg[cmd_arg->file_size] = NULL;
-
-    return cmd_arg;
-}
-
-/**
- * receive flags from client
- * @param client_fd client socket
- * @param flag_arg flag argument
- * @return
- *  True: if successful received flag
- *  False: if failed to receive flag
- */
-bool recv_flag(int client_fd, flag_t *flag_arg) {
-    /* receive type of flag */
-    uint32_t flag_type;
-    if (recv(client_fd, &flag_type, sizeof(flag_type), 0) != sizeof(flag_type)) {
-        fprintf(stderr, "recv got invalid flag type value\n");
-        return false;
-    }
-    flag_arg->type = ntohl(flag_type);
-
-    /* receive flag value */
-    /* receive if value exist first */
-    uint16_t value_exist;
-    if (recv(client_fd, &value_exist, sizeof(value_exist), 0) != sizeof(value_exist)) {
-        fprintf(stderr, "recv got invalid exist flag's exist value");
-        return false;
-    }
-    value_exist = ntohs(value_exist);
-
-    /* receive the flag's value if value exist */
-    if (value_exist) {
-        if (!(flag_arg->value = recv_str(client_fd)))
-            return false;
-    } else {
-        flag_arg->value = NULL;
-    }
-
-    return true;
-}
-
-/**
- * free memory allocated to given command argument
- * @param cmd_arg given command argument
- */
-void free_cmd(cmd_t *cmd_arg) {
-    /* free cmd_args elements */
-    /* free file args if exist (mem and mem kill doesn't have file specified) */
-    if (cmd_arg->file_arg) {
-        for (int i = 0; i < cmd_arg->file_size; i++) {
-            free(cmd_arg->file_arg[i]);
-        }
-        free(cmd_arg->file_arg);
-    }
-
-    /* free flag args and its value if exist
-     * Note that some command only has file without flag
-     * Note that some flag doesn't have value (mem) */
-    for (int i = 0; i < cmd_arg->flag_size; i++) {
-        if (cmd_arg->flag_arg[i].value) {
-            free(cmd_arg->flag_arg[i].value);
-        }
-    }
-    free(cmd_arg->flag_arg);
-
-    /* free cmd_arg */
-    free(cmd_arg);
-}
-
-/**
- * get child's pid of given pid
- * @param pid given pid
- * @return children's pid of given pid
- */
-int get_child_pid(pid_t pid) {
-    FILE *cmd;
-    char str_pid[MAX_BUFFER];
-    char command[MAX_BUFFER];
-
-    sprintf(command, "pgrep -P %d", pid);
-    cmd = popen(command, "r");
-    if (cmd == NULL) {
-        perror("popen");
-        return 0;
-    }
-    fgets(str_pid, sizeof(str_pid), cmd);
-    int child_pid;
-    if (!(child_pid = strtol(str_pid, NULL, BASE10))) {
-        pclose(cmd);
-        return 0;
-    }
-    pclose(cmd);
-    return child_pid;
-}
\ No newline at end of file
+//
+// Created by n10327622 on 12/09/2020.
+//
+
+#define _GNU_SOURCE
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <netinet/in.h>
+#include <memory.h>
+#include <arpa/inet.h>
+#include <helpers.h>
+#include <wait.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdarg.h>
+#include <inttypes.h>
+#include <signal.h>
+#include <getopt.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
+#include <sys/sysinfo.h>
+#include <sys/resource.h>
+#include <sys/un.h>
+#include <timer_wheel.h>
+#include <federation.h>
+#include <registry.h>
+#include <proc_index.h>
+#include <metrics.h>
+#include <history.h>
+#include <jobtable.h>
+#include <handoff.h>
+#include <placement.h>
+#include <heap.h>
+#include <sketch.h>
+#include <resolve.h>
+#include <pressure.h>
+#include <compress.h>
+#include <limits.h>
+
+#define BACKLOG 10
+#define NUM_THREADS 5 /* request-handling threads per shard */
+#define MAX_SHARDS 64
+#define SAMPLE_MARGIN_MS 20 /* samplers wake up this long after each second */
+#define EXEC_TIMEOUT 10 /* default execution timeout in seconds */
+#define TERM_TIMEOUT 5 /* seconds between SIGTERM and SIGKILL */
+#define CPU_WINDOW 10 /* seconds over which the cpu usage and memory growth of a job are measured */
+#define MAX_TOP 1000 /* longest top list */
+#define MAX_IDLE 64 /* kept connections of a shard waiting for their next command */
+#define MAX_ENDED_HISTORIES 1024 /* finished jobs whose histories a shard keeps, the oldest are freed first */
+#define MAX_ENDED_BYTES (64 << 20) /* most memory of the histories of finished jobs of a shard */
+
+/* what top ranks the running jobs by, every shard keeps a heap per key */
+enum top_key {
+    top_mem, top_cpu, top_growth, NUM_TOP_KEYS
+};
+#define MAX_ARRAY_JOBS 100000 /* maximum number of jobs in one job array */
+#define ARRAY_PLACEHOLDER "{}" /* replaced by the array value in the template */
+#define DEFAULT_QUEUE MAX_ARRAY_JOBS /* pending requests of a shard unless -queue is given */
+#define MAX_RETRY_AFTER 30 /* longest wait suggested to a client rejected by a full queue */
+#define DRAIN_SMOOTHING 0.3 /* weight of the latest second in the drain rate of a queue */
+
+/* job array: one template expanded server side into many jobs */
+typedef struct array {
+    int id; /* job array id returned to the client */
+    cmd_t *cmd_arg; /* template, its flags and argv are shared by every job */
+    char *list; /* comma separated values split in place, NULL for a range */
+    char **values; /* substitution values pointing into list */
+    long start, step; /* substitution range when there is no list */
+    int size; /* number of jobs in the array */
+    bool cancelled; /* array was killed, queued jobs are dropped */
+    int jobs; /* queued and running jobs, the array is freed once none is left */
+    pid_t *pids; /* pid of every running job, 0 when not running */
+    struct array *next;
+} array_t;
+
+/* job array global variables */
+array_t *arrays = NULL; /* head of linked list of job arrays */
+int num_array = 0; /* number of job arrays, also the last given id */
+pthread_mutex_t array_mutex; /* global mutex for job arrays */
+
+/* parse the spec and create a job array from the template */
+array_t *add_array(cmd_t *cmd_arg, char *spec);
+
+/* drop a job array none of whose jobs was queued */
+void remove_array(array_t *an_array);
+
+/* count a queued or running job of an array as ended, freeing the array after its last one */
+void end_array_job(array_t *an_array);
+
+/* free a job array and its template */
+void free_array(array_t *an_array);
+
+/* find a job array by id */
+array_t *find_array(int id);
+
+/* parse an @id job array reference into the id */
+int parse_array_ref(char *ref);
+
+/* memory samples of every job run from one file, kept for the life of the overseer */
+typedef struct exe_stats {
+    char *file; /* file the jobs ran */
+    int jobs; /* jobs started from it */
+    sketch_t sketch; /* memory samples of all of them */
+    struct exe_stats *next;
+} exe_stats_t;
+
+exe_stats_t *exe_stats = NULL; /* head of linked list of files */
+pthread_mutex_t exe_mutex = PTHREAD_MUTEX_INITIALIZER; /* protects the files and their sketches */
+
+/* find the memory samples of a file, added if new and counting a job if asked */
+exe_stats_t *find_exe(const char *file, bool count);
+
+/* resource whose stalls the overseer reacts to with -psi */
+enum pressure_kind {
+    pressure_memory, pressure_cpu, NUM_PRESSURE
+};
+
+/* running job carried over a hot restart */
+typedef struct handoff_job {
+    pid_t pid; /* pid of the job, still a child after execve */
+    int record_id; /* job id, 0 for a job of an array */
+    int array_id, index; /* job array and index, array_id is 0 for a single job */
+    int log_fd; /* log file of the job, kept open */
+    long timeout_ms; /* left before the pending timeout fires, -1 if none */
+    bool terminating; /* SIGTERM was sent, the pending timeout sends SIGKILL */
+    uint64_t peak_mem; /* highest memory sample */
+    sketch_t sketch; /* memory samples */
+    uint64_t cpu_tree, cpu_time; /* cpu time of the process tree and used so far */
+    time_t started; /* start time */
+    bool placed; /* the job is pinned to cpus */
+    cpu_set_t cpus; /* cpus the job is pinned to */
+    int suspended; /* 0 if running, 1 if suspended by a client, 2 if suspended under pressure */
+    uint64_t suspended_ms; /* time spent suspended, the current suspension included */
+    int argc; /* number of arguments of the job */
+    char **argv; /* arguments of the job */
+    struct handoff_job *next;
+} handoff_job_t;
+
+/* create request struct */
+typedef struct request {
+    cmd_t *cmd_arg;
+    job_record_t *record; /* registry record of a single job */
+    array_t *array; /* job array the request belongs to, NULL for a single job */
+    int index; /* index of the job in its array */
+    handoff_job_t *adopted; /* running job taken over after a hot restart, NULL otherwise */
+    struct request *next;
+} request_t;
+
+/* memkill --free waiting for the jobs it killed to exit, its client is
+ * answered by the workers reaping them or once MEMKILL_TIMEOUT_MS passed */
+typedef struct memkill {
+    int client_fd; /* parked client */
+    int killed; /* jobs killed */
+    int running; /* killed jobs not reaped yet, under memkill_mutex */
+    bool answered; /* the client was answered, under memkill_mutex */
+    uint64_t expected; /* latest memory samples of the killed jobs */
+    uint64_t before; /* memory available before they were killed */
+    timer_node_t timer; /* answers with the jobs still exiting */
+} memkill_t;
+
+pthread_mutex_t memkill_mutex = PTHREAD_MUTEX_INITIALIZER; /* progress of every memkill --free */
+
+/* running job supervised by a worker thread */
+typedef struct job {
+    pid_t pid; /* pid of the job */
+    int id; /* job id, 0 for a job of an array */
+    int log_fd; /* supervision messages are written here */
+    long term_timeout; /* seconds between SIGTERM and SIGKILL */
+    timer_node_t timer; /* execution and termination timeout */
+    int argc; /* number of arguments of the job */
+    char **argv; /* arguments of the job */
+    uint64_t mem; /* latest memory sample */
+    uint64_t peak_mem; /* highest memory sample */
+    sketch_t sketch; /* memory samples, for their quantiles */
+    exe_stats_t *exe; /* memory samples of every job of its file, NULL if it wasn't started */
+    series_t *series; /* memory history, created with the first sample */
+    uint64_t cpu_tree; /* cpu time of the process tree at the latest sample, in microseconds */
+    uint64_t cpu_time; /* cpu time used so far in microseconds, never decreasing */
+    uint64_t window_cpu[CPU_WINDOW + 1]; /* cpu_time of the latest samples, a ring */
+    uint64_t window_mem[CPU_WINDOW + 1]; /* mem of the latest samples */
+    int64_t window_ms[CPU_WINDOW + 1]; /* monotonic time of these samples */
+    int window_next, window_size; /* next slot of the ring and samples in it */
+    double cpu; /* share of the total cpu used over the window, in percent */
+    double growth; /* memory growth over the window, in bytes per second */
+    int top_pos[NUM_TOP_KEYS]; /* position in the top heaps of the shard, -1 until sampled */
+    series_t *cpu_series; /* cpu time history, created with the first sample */
+    time_t started; /* start time */
+    int array_id; /* job array of the job, 0 for a single job */
+    bool suspended; /* stopped by suspend or under pressure, its timeout paused */
+    bool pressure_suspended; /* stopped under pressure, continued once it cleared */
+    long timeout_left; /* left of the paused timeout, -1 if it had expired */
+    uint64_t suspended_ms; /* time spent suspended, the current suspension excluded */
+    int64_t suspended_at; /* start of the current suspension in milliseconds since the epoch */
+    bool placed; /* the job is pinned to cpus, counted by the placement until it ends */
+    cpu_set_t cpus; /* cpus the job is pinned to */
+    jt_slot_t *slot; /* slot in the shared job table, NULL if unpublished */
+    memkill_t *memkill; /* memkill --free which killed the job, answered once it is reaped */
+    struct job *next; /* next running job of the shard */
+} job_t;
+
+/* a shard owns a listen socket, its request pool, workers, running jobs,
+ * memory histories and sampler. Shards only meet in the mem/memkill aggregation */
+typedef struct shard {
+    int id; /* index of the shard */
+    int server_fd; /* listen socket, all shards share the port */
+    pthread_t acceptor; /* accept thread */
+    pthread_t sampler; /* memory sampling thread */
+    pthread_t workers[NUM_THREADS]; /* request-handling threads */
+
+    /* request pool */
+    request_t *requests;     /* head of linked list of requests */
+    request_t *last_request; /* pointer to the last request */
+    int num_request;         /* number of pending requests, initially none */
+    pthread_mutex_t request_mutex; /* mutex for request pool */
+    pthread_cond_t got_request; /* signalled when a request is added */
+    unsigned long drained; /* requests taken by the workers */
+    unsigned long drained_seen; /* drained when the sampler last measured it */
+    double drain_rate; /* requests taken per second, moving average updated by the sampler */
+
+    /* running jobs */
+    job_t *jobs; /* head of linked list of running jobs */
+    heap_t top[NUM_TOP_KEYS]; /* sampled running jobs by latest memory, cpu and growth */
+    pthread_mutex_t job_mutex; /* mutex for running jobs and their heaps */
+
+    /* memory histories */
+    series_t *history;      /* head of linked list of histories, oldest first */
+    series_t *last_history; /* pointer to the last history */
+    int ended_histories; /* histories of finished jobs in the list */
+    size_t ended_bytes; /* memory of those histories */
+    pthread_mutex_t history_mutex; /* mutex for the histories */
+
+    handoff_job_t *handoffs; /* running jobs left by the workers for a hot restart, under request_mutex */
+} shard_t;
+
+shard_t *shards = NULL; /* every shard of the overseer */
+int num_shards = 1; /* number of shards, one unless -shards is given */
+int max_queue = DEFAULT_QUEUE; /* pending requests of a shard before jobs are rejected, -queue */
+int quit_fd = -1; /* eventfd written once SIGINT is received */
+unsigned psi_stall_ms[NUM_PRESSURE] = {0}; /* stall within a window reacted to, none unless -psi is given */
+unsigned psi_window_ms[NUM_PRESSURE] = {PS_WINDOW_MS, PS_WINDOW_MS}; /* window of the pressure triggers */
+bool shed_suspend = false; /* jobs are suspended under pressure instead of killed, -shed suspend */
+static atomic_bool throttled = ATOMIC_VAR_INIT(false); /* queued jobs are held under pressure */
+timer_node_t resume_timer; /* resumes the jobs suspended under pressure one by one once it cleared */
+char *local_path = NULL; /* unix socket of local controllers, none unless -unix is given */
+int local_fd = -1; /* listen socket at local_path, accepted by the first shard */
+
+/* initialise the locks of a shard */
+void init_shard(shard_t *);
+
+/* start the threads of a shard, listening on the given port unless a socket was taken over */
+bool start_shard(shard_t *, uint16_t port);
+
+/* listen on the unix socket of local controllers */
+bool start_local(const char *path);
+
+/* accept loop for shards */
+void *accept_loop(void *);
+
+/* receive and process one command of a client */
+bool serve_client(shard_t *, int client_fd, bool local);
+
+/* memory sampling loop for shards */
+void *sampler_loop(void *);
+
+/* processes of every running job of a shard, sampled as one batch */
+typedef struct sample_batch {
+    pid_t *pids; /* the job and its descendants, job after job */
+    uint64_t *values; /* memory of every process */
+    uint64_t *cpu_values; /* cpu time of every process */
+    int size, capacity; /* processes in the batch and room for them */
+    int *counts; /* number of processes of every job */
+    int num_jobs, jobs_capacity; /* jobs in the batch and room for them */
+} sample_batch_t;
+
+/* add request to list */
+request_t *add_request(shard_t *, cmd_t *cmd_arg, job_record_t *a_record, array_t *an_array, int index);
+
+/* get 1 request from list */
+request_t *get_request(shard_t *);
+
+/* seconds a client should wait before n more requests fit in the queue, 0 if they fit now */
+int queue_retry_after(shard_t *, int n);
+
+/* measure how fast the workers of a shard take requests, once a second */
+void update_drain_rate(shard_t *);
+
+/* handle requests loop for threads */
+void *handle_requests_loop(void *);
+
+timer_wheel_t wheel; /* drives the timeouts of every job */
+
+/* write a supervision message to the job's log */
+void job_log(job_t *a_job, const char *fmt, ...);
+
+/* timer callback sending SIGTERM once the execution timeout expires */
+void job_timeout(void *);
+
+/* timer callback sending SIGKILL once the termination timeout expires */
+void job_term_timeout(void *);
+
+/* block until the job exits or the overseer quits */
+bool wait_job(job_t *a_job);
+
+/* supervise a started job until it exits, or hand it over on a hot restart */
+void supervise_job(shard_t *, job_t *a_job, job_record_t *a_record, array_t *an_array, int index,
+                   unsigned long timeout_ms, timer_cb on_timeout);
+
+/* supervise a job taken over from the previous image */
+void adopt_job(shard_t *, handoff_job_t *a_handoff);
+
+/* save the state and replace the process with a new image, returns on failure */
+void hot_restart(char **argv);
+
+/* restore the state saved by the previous image */
+bool restore_state(FILE *state);
+
+/* process cmd1 */
+void process_cmd1(shard_t *, cmd_t *cmd_arg, job_record_t *a_record, array_t *an_array, int index);
+
+/* register and queue a single job */
+void process_run(shard_t *, cmd_t *cmd_arg, int client_fd);
+
+/* queue a held job once the jobs it runs after ended, or drop its command */
+void release_job(job_record_t *a_record, cmd_t *cmd_arg, bool run);
+
+/* process cmd1 with a job array flag */
+void process_array(shard_t *, cmd_t *cmd_arg, int client_fd);
+
+/* run one job of a job array */
+void process_array_job(shard_t *, array_t *an_array, int index);
+
+/* process cmd2 */
+void process_cmd2(cmd_t *cmd_arg, int client_fd);
+
+/* process cmd3, true if the client is answered later */
+bool process_cmd3(cmd_t *cmd_arg, int client_fd);
+
+/* process cmd4 */
+void process_cmd4(cmd_t *cmd_arg, int client_fd);
+
+/* process cmd5 */
+void process_cmd5(int client_fd);
+
+/* process cmd6 */
+bool process_cmd6(cmd_t *cmd_arg, int client_fd);
+
+/* process cmd7 */
+void process_cmd7(cmd_t *cmd_arg, int client_fd);
+
+/* process cmd8 */
+void process_cmd8(cmd_t *cmd_arg);
+
+/* process cmd9 */
+void process_cmd9(cmd_t *cmd_arg, int client_fd);
+
+/* process cmd10 */
+void process_cmd10(cmd_t *cmd_arg, int client_fd);
+
+/* process cmd11 */
+void process_cmd11(cmd_t *cmd_arg, int client_fd);
+
+/* process cmd12 */
+void process_cmd12(cmd_t *cmd_arg, int client_fd);
+
+/* get available memory */
+unsigned long mem_avail(void);
+
+/* get memory which can still be allocated */
+unsigned long mem_free(void);
+
+/* count the running jobs of every shard */
+int running_jobs(void);
+
+/* append the latest sample of a job to its history */
+bool add_sample(shard_t *, job_t *a_job);
+
+/* mark the histories of a job as ended, freeing the oldest ended ones past the bounds */
+void end_history(shard_t *, job_t *a_job);
+
+/* free the oldest histories of finished jobs while a shard keeps too many */
+void evict_histories(shard_t *);
+
+/* Print all processes that are running with their memory or cpu usage, optionally only those of a job array */
+void send_current_process(int array_id, int client_fd, bool cpu_usage);
+
+/* part of a history asked for by mem pid and cpu pid */
+typedef struct hist_range {
+    int64_t since, until; /* first and last second sent, inclusive */
+    int64_t step; /* seconds merged into a sample, 0 to send every sample */
+} hist_range_t;
+
+/* steps of a history being merged into one sample each */
+typedef struct hist_bucket {
+    int64_t start; /* first second of the step, -1 before the first sample */
+    int64_t ts; /* latest sample of the step */
+    uint64_t val; /* largest memory or latest cpu time of the step */
+    int64_t base_ts; /* latest sample before the step, -1 if none */
+    uint64_t base_val; /* its cpu time */
+} hist_bucket_t;
+
+/* parse the --since, --until and --step flags of mem pid and cpu pid */
+bool parse_range(cmd_t *cmd_arg, hist_range_t *range);
+
+/* Print the memory or cpu history of a specified process within a time range */
+void send_process_info(pid_t pid, int client_fd, bool cpu_usage, const hist_range_t *range);
+
+/* Kill process using more than threshold memory */
+void kill_overhead_process(double);
+
+/* running job that memkill --free may kill */
+typedef struct victim {
+    job_t *job; /* valid while the job mutexes are held */
+    int shard; /* shard running the job */
+    pid_t pid;
+    uint64_t mem; /* latest memory sample */
+    double cpu; /* share of the cpu over the window, ordering the jobs shed under cpu pressure */
+    int nice; /* nice level, the highest is killed first */
+    time_t started; /* the youngest is killed first among equals */
+} victim_t;
+
+/* kill the fewest jobs to have the given memory available, true if the report is sent once they exited */
+bool free_memory(const char *goal, int client_fd);
+
+/* count a job killed by memkill --free as reaped, answering its client after the last one */
+void memkill_reaped(memkill_t *);
+
+/* current time in milliseconds since the epoch */
+int64_t epoch_ms(void);
+
+/* react to memory or cpu pressure, from the pressure thread */
+void on_pressure(const char *path, int kind, void *arg);
+
+/* kill or suspend the least important running job */
+void shed_job(enum pressure_kind kind);
+
+/* timer callback resuming the most important job suspended under pressure */
+void resume_next(void *);
+
+/* pace at which jobs suspended under pressure are resumed, in milliseconds */
+unsigned resume_interval(void);
+
+/* stop a running job, its timeout paused, false if it was suspended already */
+bool suspend_job(job_t *a_job, bool pressure);
+
+/* continue a suspended job and its timeout, false if it wasn't suspended */
+bool resume_job(job_t *a_job);
+
+/* Kill process using more than threshold cpu over the window */
+void kill_cpu_process(double);
+
+enum mem_metric metric = metric_rss; /* memory metric sampled, rss unless -metric is given */
+bool sample_uring = false; /* batch the sampler reads through io_uring with -io uring */
+
+/* Sample the memory and cpu time of every running job of a shard and its descendants */
+void sample_jobs(shard_t *, metric_reader_t *, metric_reader_t *, sample_batch_t *);
+
+cmd_t *recv_cmd(int); /* receive commands from clients */
+
+bool recv_flag(int, flag_t *); /* receive flags from client */
+
+void handler(int, siginfo_t *, void *); /* signal handler */
+
+void free_cmd(cmd_t *cmd_arg); /* free addresses for 1 request */
+
+static atomic_bool quit = ATOMIC_VAR_INIT(false); /* atomic bool variable for quitting */
+static atomic_bool restart = ATOMIC_VAR_INIT(false); /* quitting to hand everything over to a new image */
+char self_path[PATH_MAX]; /* binary started by a hot restart, the path the overseer was run from */
+
+/**
+ * signal handler
+ * @param sig signal to be handled
+ * @param siginfo signal info
+ * @param context stack context
+ */
+void handler(int sig, siginfo_t *siginfo, void *context) {
+    if (sig == SIGINT) {
+        quit = true;
+        printf("%s - received SIGINT\n", get_time());
+        printf("%s - Cleaning up and terminating\n", get_time());
+
+        /* wake up every thread waiting on the quit event */
+        uint64_t one = 1;
+        write(quit_fd, &one, sizeof(one));
+    } else if (sig == SIGUSR2 && !quit) {
+        restart = true;
+        quit = true;
+        printf("%s - received SIGUSR2\n", get_time());
+        printf("%s - Handing over to a new image\n", get_time());
+
+        uint64_t one = 1;
+        write(quit_fd, &one, sizeof(one));
+    }
+}
+
+/**
+ * main
+ * @param argc number of passed arguments from cli
+ * @param argv passed arguments from cli
+ * @return exit success or failure
+ */
+int main(int argc, char **argv) {
+    setvbuf(stdout, NULL, _IONBF, 0); /* set no buffer for stdout */
+    setvbuf(stderr, NULL, _IONBF, 0); /* set no buffer for stderr */
+    const char *usage = "usage: overseer [-shards n] [-metric rss|anon|pss|uss] [-io pread|uring] [-unix path] [-queue n] [-psi [memory:|cpu:]stall_ms[:window_ms]]... [-shed kill|suspend] [-backend host:port]... <port>\n";
+
+    /* option string for get opt method */
+    int ch, takeover_fd = -1;
+    static struct option long_options[] = {
+            {"shards", required_argument, NULL, 's'},
+            {"backend", required_argument, NULL, 'b'},
+            {"metric", required_argument, NULL, 'm'},
+            {"io", required_argument, NULL, 'i'},
+            {"unix", required_argument, NULL, 'u'},
+            {"queue", required_argument, NULL, 'q'},
+            {"psi", required_argument, NULL, 'p'},
+            {"shed", required_argument, NULL, 'h'},
+            {"takeover", required_argument, NULL, 'k'},
+            {NULL, 0,                     NULL, 0}
+    };
+
+    while ((ch = getopt_long_only(argc, argv, "", long_options, NULL)) != -1) {
+        switch (ch) {
+            case 's':
+                num_shards = (int) strtol(optarg, NULL, BASE10);
+                if (num_shards < 1 || num_shards > MAX_SHARDS) {
+                    fprintf(stderr, "Number of shards must be between 1 and %d\n", MAX_SHARDS);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 'b':
+                if (!fed_add_backend(optarg)) {
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 'm':
+                if (!metric_parse(optarg, &metric)) {
+                    fprintf(stderr, "Metric must be one of rss, anon, pss or uss\n");
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 'i':
+                if (strcmp(optarg, "uring") && strcmp(optarg, "pread")) {
+                    fprintf(stderr, "Sampler io must be uring or pread\n");
+                    exit(EXIT_FAILURE);
+                }
+                sample_uring = strcmp(optarg, "uring") == 0;
+                break;
+            case 'u':
+                local_path = optarg;
+                break;
+            case 'q':
+                max_queue = (int) strtol(optarg, NULL, BASE10);
+                if (max_queue < 1) {
+                    fprintf(stderr, "Queue bound must be at least 1\n");
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 'p': {
+                enum pressure_kind kind = strncmp(optarg, "cpu:", 4) == 0 ? pressure_cpu : pressure_memory;
+                char *end, *spec = kind == pressure_cpu ? optarg + 4 :
+                                   strncmp(optarg, "memory:", 7) == 0 ? optarg + 7 : optarg;
+                psi_stall_ms[kind] = (unsigned) strtoul(spec, &end, BASE10);
+                if (*end == ':') {
+                    psi_window_ms[kind] = (unsigned) strtoul(end + 1, &end, BASE10);
+                }
+                if (*end || !psi_stall_ms[kind] || psi_stall_ms[kind] >= psi_window_ms[kind] ||
+                    psi_window_ms[kind] < PS_MIN_WINDOW_MS || psi_window_ms[kind] > PS_MAX_WINDOW_MS) {
+                    fprintf(stderr, "Stall must be below its window of %d to %d ms\n", PS_MIN_WINDOW_MS,
+                            PS_MAX_WINDOW_MS);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            }
+            case 'h':
+                if (strcmp(optarg, "kill") && strcmp(optarg, "suspend")) {
+                    fprintf(stderr, "Jobs are shed with kill or suspend\n");
+                    exit(EXIT_FAILURE);
+                }
+                shed_suspend = strcmp(optarg, "suspend") == 0;
+                break;
+            case 'k': /* given by a hot restart only */
+                takeover_fd = (int) strtol(optarg, NULL, BASE10);
+                break;
+            default:
+                fprintf(stderr, "%s", usage);
+                exit(EXIT_FAILURE);
+        }
+    }
+
+    /* check for arguments */
+    if (argc - optind != 1) {
+        fprintf(stderr, "%s", usage);
+        exit(EXIT_FAILURE);
+    }
+
+    /* get port number to listen on */
+    uint16_t port;
+    if (!(port = strtol(argv[optind], NULL, BASE10))) {
+        fprintf(stderr, "Port must be between 1 and 65535\n%s", usage);
+        exit(EXIT_FAILURE);
+    }
+
+    if ((quit_fd = eventfd(0, EFD_CLOEXEC)) == -1) {
+        perror("eventfd");
+        exit(EXIT_FAILURE);
+    }
+
+    /* the samplers keep the /proc files of every sampled process open */
+    struct rlimit nofile;
+    if (getrlimit(RLIMIT_NOFILE, &nofile) == 0 && nofile.rlim_cur < nofile.rlim_max) {
+        nofile.rlim_cur = nofile.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &nofile);
+    }
+
+    /* a hot restart runs whatever binary is found at this path by then */
+    ssize_t path_len = readlink("/proc/self/exe", self_path, sizeof(self_path) - 1);
+    self_path[path_len > 0 ? path_len : 0] = '\0';
+
+    struct sigaction sa;
+    sa.sa_flags = SA_SIGINFO;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_sigaction = &handler;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGUSR2, &sa, NULL);
+
+    pthread_mutex_init(&array_mutex, NULL);
+
+    /* start the timer wheel driving the job timeouts */
+    if (!tw_start(&wheel)) {
+        exit(EXIT_FAILURE);
+    }
+
+    /* output of the jobs run with -oz is compressed on its own thread */
+    if (!cz_start()) {
+        fprintf(stderr, "Compressing thread unavailable, -oz won't work\n");
+    }
+
+    /* jobs run with -cpus are placed on the cpus the overseer may use */
+    pl_init();
+
+    /* local readers find the running jobs in shared memory */
+    if (!jt_create(port, metric_name(metric))) {
+        fprintf(stderr, "Shared job table unavailable, mem --shm won't work\n");
+    }
+
+    shards = (shard_t *) calloc(num_shards, sizeof(shard_t));
+    for (int i = 0; i < num_shards; i++) {
+        shards[i].id = i;
+        init_shard(shards + i);
+    }
+
+    /* held jobs are queued by the end of the jobs they run after */
+    reg_on_release(release_job);
+
+    /* after a hot restart, take the sockets, jobs and queues over before anything runs */
+    if (takeover_fd != -1) {
+        FILE *state = ho_open(takeover_fd);
+        if (!state || !restore_state(state)) {
+            fprintf(stderr, "Could not take over from the previous image\n");
+            exit(EXIT_FAILURE);
+        }
+        fclose(state);
+    }
+
+    /* the unix socket must be ready before the first shard polls it */
+    if (local_path && local_fd == -1 && !start_local(local_path)) {
+        exit(EXIT_FAILURE);
+    }
+
+    /* start the shards, each one listens on the same port */
+    for (int i = 0; i < num_shards; i++) {
+        if (!start_shard(shards + i, port)) {
+            exit(EXIT_FAILURE);
+        }
+    }
+    printf("Server starts listening on port %u with %d shard(s), sampling %s...\n",
+           port, num_shards, metric_name(metric));
+    if (local_path) {
+        printf("%s - Local controllers connect to %s\n", get_time(), local_path);
+    }
+    printf("%s - Total ram: %lu\n", get_time(), mem_avail());
+
+    /* a front routes every command to its backends */
+    if (fed_enabled()) {
+        printf("%s - Routing commands to backends\n", get_time());
+        if (!fed_start(quit_fd)) {
+            exit(EXIT_FAILURE);
+        }
+    } else if (psi_stall_ms[pressure_memory] || psi_stall_ms[pressure_cpu]) {
+        /* react to stalls of the host, and of the cgroup the jobs share if there is one */
+        const char *system_files[NUM_PRESSURE] = {PS_SYSTEM_MEMORY, PS_SYSTEM_CPU};
+        const char *cgroup_files[NUM_PRESSURE] = {"memory.pressure", "cpu.pressure"};
+        const char *names[NUM_PRESSURE] = {"memory", "cpu"};
+        char cgroup_path[PATH_MAX];
+        bool watched = false;
+
+        for (int kind = 0; kind < NUM_PRESSURE; kind++) {
+            if (!psi_stall_ms[kind]) {
+                continue;
+            }
+            watched = ps_watch(system_files[kind], psi_stall_ms[kind], psi_window_ms[kind], kind) || watched;
+            if (ps_cgroup_file(cgroup_files[kind], cgroup_path, sizeof(cgroup_path))) {
+                watched = ps_watch(cgroup_path, psi_stall_ms[kind], psi_window_ms[kind], kind) || watched;
+            }
+            printf("%s - %s jobs on %ums of %s stall within %ums\n", get_time(),
+                   shed_suspend ? "Suspending" : "Killing", psi_stall_ms[kind], names[kind], psi_window_ms[kind]);
+        }
+        if (!watched || !ps_start(on_pressure, NULL)) {
+            fprintf(stderr, "Pressure triggers unavailable, -psi won't work\n");
+        }
+    }
+
+    /* wait for the acceptors to stop, then wake up the workers */
+    for (int i = 0; i < num_shards; i++) {
+        pthread_join(shards[i].acceptor, NULL);
+    }
+    ps_stop();
+
+    for (int i = 0; i < num_shards; i++) {
+        shard_t *shard = shards + i;
+
+        pthread_mutex_lock(&shard->request_mutex);
+        pthread_cond_broadcast(&shard->got_request);
+        pthread_mutex_unlock(&shard->request_mutex);
+
+        /* join threads */
+        for (int j = 0; j < NUM_THREADS; j++) {
+            pthread_join(shard->workers[j], NULL);
+        }
+        pthread_join(shard->sampler, NULL);
+    }
+
+    /* every thread is stopped, a new image takes over from here. If it can't be run,
+     * shut down and kill the jobs which were handed over */
+    if (restart) {
+        cz_stop(false);
+        hot_restart(argv);
+        fprintf(stderr, "%s - Hot restart failed, terminating\n", get_time());
+    }
+
+    for (int i = 0; i < num_shards; i++) {
+        shard_t *shard = shards + i;
+        close(shard->server_fd);
+
+        /* free memory left if exist */
+        request_t *a_request;
+        while ((a_request = get_request(shard))) {
+            if (a_request->adopted) {
+                a_request->adopted->next = shard->handoffs;
+                shard->handoffs = a_request->adopted;
+            } else if (!a_request->array) {
+                free_cmd(a_request->cmd_arg);
+            }
+            free(a_request);
+        }
+
+        while (shard->handoffs) {
+            handoff_job_t *a_handoff = shard->handoffs;
+            shard->handoffs = a_handoff->next;
+
+            kill(-a_handoff->pid, SIGKILL);
+            waitpid(a_handoff->pid, NULL, 0);
+            if (a_handoff->log_fd != STDOUT_FILENO) {
+                close(a_handoff->log_fd);
+            }
+            for (int j = 0; j < a_handoff->argc; j++) {
+                free(a_handoff->argv[j]);
+            }
+            free(a_handoff->argv);
+            free(a_handoff);
+        }
+
+        for (int key = 0; key < NUM_TOP_KEYS; key++) {
+            heap_free(shard->top + key);
+        }
+        while (shard->history) {
+            series_t *a_series = shard->history;
+            shard->history = a_series->next;
+            hist_free(a_series);
+        }
+    }
+    if (local_path) {
+        close(local_fd);
+        unlink(local_path);
+    }
+    if (fed_enabled()) {
+        fed_stop();
+    }
+    reg_shutdown();
+    while (arrays) {
+        array_t *an_array = arrays;
+        arrays = an_array->next;
+        free_array(an_array);
+    }
+    while (exe_stats) {
+        exe_stats_t *an_exe = exe_stats;
+        exe_stats = an_exe->next;
+        free(an_exe->file);
+        free(an_exe);
+    }
+    cz_stop(true);
+    jt_destroy();
+    pi_clear();
+    tw_stop(&wheel);
+    free(shards);
+
+    /* exit gracefully */
+    exit(EXIT_SUCCESS);
+}
+
+/**
+ * initialise the mutexes and condition variable of a shard, before a hot
+ * restart fills its queue
+ * @param shard shard to initialise
+ */
+void init_shard(shard_t *shard) {
+    shard->server_fd = -1;
+    pthread_mutex_init(&shard->request_mutex, NULL);
+    pthread_cond_init(&shard->got_request, NULL);
+    pthread_mutex_init(&shard->job_mutex, NULL);
+    pthread_mutex_init(&shard->history_mutex, NULL);
+}
+
+/**
+ * set up the listen socket of a shard and start its threads. SO_REUSEPORT
+ * lets every shard bind the same port, the kernel spreads the connections.
+ * A socket taken over by a hot restart is kept, with whatever connections
+ * queued up in its backlog meanwhile
+ * @param shard shard to start
+ * @param port port to listen on
+ * @return
+ *  true: if the shard is running
+ *  false: if the socket could not be set up
+ */
+bool start_shard(shard_t *shard, uint16_t port) {
+    struct sockaddr_storage server_addr = {0};
+    struct sockaddr_in6 *addr6 = (struct sockaddr_in6 *) &server_addr;
+    struct sockaddr_in *addr4 = (struct sockaddr_in *) &server_addr;
+
+    if (shard->server_fd != -1) {
+        goto threads;
+    }
+
+    /* set up socket, IPv6 accepting IPv4 as well unless the host has no IPv6 */
+    if ((shard->server_fd = socket(AF_INET6, SOCK_STREAM | SOCK_CLOEXEC, 0)) != -1) {
+        int opt_disable = 0;
+        setsockopt(shard->server_fd, IPPROTO_IPV6, IPV6_V6ONLY, &opt_disable, sizeof(opt_disable));
+        addr6->sin6_family = AF_INET6;
+        addr6->sin6_addr = in6addr_any;
+        addr6->sin6_port = htons(port);
+    } else if ((shard->server_fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0)) != -1) {
+        addr4->sin_family = AF_INET;
+        addr4->sin_addr.s_addr = INADDR_ANY;
+        addr4->sin_port = htons(port);
+    } else {
+        perror("socket");
+        return false;
+    }
+
+    /* enable address and port reuse */
+    int opt_enable = 1;
+    setsockopt(shard->server_fd, SOL_SOCKET, SO_REUSEADDR, &opt_enable, sizeof(opt_enable));
+    setsockopt(shard->server_fd, SOL_SOCKET, SO_REUSEPORT, &opt_enable, sizeof(opt_enable));
+
+    /* bind the socket to the end point */
+    if (bind(shard->server_fd, (struct sockaddr *) &server_addr, rs_len(&server_addr)) == -1) {
+        perror("bind");
+        return false;
+    }
+
+    /* start listening */
+    if (listen(shard->server_fd, BACKLOG)) {
+        perror("listen");
+        return false;
+    }
+
+threads:
+    /* create the request-handling threads */
+    for (int i = 0; i < NUM_THREADS; i++) {
+        pthread_create(&shard->workers[i], NULL, handle_requests_loop, shard);
+    }
+    pthread_create(&shard->sampler, NULL, sampler_loop, shard);
+    pthread_create(&shard->acceptor, NULL, accept_loop, shard);
+
+    return true;
+}
+
+/**
+ * listen on a unix socket for controllers on this host. They skip the tcp
+ * stack and can pass their stdout and stderr to the job they run
+ * @param path path of the socket, replaced if it exists
+ * @return
+ *  true: if the socket is listening
+ *  false: if the socket could not be set up
+ */
+bool start_local(const char *path) {
+    struct sockaddr_un local_addr;
+
+    memset(&local_addr, 0, sizeof(local_addr));
+    local_addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(local_addr.sun_path)) {
+        fprintf(stderr, "Socket path is too long: %s\n", path);
+        return false;
+    }
+    strcpy(local_addr.sun_path, path);
+
+    /* set up socket */
+    if ((local_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)) == -1) {
+        perror("socket");
+        return false;
+    }
+
+    /* bind the socket to the path, a stale socket of a previous run is removed */
+    unlink(path);
+    if (bind(local_fd, (struct sockaddr *) &local_addr, sizeof(local_addr)) == -1) {
+        perror("bind");
+        return false;
+    }
+
+    /* start listening */
+    if (listen(local_fd, BACKLOG)) {
+        perror("listen");
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * receive a command of a client and process it. The connection is closed
+ * afterwards unless the client waits for a job or for the jobs memkill
+ * --free killed to exit, or asked to keep it with the keepalive flag to
+ * send its next command
+ * @param shard shard which accepted the client
+ * @param client_fd client socket
+ * @param local client connected to the unix socket
+ * @return
+ *  true: if the connection is kept for the next command
+ *  false: if it was closed or handed over to a waiter
+ */
+bool serve_client(shard_t *shard, int client_fd, bool local) {
+    cmd_t *cmd_arg; /* command group's information */
+    bool parked = false; /* client is answered later */
+    bool keep;
+
+    /* receive command from client */
+    if (!(cmd_arg = recv_cmd(client_fd))) {
+        close(client_fd);
+        return false;
+    }
+
+    /* a local controller passes the stdout and stderr of its job, the flag means nothing over tcp */
+    if (local && get_flag(cmd_arg, stdio) && !recv_fds(client_fd, cmd_arg->stdio_fds, 2)) {
+        free_cmd(cmd_arg);
+        close(client_fd);
+        return false;
+    }
+    keep = get_flag(cmd_arg, keepalive) != NULL;
+
+    if (fed_enabled()) { // a front only routes commands
+        parked = fed_process(cmd_arg, client_fd);
+        free_cmd(cmd_arg);
+    } else if (cmd_arg->type == cmd1) { // add request cmd1 to request pool
+        if (get_flag(cmd_arg, array)) {
+            /* expand the job array, its template is kept by the array */
+            process_array(shard, cmd_arg, client_fd);
+        } else {
+            /* register the job and add request to the linked list */
+            process_run(shard, cmd_arg, client_fd);
+        }
+    } else if (cmd_arg->type == cmd2) { // process cmd2 to cmd9 and free afterwards
+        process_cmd2(cmd_arg, client_fd);
+        free_cmd(cmd_arg);
+    } else if (cmd_arg->type == cmd3) {
+        parked = process_cmd3(cmd_arg, client_fd);
+        free_cmd(cmd_arg);
+    } else if (cmd_arg->type == cmd4) {
+        process_cmd4(cmd_arg, client_fd);
+        free_cmd(cmd_arg);
+    } else if (cmd_arg->type == cmd5) {
+        process_cmd5(client_fd);
+        free_cmd(cmd_arg);
+    } else if (cmd_arg->type == cmd7) {
+        process_cmd7(cmd_arg, client_fd);
+        free_cmd(cmd_arg);
+    } else if (cmd_arg->type == cmd8) {
+        process_cmd8(cmd_arg);
+        free_cmd(cmd_arg);
+    } else if (cmd_arg->type == cmd9) {
+        process_cmd9(cmd_arg, client_fd);
+        free_cmd(cmd_arg);
+    } else if (cmd_arg->type == cmd10) {
+        process_cmd10(cmd_arg, client_fd);
+        free_cmd(cmd_arg);
+    } else if (cmd_arg->type == cmd11) {
+        process_cmd11(cmd_arg, client_fd);
+        free_cmd(cmd_arg);
+    } else if (cmd_arg->type == cmd12) {
+        process_cmd12(cmd_arg, client_fd);
+        free_cmd(cmd_arg);
+    } else {
+        parked = process_cmd6(cmd_arg, client_fd);
+        free_cmd(cmd_arg);
+    }
+
+    /* close connection unless the client waits for a job or sends another command */
+    if (parked) {
+        return false;
+    }
+    if (!keep) {
+        close(client_fd);
+    }
+    return keep;
+}
+
+/**
+ * accept connections of a shard and process their commands until SIGINT.
+ * The first shard also accepts the local controllers. Connections kept by
+ * clients are polled along with the listening sockets, up to MAX_IDLE of
+ * them, and closed when the shard stops
+ * @param data the shard
+ * @return NULL
+ */
+void *accept_loop(void *data) {
+    shard_t *shard = data;
+    int client_fd;
+    struct sockaddr_storage client_addr;
+    char client_name[RS_ADDRSTRLEN];
+    socklen_t sin_size;
+    bool local; /* client connected to the unix socket */
+    bool idle_local[MAX_IDLE]; /* kept connection came from the unix socket */
+    int num_idle = 0;
+    struct pollfd fds[3 + MAX_IDLE] = {
+            {.fd = shard->server_fd, .events = POLLIN},
+            {.fd = quit_fd, .events = POLLIN},
+            {.fd = shard->id ? -1 : local_fd, .events = POLLIN} /* poll skips a negative fd */
+    };
+
+    /* repeat: accept or pick a kept connection, execute, close connection */
+    while (!quit) {
+        if (poll(fds, 3 + num_idle, -1) == -1) {
+            continue;
+        }
+
+        /* next commands on kept connections, a connection closed by its client is dropped */
+        for (int i = num_idle - 1; i >= 0 && !quit; i--) {
+            if (!fds[3 + i].revents) {
+                continue;
+            }
+            client_fd = fds[3 + i].fd;
+            local = idle_local[i];
+            fds[3 + i] = fds[3 + --num_idle];
+            idle_local[i] = idle_local[num_idle];
+
+            if (serve_client(shard, client_fd, local)) {
+                fds[3 + num_idle] = (struct pollfd) {.fd = client_fd, .events = POLLIN};
+                idle_local[num_idle++] = local;
+            }
+        }
+
+        local = fds[2].revents & POLLIN;
+        if (quit || (!local && !(fds[0].revents & POLLIN))) {
+            continue;
+        }
+        sin_size = sizeof(client_addr);
+
+        /* accept connection */
+        client_fd = local ? accept4(local_fd, NULL, NULL, SOCK_CLOEXEC)
+                          : accept4(shard->server_fd, (struct sockaddr *) &client_addr, &sin_size, SOCK_CLOEXEC);
+        if (client_fd == -1) {
+            if (errno == EINTR) {
+                continue;
+            } else {
+                perror("accept");
+                continue;
+            }
+        }
+
+        if (local) {
+            printf("%s - connection received on %s\n", get_time(), local_path);
+        } else {
+            rs_format(&client_addr, client_name);
+            printf("%s - connection received from %s\n", get_time(), client_name);
+        }
+
+        /* keep the connection if the client asked for it and there is room */
+        if (serve_client(shard, client_fd, local)) {
+            if (num_idle == MAX_IDLE) {
+                close(client_fd);
+            } else {
+                fds[3 + num_idle] = (struct pollfd) {.fd = client_fd, .events = POLLIN};
+                idle_local[num_idle++] = local;
+            }
+        }
+    }
+
+    for (int i = 0; i < num_idle; i++) {
+        close(fds[3 + i].fd);
+    }
+
+    return NULL;
+}
+
+/**
+ * sample the memory and cpu time of every running job of a shard once a second
+ * @param data the shard
+ * @return NULL
+ */
+void *sampler_loop(void *data) {
+    shard_t *shard = data;
+    struct pollfd quit_poll = {.fd = quit_fd, .events = POLLIN};
+    struct timespec now;
+    sample_batch_t batch = {.pids = NULL, .values = NULL, .cpu_values = NULL, .size = 0, .capacity = 0,
+                            .counts = NULL, .num_jobs = 0, .jobs_capacity = 0};
+    metric_reader_t *reader = (metric_reader_t *) malloc(sizeof(metric_reader_t));
+    metric_reader_t *cpu_reader = (metric_reader_t *) malloc(sizeof(metric_reader_t));
+
+    if (!reader || !cpu_reader || !metric_reader_init(reader, metric, sample_uring)) {
+        fprintf(stderr, "shard %d: could not start sampling\n", shard->id);
+        free(reader);
+        free(cpu_reader);
+        return NULL;
+    }
+    if (!metric_reader_init(cpu_reader, metric_cpu, sample_uring)) {
+        fprintf(stderr, "shard %d: could not start sampling\n", shard->id);
+        metric_reader_close(reader);
+        free(reader);
+        free(cpu_reader);
+        return NULL;
+    }
+    if (sample_uring && !reader->use_uring) {
+        fprintf(stderr, "shard %d: io_uring unavailable, sampling with pread\n", shard->id);
+    }
+
+    while (!quit) {
+        /* one /proc sweep per tick is shared by the samplers of every shard */
+        pthread_mutex_lock(&shard->job_mutex);
+        bool busy = shard->jobs != NULL;
+        pthread_mutex_unlock(&shard->job_mutex);
+        if (busy) {
+            pi_refresh();
+        }
+
+        pthread_mutex_lock(&shard->job_mutex);
+        sample_jobs(shard, reader, cpu_reader, &batch);
+        pthread_mutex_unlock(&shard->job_mutex);
+        update_drain_rate(shard);
+
+        /* sleep until just after the next second unless the overseer quits,
+         * staying aligned so there is one sample per job and second. The
+         * margin covers time() being served from the coarse clock */
+        clock_gettime(CLOCK_REALTIME, &now);
+        poll(&quit_poll, 1, 1000 - now.tv_nsec / 1000000 + SAMPLE_MARGIN_MS);
+    }
+
+    metric_reader_close(reader);
+    metric_reader_close(cpu_reader);
+    free(reader);
+    free(cpu_reader);
+    free(batch.pids);
+    free(batch.values);
+    free(batch.cpu_values);
+    free(batch.counts);
+    return NULL;
+}
+
+/**
+ * add request to request pool
+ * @param shard shard owning the request pool
+ * @param cmd_arg cmd to be added to request pool
+ * @param a_record registry record of a single job, NULL for a job array
+ * @param an_array job array the request belongs to, NULL for a single job
+ * @param index index of the job in its array
+ * @return the added request
+ */
+request_t *add_request(shard_t *shard, cmd_t *cmd_arg, job_record_t *a_record, array_t *an_array, int index) {
+    request_t *a_request; /* pointer to newly added request */
+
+    /* create a new request */
+    a_request = (request_t *) malloc(sizeof(request_t));
+    if (!a_request) {
+        fprintf(stderr, "add_request: out of memory\n");
+        return NULL;
+    }
+
+    a_request->cmd_arg = cmd_arg;
+    a_request->record = a_record;
+    a_request->array = an_array;
+    a_request->index = index;
+    a_request->adopted = NULL;
+    a_request->next = NULL;
+
+    /* modify the linked list of requests */
+    pthread_mutex_lock(&shard->request_mutex); /* get exclusive access to the list */
+
+    /* add the request to the end of the list */
+    if (!shard->num_request) { /* the request list is empty */
+        shard->requests = a_request;
+        shard->last_request = a_request;
+    } else {
+        shard->last_request->next = a_request;
+        shard->last_request = a_request;
+    }
+
+    /* increase the total of pending requests */
+    shard->num_request++;
+
+    /* unlock the mutex */
+    pthread_mutex_unlock(&shard->request_mutex);
+
+    /* signal the condition variable */
+    pthread_cond_signal(&shard->got_request);
+
+    return a_request;
+}
+
+/**
+ * get request from the end of the request pool (FIFO)
+ * @param shard shard owning the request pool
+ * @return the request from the end of the request pool
+ */
+request_t *get_request(shard_t *shard) {
+    request_t *a_request; /* pointer to a request */
+
+    if (shard->num_request > 0) {
+        /* get request from the head of the list */
+        a_request = shard->requests;
+        shard->requests = a_request->next;
+
+        /* if request is the last request on the list */
+        if (shard->requests == NULL) {
+            shard->last_request = NULL;
+        }
+
+        /* decrement the number of pending requests */
+        shard->num_request--;
+        shard->drained++;
+    } else {
+        a_request = NULL;
+    }
+
+    /* return the request to the caller */
+    return a_request;
+}
+
+/**
+ * check if the queue of a shard has room for n more requests. When it
+ * doesn't, the wait suggested to the client is the time the workers take
+ * to drain the excess at the rate they took requests lately, between 1
+ * and MAX_RETRY_AFTER seconds. Only the accept thread of the shard queues
+ * new requests, so the room is still there when it adds them
+ * @param shard shard owning the request pool
+ * @param n number of requests to be added
+ * @return 0 if they fit, otherwise the seconds to wait
+ */
+int queue_retry_after(shard_t *shard, int n) {
+    int seconds = MAX_RETRY_AFTER;
+
+    pthread_mutex_lock(&shard->request_mutex);
+    int excess = shard->num_request + n - max_queue;
+    double rate = shard->drain_rate, current = (double) (shard->drained - shard->drained_seen);
+    if (current > rate) {
+        rate = current; /* the current second already took more, after a burst or before any was measured */
+    }
+    if (excess > 0 && rate * MAX_RETRY_AFTER > excess) {
+        seconds = (int) (excess / rate) + 1;
+    }
+    pthread_mutex_unlock(&shard->request_mutex);
+
+    return excess > 0 ? seconds : 0;
+}
+
+/**
+ * update the drain rate of the queue of a shard with the requests taken
+ * since the last call, about a second ago
+ * @param shard shard owning the request pool
+ */
+void update_drain_rate(shard_t *shard) {
+    pthread_mutex_lock(&shard->request_mutex);
+    double taken = (double) (shard->drained - shard->drained_seen);
+    shard->drained_seen = shard->drained;
+    shard->drain_rate += DRAIN_SMOOTHING * (taken - shard->drain_rate);
+    pthread_mutex_unlock(&shard->request_mutex);
+}
+
+/**
+ * continuously handle request from the request pool
+ * @param data the shard owning the request pool
+ * @return void pointer data if exist
+ */
+void *handle_requests_loop(void *data) {
+    shard_t *shard = data;
+    request_t *a_request; /* pointer to a request */
+
+    /* do forever... */
+    while (!quit) {
+        /* lock the mutex, to access the requests list exclusively. */
+        pthread_mutex_lock(&shard->request_mutex);
+
+        /* wait for a request to arrive. Note the mutex will be
+         * unlocked here for other threads to access the requests list.
+         * After getting request and acquire mutex, it will automatically
+         * locked the mutex (require unlock explicitly). Under memory
+         * pressure new jobs wait, jobs handed over by a hot restart run */
+        while ((shard->num_request <= 0 || (throttled && !shard->requests->adopted)) && !quit) {
+            pthread_cond_wait(&shard->got_request, &shard->request_mutex);
+        }
+
+        /* get request */
+        a_request = quit ? NULL : get_request(shard);
+
+        /* unlock lock other threads to get request */
+        pthread_mutex_unlock(&shard->request_mutex);
+
+        if (a_request && a_request->adopted) {
+            /* supervise a job started by the previous image */
+            adopt_job(shard, a_request->adopted);
+            free(a_request);
+        } else if (a_request && a_request->array) {
+            /* handle job of an array, the template stays with the array. A
+             * job handed to the next image still counts for the array */
+            process_array_job(shard, a_request->array, a_request->index);
+            if (!restart) {
+                end_array_job(a_request->array);
+            }
+            free(a_request);
+        } else if (a_request) {
+            /* handle request */
+            process_cmd1(shard, a_request->cmd_arg, a_request->record, NULL, 0);
+
+            /* free the request */
+            free_cmd(a_request->cmd_arg);
+            free(a_request);
+        }
+    }
+    return NULL;
+}
+
+/**
+ * log a supervision message to the job's log file (or stdout if none)
+ * @param a_job job the message is about
+ * @param fmt printf style format
+ */
+void job_log(job_t *a_job, const char *fmt, ...) {
+    char msg[MAX_BUFFER];
+    va_list args;
+
+    va_start(args, fmt);
+    vsnprintf(msg, sizeof(msg), fmt, args);
+    va_end(args);
+
+    dprintf(a_job->log_fd, "%s - %s\n", get_time(), msg);
+}
+
+/**
+ * timer callback: the job ran past its execution timeout, ask its process
+ * group to terminate and escalate to SIGKILL if it is still alive after the
+ * termination timeout
+ * @param data the timed out job
+ */
+void job_timeout(void *data) {
+    job_t *a_job = data;
+
+    job_log(a_job, "sent SIGTERM to %d", a_job->pid);
+    kill(-a_job->pid, SIGTERM);
+
+    tw_add(&wheel, &a_job->timer, a_job->term_timeout * 1000UL, job_term_timeout, a_job);
+}
+
+/**
+ * timer callback: the job ignored SIGTERM, kill its process group
+ * @param data the job to kill
+ */
+void job_term_timeout(void *data) {
+    job_t *a_job = data;
+
+    job_log(a_job, "sent SIGKILL to %d", a_job->pid);
+    kill(-a_job->pid, SIGKILL);
+}
+
+/**
+ * block until the job exits, without reaping it, or until the overseer quits
+ * @param a_job running job
+ * @return
+ *  true: if the job has exited
+ *  false: if the overseer is quitting or the job can't be waited for
+ */
+bool wait_job(job_t *a_job) {
+    struct pollfd fds[2] = {
+            {.fd = (int) syscall(SYS_pidfd_open, a_job->pid, 0), .events = POLLIN},
+            {.fd = quit_fd, .events = POLLIN}
+    };
+    siginfo_t info;
+    bool exited = false;
+
+    while (!quit && !exited) {
+        /* without pidfd support fall back to checking once a second */
+        if (fds[0].fd == -1) {
+            poll(fds + 1, 1, 1000);
+        } else if (poll(fds, 2, -1) == -1) {
+            continue;
+        }
+
+        info.si_pid = 0;
+        if (waitid(P_PID, a_job->pid, &info, WEXITED | WNOHANG | WNOWAIT) == -1) {
+            perror("waitid");
+            break;
+        }
+        exited = info.si_pid != 0;
+    }
+
+    if (fds[0].fd != -1) {
+        close(fds[0].fd);
+    }
+    return exited;
+}
+
+/**
+ * process cmd_1: fork and exec the given file and wait for it to exit while
+ * the shard's sampler records its memory. The execution timeout and
+ * SIGTERM/SIGKILL escalation are driven by the timer wheel so no supervisor
+ * process is needed per job.
+ * @param shard shard running the job
+ * @param cmd_arg command argument to be processed
+ * @param a_record registry record of the job, NULL for a job of an array
+ * @param an_array job array the job belongs to, NULL for a single job
+ * @param index index of the job in its array
+ */
+void process_cmd1(shard_t *shard, cmd_t *cmd_arg, job_record_t *a_record, array_t *an_array, int index) {
+    char *outFile = NULL, *logFile = NULL, *cpus = NULL, *nice_level = NULL, *io_priority = NULL;
+    bool compressed = false;
+    long exec_timeout = EXEC_TIMEOUT;
+    int outFd = -1, job_nice = 0, job_ioprio = 0;
+    job_t a_job = {
+            .pid = 0,
+            .id = a_record ? a_record->id : 0,
+            .array_id = an_array ? an_array->id : 0,
+            .log_fd = STDOUT_FILENO,
+            .peak_mem = 0,
+            .series = NULL,
+            .placed = false,
+            .slot = NULL,
+            .term_timeout = TERM_TIMEOUT,
+            .top_pos = {-1, -1, -1},
+            .argc = cmd_arg->file_size,
+            .argv = cmd_arg->file_arg
+    };
+
+    /* process flags */
+    for (int i = 0; i < cmd_arg->flag_size; i++) {
+        switch (cmd_arg->flag_arg[i].type) {
+            case o:
+            case oz:
+                outFile = cmd_arg->flag_arg[i].value;
+                compressed = cmd_arg->flag_arg[i].type == oz;
+                break;
+            case log:
+                logFile = cmd_arg->flag_arg[i].value;
+                break;
+            case t:
+                exec_timeout = strtol(cmd_arg->flag_arg[i].value, NULL, BASE10);
+                break;
+            case cpuset:
+                cpus = cmd_arg->flag_arg[i].value;
+                break;
+            case niceness:
+                nice_level = cmd_arg->flag_arg[i].value;
+                break;
+            case ioprio:
+                io_priority = cmd_arg->flag_arg[i].value;
+                break;
+            default:
+                break;
+        }
+    }
+
+    /* open logfile and outfile if exist, they must not leak into other jobs */
+    if (outFile && (outFd = open(outFile, O_CREAT | O_TRUNC | O_WRONLY | O_CLOEXEC, 0644)) == -1) {
+        perror("open outfile");
+    } else if (compressed) {
+        /* the job writes to a pipe the compressing thread reads */
+        outFd = cz_open(outFd, outFile);
+    }
+    if (logFile && (a_job.log_fd = open(logFile, O_CREAT | O_TRUNC | O_WRONLY | O_CLOEXEC, 0644)) == -1) {
+        perror("open logfile");
+        a_job.log_fd = STDOUT_FILENO;
+    }
+
+    /* concat file arguments into string */
+    char file_args[MAX_BUFFER] = "";
+    for (int i = 0, len = 0; i < cmd_arg->file_size && len < MAX_BUFFER; i++) {
+        len += snprintf(file_args + len, MAX_BUFFER - len, i ? " %s" : "%s", cmd_arg->file_arg[i]);
+    }
+
+    /* check the placement before placing anything */
+    int err = EINVAL;
+    char *end;
+    if (nice_level && ((job_nice = (int) strtol(nice_level, &end, BASE10)) < -20 || job_nice > 19 || *end)) {
+        job_log(&a_job, "could not execute %s - Error: invalid nice level %s", file_args, nice_level);
+        goto failed;
+    }
+    if (io_priority && !pl_parse_ioprio(io_priority, &job_ioprio)) {
+        job_log(&a_job, "could not execute %s - Error: invalid io priority %s", file_args, io_priority);
+        goto failed;
+    }
+    if (cpus && strncmp(cpus, "auto", 4) == 0) {
+        /* auto[:n] spreads the jobs over the least loaded cpus */
+        long n = cpus[4] == ':' ? strtol(cpus + 5, &end, BASE10) : 1;
+        if ((cpus[4] && cpus[4] != ':') || (cpus[4] == ':' && (*end || n < 1)) || !pl_pick((int) n, &a_job.cpus)) {
+            job_log(&a_job, "could not execute %s - Error: invalid cpus %s", file_args, cpus);
+            goto failed;
+        }
+        a_job.placed = true;
+    } else if (cpus) {
+        if (!pl_parse_cpus(cpus, &a_job.cpus)) {
+            job_log(&a_job, "could not execute %s - Error: invalid cpus %s", file_args, cpus);
+            goto failed;
+        }
+        pl_hold(&a_job.cpus);
+        a_job.placed = true;
+    }
+
+    /* pipe to report a placement or execv failure back to the parent */
+    int pipe_fds[2], report[2];
+    if (pipe2(pipe_fds, O_CLOEXEC) == -1) {
+        err = errno;
+        perror("pipe2");
+        goto failed;
+    }
+
+    job_log(&a_job, "attempting to execute %s", file_args);
+
+    /* fork and execute file */
+    a_job.pid = fork();
+    if (a_job.pid == -1) {
+        err = errno;
+        perror("fork");
+        close(pipe_fds[0]);
+        close(pipe_fds[1]);
+        goto failed;
+    } else if (a_job.pid == 0) { /* child */
+        /* set pgid so that sigint doesn't interrupt the child */
+        setpgid(0, 0);
+
+        /* ignore SIGINT */
+        signal(SIGINT, SIG_IGN);
+
+        /* place the job, the step that failed is reported with its error */
+        report[0] = 1;
+        if (a_job.placed && sched_setaffinity(0, sizeof(a_job.cpus), &a_job.cpus) == -1) {
+            goto child_failed;
+        }
+        report[0] = 2;
+        if (nice_level && setpriority(PRIO_PROCESS, 0, job_nice) == -1) {
+            goto child_failed;
+        }
+        report[0] = 3;
+        if (io_priority && syscall(SYS_ioprio_set, PL_IOPRIO_WHO_PROCESS, 0, job_ioprio) == -1) {
+            goto child_failed;
+        }
+
+        /* duplicate outfile descriptor onto stdout and stderr if exist,
+         * otherwise use the ones passed by a local controller */
+        if (outFd != -1) {
+            dup2(outFd, STDOUT_FILENO);
+            dup2(outFd, STDERR_FILENO);
+        } else if (cmd_arg->stdio_fds[0] != -1) {
+            dup2(cmd_arg->stdio_fds[0], STDOUT_FILENO);
+            dup2(cmd_arg->stdio_fds[1], STDERR_FILENO);
+        }
+
+        /* execute the file */
+        report[0] = 0;
+        execv(cmd_arg->file_arg[0], cmd_arg->file_arg);
+
+child_failed:
+        /* write to the pipe the failed step and error code */
+        report[1] = errno;
+        write(pipe_fds[1], report, sizeof(report));
+        _exit(report[1]);
+    }
+
+    /* parent: nothing in the pipe means the exec succeeded */
+    close(pipe_fds[1]);
+    if (read(pipe_fds[0], report, sizeof(report)) == sizeof(report)) {
+        static const char *steps[] = {"execute", "set the cpus of", "set the nice level of", "set the io priority of"};
+        close(pipe_fds[0]);
+        err = report[1];
+        job_log(&a_job, "could not %s %s - Error: %s", steps[report[0]], file_args, strerror(err));
+        waitpid(a_job.pid, NULL, 0);
+        goto failed;
+    }
+    close(pipe_fds[0]);
+
+    job_log(&a_job, "%s has been executed with pid %d", file_args, a_job.pid);
+    if (a_job.placed) {
+        char cpu_list[MAX_BUFFER];
+        pl_format(&a_job.cpus, cpu_list, sizeof(cpu_list));
+        job_log(&a_job, "%d runs on cpus %s", a_job.pid, cpu_list);
+    }
+    if (a_record) {
+        reg_start(a_record, a_job.pid);
+    }
+    a_job.started = time(NULL);
+    a_job.exe = find_exe(a_job.argv[0], true);
+
+    supervise_job(shard, &a_job, a_record, an_array, index, exec_timeout * 1000UL, job_timeout);
+    goto cleanup;
+
+failed:
+    if (a_job.placed) {
+        pl_release(&a_job.cpus);
+    }
+    if (a_record) {
+        reg_finish(a_record, job_failed, err, 0, NULL);
+    }
+
+cleanup:
+    if (outFd != -1) {
+        close(outFd);
+    }
+    if (a_job.log_fd != STDOUT_FILENO) {
+        close(a_job.log_fd);
+    }
+}
+
+/**
+ * supervise a started job: publish it, arm its timeout and hand it to the
+ * sampler until it exits, then reap it and answer its waiters. If the
+ * overseer quits meanwhile the job is killed and reaped, unless it is
+ * restarting: the job is then left running for the new image with what is
+ * needed to adopt it
+ * @param shard shard running the job
+ * @param a_job started job
+ * @param a_record registry record of the job, NULL for a job of an array
+ * @param an_array job array the job belongs to, NULL for a single job
+ * @param index index of the job in its array
+ * @param timeout_ms time before on_timeout fires
+ * @param on_timeout job_timeout, or job_term_timeout if SIGTERM was already sent
+ */
+void supervise_job(shard_t *shard, job_t *a_job, job_record_t *a_record, array_t *an_array, int index,
+                   unsigned long timeout_ms, timer_cb on_timeout) {
+    /* publish the pid so the whole array can be killed */
+    if (an_array) {
+        pthread_mutex_lock(&array_mutex);
+        an_array->pids[index] = a_job->pid;
+        pthread_mutex_unlock(&array_mutex);
+    }
+
+    /* publish the job before the sampler sees it, only one of them writes its slot at a time */
+    a_job->slot = jt_start(a_job->pid, a_record ? a_record->id : 0, an_array ? an_array->id : 0, index,
+                           a_job->argv[0], a_job->started);
+
+    /* arm the execution timeout, a job suspended before a hot restart keeps it paused */
+    if (a_job->suspended) {
+        a_job->timeout_left = (long) timeout_ms;
+        a_job->timer.cb = on_timeout;
+    } else {
+        tw_add(&wheel, &a_job->timer, timeout_ms, on_timeout, a_job);
+    }
+    if (a_job->suspended || a_job->suspended_ms) {
+        jt_suspend(a_job->slot, a_job->suspended, a_job->suspended_ms, a_job->suspended_at / 1000);
+    }
+
+    /* hand the job to the sampler until it exits. The job is only reaped
+     * once it left the shard and its timer is cancelled so neither memkill
+     * nor the timer can ever signal a recycled pid */
+    pthread_mutex_lock(&shard->job_mutex);
+    a_job->next = shard->jobs;
+    shard->jobs = a_job;
+    pthread_mutex_unlock(&shard->job_mutex);
+
+    bool exited = wait_job(a_job);
+
+    pthread_mutex_lock(&shard->job_mutex);
+    job_t **link = &shard->jobs;
+    while (*link != a_job) link = &(*link)->next;
+    *link = a_job->next;
+    for (int key = 0; key < NUM_TOP_KEYS; key++) {
+        if (a_job->top_pos[key] != -1) {
+            heap_remove(shard->top + key, a_job->top_pos[key]);
+        }
+    }
+    pthread_mutex_unlock(&shard->job_mutex);
+
+    /* killed by memkill --free, its client is answered once the last of its jobs is reaped */
+    if (a_job->memkill) {
+        memkill_reaped(a_job->memkill);
+    }
+
+    long timeout_left = exited ? -1 : a_job->suspended ? a_job->timeout_left : tw_remaining(&wheel, &a_job->timer);
+    bool terminating = a_job->timer.cb == job_term_timeout;
+    tw_cancel(&wheel, &a_job->timer);
+
+    if (an_array) {
+        pthread_mutex_lock(&array_mutex);
+        an_array->pids[index] = 0;
+        pthread_mutex_unlock(&array_mutex);
+    }
+
+    if (!exited && restart) {
+        /* leave the job to the new image, its log file stays open */
+        handoff_job_t *a_handoff = (handoff_job_t *) malloc(sizeof(handoff_job_t));
+        a_handoff->pid = a_job->pid;
+        a_handoff->record_id = a_record ? a_record->id : 0;
+        a_handoff->array_id = an_array ? an_array->id : 0;
+        a_handoff->index = index;
+        a_handoff->log_fd = a_job->log_fd;
+        a_handoff->timeout_ms = timeout_left;
+        a_handoff->terminating = terminating;
+        a_handoff->peak_mem = a_job->peak_mem;
+        a_handoff->sketch = a_job->sketch;
+        a_handoff->cpu_tree = a_job->cpu_tree;
+        a_handoff->cpu_time = a_job->cpu_time;
+        a_handoff->started = a_job->started;
+        a_handoff->placed = a_job->placed;
+        a_handoff->cpus = a_job->cpus;
+        a_handoff->suspended = a_job->suspended ? 1 + a_job->pressure_suspended : 0;
+        a_handoff->suspended_ms = a_job->suspended_ms + (a_job->suspended ? epoch_ms() - a_job->suspended_at : 0);
+        a_handoff->argc = a_job->argc;
+        a_handoff->argv = (char **) malloc(sizeof(char *) * (a_job->argc + 1));
+        for (int i = 0; i < a_job->argc; i++) {
+            a_handoff->argv[i] = strdup(a_job->argv[i]);
+        }
+        a_handoff->argv[a_job->argc] = NULL;
+        a_job->log_fd = STDOUT_FILENO;
+
+        pthread_mutex_lock(&shard->request_mutex);
+        a_handoff->next = shard->handoffs;
+        shard->handoffs = a_handoff;
+        pthread_mutex_unlock(&shard->request_mutex);
+        return;
+    }
+
+    if (a_job->placed) {
+        pl_release(&a_job->cpus);
+    }
+    end_history(shard, a_job);
+
+    /* the overseer is shutting down, don't leave the job behind */
+    if (!exited && quit) {
+        job_log(a_job, "sent SIGKILL to %d, the overseer is shutting down", a_job->pid);
+        kill(-a_job->pid, SIGKILL);
+        exited = true;
+    }
+
+    /* waitid failed, block until the job exits rather than leave it unreaped */
+    if (!exited) {
+        job_log(a_job, "could not watch %d, waiting for it to exit", a_job->pid);
+    }
+
+    int status;
+    if (waitpid(a_job->pid, &status, 0) > 0) {
+        job_log(a_job, "%d has terminated with status code %d", a_job->pid, WEXITSTATUS(status));
+        jt_finish(a_job->slot, WIFSIGNALED(status), WIFSIGNALED(status) ? WTERMSIG(status) : WEXITSTATUS(status));
+
+        /* answer the clients waiting for the job */
+        if (a_record && WIFSIGNALED(status)) {
+            reg_finish(a_record, job_signaled, WTERMSIG(status), a_job->peak_mem, &a_job->sketch);
+        } else if (a_record) {
+            reg_finish(a_record, job_exited, WEXITSTATUS(status), a_job->peak_mem, &a_job->sketch);
+        }
+    } else {
+        /* its status is lost, the clients waiting for it must still be answered */
+        int err = errno;
+        job_log(a_job, "could not reap %d - Error: %s", a_job->pid, strerror(err));
+        jt_finish(a_job->slot, false, -1);
+        if (a_record) {
+            reg_finish(a_record, job_failed, err, a_job->peak_mem, &a_job->sketch);
+        }
+    }
+}
+
+/**
+ * supervise a job started by the previous image of the overseer. It is still
+ * a child since execve kept the pid, its timeout resumes where it was and
+ * its memory history goes on
+ * @param shard shard running the job
+ * @param a_handoff the job as saved by the previous image, freed here
+ */
+void adopt_job(shard_t *shard, handoff_job_t *a_handoff) {
+    job_t a_job = {
+            .pid = a_handoff->pid,
+            .id = a_handoff->record_id,
+            .log_fd = a_handoff->log_fd,
+            .mem = 0,
+            .peak_mem = a_handoff->peak_mem,
+            .sketch = a_handoff->sketch,
+            .exe = find_exe(a_handoff->argv[0], false),
+            .cpu_tree = a_handoff->cpu_tree,
+            .cpu_time = a_handoff->cpu_time,
+            .series = NULL,
+            .started = a_handoff->started,
+            .array_id = a_handoff->array_id,
+            .suspended = a_handoff->suspended != 0,
+            .pressure_suspended = a_handoff->suspended == 2,
+            .suspended_ms = a_handoff->suspended_ms,
+            .suspended_at = a_handoff->suspended ? epoch_ms() : 0,
+            .placed = a_handoff->placed,
+            .cpus = a_handoff->cpus,
+            .slot = NULL,
+            .term_timeout = TERM_TIMEOUT,
+            .top_pos = {-1, -1, -1},
+            .argc = a_handoff->argc,
+            .argv = a_handoff->argv
+    };
+    job_record_t *a_record = a_handoff->record_id ? reg_get(a_handoff->record_id) : NULL;
+    array_t *an_array = a_handoff->array_id ? find_array(a_handoff->array_id) : NULL;
+
+    /* keep appending to the histories of the pid, those of an earlier job with the same pid ended */
+    pthread_mutex_lock(&shard->history_mutex);
+    for (series_t *a_series = shard->history; a_series; a_series = a_series->next) {
+        if (a_series->pid != a_job.pid || a_series->ended) {
+            continue;
+        } else if (a_series->cpu) {
+            a_job.cpu_series = a_series;
+        } else {
+            a_job.series = a_series;
+        }
+    }
+    pthread_mutex_unlock(&shard->history_mutex);
+
+    job_log(&a_job, "%d has been taken over after a hot restart", a_job.pid);
+    if (a_job.placed) {
+        pl_hold(&a_job.cpus);
+    }
+
+    /* jobs suspended under pressure by the previous image are resumed by this one */
+    if (a_job.pressure_suspended) {
+        tw_add(&wheel, &resume_timer, resume_interval(), resume_next, NULL);
+    }
+
+    /* a job whose timer was not pending already got SIGKILL */
+    supervise_job(shard, &a_job, a_record, an_array, a_handoff->index,
+                  a_handoff->timeout_ms > 0 ? (unsigned long) a_handoff->timeout_ms : 0,
+                  a_handoff->terminating || a_handoff->timeout_ms < 0 ? job_term_timeout : job_timeout);
+    if (an_array && !restart) {
+        end_array_job(an_array);
+    }
+
+    if (a_job.log_fd != STDOUT_FILENO) {
+        close(a_job.log_fd);
+    }
+    for (int i = 0; i < a_handoff->argc; i++) {
+        free(a_handoff->argv[i]);
+    }
+    free(a_handoff->argv);
+    free(a_handoff);
+}
+
+/**
+ * write a job handed over by a worker, or still queued for adoption
+ * @param state hot restart state
+ * @param a_handoff the job
+ */
+static void save_handoff(FILE *state, handoff_job_t *a_handoff) {
+    ho_put_int(state, a_handoff->pid);
+    ho_put_int(state, a_handoff->record_id);
+    ho_put_int(state, a_handoff->array_id);
+    ho_put_int(state, a_handoff->index);
+    ho_put_fd(state, a_handoff->log_fd == STDOUT_FILENO ? -1 : a_handoff->log_fd);
+    ho_put_int(state, a_handoff->timeout_ms);
+    ho_put_int(state, a_handoff->terminating);
+    ho_put_int(state, (int64_t) a_handoff->peak_mem);
+    ho_put_sketch(state, &a_handoff->sketch);
+    ho_put_int(state, (int64_t) a_handoff->cpu_tree);
+    ho_put_int(state, (int64_t) a_handoff->cpu_time);
+    ho_put_int(state, a_handoff->started);
+    ho_put_int(state, a_handoff->placed);
+    ho_put_bytes(state, &a_handoff->cpus, sizeof(a_handoff->cpus));
+    ho_put_int(state, a_handoff->suspended);
+    ho_put_int(state, (int64_t) a_handoff->suspended_ms);
+    ho_put_int(state, a_handoff->argc);
+    for (int i = 0; i < a_handoff->argc; i++) {
+        ho_put_str(state, a_handoff->argv[i]);
+    }
+}
+
+/**
+ * read a job written by save_handoff
+ * @param state hot restart state
+ * @return the job to adopt
+ */
+static handoff_job_t *load_handoff(FILE *state) {
+    handoff_job_t *a_handoff = (handoff_job_t *) calloc(1, sizeof(handoff_job_t));
+
+    a_handoff->pid = (pid_t) ho_get_int(state);
+    a_handoff->record_id = (int) ho_get_int(state);
+    a_handoff->array_id = (int) ho_get_int(state);
+    a_handoff->index = (int) ho_get_int(state);
+    a_handoff->log_fd = ho_get_fd(state);
+    if (a_handoff->log_fd == -1) {
+        a_handoff->log_fd = STDOUT_FILENO;
+    }
+    a_handoff->timeout_ms = (long) ho_get_int(state);
+    a_handoff->terminating = ho_get_int(state) != 0;
+    a_handoff->peak_mem = (uint64_t) ho_get_int(state);
+    ho_get_sketch(state, &a_handoff->sketch);
+    a_handoff->cpu_tree = (uint64_t) ho_get_int(state);
+    a_handoff->cpu_time = (uint64_t) ho_get_int(state);
+    a_handoff->started = (time_t) ho_get_int(state);
+    a_handoff->placed = ho_get_int(state) != 0;
+    ho_get_bytes(state, &a_handoff->cpus, sizeof(a_handoff->cpus));
+    a_handoff->suspended = (int) ho_get_int(state);
+    a_handoff->suspended_ms = (uint64_t) ho_get_int(state);
+    a_handoff->argc = (int) ho_get_int(state);
+    if (a_handoff->argc < 0) {
+        a_handoff->argc = 0;
+    }
+    a_handoff->argv = (char **) malloc(sizeof(char *) * (a_handoff->argc + 1));
+    for (int i = 0; i < a_handoff->argc; i++) {
+        if (!(a_handoff->argv[i] = ho_get_str(state))) {
+            a_handoff->argv[i] = strdup("");
+        }
+    }
+    a_handoff->argv[a_handoff->argc] = NULL;
+
+    return a_handoff;
+}
+
+/**
+ * hot restart, once every thread stopped: save the listen sockets, the
+ * registry and its parked clients, the job arrays, then for every shard its
+ * memory histories, running jobs and queued requests, and the compressed
+ * outputs being written. The process then execs the binary at the path it
+ * was started from, keeping its pid so the jobs stay its children and no
+ * connection is refused: the listen sockets never close and queue new
+ * connections until the new image accepts them
+ * @param argv arguments the overseer was started with
+ */
+void hot_restart(char **argv) {
+    FILE *state = ho_create();
+    if (!state) {
+        return;
+    }
+
+    ho_put_int(state, num_shards);
+    for (int i = 0; i < num_shards; i++) {
+        ho_put_fd(state, shards[i].server_fd);
+    }
+    ho_put_fd(state, local_fd);
+
+    reg_save(state);
+
+    /* job arrays with their template */
+    int count = 0;
+    for (array_t *an_array = arrays; an_array; an_array = an_array->next) count++;
+    ho_put_int(state, num_array);
+    ho_put_int(state, count);
+    for (array_t *an_array = arrays; an_array; an_array = an_array->next) {
+        ho_put_int(state, an_array->id);
+        ho_put_int(state, an_array->cancelled);
+        ho_put_cmd(state, an_array->cmd_arg);
+    }
+
+    /* memory samples of every file */
+    count = 0;
+    for (exe_stats_t *an_exe = exe_stats; an_exe; an_exe = an_exe->next) count++;
+    ho_put_int(state, count);
+    for (exe_stats_t *an_exe = exe_stats; an_exe; an_exe = an_exe->next) {
+        ho_put_str(state, an_exe->file);
+        ho_put_int(state, an_exe->jobs);
+        ho_put_sketch(state, &an_exe->sketch);
+    }
+
+    for (int i = 0; i < num_shards; i++) {
+        shard_t *shard = shards + i;
+
+        count = 0;
+        for (series_t *a_series = shard->history; a_series; a_series = a_series->next) count++;
+        ho_put_int(state, count);
+        for (series_t *a_series = shard->history; a_series; a_series = a_series->next) {
+            hist_save(state, a_series);
+        }
+
+        /* running jobs, those adopted after the previous restart included */
+        count = 0;
+        for (handoff_job_t *a_handoff = shard->handoffs; a_handoff; a_handoff = a_handoff->next) count++;
+        for (request_t *a_request = shard->requests; a_request; a_request = a_request->next) {
+            if (a_request->adopted) count++;
+        }
+        ho_put_int(state, count);
+        for (handoff_job_t *a_handoff = shard->handoffs; a_handoff; a_handoff = a_handoff->next) {
+            save_handoff(state, a_handoff);
+        }
+        for (request_t *a_request = shard->requests; a_request; a_request = a_request->next) {
+            if (a_request->adopted) save_handoff(state, a_request->adopted);
+        }
+
+        /* queued requests in order */
+        count = 0;
+        for (request_t *a_request = shard->requests; a_request; a_request = a_request->next) {
+            if (!a_request->adopted) count++;
+        }
+        ho_put_int(state, count);
+        for (request_t *a_request = shard->requests; a_request; a_request = a_request->next) {
+            if (a_request->adopted) continue;
+            ho_put_int(state, a_request->array ? a_request->array->id : 0);
+            ho_put_int(state, a_request->index);
+            if (!a_request->array) {
+                ho_put_int(state, a_request->record ? a_request->record->id : 0);
+                ho_put_cmd(state, a_request->cmd_arg);
+            }
+        }
+    }
+
+    /* compressed outputs, the pipes keep what wasn't read yet */
+    cz_save(state);
+
+    printf("%s - Running %s\n", get_time(), self_path);
+    ho_exec(state, self_path, argv);
+
+    /* the binary may be gone, run this image again so the jobs are kept */
+    ho_exec(state, "/proc/self/exe", argv);
+    fclose(state);
+}
+
+/**
+ * restore the state saved by hot_restart, before the shards start
+ * @param state hot restart state
+ * @return
+ *  true: if the state was complete
+ *  false: if it doesn't match this overseer or is truncated
+ */
+bool restore_state(FILE *state) {
+    int jobs = 0, queued = 0;
+
+    if (ho_get_int(state) != num_shards) {
+        fprintf(stderr, "The previous image ran a different number of shards\n");
+        return false;
+    }
+    for (int i = 0; i < num_shards; i++) {
+        shards[i].server_fd = ho_get_fd(state);
+    }
+    local_fd = ho_get_fd(state);
+
+    reg_load(state);
+
+    /* job arrays keep their id */
+    int last_array = (int) ho_get_int(state);
+    for (int n = (int) ho_get_int(state); n > 0 && ho_ok(state); n--) {
+        int id = (int) ho_get_int(state);
+        bool cancelled = ho_get_int(state) != 0;
+        cmd_t *cmd_arg = ho_get_cmd(state);
+        flag_t *spec = get_flag(cmd_arg, array);
+        array_t *an_array = spec && spec->value ? add_array(cmd_arg, spec->value) : NULL;
+
+        if (an_array) {
+            an_array->id = id;
+            an_array->cancelled = cancelled;
+        } else {
+            free_cmd(cmd_arg);
+        }
+    }
+    num_array = last_array;
+
+    for (int n = (int) ho_get_int(state); n > 0 && ho_ok(state); n--) {
+        char *file = ho_get_str(state);
+        int jobs = (int) ho_get_int(state);
+        sketch_t sketch;
+        ho_get_sketch(state, &sketch);
+
+        exe_stats_t *an_exe = find_exe(file ? file : "", false);
+        if (an_exe) {
+            an_exe->jobs = jobs;
+            an_exe->sketch = sketch;
+        }
+        free(file);
+    }
+
+    for (int i = 0; i < num_shards && ho_ok(state); i++) {
+        shard_t *shard = shards + i;
+
+        for (int n = (int) ho_get_int(state); n > 0 && ho_ok(state); n--) {
+            series_t *a_series = hist_load(state);
+            if (!a_series) continue;
+
+            if (!shard->history) {
+                shard->history = a_series;
+            } else {
+                shard->last_history->next = a_series;
+            }
+            shard->last_history = a_series;
+            if (a_series->ended) {
+                shard->ended_histories++;
+                shard->ended_bytes += hist_bytes(a_series);
+            }
+        }
+
+        /* running jobs are adopted first, a worker each */
+        for (int n = (int) ho_get_int(state); n > 0 && ho_ok(state); n--, jobs++) {
+            request_t *a_request = add_request(shard, NULL, NULL, NULL, 0);
+            a_request->adopted = load_handoff(state); /* no worker runs yet */
+
+            array_t *an_array = a_request->adopted && a_request->adopted->array_id
+                                ? find_array(a_request->adopted->array_id) : NULL;
+            if (an_array) {
+                an_array->jobs++;
+            }
+        }
+
+        for (int n = (int) ho_get_int(state); n > 0 && ho_ok(state); n--, queued++) {
+            int array_id = (int) ho_get_int(state), index = (int) ho_get_int(state);
+
+            if (array_id) {
+                array_t *an_array = find_array(array_id);
+                if (an_array) {
+                    an_array->jobs++;
+                    add_request(shard, an_array->cmd_arg, NULL, an_array, index);
+                }
+            } else {
+                job_record_t *a_record = reg_get((int) ho_get_int(state));
+                add_request(shard, ho_get_cmd(state), a_record, NULL, 0);
+            }
+        }
+    }
+
+    /* arrays whose last job ended during the restart */
+    for (array_t **link = &arrays; *link;) {
+        array_t *an_array = *link;
+        if (an_array->jobs) {
+            link = &an_array->next;
+        } else {
+            *link = an_array->next;
+            free_array(an_array);
+        }
+    }
+
+    cz_load(state);
+
+    if (!ho_ok(state)) {
+        return false;
+    }
+    printf("%s - Took over %d running and %d queued jobs\n", get_time(), jobs, queued);
+    return true;
+}
+
+/**
+ * parse a job array spec and create the array from the given template.
+ * The spec is either a range "start-end[:step]" or a comma separated list
+ * of values, each job substitutes its value for "{}" in the template.
+ * @param cmd_arg template shared by every job of the array
+ * @param spec job array spec
+ * @return the created job array or NULL if the spec is invalid
+ */
+array_t *add_array(cmd_t *cmd_arg, char *spec) {
+    array_t *an_array = (array_t *) calloc(1, sizeof(array_t));
+    if (!an_array) {
+        fprintf(stderr, "add_array: out of memory\n");
+        return NULL;
+    }
+    an_array->cmd_arg = cmd_arg;
+
+    /* try a range first */
+    char *ptr;
+    long start = strtol(spec, &ptr, BASE10), end = start, step = 1;
+    bool is_range = ptr != spec && *ptr == '-';
+    if (is_range) {
+        char *end_ptr = ptr + 1;
+        end = strtol(end_ptr, &ptr, BASE10);
+        is_range = ptr != end_ptr;
+        if (is_range && *ptr == ':') {
+            step = strtol(ptr + 1, &ptr, BASE10);
+        }
+        is_range = is_range && *ptr == '\0';
+    }
+
+    if (is_range) {
+        if (step <= 0 || end < start || (end - start) / step >= MAX_ARRAY_JOBS) {
+            free(an_array);
+            return NULL;
+        }
+        an_array->start = start;
+        an_array->step = step;
+        an_array->size = (int) ((end - start) / step) + 1;
+    } else {
+        /* split the list in place, the values point into it */
+        int size = 1;
+        for (ptr = spec; *ptr; ptr++) {
+            if (*ptr == ',') size++;
+        }
+        if (!*spec || size > MAX_ARRAY_JOBS) {
+            free(an_array);
+            return NULL;
+        }
+
+        an_array->list = strdup(spec);
+        an_array->values = (char **) malloc(sizeof(char *) * size);
+        an_array->size = size;
+        ptr = an_array->list;
+        for (int i = 0; i < size; i++) {
+            an_array->values[i] = strsep(&ptr, ",");
+        }
+    }
+
+    an_array->pids = (pid_t *) calloc(an_array->size, sizeof(pid_t));
+
+    /* give it an id and add it to the list */
+    pthread_mutex_lock(&array_mutex);
+    an_array->id = ++num_array;
+    an_array->next = arrays;
+    arrays = an_array;
+    pthread_mutex_unlock(&array_mutex);
+
+    return an_array;
+}
+
+/**
+ * drop a job array none of whose jobs was queued, its id is given again
+ * unless a newer array took the next one. The template is freed too
+ * @param an_array job array created by add_array
+ */
+void remove_array(array_t *an_array) {
+    pthread_mutex_lock(&array_mutex);
+    for (array_t **link = &arrays; *link; link = &(*link)->next) {
+        if (*link == an_array) {
+            *link = an_array->next;
+            break;
+        }
+    }
+    if (an_array->id == num_array) {
+        num_array--;
+    }
+    pthread_mutex_unlock(&array_mutex);
+
+    free_array(an_array);
+}
+
+/**
+ * count a job of an array as ended, whether it ran or was dropped. The
+ * array is freed with its last job, once none is queued or running
+ * @param an_array job array of the job
+ */
+void end_array_job(array_t *an_array) {
+    pthread_mutex_lock(&array_mutex);
+    bool last = --an_array->jobs == 0;
+    if (last) {
+        array_t **link = &arrays;
+        while (*link != an_array) link = &(*link)->next;
+        *link = an_array->next;
+    }
+    pthread_mutex_unlock(&array_mutex);
+
+    if (last) {
+        free_array(an_array);
+    }
+}
+
+/**
+ * free a job array no longer listed, its template included
+ * @param an_array job array
+ */
+void free_array(array_t *an_array) {
+    free_cmd(an_array->cmd_arg);
+    free(an_array->list);
+    free(an_array->values);
+    free(an_array->pids);
+    free(an_array);
+}
+
+/**
+ * find a job array by its id, with array_mutex held
+ * @param id job array id
+ * @return the job array or NULL if not found
+ */
+static array_t *lookup_array(int id) {
+    array_t *an_array;
+
+    for (an_array = arrays; an_array && an_array->id != id; an_array = an_array->next);
+    return an_array;
+}
+
+/**
+ * find a job array by its id. The array is freed after its last job, so
+ * it may only be used by one of its jobs, otherwise under array_mutex
+ * @param id job array id
+ * @return the job array or NULL if not found
+ */
+array_t *find_array(int id) {
+    pthread_mutex_lock(&array_mutex);
+    array_t *an_array = lookup_array(id);
+    pthread_mutex_unlock(&array_mutex);
+
+    return an_array;
+}
+
+/**
+ * find the memory samples of the jobs of a file
+ * @param file file the jobs run
+ * @param count count a new job of the file
+ * @return the samples of the file, added if it is new, or NULL if out of memory
+ */
+exe_stats_t *find_exe(const char *file, bool count) {
+    exe_stats_t *an_exe;
+
+    pthread_mutex_lock(&exe_mutex);
+    for (an_exe = exe_stats; an_exe && strcmp(an_exe->file, file) != 0; an_exe = an_exe->next);
+    if (!an_exe && (an_exe = (exe_stats_t *) calloc(1, sizeof(exe_stats_t)))) {
+        an_exe->file = strdup(file);
+        an_exe->next = exe_stats;
+        exe_stats = an_exe;
+    }
+    if (an_exe && count) {
+        an_exe->jobs++;
+    }
+    pthread_mutex_unlock(&exe_mutex);
+
+    return an_exe;
+}
+
+/**
+ * parse a job array reference of the form @id
+ * @param ref the reference sent by the client
+ * @return the id of the job array or 0 if not found
+ */
+int parse_array_ref(char *ref) {
+    if (!ref || ref[0] != '@') {
+        return 0;
+    }
+
+    int id = (int) strtol(ref + 1, NULL, BASE10);
+    return id > 0 && find_array(id) ? id : 0;
+}
+
+/**
+ * substitute the array value for the placeholder in a template string
+ * @param template template string
+ * @param value value of the job
+ * @return the template itself if it has no placeholder, a new string otherwise
+ */
+char *array_substitute(char *template, char *value) {
+    char *pos = strstr(template, ARRAY_PLACEHOLDER);
+    if (!pos) {
+        return template;
+    }
+
+    size_t prefix = pos - template, value_len = strlen(value);
+    char *rest = pos + strlen(ARRAY_PLACEHOLDER);
+    char *str = (char *) malloc(prefix + value_len + strlen(rest) + 1);
+    memcpy(str, template, prefix);
+    memcpy(str + prefix, value, value_len);
+    strcpy(str + prefix + value_len, rest);
+
+    return str;
+}
+
+/**
+ * run one job of a job array: its argv is built from the shared template,
+ * only the arguments holding the placeholder are copied
+ * @param shard shard running the job
+ * @param an_array job array
+ * @param index index of the job in the array
+ */
+void process_array_job(shard_t *shard, array_t *an_array, int index) {
+    cmd_t *template = an_array->cmd_arg;
+
+    pthread_mutex_lock(&array_mutex);
+    bool cancelled = an_array->cancelled;
+    pthread_mutex_unlock(&array_mutex);
+    if (cancelled) {
+        return;
+    }
+
+    /* value of this job */
+    char range_value[MAX_BUFFER], *value = range_value;
+    if (an_array->values) {
+        value = an_array->values[index];
+    } else {
+        sprintf(range_value, "%ld", an_array->start + index * an_array->step);
+    }
+
+    char **argv = (char **) malloc(sizeof(char *) * (template->file_size + 1));
+    for (int i = 0; i < template->file_size; i++) {
+        argv[i] = array_substitute(template->file_arg[i], value);
+    }
+    argv[template->file_size] = NULL;
+
+    flag_t flags[MAX_FLAGS];
+    for (int i = 0; i < template->flag_size; i++) {
+        flags[i].type = template->flag_arg[i].type;
+        flags[i].value = template->flag_arg[i].value && template->flag_arg[i].type != array
+                         ? array_substitute(template->flag_arg[i].value, value)
+                         : template->flag_arg[i].value;
+    }
+
+    cmd_t cmd_arg = *template;
+    cmd_arg.flag_arg = flags;
+    cmd_arg.file_arg = argv;
+    process_cmd1(shard, &cmd_arg, NULL, an_array, index);
+
+    /* free what was substituted, the rest belongs to the template */
+    for (int i = 0; i < template->flag_size; i++) {
+        if (flags[i].value != template->flag_arg[i].value) {
+            free(flags[i].value);
+        }
+    }
+    for (int i = 0; i < template->file_size; i++) {
+        if (argv[i] != template->file_arg[i]) {
+            free(argv[i]);
+        }
+    }
+    free(argv);
+}
+
+/**
+ * process cmd1 with a job array flag: expand it into one queued request
+ * per job and send the job array id back to the client
+ * @param shard shard receiving the job array
+ * @param cmd_arg template of the jobs, owned by the job array afterwards
+ * @param client_fd client to send the job array id
+ */
+void process_array(shard_t *shard, cmd_t *cmd_arg, int client_fd) {
+    char buff[MAX_BUFFER];
+    array_t *an_array;
+
+    /* jobs are held one by one, each with its own record */
+    if (get_flag(cmd_arg, afterjob)) {
+        send_str(client_fd, "error: -after holds single jobs, not job arrays\n");
+        free_cmd(cmd_arg);
+        return;
+    }
+
+    /* the template outlives the controller, its jobs don't get a passed stdout */
+    for (int i = 0; i < 2; i++) {
+        if (cmd_arg->stdio_fds[i] != -1) {
+            close(cmd_arg->stdio_fds[i]);
+            cmd_arg->stdio_fds[i] = -1;
+        }
+    }
+
+    if (!(an_array = add_array(cmd_arg, get_flag(cmd_arg, array)->value))) {
+        send_str(client_fd, "error: invalid job array spec\n");
+        free_cmd(cmd_arg);
+        return;
+    }
+
+    /* the whole array is queued or none of it */
+    int retry = an_array->size > max_queue ? -1 : queue_retry_after(shard, an_array->size);
+    if (retry) {
+        if (retry == -1) {
+            sprintf(buff, "error: job array larger than the queue of %d jobs\n", max_queue);
+        } else {
+            sprintf(buff, OVERLOADED_REPLY, retry);
+        }
+        send_str(client_fd, buff);
+        remove_array(an_array);
+        return;
+    }
+
+    /* queue every job of the array, a worker may end the first before the last is queued */
+    int id = an_array->id, size = an_array->size;
+    an_array->jobs = size;
+    for (int i = 0; i < size; i++) {
+        add_request(shard, cmd_arg, NULL, an_array, i);
+    }
+
+    sprintf(buff, "%d\n", id);
+    if (!send_str(client_fd, buff)) {
+        fprintf(stderr, "error sending job array id\n");
+    }
+}
+
+/**
+ * process cmd1 of a single job: register it, queue it and send the job id
+ * back to the client. A job run with -after is held by the registry
+ * instead, until the jobs it runs after ended
+ * @param shard shard receiving the job
+ * @param cmd_arg command of the job, freed once the job ended
+ * @param client_fd client to send the job id
+ */
+void process_run(shard_t *shard, cmd_t *cmd_arg, int client_fd) {
+    char buff[MAX_BUFFER];
+    job_record_t *a_record;
+    flag_t *after = get_flag(cmd_arg, afterjob);
+    int retry, failed;
+
+    /* a full queue rejects the job before it gets an id */
+    if ((retry = queue_retry_after(shard, 1))) {
+        sprintf(buff, OVERLOADED_REPLY, retry);
+        send_str(client_fd, buff);
+        free_cmd(cmd_arg);
+        return;
+    }
+
+    if (!(a_record = reg_add())) {
+        send_str(client_fd, "error: could not register job\n");
+        free_cmd(cmd_arg);
+        return;
+    }
+
+    /* the record may be dropped once the job ended, print its id first */
+    sprintf(buff, "%d\n", a_record->id);
+    switch (after ? reg_hold(a_record, after->value ? after->value : "", cmd_arg, &failed) : hold_ready) {
+        case hold_ready:
+            add_request(shard, cmd_arg, a_record, NULL, 0);
+            break;
+        case hold_held:
+            break;
+        case hold_cancelled:
+            free_cmd(cmd_arg);
+            reg_finish(a_record, job_cancelled, failed, 0, NULL);
+            break;
+        case hold_invalid:
+            sprintf(buff, "error: -after names no earlier job or is not id[:ok|:any][,...]\n");
+            free_cmd(cmd_arg);
+            reg_finish(a_record, job_cancelled, 0, 0, NULL);
+            break;
+    }
+
+    if (!send_str(client_fd, buff)) {
+        fprintf(stderr, "error sending job id\n");
+    }
+}
+
+/**
+ * registry callback: every job a held job runs after ended. The job joins
+ * the queue of a shard picked by its id, past the bound of the queue as it
+ * was admitted when submitted; the command of a cancelled job is dropped
+ * @param a_record record of the held job
+ * @param cmd_arg command of the job
+ * @param run whether to run it, otherwise it is cancelled
+ */
+void release_job(job_record_t *a_record, cmd_t *cmd_arg, bool run) {
+    if (run) {
+        add_request(shards + (unsigned) a_record->id % num_shards, cmd_arg, a_record, NULL, 0);
+    } else {
+        free_cmd(cmd_arg);
+    }
+}
+
+/**
+ * process the cmd2 which is mem regulation:
+ *  send memory info of all running processes to given client if no pid is passed
+ *  send memory history of specific process id to given client if pid is passed
+ * @param cmd_arg command argument to be processed
+ * @param client_fd client to send info
+ */
+void process_cmd2(cmd_t *cmd_arg, int client_fd) {
+    // print_entry(entry);
+    int array_id = 0;
+    if (cmd_arg->flag_arg[0].value && cmd_arg->flag_arg[0].value[0] == '@') {
+        /* current processes of a job array */
+        if (!(array_id = parse_array_ref(cmd_arg->flag_arg[0].value))) {
+            send_str(client_fd, "error: no such job array\n");
+            return;
+        }
+    } else if (cmd_arg->flag_arg[0].value) {
+        char *end;
+        pid_t mem_pid = (pid_t) strtol(cmd_arg->flag_arg[0].value, &end, BASE10);
+        hist_range_t range;
+        if (mem_pid <= 0 || *end) {
+            send_str(client_fd, "error: invalid pid\n");
+            return;
+        }
+        if (!parse_range(cmd_arg, &range)) {
+            send_str(client_fd, "error: invalid time range\n");
+            return;
+        }
+        send_process_info(mem_pid, client_fd, cmd_arg->type == cmd7, &range);
+        return;
+    }
+
+    /* send the latest sample of every running process */
+    send_current_process(array_id, client_fd, cmd_arg->type == cmd7);
+}
+
+/**
+ * process cmd3 (mem kill):
+ *  kill process using more than given percentage of memory, or with
+ *  --free the fewest jobs to have the given memory available
+ * @param cmd_arg command argument to be processed
+ * @param client_fd client to send what --free freed
+ * @return
+ *  true: if the client is answered once the killed jobs exited
+ *  false: if it was answered or expects no answer
+ */
+bool process_cmd3(cmd_t *cmd_arg, int client_fd) {
+    flag_t *goal = get_flag(cmd_arg, memfree);
+
+    if (goal) {
+        return free_memory(goal->value, client_fd);
+    } else if (cmd_arg->flag_arg[0].value) {
+        double mem_percent = strtod(cmd_arg->flag_arg[0].value, NULL);
+        kill_overhead_process(mem_percent);
+    }
+    return false;
+}
+
+/**
+ * process cmd7 (cpu):
+ *  send the cpu usage of all running processes to given client if no pid is passed
+ *  send the cpu history of specific process id to given client if pid is passed
+ * @param cmd_arg command argument to be processed
+ * @param client_fd client to send info
+ */
+void process_cmd7(cmd_t *cmd_arg, int client_fd) {
+    /* answered like mem, from the cpu samples */
+    process_cmd2(cmd_arg, client_fd);
+}
+
+/**
+ * process cmd8 (cpu kill):
+ *  kill process using more than given percentage of the total cpu over the window
+ * @param cmd_arg command argument to be processed
+ */
+void process_cmd8(cmd_t *cmd_arg) {
+    if (cmd_arg->flag_arg[0].value) {
+        double cpu_percent = strtod(cmd_arg->flag_arg[0].value, NULL);
+        kill_cpu_process(cpu_percent);
+    }
+}
+
+/**
+ * order the jobs of a top list, largest key first
+ * @param a first job
+ * @param b second job
+ * @return the comparison of their keys
+ */
+static int compare_top(const void *a, const void *b) {
+    double x = ((const heap_entry_t *) a)->key, y = ((const heap_entry_t *) b)->key;
+    return x < y ? 1 : x > y ? -1 : 0;
+}
+
+/**
+ * append a line about a job to a reply: its head, the arguments of the job
+ * and a newline. The reply grows to fit arguments of any length
+ * @param buff reply, reallocated as needed
+ * @param max_buffer size of the reply
+ * @param len length of the reply, moved past the line
+ * @param head fields before the arguments
+ * @param a_job job
+ */
+static void append_job_line(char **buff, size_t *max_buffer, size_t *len, const char *head, job_t *a_job) {
+    size_t need = *len + strlen(head) + 2;
+
+    for (int i = 0; i < a_job->argc; i++) {
+        need += strlen(a_job->argv[i]) + 1;
+    }
+    if (need > *max_buffer) {
+        *max_buffer = need > 2 * *max_buffer ? need : 2 * *max_buffer;
+        *buff = (char *) realloc(*buff, *max_buffer);
+    }
+
+    *len += sprintf(*buff + *len, "%s", head);
+    for (int i = 0; i < a_job->argc; i++) {
+        *len += sprintf(*buff + *len, "%s ", a_job->argv[i]);
+    }
+    *len += sprintf(*buff + *len, "\n");
+}
+
+/**
+ * process cmd9 (top):
+ *  send the n running jobs with the most memory, cpu usage or memory growth:
+ *  pid, memory, share of the total cpu, growth in bytes per second and
+ *  arguments. Every shard keeps its jobs in a heap per key updated by the
+ *  sampler, so the n largest of each shard are read in O(n log n) and merged
+ * @param cmd_arg command argument to be processed
+ * @param client_fd client to send the list
+ */
+void process_cmd9(cmd_t *cmd_arg, int client_fd) {
+    static const char *keys[] = {"mem", "cpu", "growth"};
+    flag_t *key_flag = get_flag(cmd_arg, topkey);
+    char *end;
+    long n = strtol(cmd_arg->flag_arg[0].value ? cmd_arg->flag_arg[0].value : "", &end, BASE10);
+    int key = 0;
+
+    while (key_flag && key_flag->value && key < NUM_TOP_KEYS && strcmp(key_flag->value, keys[key])) key++;
+    if (n <= 0 || n > MAX_TOP || *end || key == NUM_TOP_KEYS) {
+        send_str(client_fd, "error: usage is top <1-1000> [--by mem|cpu|growth]\n");
+        return;
+    }
+
+    /* the n largest of every shard, then the n largest of those */
+    heap_entry_t *best = (heap_entry_t *) malloc(sizeof(heap_entry_t) * n * num_shards);
+    size_t max_buffer = MAX_BUFFER, len = 0;
+    char *buff = (char *) calloc(max_buffer, sizeof(char));
+    int count = 0;
+
+    for (int s = 0; s < num_shards; s++) {
+        pthread_mutex_lock(&shards[s].job_mutex);
+    }
+    for (int s = 0; s < num_shards; s++) {
+        count += heap_top(shards[s].top + key, (int) n, best + count);
+    }
+    qsort(best, count, sizeof(heap_entry_t), compare_top);
+
+    for (int i = 0; i < count && i < n; i++) {
+        job_t *a_job = best[i].item;
+        char head[MAX_BUFFER];
+
+        snprintf(head, sizeof(head), "%d %" PRIu64 " %.1f%% %+.0fB/s ", a_job->pid, a_job->mem, a_job->cpu,
+                 a_job->growth);
+        append_job_line(&buff, &max_buffer, &len, head, a_job);
+    }
+    for (int s = num_shards - 1; s >= 0; s--) {
+        pthread_mutex_unlock(&shards[s].job_mutex);
+    }
+
+    if (!send_str(client_fd, buff)) {
+        fprintf(stderr, "error sending top jobs\n");
+    }
+    free(best);
+    free(buff);
+}
+
+/**
+ * process cmd10 (stats):
+ *  send the median, 95th and 99th percentiles, peak and number of the memory
+ *  samples of a job, running or among the finished ones the registry keeps,
+ *  or those of every job of a file, of every file if none is given. A front
+ *  asks its backends for the sketches themselves to merge them
+ * @param cmd_arg command argument to be processed
+ * @param client_fd client to send the quantiles
+ */
+void process_cmd10(cmd_t *cmd_arg, int client_fd) {
+    char *value = cmd_arg->flag_arg[0].value;
+    bool raw = get_flag(cmd_arg, sketches) != NULL;
+
+    if (value && value[0] >= '0' && value[0] <= '9') {
+        int id = (int) strtol(value, NULL, BASE10);
+        char summary[MAX_BUFFER];
+        sketch_t sketch;
+        bool found = false;
+
+        /* a running job, otherwise a finished one */
+        for (int s = 0; s < num_shards && !found; s++) {
+            pthread_mutex_lock(&shards[s].job_mutex);
+            for (job_t *a_job = shards[s].jobs; a_job; a_job = a_job->next) {
+                if (a_job->id == id && a_job->sketch.count) {
+                    sketch = a_job->sketch;
+                    found = true;
+                    break;
+                }
+            }
+            pthread_mutex_unlock(&shards[s].job_mutex);
+        }
+        if (!found && !reg_sketch(id, &sketch)) {
+            send_str(client_fd, "error: no memory samples of this job\n");
+            return;
+        }
+
+        sprintf(summary + sk_summary(&sketch, summary), "\n");
+        send_str(client_fd, summary);
+        return;
+    }
+
+    size_t max_buffer = MAX_BUFFER, len = 0;
+    char *buff = (char *) calloc(max_buffer, sizeof(char));
+
+    pthread_mutex_lock(&exe_mutex);
+    for (exe_stats_t *an_exe = exe_stats; an_exe; an_exe = an_exe->next) {
+        if ((value && strcmp(an_exe->file, value) != 0) || !an_exe->sketch.count) continue;
+
+        /* make room for the file */
+        size_t needed = SK_ENCODED + strlen(an_exe->file) + 32;
+        if (len + needed > max_buffer) {
+            max_buffer = max_buffer * 2 + needed;
+            buff = (char *) realloc(buff, max_buffer);
+        }
+
+        len += raw ? sk_encode(&an_exe->sketch, buff + len) : sk_summary(&an_exe->sketch, buff + len);
+        len += sprintf(buff + len, " %d %s\n", an_exe->jobs, an_exe->file);
+    }
+    pthread_mutex_unlock(&exe_mutex);
+
+    if (value && !len) {
+        send_str(client_fd, "error: no memory samples of this file\n");
+    } else if (!send_str(client_fd, buff)) {
+        fprintf(stderr, "error sending stats\n");
+    }
+    free(buff);
+}
+
+/**
+ * process cmd4 (kill):
+ *  kill every job of the given job array, queued jobs are dropped and
+ *  running ones receive SIGKILL
+ * @param cmd_arg command argument to be processed
+ * @param client_fd client to send the result
+ */
+void process_cmd4(cmd_t *cmd_arg, int client_fd) {
+    char buff[MAX_BUFFER];
+    int id = parse_array_ref(cmd_arg->flag_arg[0].value), killed = 0;
+
+    /* the array may have ended since it was found */
+    pthread_mutex_lock(&array_mutex);
+    array_t *an_array = lookup_array(id);
+    if (!an_array) {
+        pthread_mutex_unlock(&array_mutex);
+        send_str(client_fd, "error: no such job array\n");
+        return;
+    }
+    an_array->cancelled = true;
+    for (int i = 0; i < an_array->size; i++) {
+        /* each job leads its own process group, kill what it forked as well */
+        if (an_array->pids[i] && kill(-an_array->pids[i], SIGKILL) == 0) {
+            killed++;
+        }
+    }
+    pthread_mutex_unlock(&array_mutex);
+
+    sprintf(buff, "killed %d running jobs of array %d\n", killed, id);
+    if (!send_str(client_fd, buff)) {
+        fprintf(stderr, "error sending kill result\n");
+    }
+}
+
+/**
+ * process cmd5 (load):
+ *  send the available memory in bytes and the number of running jobs,
+ *  a front uses it to pick the backend to route a job to
+ * @param client_fd client to send the result
+ */
+void process_cmd5(int client_fd) {
+    char buff[MAX_BUFFER];
+
+    sprintf(buff, "%lu %d\n", mem_free(), running_jobs());
+    if (!send_str(client_fd, buff)) {
+        fprintf(stderr, "error sending load\n");
+    }
+}
+
+/**
+ * process cmd6 (wait):
+ *  block the client until the given job ends and send it the exit status,
+ *  runtime and peak memory of the job
+ * @param cmd_arg command argument to be processed
+ * @param client_fd client to send the status
+ * @return
+ *  true: if the client is parked until the job ends
+ *  false: if the client was answered and can be closed
+ */
+bool process_cmd6(cmd_t *cmd_arg, int client_fd) {
+    char *value = cmd_arg->flag_size ? cmd_arg->flag_arg[0].value : NULL, *end;
+    long id = value ? strtol(value, &end, BASE10) : 0;
+
+    if (id <= 0 || *end) {
+        send_str(client_fd, "error: invalid job id\n");
+        return false;
+    }
+
+    return reg_wait((int) id, client_fd);
+}
+
+/**
+ * count the running jobs of every shard
+ * @return number of running jobs
+ */
+int running_jobs(void) {
+    int count = 0;
+
+    for (int i = 0; i < num_shards; i++) {
+        pthread_mutex_lock(&shards[i].job_mutex);
+        for (job_t *a_job = shards[i].jobs; a_job; a_job = a_job->next) {
+            count++;
+        }
+        pthread_mutex_unlock(&shards[i].job_mutex);
+    }
+
+    return count;
+}
+
+/**
+ * get the memory which can still be allocated without swapping, read from
+ * MemAvailable in /proc/meminfo
+ * @return available memory in bytes, 0 if unknown
+ */
+unsigned long mem_free(void) {
+    char buf[MAX_BUFFER];
+    unsigned long kb = 0;
+    FILE *f;
+
+    if (!(f = fopen("/proc/meminfo", "r"))) {
+        return 0;
+    }
+
+    while (fgets(buf, MAX_BUFFER, f)) {
+        if (sscanf(buf, "MemAvailable: %lu kB", &kb) == 1) {
+            break;
+        }
+    }
+    fclose(f);
+
+    return kb * 1024;
+}
+
+/**
+ * get total usable memory
+ * @return total usable memory
+ */
+unsigned long mem_avail() {
+    struct sysinfo info;
+
+    if (sysinfo(&info) < 0)
+        return 0;
+
+    return info.totalram;
+}
+
+/**
+ * sample the memory of every running job of a shard: the job itself and
+ * every process it forked, found through the /proc index refreshed by the
+ * sampler. The processes of all jobs are read as one batch, through
+ * io_uring a tick costs one submission per READER_CHUNK processes. pss splits shared pages
+ * between the processes, the other metrics count a page shared inside the
+ * tree once per process. The cpu time of the same processes is read in the
+ * same sweep, the job's share of the total cpu is then measured over the
+ * last CPU_WINDOW seconds. Caller holds the job mutex.
+ * @param shard shard whose jobs are sampled
+ * @param reader metric reader of the shard's sampler
+ * @param cpu_reader cpu time reader of the shard's sampler
+ * @param batch buffers reused from one tick to the next
+ */
+void sample_jobs(shard_t *shard, metric_reader_t *reader, metric_reader_t *cpu_reader, sample_batch_t *batch) {
+    pid_t tree[MAX_TREE_PIDS];
+    struct timespec now;
+    static int num_cpus = 0;
+
+    if (!num_cpus) {
+        num_cpus = get_nprocs();
+    }
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    int64_t now_ms = (int64_t) now.tv_sec * 1000 + now.tv_nsec / 1000000;
+
+    /* collect the process tree of every job */
+    batch->size = batch->num_jobs = 0;
+    for (job_t *a_job = shard->jobs; a_job; a_job = a_job->next) {
+        int count = pi_descendants(a_job->pid, tree, MAX_TREE_PIDS);
+
+        if (batch->size + count > batch->capacity) {
+            batch->capacity = (batch->size + count) * 2;
+            batch->pids = (pid_t *) realloc(batch->pids, batch->capacity * sizeof(pid_t));
+            batch->values = (uint64_t *) realloc(batch->values, batch->capacity * sizeof(uint64_t));
+            batch->cpu_values = (uint64_t *) realloc(batch->cpu_values, batch->capacity * sizeof(uint64_t));
+        }
+        if (batch->num_jobs == batch->jobs_capacity) {
+            batch->jobs_capacity = batch->jobs_capacity ? batch->jobs_capacity * 2 : 64;
+            batch->counts = (int *) realloc(batch->counts, batch->jobs_capacity * sizeof(int));
+        }
+
+        memcpy(batch->pids + batch->size, tree, count * sizeof(pid_t));
+        batch->size += count;
+        batch->counts[batch->num_jobs++] = count;
+    }
+
+    /* an empty batch still closes the files of processes gone since */
+    metric_reader_sample(reader, batch->pids, batch->values, batch->size);
+    metric_reader_sample(cpu_reader, batch->pids, batch->cpu_values, batch->size);
+
+    /* sum the tree of every job, in the same order */
+    int first = 0, j = 0;
+    for (job_t *a_job = shard->jobs; a_job; a_job = a_job->next, j++) {
+        uint64_t cpu_tree = 0;
+        a_job->mem = 0;
+        for (int i = first; i < first + batch->counts[j]; i++) {
+            a_job->mem += batch->values[i];
+            cpu_tree += batch->cpu_values[i];
+        }
+        first += batch->counts[j];
+
+        /* a process which exits unreaped by the tree takes its time with it, only count growth */
+        if (cpu_tree > a_job->cpu_tree) {
+            a_job->cpu_time += cpu_tree - a_job->cpu_tree;
+        }
+        a_job->cpu_tree = cpu_tree;
+
+        /* share of the total cpu and memory growth since the oldest sample of the window */
+        int oldest = (a_job->window_next + CPU_WINDOW + 1 - a_job->window_size) % (CPU_WINDOW + 1);
+        if (a_job->window_size && now_ms > a_job->window_ms[oldest]) {
+            a_job->cpu = (double) (a_job->cpu_time - a_job->window_cpu[oldest]) / 10.0 /
+                         (double) ((now_ms - a_job->window_ms[oldest]) * num_cpus);
+            a_job->growth = ((double) a_job->mem - (double) a_job->window_mem[oldest]) * 1000.0 /
+                            (double) (now_ms - a_job->window_ms[oldest]);
+        }
+        a_job->window_cpu[a_job->window_next] = a_job->cpu_time;
+        a_job->window_mem[a_job->window_next] = a_job->mem;
+        a_job->window_ms[a_job->window_next] = now_ms;
+        a_job->window_next = (a_job->window_next + 1) % (CPU_WINDOW + 1);
+        if (a_job->window_size < CPU_WINDOW + 1) {
+            a_job->window_size++;
+        }
+
+        if (a_job->mem > 0) {
+            if (a_job->mem > a_job->peak_mem) {
+                a_job->peak_mem = a_job->mem;
+            }
+            sk_add(&a_job->sketch, a_job->mem);
+            if (a_job->exe) {
+                pthread_mutex_lock(&exe_mutex);
+                sk_add(&a_job->exe->sketch, a_job->mem);
+                pthread_mutex_unlock(&exe_mutex);
+            }
+            jt_update(a_job->slot, a_job->mem, a_job->peak_mem);
+            if (!add_sample(shard, a_job)) {
+                fprintf(stderr, "error adding sample\n");
+            }
+
+            /* rank the job by its new values, O(log jobs) each */
+            double keys[NUM_TOP_KEYS] = {(double) a_job->mem, a_job->cpu, a_job->growth};
+            for (int key = 0; key < NUM_TOP_KEYS; key++) {
+                if (a_job->top_pos[key] != -1) {
+                    heap_update(shard->top + key, a_job->top_pos[key], keys[key]);
+                } else {
+                    heap_insert(shard->top + key, a_job, keys[key], a_job->top_pos + key);
+                }
+            }
+        }
+    }
+}
+
+/**
+ * append the latest sample of a job to its memory and cpu histories, they are
+ * created with the first sample so jobs never sampled leave nothing behind
+ * @param shard shard owning the histories
+ * @param a_job job with its latest memory sample
+ * @return
+ *  true: if the sample was stored
+ *  false: if out of memory
+ */
+bool add_sample(shard_t *shard, job_t *a_job) {
+    bool added;
+
+    pthread_mutex_lock(&shard->history_mutex); /* get exclusive access to the list */
+
+    for (int i = 0; i < 2; i++) {
+        series_t **a_series = i ? &a_job->cpu_series : &a_job->series;
+        if (*a_series) {
+            continue;
+        }
+        if (!(*a_series = hist_new(a_job->pid, i))) {
+            pthread_mutex_unlock(&shard->history_mutex);
+            return false;
+        }
+
+        /* add the history to the end of the list */
+        if (!shard->history) {
+            shard->history = *a_series;
+        } else {
+            shard->last_history->next = *a_series;
+        }
+        shard->last_history = *a_series;
+    }
+    time_t now = time(NULL);
+    added = hist_append(a_job->series, now, a_job->mem) && hist_append(a_job->cpu_series, now, a_job->cpu_time);
+
+    pthread_mutex_unlock(&shard->history_mutex);
+
+    return added;
+}
+
+/**
+ * mark the memory and cpu histories of a job which ended. mem pid and cpu
+ * pid still answer from them until the shard holds more than
+ * MAX_ENDED_HISTORIES finished jobs or MAX_ENDED_BYTES of their histories,
+ * the job's quantile sketch stays in the registry and its file's stats
+ * @param shard shard owning the histories
+ * @param a_job job which left the shard, the sampler no longer appends to it
+ */
+void end_history(shard_t *shard, job_t *a_job) {
+    pthread_mutex_lock(&shard->history_mutex);
+    for (int i = 0; i < 2; i++) {
+        series_t *a_series = i ? a_job->cpu_series : a_job->series;
+        if (a_series) {
+            a_series->ended = true;
+            shard->ended_histories++;
+            shard->ended_bytes += hist_bytes(a_series);
+        }
+    }
+    a_job->series = a_job->cpu_series = NULL;
+    evict_histories(shard);
+    pthread_mutex_unlock(&shard->history_mutex);
+}
+
+/**
+ * free the histories of finished jobs, oldest first, until the shard is
+ * within MAX_ENDED_HISTORIES jobs and MAX_ENDED_BYTES. Caller holds the
+ * history mutex of the shard
+ * @param shard shard owning the histories
+ */
+void evict_histories(shard_t *shard) {
+    series_t **link = &shard->history, *prev = NULL;
+
+    while (*link && (shard->ended_histories > 2 * MAX_ENDED_HISTORIES || shard->ended_bytes > MAX_ENDED_BYTES)) {
+        series_t *a_series = *link;
+        if (!a_series->ended) {
+            prev = a_series;
+            link = &a_series->next;
+            continue;
+        }
+
+        *link = a_series->next;
+        if (shard->last_history == a_series) {
+            shard->last_history = prev;
+        }
+        shard->ended_histories--;
+        shard->ended_bytes -= hist_bytes(a_series);
+        hist_free(a_series);
+    }
+}
+
+/**
+ * send info of current running process to client, including:
+ * pid, mem usage of the latest sample and arguments, or pid, share of the
+ * total cpu over the window, cpu time and arguments.
+ * The running jobs of every shard are merged into one response, the
+ * arguments are only read while the job is running.
+ * @param array_id only send processes of this job array, 0 for all
+ * @param client_fd the client socket
+ * @param cpu_usage send the cpu usage instead of the memory
+ */
+void send_current_process(int array_id, int client_fd, bool cpu_usage) {
+    size_t max_buffer = MAX_BUFFER, len = 0;
+    char *buff = (char *) calloc(max_buffer, sizeof(char));
+
+    for (int s = 0; s < num_shards; s++) {
+        shard_t *shard = shards + s;
+        pthread_mutex_lock(&shard->job_mutex);
+
+        for (job_t *a_job = shard->jobs; a_job != NULL; a_job = a_job->next) {
+            /* skip jobs which were not sampled yet */
+            if (!a_job->mem) continue;
+
+            /* skip processes which are not part of the array */
+            if (array_id && a_job->array_id != array_id) continue;
+
+            char head[MAX_BUFFER];
+            if (cpu_usage) {
+                snprintf(head, sizeof(head), "%d %.1f%% %.2fs ", a_job->pid, a_job->cpu, a_job->cpu_time / 1e6);
+            } else {
+                snprintf(head, sizeof(head), "%d %" PRIu64 " ", a_job->pid, a_job->mem);
+            }
+            append_job_line(&buff, &max_buffer, &len, head, a_job);
+        }
+        pthread_mutex_unlock(&shard->job_mutex);
+    }
+
+    if (!send_str(client_fd, buff)) {
+        fprintf(stderr, "error sending current process entries\n");
+    }
+    free(buff);
+}
+
+/**
+ * parse a time of a range: seconds since the epoch, now, a duration before
+ * now such as -90s, -5m, -2h or -1d, or a local date YYYY-MM-DD with an
+ * optional time THH:MM:SS (or with a space instead of the T)
+ * @param value time to parse
+ * @param now current time
+ * @param ts receives the time in seconds since the epoch
+ * @return
+ *  true: if the time is valid
+ *  false: otherwise
+ */
+static bool parse_time(const char *value, time_t now, int64_t *ts) {
+    char *end;
+
+    if (strcmp(value, "now") == 0) {
+        *ts = now;
+        return true;
+    }
+
+    if (value[0] == '-') {
+        int64_t seconds = strtoll(value + 1, &end, 10);
+        if (end == value + 1 || seconds < 0) {
+            return false;
+        }
+        switch (*end) {
+            case 'd': seconds *= 24;
+            case 'h': seconds *= 60;
+            case 'm': seconds *= 60;
+            case 's': end++;
+            case '\0': break;
+            default: return false;
+        }
+        *ts = now - seconds;
+        return *end == '\0';
+    }
+
+    if (value[0] >= '0' && value[0] <= '9') {
+        *ts = strtoll(value, &end, 10);
+        if (*end == '\0') {
+            return true;
+        }
+    }
+
+    struct tm tm_info = {0};
+    if (!(end = strptime(value, "%Y-%m-%dT%H:%M:%S", &tm_info)) &&
+        !(end = strptime(value, "%Y-%m-%d %H:%M:%S", &tm_info)) &&
+        !(end = strptime(value, "%Y-%m-%d", &tm_info))) {
+        return false;
+    }
+    tm_info.tm_isdst = -1;
+    *ts = mktime(&tm_info);
+    return *end == '\0';
+}
+
+/**
+ * parse the --since, --until and --step flags of mem pid and cpu pid. The
+ * range is the whole history unless given, the step a duration such as 60,
+ * 30s, 5m or 1h
+ * @param cmd_arg command argument
+ * @param range receives the range
+ * @return
+ *  true: if the flags are valid
+ *  false: otherwise
+ */
+bool parse_range(cmd_t *cmd_arg, hist_range_t *range) {
+    time_t now = time(NULL);
+    flag_t *flag;
+    char *end;
+
+    range->since = INT64_MIN;
+    range->until = INT64_MAX;
+    range->step = 0;
+
+    if ((flag = get_flag(cmd_arg, since)) && !parse_time(flag->value, now, &range->since)) {
+        return false;
+    }
+    if ((flag = get_flag(cmd_arg, until)) && !parse_time(flag->value, now, &range->until)) {
+        return false;
+    }
+    if ((flag = get_flag(cmd_arg, step))) {
+        range->step = strtoll(flag->value, &end, 10);
+        switch (*end) {
+            case 'd': range->step *= 24;
+            case 'h': range->step *= 60;
+            case 'm': range->step *= 60;
+            case 's': end++;
+            case '\0': break;
+            default: return false;
+        }
+        if (*end || range->step <= 0) {
+            return false;
+        }
+    }
+
+    return range->since <= range->until;
+}
+
+/**
+ * append the sample merged from a step of a history to the response
+ * @param buff response, grown as needed
+ * @param max_buffer size of the response
+ * @param len length of the response
+ * @param bucket step to append
+ * @param pid pid of the history
+ * @param cpu_usage the history holds cpu time
+ */
+static void append_bucket(char **buff, size_t *max_buffer, size_t *len, const hist_bucket_t *bucket, pid_t pid,
+                          bool cpu_usage) {
+    char sample_time[TIME_BUFFER];
+    struct tm tm_info;
+    time_t start = (time_t) bucket->start;
+
+    /* cpu time is turned into usage since the sample before the step */
+    if (cpu_usage && (bucket->base_ts == -1 || bucket->ts <= bucket->base_ts)) {
+        return;
+    }
+
+    if (*len + TIME_BUFFER + 64 > *max_buffer) {
+        *max_buffer *= 2;
+        *buff = (char *) realloc(*buff, *max_buffer);
+    }
+
+    localtime_r(&start, &tm_info);
+    strftime(sample_time, TIME_BUFFER, "%Y-%m-%d %H:%M:%S", &tm_info);
+    if (cpu_usage) {
+        uint64_t used = bucket->val > bucket->base_val ? bucket->val - bucket->base_val : 0;
+        *len += sprintf(*buff + *len, "%s- PID:%d - Cpu:%.1f%%\n", sample_time, pid,
+                        (double) used / 1e4 / (double) ((bucket->ts - bucket->base_ts) * get_nprocs()));
+    } else {
+        *len += sprintf(*buff + *len, "%s- PID:%d - Mem:%" PRIu64 "\n", sample_time, pid, bucket->val);
+    }
+}
+
+/**
+ * send the memory usage history of given pid within a time range, whichever
+ * shard runs it. The histories are decoded sequentially, a job which reused
+ * the pid of an earlier one follows it. Each history is entered by binary
+ * search on the time of its blocks so only the samples of the range are
+ * decoded. With a step the samples of every step (aligned on the epoch) are
+ * merged into one, stamped with the start of the step: the largest memory,
+ * or the cpu used over the step. The cpu history holds the cpu time used so
+ * far, every sample after the first is sent as the share of the total cpu
+ * used since the previous one.
+ * @param pid given pid to query
+ * @param client_fd socket of client
+ * @param cpu_usage send the cpu history instead of the memory
+ * @param range samples to send and how to merge them
+ */
+void send_process_info(pid_t pid, int client_fd, bool cpu_usage, const hist_range_t *range) {
+    size_t max_buffer = MAX_BUFFER, len = 0;
+    char *buff = (char *) calloc(max_buffer, sizeof(char));
+
+    for (int s = 0; s < num_shards; s++) {
+        shard_t *shard = shards + s;
+        pthread_mutex_lock(&shard->history_mutex);
+
+        for (series_t *a_series = shard->history; a_series != NULL; a_series = a_series->next) {
+            if (a_series->pid != pid || a_series->cpu != cpu_usage) continue;
+
+            hist_iter_t iter;
+            hist_bucket_t bucket = {.start = -1, .base_ts = -1};
+            int64_t ts, prev_ts = -1;
+            uint64_t val, prev_val = 0;
+            hist_iter_seek(&iter, a_series, range->since);
+            while (hist_next(&iter, &ts, &val) && ts <= range->until) {
+                if (ts >= range->since) {
+                    int64_t start = range->step ? ts - ((ts % range->step) + range->step) % range->step : ts;
+                    if (start != bucket.start) {
+                        if (bucket.start != -1) {
+                            append_bucket(&buff, &max_buffer, &len, &bucket, pid, cpu_usage);
+                        }
+                        bucket.start = start;
+                        bucket.val = 0;
+                        bucket.base_ts = prev_ts;
+                        bucket.base_val = prev_val;
+                    }
+                    bucket.ts = ts;
+                    bucket.val = cpu_usage || val > bucket.val ? val : bucket.val;
+                }
+                prev_ts = ts;
+                prev_val = val;
+            }
+            if (bucket.start != -1) {
+                append_bucket(&buff, &max_buffer, &len, &bucket, pid, cpu_usage);
+            }
+        }
+        pthread_mutex_unlock(&shard->history_mutex);
+    }
+
+    if (!send_str(client_fd, buff)) {
+        fprintf(stderr, "error sending %d's info\n", pid);
+    }
+
+    free(buff);
+}
+
+/**
+ * kill running jobs of every shard using over a given percentage of total
+ * usable memory, based on their latest sample of the whole process tree
+ * @param mem_percent memory threshold
+ */
+void kill_overhead_process(double mem_percent) {
+    double total = (double) mem_avail();
+
+    for (int s = 0; s < num_shards; s++) {
+        shard_t *shard = shards + s;
+        pthread_mutex_lock(&shard->job_mutex);
+        for (job_t *a_job = shard->jobs; a_job != NULL; a_job = a_job->next) {
+            double process_percent = (double) a_job->mem / total * 100.0;
+            if (process_percent > mem_percent) {
+                /* the job leads its own process group, kill what it forked as well */
+                kill(-a_job->pid, SIGKILL);
+            }
+        }
+        pthread_mutex_unlock(&shard->job_mutex);
+    }
+}
+
+/**
+ * order the jobs memkill --free may kill: the lowest priority (highest nice
+ * level) first, then the largest, then the youngest
+ * @param a first job
+ * @param b second job
+ * @return the comparison of the jobs
+ */
+static int compare_victims(const void *a, const void *b) {
+    const victim_t *va = a, *vb = b;
+
+    if (va->nice != vb->nice) {
+        return vb->nice - va->nice;
+    }
+    if (va->mem != vb->mem) {
+        return va->mem < vb->mem ? 1 : -1;
+    }
+    return (vb->started > va->started) - (vb->started < va->started);
+}
+
+/**
+ * parse the memory goal of memkill --free: bytes with an optional K, M or
+ * G suffix, or a percentage of the total memory
+ * @param goal goal sent by the client
+ * @param bytes receives the goal in bytes
+ * @return
+ *  true: if the goal is valid
+ *  false: otherwise
+ */
+static bool parse_goal(const char *goal, uint64_t *bytes) {
+    char *end;
+    double value = goal ? strtod(goal, &end) : -1;
+
+    if (!goal || end == goal || value < 0) {
+        return false;
+    }
+    if (*end == '%') {
+        value = value / 100.0 * (double) mem_avail();
+        end++;
+    } else if (*end == 'K' || *end == 'k' || *end == 'M' || *end == 'm' || *end == 'G' || *end == 'g') {
+        value *= *end == 'K' || *end == 'k' ? 1024.0 : *end == 'M' || *end == 'm' ? 1048576.0 : 1073741824.0;
+        end++;
+    }
+
+    *bytes = (uint64_t) value;
+    return *end == '\0';
+}
+
+/**
+ * send the report of memkill --free to its client and close the connection,
+ * the memory freed being what the kernel got back since the jobs were killed
+ * @param a_memkill memkill --free
+ * @param running killed jobs still exiting
+ */
+static void answer_memkill(memkill_t *a_memkill, int running) {
+    char buff[MAX_BUFFER];
+    uint64_t after = mem_free();
+    int len = sprintf(buff, "killed %d jobs, expected %" PRIu64 " bytes, freed %" PRId64 " bytes, %" PRIu64
+                            " bytes available", a_memkill->killed, a_memkill->expected,
+                      (int64_t) (after - a_memkill->before), after);
+
+    if (running) {
+        len += sprintf(buff + len, ", %d still exiting", running);
+    }
+    strcpy(buff + len, "\n");
+    if (!send_str(a_memkill->client_fd, buff)) {
+        fprintf(stderr, "error sending memkill result\n");
+    }
+    close(a_memkill->client_fd);
+}
+
+/**
+ * timer callback: the jobs killed by memkill --free did not all exit within
+ * MEMKILL_TIMEOUT_MS, report with those still exiting
+ * @param data the memkill --free
+ */
+static void memkill_timeout(void *data) {
+    memkill_t *a_memkill = data;
+
+    pthread_mutex_lock(&memkill_mutex);
+    bool answer = !a_memkill->answered;
+    int running = a_memkill->running;
+    a_memkill->answered = true;
+    pthread_mutex_unlock(&memkill_mutex);
+
+    /* the last reaper frees it only once this callback returned */
+    if (answer) {
+        answer_memkill(a_memkill, running);
+    }
+}
+
+/**
+ * count a job killed by memkill --free as reaped, called by the worker
+ * supervising it once the job exited and left its shard. The last one
+ * answers the client unless the timeout did, then frees the memkill
+ * @param a_memkill memkill --free which killed the job
+ */
+void memkill_reaped(memkill_t *a_memkill) {
+    pthread_mutex_lock(&memkill_mutex);
+    bool last = --a_memkill->running == 0;
+    bool answer = last && !a_memkill->answered;
+    a_memkill->answered |= answer;
+    pthread_mutex_unlock(&memkill_mutex);
+
+    if (answer) {
+        answer_memkill(a_memkill, 0);
+    }
+    if (last) {
+        /* waits for a timeout callback answering meanwhile */
+        tw_cancel(&wheel, &a_memkill->timer);
+        free(a_memkill);
+    }
+}
+
+/**
+ * kill the fewest running jobs needed to have goal bytes of memory
+ * available. The jobs are taken by priority class, lowest first; within a
+ * class the largest go until one job is enough, then the smallest job
+ * enough is taken instead, so no more jobs die than needed and as little
+ * memory as possible is freed beyond the goal. Nothing is killed if every
+ * job together can't reach it. The client is parked like a waiter: the
+ * workers reaping the killed jobs send it the memory actually freed once
+ * the last one exited, or after MEMKILL_TIMEOUT_MS with those still exiting
+ * @param goal bytes with an optional K, M or G suffix, or percentage of the total memory
+ * @param client_fd client to send the report
+ * @return
+ *  true: if the client is answered once the killed jobs exited
+ *  false: if it was answered
+ */
+bool free_memory(const char *goal, int client_fd) {
+    char buff[MAX_BUFFER];
+    uint64_t target, expected = 0, total = 0;
+    victim_t *victims = NULL;
+    int num_victims = 0, capacity = 0, num_killed = 0;
+    memkill_t *a_memkill;
+
+    if (!parse_goal(goal, &target)) {
+        send_str(client_fd, "error: invalid memory goal\n");
+        return false;
+    }
+    if (!(a_memkill = (memkill_t *) calloc(1, sizeof(memkill_t)))) {
+        send_str(client_fd, "error: out of memory\n");
+        return false;
+    }
+
+    /* every shard is held while the victims are picked and killed so none of them is reaped meanwhile */
+    for (int s = 0; s < num_shards; s++) {
+        pthread_mutex_lock(&shards[s].job_mutex);
+    }
+
+    uint64_t before = mem_free();
+    uint64_t needed = target > before ? target - before : 0;
+    for (int s = 0; s < num_shards && needed; s++) {
+        for (job_t *a_job = shards[s].jobs; a_job; a_job = a_job->next) {
+            if (!a_job->mem) {
+                continue; /* not sampled yet, killing it frees nothing known */
+            }
+            if (num_victims == capacity) {
+                capacity = capacity ? capacity * 2 : 64;
+                victims = (victim_t *) realloc(victims, sizeof(victim_t) * capacity);
+            }
+            errno = 0;
+            int nice = getpriority(PRIO_PROCESS, a_job->pid);
+            victims[num_victims++] = (victim_t) {.job = a_job, .shard = s, .pid = a_job->pid, .mem = a_job->mem,
+                                                 .nice = errno ? 0 : nice, .started = a_job->started};
+            total += a_job->mem;
+        }
+    }
+
+    if (total < needed) {
+        for (int s = 0; s < num_shards; s++) {
+            pthread_mutex_unlock(&shards[s].job_mutex);
+        }
+        sprintf(buff, "error: every job together uses %" PRIu64 " bytes, %" PRIu64 " are needed\n", total, needed);
+        send_str(client_fd, buff);
+        free(victims);
+        free(a_memkill);
+        return false;
+    }
+
+    /* pick the victims, moving them to the front of the array */
+    qsort(victims, num_victims, sizeof(victim_t), compare_victims);
+    for (int i = 0; i < num_victims && expected < needed;) {
+        int class_end = i;
+        while (class_end < num_victims && victims[class_end].nice == victims[i].nice) class_end++;
+
+        while (i < class_end && expected < needed) {
+            int pick = i;
+            /* the smallest job of the class freeing the rest alone, the largest otherwise */
+            while (pick + 1 < class_end && victims[pick + 1].mem >= needed - expected) pick++;
+
+            victim_t chosen = victims[pick];
+            memmove(victims + i + 1, victims + i, sizeof(victim_t) * (pick - i));
+            victims[num_killed++] = chosen;
+            expected += chosen.mem;
+            i++;
+        }
+        i = class_end;
+    }
+
+    *a_memkill = (memkill_t) {.client_fd = client_fd, .killed = num_killed, .running = num_killed,
+                              .expected = expected, .before = before};
+    for (int i = 0; i < num_killed; i++) {
+        job_log(victims[i].job, "sent SIGKILL to %d to free memory, using %" PRIu64 " bytes", victims[i].pid,
+                victims[i].mem);
+        kill(-victims[i].pid, SIGKILL);
+        victims[i].job->memkill = a_memkill;
+    }
+
+    /* no job can be reaped before the shards are released, the client is answered by the last one */
+    if (num_killed) {
+        tw_add(&wheel, &a_memkill->timer, MEMKILL_TIMEOUT_MS, memkill_timeout, a_memkill);
+    }
+    for (int s = 0; s < num_shards; s++) {
+        pthread_mutex_unlock(&shards[s].job_mutex);
+    }
+    free(victims);
+
+    /* nothing needed killing */
+    if (!num_killed) {
+        answer_memkill(a_memkill, 0);
+        free(a_memkill);
+    }
+    return num_killed > 0;
+}
+
+/**
+ * current time in milliseconds since the epoch, for the time jobs spend suspended
+ * @return milliseconds
+ */
+int64_t epoch_ms(void) {
+    struct timespec now;
+
+    clock_gettime(CLOCK_REALTIME, &now);
+    return (int64_t) now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+/**
+ * stop a job and what it forked with SIGSTOP. Its execution timeout is
+ * paused so the time spent suspended doesn't count, its memory stays
+ * allocated. Caller holds the job mutex of its shard
+ * @param a_job running job
+ * @param pressure the job is suspended under pressure and resumed once it cleared
+ * @return
+ *  true: if the job was suspended
+ *  false: if it was suspended already or is gone
+ */
+bool suspend_job(job_t *a_job, bool pressure) {
+    if (a_job->suspended || kill(-a_job->pid, SIGSTOP) == -1) {
+        return false;
+    }
+
+    a_job->timeout_left = tw_pause(&wheel, &a_job->timer);
+    a_job->suspended = true;
+    a_job->pressure_suspended = pressure;
+    a_job->suspended_at = epoch_ms();
+    jt_suspend(a_job->slot, true, a_job->suspended_ms, a_job->suspended_at / 1000);
+    job_log(a_job, pressure ? "suspended %d under pressure" : "suspended %d", a_job->pid);
+    return true;
+}
+
+/**
+ * continue a suspended job with SIGCONT and rearm its timeout with what it
+ * had left. Caller holds the job mutex of its shard
+ * @param a_job running job
+ * @return
+ *  true: if the job was resumed
+ *  false: if it wasn't suspended
+ */
+bool resume_job(job_t *a_job) {
+    if (!a_job->suspended) {
+        return false;
+    }
+
+    kill(-a_job->pid, SIGCONT);
+    int64_t suspended_for = epoch_ms() - a_job->suspended_at;
+    a_job->suspended_ms += suspended_for > 0 ? (uint64_t) suspended_for : 0;
+    a_job->suspended = a_job->pressure_suspended = false;
+    if (a_job->timeout_left >= 0) {
+        tw_add(&wheel, &a_job->timer, (unsigned long) a_job->timeout_left, a_job->timer.cb, a_job);
+    }
+    jt_suspend(a_job->slot, false, a_job->suspended_ms, 0);
+    job_log(a_job, "resumed %d after %.1fs suspended", a_job->pid, (double) suspended_for / 1000.0);
+    return true;
+}
+
+/**
+ * order the jobs shed under pressure: like memkill --free, or by share
+ * of the cpu instead of memory under cpu pressure
+ * @param a first job
+ * @param b second job
+ * @param kind resource under pressure
+ * @return the comparison of the jobs, negative if a goes first
+ */
+static int compare_shed(const victim_t *a, const victim_t *b, enum pressure_kind kind) {
+    if (kind == pressure_cpu && a->nice == b->nice && a->cpu != b->cpu) {
+        return a->cpu < b->cpu ? 1 : -1;
+    }
+    return compare_victims(a, b);
+}
+
+/**
+ * describe a running job as a victim, caller holds the job mutex of its shard
+ * @param a_job running job
+ * @param shard index of its shard
+ * @return the victim
+ */
+static victim_t make_victim(job_t *a_job, int shard) {
+    errno = 0;
+    int nice = getpriority(PRIO_PROCESS, a_job->pid);
+
+    return (victim_t) {.job = a_job, .shard = shard, .pid = a_job->pid, .mem = a_job->mem, .cpu = a_job->cpu,
+                       .nice = errno ? 0 : nice, .started = a_job->started};
+}
+
+/**
+ * longest window of the pressure triggers, the pace at which jobs
+ * suspended under pressure are resumed
+ * @return milliseconds
+ */
+unsigned resume_interval(void) {
+    return psi_window_ms[pressure_memory] > psi_window_ms[pressure_cpu] ? psi_window_ms[pressure_memory]
+                                                                        : psi_window_ms[pressure_cpu];
+}
+
+/**
+ * react to a pressure trigger: the workers stop starting queued jobs and
+ * the least important running job is killed, or suspended with -shed
+ * suspend. The kernel fires again after every window while the stall
+ * lasts, so one job goes per window until the stall ends, then the queued
+ * jobs start again and the suspended ones are resumed one per window, the
+ * most important first, each getting a window to show whether the stall
+ * comes back. Jobs keep being queued meanwhile, up to -queue
+ * @param path pressure file whose trigger fired, NULL once pressure cleared
+ * @param kind pressure_memory or pressure_cpu, the tag of the trigger
+ * @param arg unused
+ */
+void on_pressure(const char *path, int kind, void *arg) {
+    if (path && !throttled) {
+        throttled = true;
+        printf("%s - %s pressure on %s, holding queued jobs\n", get_time(), kind == pressure_cpu ? "Cpu" : "Memory",
+               path);
+    } else if (!path) {
+        throttled = false;
+        printf("%s - Pressure cleared, starting queued jobs\n", get_time());
+
+        for (int s = 0; s < num_shards; s++) {
+            pthread_mutex_lock(&shards[s].request_mutex);
+            pthread_cond_broadcast(&shards[s].got_request);
+            pthread_mutex_unlock(&shards[s].request_mutex);
+        }
+        resume_next(NULL);
+        return;
+    }
+    shed_job((enum pressure_kind) kind);
+}
+
+/**
+ * kill or suspend the least important running job of every shard, in the
+ * order of memkill --free: the highest nice level, then the most memory
+ * (the most cpu under cpu pressure), then the youngest. Jobs not sampled
+ * yet, jobs already suspended and, under cpu pressure, jobs which used no
+ * cpu over their window are spared
+ * @param kind resource under pressure
+ */
+void shed_job(enum pressure_kind kind) {
+    victim_t victim = {.job = NULL}, candidate;
+
+    for (int s = 0; s < num_shards; s++) {
+        pthread_mutex_lock(&shards[s].job_mutex);
+    }
+
+    for (int s = 0; s < num_shards; s++) {
+        for (job_t *a_job = shards[s].jobs; a_job; a_job = a_job->next) {
+            if (a_job->suspended || !a_job->mem ||
+                (kind == pressure_cpu && (a_job->window_size < 2 || a_job->cpu <= 0))) {
+                continue;
+            }
+            candidate = make_victim(a_job, s);
+            if (!victim.job || compare_shed(&candidate, &victim, kind) < 0) {
+                victim = candidate;
+            }
+        }
+    }
+
+    if (victim.job && shed_suspend) {
+        suspend_job(victim.job, true);
+    } else if (victim.job) {
+        job_log(victim.job, "sent SIGKILL to %d under %s pressure, using %" PRIu64 " bytes and %.1f%% of the cpu",
+                victim.pid, kind == pressure_cpu ? "cpu" : "memory", victim.mem, victim.cpu);
+        kill(-victim.pid, SIGKILL);
+    }
+    for (int s = 0; s < num_shards; s++) {
+        pthread_mutex_unlock(&shards[s].job_mutex);
+    }
+}
+
+/**
+ * resume the most important job suspended under pressure, the last one
+ * shed_job would pick, and come back after a window for the next one.
+ * Nothing is resumed while there is pressure, the next time it clears
+ * starts over
+ * @param data unused
+ */
+void resume_next(void *data) {
+    victim_t chosen = {.job = NULL}, candidate;
+    int left = 0;
+
+    if (throttled) {
+        return;
+    }
+
+    for (int s = 0; s < num_shards; s++) {
+        pthread_mutex_lock(&shards[s].job_mutex);
+    }
+    for (int s = 0; s < num_shards; s++) {
+        for (job_t *a_job = shards[s].jobs; a_job; a_job = a_job->next) {
+            if (!a_job->pressure_suspended) {
+                continue;
+            }
+            left++;
+            candidate = make_victim(a_job, s);
+            if (!chosen.job || compare_victims(&candidate, &chosen) > 0) {
+                chosen = candidate;
+            }
+        }
+    }
+    if (chosen.job) {
+        resume_job(chosen.job);
+    }
+    for (int s = 0; s < num_shards; s++) {
+        pthread_mutex_unlock(&shards[s].job_mutex);
+    }
+
+    if (left > 1) {
+        tw_add(&wheel, &resume_timer, resume_interval(), resume_next, NULL);
+    }
+}
+
+/**
+ * suspend or resume a job, or every running job of an array
+ * @param ref job id or @id of the array
+ * @param suspend true to suspend, false to resume
+ * @param client_fd client to send the result
+ */
+static void suspend_ref(const char *ref, bool suspend, int client_fd) {
+    char buff[MAX_BUFFER], *end;
+    bool is_array = ref && ref[0] == '@';
+    long id = ref ? strtol(ref + is_array, &end, BASE10) : 0;
+    int matched = 0, changed = 0;
+
+    if (id <= 0 || *end) {
+        send_str(client_fd, is_array ? "error: no such job array\n" : "error: invalid job id\n");
+        return;
+    }
+    if (is_array && !find_array((int) id)) {
+        send_str(client_fd, "error: no such job array\n");
+        return;
+    }
+
+    for (int s = 0; s < num_shards; s++) {
+        pthread_mutex_lock(&shards[s].job_mutex);
+        for (job_t *a_job = shards[s].jobs; a_job; a_job = a_job->next) {
+            if (is_array ? a_job->array_id == id : a_job->id == id) {
+                matched++;
+                changed += suspend ? suspend_job(a_job, false) : resume_job(a_job);
+            }
+        }
+        pthread_mutex_unlock(&shards[s].job_mutex);
+    }
+
+    if (is_array) {
+        sprintf(buff, "%s %d running jobs of array %ld\n", suspend ? "suspended" : "resumed", changed, id);
+    } else if (!matched) {
+        sprintf(buff, "error: job %ld is not running\n", id);
+    } else if (!changed) {
+        sprintf(buff, "error: job %ld is %s\n", id, suspend ? "already suspended" : "not suspended");
+    } else {
+        sprintf(buff, "%s job %ld\n", suspend ? "suspended" : "resumed", id);
+    }
+    if (!send_str(client_fd, buff)) {
+        fprintf(stderr, "error sending suspend result\n");
+    }
+}
+
+/**
+ * process cmd11 (suspend):
+ *  stop a job or the running jobs of an array until they are resumed
+ * @param cmd_arg command argument to be processed
+ * @param client_fd client to send the result
+ */
+void process_cmd11(cmd_t *cmd_arg, int client_fd) {
+    suspend_ref(cmd_arg->flag_size ? cmd_arg->flag_arg[0].value : NULL, true, client_fd);
+}
+
+/**
+ * process cmd12 (resume):
+ *  continue a suspended job or the suspended jobs of an array
+ * @param cmd_arg command argument to be processed
+ * @param client_fd client to send the result
+ */
+void process_cmd12(cmd_t *cmd_arg, int client_fd) {
+    suspend_ref(cmd_arg->flag_size ? cmd_arg->flag_arg[0].value : NULL, false, client_fd);
+}
+
+/**
+ * kill running jobs of every shard using over a given percentage of the
+ * total cpu, measured over their last CPU_WINDOW seconds of samples. A job
+ * is judged once it has been sampled twice
+ * @param cpu_percent cpu threshold
+ */
+void kill_cpu_process(double cpu_percent) {
+    for (int s = 0; s < num_shards; s++) {
+        shard_t *shard = shards + s;
+        pthread_mutex_lock(&shard->job_mutex);
+        for (job_t *a_job = shard->jobs; a_job != NULL; a_job = a_job->next) {
+            if (a_job->window_size > 1 && a_job->cpu > cpu_percent) {
+                job_log(a_job, "sent SIGKILL to %d, using %.1f%% of the cpu", a_job->pid, a_job->cpu);
+                kill(-a_job->pid, SIGKILL);
+            }
+        }
+        pthread_mutex_unlock(&shard->job_mutex);
+    }
+}
+
+/**
+ * receive the command arguments from client
+ * @param client_fd socket of client
+ * @return the received command argument or NULL if failed
+ */
+cmd_t *recv_cmd(int client_fd) {
+    /* allocate memory for the newly created command, counts grow with what is received so free_cmd frees it all */
+    cmd_t *cmd_arg = (cmd_t *) calloc(1, sizeof(cmd_t));
+    if (!cmd_arg) {
+        fprintf(stderr, "recv_cmd: out of memory\n");
+        return NULL;
+    }
+    cmd_arg->stdio_fds[0] = cmd_arg->stdio_fds[1] = -1;
+
+    /* receive type of the command, a client closing a kept connection sends none */
+    uint32_t type;
+    ssize_t got = recv(client_fd, &type, sizeof(type), MSG_WAITALL);
+    if (got != sizeof(type)) {
+        if (got != 0) {
+            fprintf(stderr, "recv got invalid size value\n");
+        }
+        free_cmd(cmd_arg);
+        return NULL;
+    }
+    cmd_arg->type = ntohl(type);
+
+    /* receive flag size */
+    uint32_t flag_size;
+    if (recv(client_fd, &flag_size, sizeof(flag_size), 0) != sizeof(flag_size)) {
+        fprintf(stderr, "recv got invalid size value\n");
+        free_cmd(cmd_arg);
+        return NULL;
+    }
+    flag_size = ntohl(flag_size);
+
+    /* receive all flags */
+    if (flag_size > MAX_FLAGS) {
+        fprintf(stderr, "recv got too many flags\n");
+        free_cmd(cmd_arg);
+        return NULL;
+    }
+    cmd_arg->flag_arg = (flag_t *) malloc(sizeof(flag_t) * MAX_FLAGS);
+    for (; cmd_arg->flag_size < (int) flag_size; cmd_arg->flag_size++) {
+        if (!recv_flag(client_fd, cmd_arg->flag_arg + cmd_arg->flag_size)) {
+            fprintf(stderr, "error receiving flag argument\n");
+            free_cmd(cmd_arg);
+            return NULL;
+        }
+    }
+
+    /* receive file arguments */
+    /* receive file size */
+    uint32_t file_size;
+    if (recv(client_fd, &file_size, sizeof(file_size), 0) != sizeof(file_size)) {
+        fprintf(stderr, "recv got invalid size value\n");
+        free_cmd(cmd_arg);
+        return NULL;
+    }
+    file_size = ntohl(file_size);
+    if (file_size > MAX_FILE_ARGS) {
+        fprintf(stderr, "recv got too many file arguments\n");
+        free_cmd(cmd_arg);
+        return NULL;
+    }
+
+    /* receive file arguments, the array stays null terminated */
+    if (!(cmd_arg->file_arg = (char **) calloc(file_size + 1, sizeof(char *)))) {
+        fprintf(stderr, "recv_cmd: out of memory\n");
+        free_cmd(cmd_arg);
+        return NULL;
+    }
+    for (; cmd_arg->file_size < (int) file_size; cmd_arg->file_size++) {
+        if (!(cmd_arg->file_arg[cmd_arg->file_size] = recv_str(client_fd))) {
+            fprintf(stderr, "error receiving file arguments\n");
+            free_cmd(cmd_arg);
+            return NULL;
+        }
+    }
+
+    return cmd_arg;
+}
+
+/**
+ * receive flags from client
+ * @param client_fd client socket
+ * @param flag_arg flag argument
+ * @return
+ *  True: if successful received flag
+ *  False: if failed to receive flag
+ */
+bool recv_flag(int client_fd, flag_t *flag_arg) {
+    /* receive type of flag */
+    uint32_t flag_type;
+    if (recv(client_fd, &flag_type, sizeof(flag_type), 0) != sizeof(flag_type)) {
+        fprintf(stderr, "recv got invalid flag type value\n");
+        return false;
+    }
+    flag_arg->type = ntohl(flag_type);
+
+    /* receive flag value */
+    /* receive if value exist first */
+    uint16_t value_exist;
+    if (recv(client_fd, &value_exist, sizeof(value_exist), 0) != sizeof(value_exist)) {
+        fprintf(stderr, "recv got invalid exist flag's exist value");
+        return false;
+    }
+    value_exist = ntohs(value_exist);
+
+    /* receive the flag's value if value exist */
+    if (value_exist) {
+        if (!(flag_arg->value = recv_str(client_fd)))
+            return false;
+    } else {
+        flag_arg->value = NULL;
+    }
+
+    return true;
+}
+
+/**
+ * free memory allocated to given command argument
+ * @param cmd_arg given command argument
+ */
+void free_cmd(cmd_t *cmd_arg) {
+    /* free cmd_args elements */
+    /* free file args if exist (mem and mem kill doesn't have file specified) */
+    if (cmd_arg->file_arg) {
+        for (int i = 0; i < cmd_arg->file_size; i++) {
+            free(cmd_arg->file_arg[i]);
+        }
+        free(cmd_arg->file_arg);
+    }
+
+    /* free flag args and its value if exist
+     * Note that some command only has file without flag
+     * Note that some flag doesn't have value (mem) */
+    for (int i = 0; i < cmd_arg->flag_size; i++) {
+        if (cmd_arg->flag_arg[i].value) {
+            free(cmd_arg->flag_arg[i].value);
+        }
+    }
+    free(cmd_arg->flag_arg);
+
+    /* close the stdout and stderr passed by a local controller */
+    for (int i = 0; i < 2; i++) {
+        if (cmd_arg->stdio_fds[i] != -1) {
+            close(cmd_arg->stdio_fds[i]);
+        }
+    }
+
+    /* free cmd_arg */
+    free(cmd_arg);
+}
@@ -0,0 +1,358 @@
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <dirent.h>
+#include <time.h>
+#include <pthread.h>
+#include <placement.h>
+
+/* a cpu the overseer may place jobs on */
+typedef struct pl_cpu {
+    bool usable; /* in the affinity mask of the overseer */
+    int core; /* first cpu of its hyperthread siblings */
+    int domain; /* first cpu sharing its L3, NUMA node or package, whichever is found first */
+    int jobs; /* jobs pinned to it by the overseer */
+    double busy; /* fraction of the last load interval it was busy */
+    unsigned long long prev_total, prev_idle; /* /proc/stat counters at the last load reading */
+} pl_cpu_t;
+
+static pl_cpu_t cpus[PL_MAX_CPUS];
+static int num_cpus = 0; /* highest usable cpu + 1 */
+static struct timespec last_load; /* when the load was last read */
+static pthread_mutex_t pl_mutex = PTHREAD_MUTEX_INITIALIZER; /* protects the cpus */
+
+/**
+ * read the first cpu of a cpu list file of sysfs
+ * @param path file holding a cpu list
+ * @return the first cpu or -1 if the file is missing
+ */
+static int first_cpu(const char *path) {
+    FILE *file;
+    int cpu = -1;
+
+    if (!(file = fopen(path, "re"))) {
+        return -1;
+    }
+    if (fscanf(file, "%d", &cpu) != 1) {
+        cpu = -1;
+    }
+    fclose(file);
+
+    return cpu;
+}
+
+/**
+ * find the cache domain of a cpu: its L3 if the cache topology is exposed,
+ * otherwise its NUMA node, otherwise its package
+ * @param cpu cpu
+ * @return the first cpu of the domain
+ */
+static int cpu_domain(int cpu) {
+    char path[128];
+    int level, domain;
+
+    for (int i = 0; i < 8; i++) {
+        sprintf(path, "/sys/devices/system/cpu/cpu%d/cache/index%d/level", cpu, i);
+        FILE *file = fopen(path, "re");
+        if (!file) {
+            break;
+        }
+        if (fscanf(file, "%d", &level) != 1) {
+            level = 0;
+        }
+        fclose(file);
+
+        sprintf(path, "/sys/devices/system/cpu/cpu%d/cache/index%d/shared_cpu_list", cpu, i);
+        if (level == 3 && (domain = first_cpu(path)) != -1) {
+            return domain;
+        }
+    }
+
+    /* the node of a cpu is a nodeN entry of its directory */
+    sprintf(path, "/sys/devices/system/cpu/cpu%d", cpu);
+    DIR *dir = opendir(path);
+    struct dirent *entry;
+    while (dir && (entry = readdir(dir))) {
+        int node;
+        if (sscanf(entry->d_name, "node%d", &node) == 1) {
+            sprintf(path, "/sys/devices/system/node/node%d/cpulist", node);
+            closedir(dir);
+            return (domain = first_cpu(path)) != -1 ? domain : 0;
+        }
+    }
+    if (dir) {
+        closedir(dir);
+    }
+
+    sprintf(path, "/sys/devices/system/cpu/cpu%d/topology/core_siblings_list", cpu);
+    return (domain = first_cpu(path)) != -1 ? domain : 0;
+}
+
+/**
+ * read the busy fraction of every cpu since the last reading from /proc/stat,
+ * at most once per PL_LOAD_INTERVAL_MS. Called with pl_mutex held
+ */
+static void read_load(void) {
+    struct timespec now;
+    char line[256];
+    FILE *file;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if ((now.tv_sec - last_load.tv_sec) * 1000 + (now.tv_nsec - last_load.tv_nsec) / 1000000 < PL_LOAD_INTERVAL_MS) {
+        return;
+    }
+    last_load = now;
+
+    if (!(file = fopen("/proc/stat", "re"))) {
+        return;
+    }
+    while (fgets(line, sizeof(line), file)) {
+        unsigned long long user, nice, system, idle, iowait, irq, softirq, steal;
+        int cpu;
+
+        if (sscanf(line, "cpu%d %llu %llu %llu %llu %llu %llu %llu %llu", &cpu, &user, &nice, &system, &idle,
+                   &iowait, &irq, &softirq, &steal) != 9 || cpu < 0 || cpu >= num_cpus) {
+            continue;
+        }
+
+        pl_cpu_t *a_cpu = cpus + cpu;
+        unsigned long long total = user + nice + system + idle + iowait + irq + softirq + steal;
+        if (a_cpu->prev_total && total > a_cpu->prev_total) {
+            a_cpu->busy = 1.0 - (double) (idle + iowait - a_cpu->prev_idle) / (double) (total - a_cpu->prev_total);
+        }
+        a_cpu->prev_total = total;
+        a_cpu->prev_idle = idle + iowait;
+    }
+    fclose(file);
+}
+
+/**
+ * read the topology of the cpus the overseer may run on
+ */
+void pl_init(void) {
+    cpu_set_t allowed;
+    char path[128];
+
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) == -1) {
+        perror("sched_getaffinity");
+        return;
+    }
+
+    pthread_mutex_lock(&pl_mutex);
+    for (int cpu = 0; cpu < PL_MAX_CPUS; cpu++) {
+        if (!CPU_ISSET(cpu, &allowed)) {
+            continue;
+        }
+
+        sprintf(path, "/sys/devices/system/cpu/cpu%d/topology/thread_siblings_list", cpu);
+        int core = first_cpu(path);
+        cpus[cpu].usable = true;
+        cpus[cpu].core = core != -1 ? core : cpu;
+        cpus[cpu].domain = cpu_domain(cpu);
+        num_cpus = cpu + 1;
+    }
+
+    /* the first reading sets the counters the next one is compared with */
+    read_load();
+    pthread_mutex_unlock(&pl_mutex);
+}
+
+/**
+ * parse a cpu list: cpus and ranges of cpus separated by commas
+ * @param list cpu list such as 0-3,8,10-11
+ * @param set receives the cpus
+ * @return
+ *  true: if the list is valid
+ *  false: otherwise
+ */
+bool pl_parse_cpus(const char *list, cpu_set_t *set) {
+    char *end;
+
+    CPU_ZERO(set);
+    do {
+        long first = strtol(list, &end, 10), last = first;
+        if (end == list || first < 0) {
+            return false;
+        }
+        if (*end == '-') {
+            list = end + 1;
+            last = strtol(list, &end, 10);
+            if (end == list || last < first) {
+                return false;
+            }
+        }
+        if (last >= PL_MAX_CPUS) {
+            return false;
+        }
+
+        for (long cpu = first; cpu <= last; cpu++) {
+            CPU_SET(cpu, set);
+        }
+        list = end + 1;
+    } while (*end == ',');
+
+    return *end == '\0';
+}
+
+/**
+ * parse an io priority
+ * @param spec rt, be or idle, with an optional :level from 0 (highest) to 7
+ * @param ioprio receives the priority as given to ioprio_set
+ * @return
+ *  true: if the priority is valid
+ *  false: otherwise
+ */
+bool pl_parse_ioprio(const char *spec, int *ioprio) {
+    static const char *classes[] = {"rt", "be", "idle"};
+    const char *colon = strchr(spec, ':');
+    size_t len = colon ? (size_t) (colon - spec) : strlen(spec);
+    long level = 4;
+    char *end;
+
+    if (colon) {
+        level = strtol(colon + 1, &end, 10);
+        if (end == colon + 1 || *end || level < 0 || level > 7) {
+            return false;
+        }
+    }
+
+    for (int i = 0; i < 3; i++) {
+        if (strlen(classes[i]) == len && strncmp(spec, classes[i], len) == 0) {
+            /* classes are numbered from 1, idle has no level */
+            *ioprio = (i + 1) << PL_IOPRIO_CLASS_SHIFT | (i == 2 ? 0 : (int) level);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * format a cpu set as a cpu list, ranges of consecutive cpus joined
+ * @param set cpus
+ * @param buf receives the list, truncated if too long
+ * @param len size of buf
+ */
+void pl_format(const cpu_set_t *set, char *buf, size_t len) {
+    size_t used = 0;
+
+    buf[0] = '\0';
+    for (int cpu = 0; cpu < PL_MAX_CPUS && used < len; cpu++) {
+        if (!CPU_ISSET(cpu, set)) {
+            continue;
+        }
+
+        int last = cpu;
+        while (last + 1 < PL_MAX_CPUS && CPU_ISSET(last + 1, set)) last++;
+        used += last > cpu ? snprintf(buf + used, len - used, used ? ",%d-%d" : "%d-%d", cpu, last)
+                           : snprintf(buf + used, len - used, used ? ",%d" : "%d", cpu);
+        cpu = last;
+    }
+}
+
+/**
+ * get the load of a cpu: the jobs pinned to it plus how busy it was
+ * @param cpu cpu
+ * @return the load, a job counting as a busy cpu
+ */
+static double cpu_load(int cpu) {
+    return cpus[cpu].jobs + cpus[cpu].busy;
+}
+
+/**
+ * place a job on the n least loaded cpus. The least loaded cache domain
+ * with at least n cpus is chosen so the job's threads share their L3 and
+ * memory node with each other and not with the jobs of other domains, then
+ * the cpus of the least loaded physical cores within it. Hyperthread
+ * siblings are only taken together once every core has one cpu picked.
+ * The cpus count the job until pl_release
+ * @param n number of cpus
+ * @param set receives the cpus
+ * @return
+ *  true: if cpus were picked
+ *  false: if the topology is unknown
+ */
+bool pl_pick(int n, cpu_set_t *set) {
+    double domain_load[PL_MAX_CPUS] = {0}, core_load[PL_MAX_CPUS] = {0};
+    int domain_cpus[PL_MAX_CPUS] = {0}, core_picked[PL_MAX_CPUS] = {0};
+    int domain = -1, picked = 0;
+
+    CPU_ZERO(set);
+    pthread_mutex_lock(&pl_mutex);
+    read_load();
+
+    for (int cpu = 0; cpu < num_cpus; cpu++) {
+        if (cpus[cpu].usable) {
+            domain_load[cpus[cpu].domain] += cpu_load(cpu);
+            domain_cpus[cpus[cpu].domain]++;
+            core_load[cpus[cpu].core] += cpu_load(cpu);
+        }
+    }
+
+    /* least loaded domain per cpu, any cpu if no domain is large enough */
+    for (int d = 0; d < num_cpus; d++) {
+        if (domain_cpus[d] >= n && (domain == -1 ||
+                                    domain_load[d] / domain_cpus[d] < domain_load[domain] / domain_cpus[domain])) {
+            domain = d;
+        }
+    }
+
+    while (picked < n) {
+        int best = -1;
+        double best_load = 0;
+
+        for (int cpu = 0; cpu < num_cpus; cpu++) {
+            if (!cpus[cpu].usable || CPU_ISSET(cpu, set) || (domain != -1 && cpus[cpu].domain != domain)) {
+                continue;
+            }
+
+            /* a cpu of a core picked already weighs as much as a busy one */
+            double load = cpu_load(cpu) + core_load[cpus[cpu].core] + 2 * core_picked[cpus[cpu].core];
+            if (best == -1 || load < best_load) {
+                best = cpu;
+                best_load = load;
+            }
+        }
+        if (best == -1) {
+            break;
+        }
+
+        CPU_SET(best, set);
+        core_picked[cpus[best].core]++;
+        cpus[best].jobs++;
+        picked++;
+    }
+    pthread_mutex_unlock(&pl_mutex);
+
+    return picked > 0;
+}
+
+/**
+ * count a job on the cpus of a set
+ * @param set cpus the job is pinned to
+ */
+void pl_hold(const cpu_set_t *set) {
+    pthread_mutex_lock(&pl_mutex);
+    for (int cpu = 0; cpu < num_cpus; cpu++) {
+        if (CPU_ISSET(cpu, set)) {
+            cpus[cpu].jobs++;
+        }
+    }
+    pthread_mutex_unlock(&pl_mutex);
+}
+
+/**
+ * stop counting a finished job on its cpus
+ * @param set cpus the job was pinned to
+ */
+void pl_release(const cpu_set_t *set) {
+    pthread_mutex_lock(&pl_mutex);
+    for (int cpu = 0; cpu < num_cpus; cpu++) {
+        if (CPU_ISSET(cpu, set) && cpus[cpu].jobs > 0) {
+            cpus[cpu].jobs--;
+        }
+    }
+    pthread_mutex_unlock(&pl_mutex);
+}
@@ -0,0 +1,36 @@
+#ifndef PROCESS_OVERSEER_PLACEMENT_H
+#define PROCESS_OVERSEER_PLACEMENT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <sched.h>
+
+#define PL_MAX_CPUS CPU_SETSIZE /* cpus the placement knows of */
+#define PL_LOAD_INTERVAL_MS 1000 /* per cpu load older than this is read again */
+
+/* io priority classes, see ioprio_set(2) */
+#define PL_IOPRIO_CLASS_SHIFT 13
+#define PL_IOPRIO_WHO_PROCESS 1
+
+/* read the cpu topology, the cpus the overseer may run on are placed on */
+void pl_init(void);
+
+/* parse a cpu list such as 0-3,8,10-11, false if invalid */
+bool pl_parse_cpus(const char *list, cpu_set_t *set);
+
+/* parse an io priority class[:level] with class rt, be or idle */
+bool pl_parse_ioprio(const char *spec, int *ioprio);
+
+/* format a cpu set as a cpu list into buf */
+void pl_format(const cpu_set_t *set, char *buf, size_t len);
+
+/* pick the n least loaded cpus, within one cache domain if it has n cpus */
+bool pl_pick(int n, cpu_set_t *set);
+
+/* count the cpus of a set as running a job, placed by pl_pick or adopted */
+void pl_hold(const cpu_set_t *set);
+
+/* release the cpus of a finished job */
+void pl_release(const cpu_set_t *set);
+
+#endif //PROCESS_OVERSEER_PLACEMENT_H
@@ -0,0 +1,228 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+#include <mntent.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
+#include <pressure.h>
+
+/* trigger registered on a pressure file */
+typedef struct ps_watch {
+    char path[256]; /* pressure file */
+    int fd; /* polled for POLLPRI, the trigger lives as long as it is open */
+    unsigned window_ms; /* window of the trigger */
+    int tag; /* given back to the callback, telling what the file is about */
+} ps_watch_t;
+
+static ps_watch_t watches[PS_MAX_WATCHES]; /* registered triggers */
+static int num_watches = 0; /* number of registered triggers */
+static int stop_fd = -1; /* wakes the pressure thread up to stop */
+static pthread_t thread; /* pressure thread */
+static ps_callback_t callback; /* told of every trigger and of the end of pressure */
+static void *callback_arg; /* argument of the callback */
+
+/**
+ * register a trigger on a pressure file, firing when some tasks stalled
+ * for stall_ms in total within window_ms. The kernel raises POLLPRI on the
+ * file at most once per window while the stall lasts, so nothing is read
+ * or polled in between
+ * @param path pressure file, /proc/pressure/memory or memory.pressure of a cgroup
+ * @param stall_ms stall threshold in milliseconds
+ * @param window_ms tracking window in milliseconds
+ * @param tag given back to the callback when the trigger fires
+ * @return
+ *  true: if the trigger is registered
+ *  false: if the file can't be opened or the kernel refused the trigger
+ */
+bool ps_watch(const char *path, unsigned stall_ms, unsigned window_ms, int tag) {
+    char trigger[64];
+    int fd;
+
+    if (num_watches == PS_MAX_WATCHES || strlen(path) >= sizeof(watches[0].path)) {
+        return false;
+    }
+    if ((fd = open(path, O_RDWR | O_NONBLOCK | O_CLOEXEC)) == -1) {
+        fprintf(stderr, "ps_watch: %s: %s\n", path, strerror(errno));
+        return false;
+    }
+
+    /* the kernel takes the times in microseconds, the string with its terminator */
+    int len = snprintf(trigger, sizeof(trigger), "some %u %u", stall_ms * 1000, window_ms * 1000);
+    if (write(fd, trigger, len + 1) == -1) {
+        fprintf(stderr, "ps_watch: %s: %s%s\n", path, strerror(errno),
+                errno == EINVAL && window_ms % 2000 ? " (windows must be a multiple of 2s without CAP_SYS_RESOURCE)"
+                                                    : "");
+        close(fd);
+        return false;
+    }
+
+    ps_watch_t *a_watch = watches + num_watches++;
+    strcpy(a_watch->path, path);
+    a_watch->fd = fd;
+    a_watch->window_ms = window_ms;
+    a_watch->tag = tag;
+    return true;
+}
+
+/**
+ * find a pressure file of the cgroup the overseer runs in, which its jobs
+ * inherit. Only cgroup v2 has pressure files; the root cgroup has none,
+ * the files of /proc/pressure cover it
+ * @param name pressure file, memory.pressure, cpu.pressure or io.pressure
+ * @param path receives the path of the file
+ * @param len size of path
+ * @return
+ *  true: if the file exists
+ *  false: otherwise
+ */
+bool ps_cgroup_file(const char *name, char *path, size_t len) {
+    char line[512], *group = NULL, *mount = NULL;
+    FILE *file;
+    struct mntent *entry;
+
+    if ((file = fopen("/proc/self/cgroup", "re"))) {
+        while (!group && fgets(line, sizeof(line), file)) {
+            if (strncmp(line, "0::", 3) == 0) {
+                line[strcspn(line, "\n")] = '\0';
+                group = strdup(line + 3);
+            }
+        }
+        fclose(file);
+    }
+    if (!group || strcmp(group, "/") == 0) {
+        free(group);
+        return false;
+    }
+
+    if ((file = setmntent("/proc/self/mounts", "re"))) {
+        while (!mount && (entry = getmntent(file))) {
+            if (strcmp(entry->mnt_type, "cgroup2") == 0) {
+                mount = strdup(entry->mnt_dir);
+            }
+        }
+        endmntent(file);
+    }
+
+    bool found = mount && snprintf(path, len, "%s%s/%s", mount, group, name) < (int) len && access(path, R_OK) == 0;
+    free(group);
+    free(mount);
+    return found;
+}
+
+/**
+ * current monotonic time
+ * @return milliseconds
+ */
+static long long ps_now_ms(void) {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000LL + now.tv_nsec / 1000000;
+}
+
+/**
+ * wait for triggers and call back on each of them. Pressure is over once
+ * a window and a half went by without any trigger: a lasting stall fires
+ * again after every window. Only then does the poll have a timeout, the
+ * thread sleeps otherwise
+ * @param data unused
+ * @return NULL
+ */
+static void *ps_loop(void *data) {
+    struct pollfd fds[PS_MAX_WATCHES + 1];
+    long long last = 0; /* time of the latest trigger, 0 without pressure */
+    unsigned clear_ms = 0;
+
+    for (int i = 0; i < num_watches; i++) {
+        fds[i] = (struct pollfd) {.fd = watches[i].fd, .events = POLLPRI};
+        if (watches[i].window_ms * 3 / 2 > clear_ms) {
+            clear_ms = watches[i].window_ms * 3 / 2;
+        }
+    }
+    fds[num_watches] = (struct pollfd) {.fd = stop_fd, .events = POLLIN};
+
+    for (;;) {
+        int timeout = last ? (int) (last + clear_ms - ps_now_ms()) : -1;
+        if (last && timeout <= 0) {
+            last = 0;
+            callback(NULL, 0, callback_arg);
+            continue;
+        }
+
+        if (poll(fds, num_watches + 1, timeout) == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("poll");
+            return NULL;
+        }
+        if (fds[num_watches].revents) {
+            return NULL;
+        }
+
+        for (int i = 0; i < num_watches; i++) {
+            if (fds[i].revents & POLLERR) {
+                /* the cgroup of the file was removed */
+                fprintf(stderr, "ps_loop: %s is gone\n", watches[i].path);
+                fds[i].fd = -1;
+            } else if (fds[i].revents & POLLPRI) {
+                last = ps_now_ms();
+                callback(watches[i].path, watches[i].tag, callback_arg);
+            }
+        }
+    }
+}
+
+/**
+ * start the pressure thread on the registered triggers
+ * @param on_pressure callback run on every trigger and once pressure cleared
+ * @param arg argument of the callback
+ * @return
+ *  true: if the thread runs
+ *  false: if no trigger was registered or the thread could not start
+ */
+bool ps_start(ps_callback_t on_pressure, void *arg) {
+    if (!num_watches) {
+        return false;
+    }
+    callback = on_pressure;
+    callback_arg = arg;
+
+    if ((stop_fd = eventfd(0, EFD_CLOEXEC)) == -1) {
+        perror("eventfd");
+        return false;
+    }
+    if (pthread_create(&thread, NULL, ps_loop, NULL)) {
+        fprintf(stderr, "ps_start: could not create pressure thread\n");
+        close(stop_fd);
+        stop_fd = -1;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * stop the pressure thread if it runs and remove the triggers
+ */
+void ps_stop(void) {
+    uint64_t one = 1;
+
+    if (stop_fd != -1) {
+        if (write(stop_fd, &one, sizeof(one)) != sizeof(one)) {
+            perror("write eventfd");
+        }
+        pthread_join(thread, NULL);
+        close(stop_fd);
+        stop_fd = -1;
+    }
+    for (int i = 0; i < num_watches; i++) {
+        close(watches[i].fd);
+    }
+    num_watches = 0;
+}
@@ -0,0 +1,29 @@
+#ifndef PROCESS_OVERSEER_PRESSURE_H
+#define PROCESS_OVERSEER_PRESSURE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#define PS_SYSTEM_MEMORY "/proc/pressure/memory" /* memory pressure of the whole host */
+#define PS_SYSTEM_CPU "/proc/pressure/cpu" /* cpu pressure of the whole host */
+#define PS_WINDOW_MS 2000 /* default window, triggers without CAP_SYS_RESOURCE need a multiple of 2s */
+#define PS_MIN_WINDOW_MS 500 /* shortest window the kernel accepts */
+#define PS_MAX_WINDOW_MS 10000 /* longest window the kernel accepts */
+#define PS_MAX_WATCHES 4 /* pressure files watched at once */
+
+/* called from the pressure thread, with the file and tag of the trigger fired or NULL once pressure cleared */
+typedef void (*ps_callback_t)(const char *path, int tag, void *arg);
+
+/* register a trigger firing when tasks stall over stall_ms within window_ms, false if refused */
+bool ps_watch(const char *path, unsigned stall_ms, unsigned window_ms, int tag);
+
+/* find a pressure file (memory.pressure...) of the cgroup v2 the overseer runs in, false in the root cgroup */
+bool ps_cgroup_file(const char *name, char *path, size_t len);
+
+/* start the thread calling back on every trigger and once pressure cleared */
+bool ps_start(ps_callback_t, void *arg);
+
+/* stop the thread and close the triggers */
+void ps_stop(void);
+
+#endif //PROCESS_OVERSEER_PRESSURE_H
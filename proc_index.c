@@ -0,0 +1,221 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <time.h>
+#include <helpers.h>
+#include <proc_index.h>
+
+/* process known to the index */
+typedef struct pi_node {
+    pid_t pid;
+    unsigned long gen; /* sweep which last saw the process */
+    bool fresh; /* parent must be (re)read from /proc/pid/stat */
+    struct pi_node *parent; /* parent process, NULL if unknown */
+    struct pi_node *child; /* first child */
+    struct pi_node *sibling; /* next child of the same parent */
+    struct pi_node *hnext; /* next node in the hash bucket */
+    struct pi_node *fnext; /* next node whose parent must be read */
+} pi_node_t;
+
+static pi_node_t *buckets[PI_BUCKETS]; /* nodes hashed by pid */
+static unsigned long gen = 0; /* number of sweeps so far */
+static struct timespec last_sweep; /* monotonic time of the last sweep */
+static pthread_mutex_t index_mutex = PTHREAD_MUTEX_INITIALIZER; /* protects the index */
+
+/**
+ * find a process in the index, caller holds the lock
+ * @param pid pid of the process
+ * @return the node or NULL if unknown
+ */
+static pi_node_t *pi_find(pid_t pid) {
+    pi_node_t *node = buckets[(unsigned) pid % PI_BUCKETS];
+    while (node && node->pid != pid) node = node->hnext;
+    return node;
+}
+
+/**
+ * remove a node from the children of its parent, caller holds the lock
+ * @param node node to unlink
+ */
+static void pi_unlink(pi_node_t *node) {
+    if (!node->parent) {
+        return;
+    }
+
+    pi_node_t **link = &node->parent->child;
+    while (*link != node) link = &(*link)->sibling;
+    *link = node->sibling;
+    node->parent = NULL;
+    node->sibling = NULL;
+}
+
+/**
+ * read the parent of a process and link the node under it
+ * @param node node whose parent is unknown
+ */
+static void pi_link(pi_node_t *node) {
+    char buf[MAX_BUFFER], *ptr;
+    pid_t ppid;
+    FILE *f;
+
+    sprintf(buf, "/proc/%d/stat", node->pid);
+    if (!(f = fopen(buf, "r"))) {
+        return; /* gone already, dropped by the next sweep */
+    }
+    ptr = fgets(buf, MAX_BUFFER, f);
+    fclose(f);
+
+    /* the command name may hold spaces and parentheses, skip past the last one */
+    if (!ptr || !(ptr = strrchr(buf, ')')) || sscanf(ptr + 1, " %*c %d", &ppid) != 1) {
+        return;
+    }
+
+    pi_node_t *parent = pi_find(ppid);
+    if (parent) {
+        node->parent = parent;
+        node->sibling = parent->child;
+        parent->child = node;
+    }
+}
+
+/**
+ * sweep /proc once: new processes are added, exited ones dropped and only
+ * the new processes and the orphans of exited ones have their stat read,
+ * every other parent link is kept from the previous sweep. Caller holds the lock.
+ */
+static void pi_sweep(void) {
+    pi_node_t *fresh = NULL;
+    struct dirent *ent;
+    DIR *dir;
+
+    if (!(dir = opendir("/proc"))) {
+        perror("opendir /proc");
+        return;
+    }
+    gen++;
+
+    /* mark every process still alive */
+    while ((ent = readdir(dir))) {
+        if (!isdigit((unsigned char) ent->d_name[0])) {
+            continue;
+        }
+
+        pid_t pid = (pid_t) strtol(ent->d_name, NULL, BASE10);
+        pi_node_t *node = pi_find(pid);
+        if (!node) {
+            if (!(node = (pi_node_t *) calloc(1, sizeof(pi_node_t)))) {
+                fprintf(stderr, "pi_sweep: out of memory\n");
+                break;
+            }
+            node->pid = pid;
+            node->hnext = buckets[(unsigned) pid % PI_BUCKETS];
+            buckets[(unsigned) pid % PI_BUCKETS] = node;
+            node->fresh = true;
+            node->fnext = fresh;
+            fresh = node;
+        }
+        node->gen = gen;
+    }
+    closedir(dir);
+
+    /* drop exited processes, their living children were reparented */
+    for (int i = 0; i < PI_BUCKETS; i++) {
+        pi_node_t **link = &buckets[i];
+        while (*link) {
+            pi_node_t *node = *link;
+            if (node->gen == gen) {
+                link = &node->hnext;
+                continue;
+            }
+
+            *link = node->hnext;
+            pi_unlink(node);
+            for (pi_node_t *child = node->child, *next; child; child = next) {
+                next = child->sibling;
+                child->parent = NULL;
+                child->sibling = NULL;
+                if (child->gen == gen && !child->fresh) {
+                    child->fresh = true;
+                    child->fnext = fresh;
+                    fresh = child;
+                }
+            }
+            free(node);
+        }
+    }
+
+    /* read the parent of new and orphaned processes */
+    while (fresh) {
+        pi_node_t *node = fresh;
+        fresh = node->fnext;
+        node->fresh = false;
+        pi_link(node);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &last_sweep);
+}
+
+/**
+ * refresh the index, samplers of several shards share one sweep per tick
+ * @return true once the index is at most PI_MIN_INTERVAL_MS old
+ */
+bool pi_refresh(void) {
+    struct timespec now;
+
+    pthread_mutex_lock(&index_mutex);
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    long age_ms = (now.tv_sec - last_sweep.tv_sec) * 1000 + (now.tv_nsec - last_sweep.tv_nsec) / 1000000;
+    if (!gen || age_ms >= PI_MIN_INTERVAL_MS) {
+        pi_sweep();
+    }
+    pthread_mutex_unlock(&index_mutex);
+
+    return gen > 0;
+}
+
+/**
+ * collect a process and all of its descendants known to the index
+ * @param root pid of the process, always stored first
+ * @param pids receives the pids
+ * @param max size of pids
+ * @return number of pids stored
+ */
+int pi_descendants(pid_t root, pid_t *pids, int max) {
+    int count = 0;
+
+    if (max < 1) {
+        return 0;
+    }
+    pids[count++] = root;
+
+    /* breadth first, pids doubles as the queue */
+    pthread_mutex_lock(&index_mutex);
+    for (int i = 0; i < count; i++) {
+        pi_node_t *node = pi_find(pids[i]);
+        for (pi_node_t *child = node ? node->child : NULL; child && count < max; child = child->sibling) {
+            pids[count++] = child->pid;
+        }
+    }
+    pthread_mutex_unlock(&index_mutex);
+
+    return count;
+}
+
+/**
+ * drop every process from the index
+ */
+void pi_clear(void) {
+    pthread_mutex_lock(&index_mutex);
+    for (int i = 0; i < PI_BUCKETS; i++) {
+        while (buckets[i]) {
+            pi_node_t *node = buckets[i];
+            buckets[i] = node->hnext;
+            free(node);
+        }
+    }
+    gen = 0;
+    pthread_mutex_unlock(&index_mutex);
+}
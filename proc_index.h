@@ -0,0 +1,20 @@
+#ifndef PROCESS_OVERSEER_PROC_INDEX_H
+#define PROCESS_OVERSEER_PROC_INDEX_H
+
+#include <stdbool.h>
+#include <sys/types.h>
+
+#define PI_BUCKETS 4096 /* buckets of the pid hash table */
+#define PI_MIN_INTERVAL_MS 500 /* a sweep younger than this is reused */
+#define MAX_TREE_PIDS 4096 /* maximum number of processes counted per job */
+
+/* refresh the index from /proc unless another sampler just did */
+bool pi_refresh(void);
+
+/* collect a process and its descendants, returns how many were stored */
+int pi_descendants(pid_t root, pid_t *pids, int max);
+
+/* drop every process from the index */
+void pi_clear(void);
+
+#endif //PROCESS_OVERSEER_PROC_INDEX_H
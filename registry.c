@@ -0,0 +1,630 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <string.h>
+#include <pthread.h>
+#include <inttypes.h>
+#include <helpers.h>
+#include <registry.h>
+#include <handoff.h>
+
+static job_record_t *buckets[REG_BUCKETS]; /* records hashed by job id */
+static job_record_t *finished, *last_finished; /* finished records, oldest first */
+static int num_finished = 0; /* number of finished records */
+static int num_jobs = 0; /* number of submitted jobs, also the last given id */
+static pthread_mutex_t registry_mutex = PTHREAD_MUTEX_INITIALIZER; /* protects the registry */
+static reg_release_t release; /* queues or drops the command of a held job */
+
+/* held jobs of a job which ended, released or cancelled once the registry lock is dropped */
+typedef struct release_batch {
+    dependent_t *dependents; /* held jobs */
+    int id; /* job which ended */
+    bool ok; /* whether it exited with 0 */
+    struct release_batch *next;
+} release_batch_t;
+
+/**
+ * find a record by job id, caller holds the lock
+ * @param id job id
+ * @return the record or NULL if unknown or already dropped
+ */
+static job_record_t *reg_find(int id) {
+    job_record_t *rec = buckets[(unsigned) id % REG_BUCKETS];
+    while (rec && rec->id != id) rec = rec->hnext;
+    return rec;
+}
+
+/**
+ * drop the oldest finished record, caller holds the lock
+ */
+static void reg_evict(void) {
+    job_record_t *rec = finished, **link;
+
+    finished = rec->fnext;
+    if (!finished) {
+        last_finished = NULL;
+    }
+    num_finished--;
+
+    for (link = &buckets[(unsigned) rec->id % REG_BUCKETS]; *link != rec; link = &(*link)->hnext);
+    *link = rec->hnext;
+    free(rec->sketch);
+    free(rec);
+}
+
+/**
+ * describe how a finished job ended
+ * @param rec finished record
+ * @param buff buffer of MAX_BUFFER bytes receiving the description
+ */
+static void reg_format(job_record_t *rec, char *buff) {
+    double runtime = (double) (rec->end.tv_sec - rec->start.tv_sec) +
+                     (double) (rec->end.tv_nsec - rec->start.tv_nsec) / 1e9;
+
+    switch (rec->state) {
+        case job_exited:
+            sprintf(buff, "exited with status %d after %.3fs, peak memory %" PRIu64 "\n",
+                    rec->status, runtime, rec->peak_mem);
+            break;
+        case job_signaled:
+            sprintf(buff, "killed by signal %d (%s) after %.3fs, peak memory %" PRIu64 "\n",
+                    rec->status, strsignal(rec->status), runtime, rec->peak_mem);
+            break;
+        case job_failed:
+            sprintf(buff, "could not be executed: %s\n", strerror(rec->status));
+            break;
+        default:
+            if (rec->status) {
+                sprintf(buff, "cancelled before it started, job %d it ran after failed\n", rec->status);
+            } else {
+                sprintf(buff, "cancelled before it started\n");
+            }
+            break;
+    }
+}
+
+/**
+ * register a queued job
+ * @return the record holding its id or NULL if out of memory
+ */
+job_record_t *reg_add(void) {
+    job_record_t *rec = (job_record_t *) calloc(1, sizeof(job_record_t));
+    if (!rec) {
+        fprintf(stderr, "reg_add: out of memory\n");
+        return NULL;
+    }
+    rec->state = job_queued;
+
+    pthread_mutex_lock(&registry_mutex);
+    rec->id = ++num_jobs;
+    rec->hnext = buckets[(unsigned) rec->id % REG_BUCKETS];
+    buckets[(unsigned) rec->id % REG_BUCKETS] = rec;
+    pthread_mutex_unlock(&registry_mutex);
+
+    return rec;
+}
+
+/**
+ * mark a registered job as running
+ * @param rec record of the job
+ * @param pid pid of the job
+ */
+void reg_start(job_record_t *rec, pid_t pid) {
+    pthread_mutex_lock(&registry_mutex);
+    rec->pid = pid;
+    rec->state = job_running;
+    clock_gettime(CLOCK_MONOTONIC, &rec->start);
+    pthread_mutex_unlock(&registry_mutex);
+}
+
+/**
+ * record how a job ended, answer the clients waiting for it and keep the
+ * record among the finished ones. Only the newest MAX_FINISHED_JOBS finished
+ * records are kept so the caller must not use the record afterwards.
+ * @param rec record of the job
+ * @param state final state of the job
+ * @param status exit code, signal number or errno depending on state
+ * @param peak_mem highest memory sample of the job
+ * @param sketch memory samples of the job, kept with the record, NULL if none
+ * @return the held jobs waiting for this one, to be released
+ */
+static dependent_t *reg_end(job_record_t *rec, enum job_state state, int status, uint64_t peak_mem,
+                            const sketch_t *sketch) {
+    sketch_t *copy = NULL;
+    char buff[MAX_BUFFER];
+    waiter_t *waiters;
+    dependent_t *dependents;
+    int id = rec->id;
+
+    if (sketch && sketch->count && (copy = (sketch_t *) malloc(sizeof(sketch_t)))) {
+        *copy = *sketch;
+    }
+
+    pthread_mutex_lock(&registry_mutex);
+    clock_gettime(CLOCK_MONOTONIC, &rec->end);
+    if (rec->state == job_queued || rec->state == job_held) {
+        rec->start = rec->end;
+    }
+    rec->state = state;
+    rec->status = status;
+    rec->peak_mem = peak_mem;
+    rec->sketch = copy;
+    reg_format(rec, buff);
+
+    waiters = rec->waiters;
+    rec->waiters = NULL;
+
+    /* held jobs are listed newest first, release them in the order they were submitted */
+    dependents = NULL;
+    while (rec->dependents) {
+        dependent_t *a_dependent = rec->dependents;
+        rec->dependents = a_dependent->next;
+        a_dependent->next = dependents;
+        dependents = a_dependent;
+    }
+
+    /* append to the finished records and drop the oldest ones */
+    if (last_finished) {
+        last_finished->fnext = rec;
+    } else {
+        finished = rec;
+    }
+    last_finished = rec;
+    if (++num_finished > MAX_FINISHED_JOBS) {
+        reg_evict();
+    }
+    pthread_mutex_unlock(&registry_mutex);
+
+    /* answer the waiting clients outside the lock */
+    while (waiters) {
+        waiter_t *next = waiters->next;
+        if (!send_str(waiters->client_fd, buff)) {
+            fprintf(stderr, "error sending status of job %d\n", id);
+        }
+        close(waiters->client_fd);
+        free(waiters);
+        waiters = next;
+    }
+
+    return dependents;
+}
+
+/**
+ * record how a job ended and answer the clients waiting for it, then go
+ * on with the jobs held until it ended: a job is queued as soon as the
+ * last job it runs after ended as it asked, or cancelled as soon as one of
+ * them didn't, which cancels the jobs held by it in turn. Nothing polls,
+ * the held jobs are released by the end of the job itself
+ * @param rec record of the job, may be dropped afterwards
+ * @param state final state of the job
+ * @param status exit code, signal number or errno depending on state
+ * @param peak_mem highest memory sample of the job
+ * @param sketch memory samples of the job, kept with the record, NULL if none
+ */
+void reg_finish(job_record_t *rec, enum job_state state, int status, uint64_t peak_mem, const sketch_t *sketch) {
+    release_batch_t first = {.id = rec->id, .ok = state == job_exited && status == 0, .next = NULL};
+    release_batch_t *batches = &first;
+
+    /* cancelled jobs add their own held jobs, so a long chain doesn't recurse */
+    first.dependents = reg_end(rec, state, status, peak_mem, sketch);
+    while (batches) {
+        release_batch_t *a_batch = batches;
+        dependent_t *a_dependent = a_batch->dependents;
+
+        if (!a_dependent) {
+            batches = a_batch->next;
+            if (a_batch != &first) {
+                free(a_batch);
+            }
+            continue;
+        }
+        a_batch->dependents = a_dependent->next;
+
+        /* the held job may have been cancelled by another job it runs after */
+        cmd_t *held = NULL;
+        bool run = false;
+        pthread_mutex_lock(&registry_mutex);
+        job_record_t *dep = reg_find(a_dependent->id);
+        if (dep && dep->held && (a_batch->ok || a_dependent->any)) {
+            if (--dep->parents == 0) {
+                held = dep->held;
+                dep->held = NULL;
+                dep->state = job_queued;
+                run = true;
+            }
+        } else if (dep && dep->held) {
+            held = dep->held;
+            dep->held = NULL;
+        }
+        pthread_mutex_unlock(&registry_mutex);
+        int dep_id = a_dependent->id;
+        free(a_dependent);
+
+        if (held) {
+            release(dep, held, run);
+        }
+        if (held && !run) {
+            release_batch_t *cancelled = (release_batch_t *) malloc(sizeof(release_batch_t));
+            dependent_t *dependents = reg_end(dep, job_cancelled, a_batch->id, 0, NULL);
+            if (!cancelled) {
+                fprintf(stderr, "reg_finish: out of memory, jobs held by job %d stay held\n", dep_id);
+                continue;
+            }
+            cancelled->dependents = dependents;
+            cancelled->id = dep_id;
+            cancelled->ok = false;
+            cancelled->next = batches;
+            batches = cancelled;
+        }
+    }
+}
+
+/**
+ * hold a registered job until the jobs it runs after ended. after lists
+ * their ids, each followed by :ok (the default) to run only if that job
+ * exited with 0 or :any to run however it ended. A job can only run after
+ * jobs submitted before it, so the jobs and what they run after always
+ * form a graph without cycles. The job is listed on the record of every
+ * job it runs after which is still queued, held or running; the end of
+ * the last one releases it through the release callback
+ * @param rec record of the job, just registered
+ * @param after ids of the jobs it runs after, id[:ok|:any][,...]
+ * @param cmd_arg command of the job, kept by the registry while it is held
+ * @param failed receives the id of a job which already ended without exiting with 0
+ * @return how the job goes on, the caller keeps the command unless it is held
+ */
+enum reg_hold reg_hold(job_record_t *rec, const char *after, cmd_t *cmd_arg, int *failed) {
+    int ids[REG_MAX_AFTER];
+    bool any[REG_MAX_AFTER];
+    int count = 0;
+    char *end;
+
+    /* read the whole spec before holding anything */
+    do {
+        long id = strtol(after, &end, BASE10);
+        if (id <= 0 || id >= rec->id || count == REG_MAX_AFTER) {
+            return hold_invalid;
+        }
+        any[count] = strncmp(end, ":any", 4) == 0;
+        end += any[count] ? 4 : strncmp(end, ":ok", 3) == 0 ? 3 : 0;
+        if (*end && *end != ',') {
+            return hold_invalid;
+        }
+        ids[count++] = (int) id;
+        after = end + 1;
+    } while (*end);
+
+    pthread_mutex_lock(&registry_mutex);
+    for (int i = 0; i < count; i++) {
+        if (!reg_find(ids[i])) {
+            pthread_mutex_unlock(&registry_mutex);
+            return hold_invalid;
+        }
+    }
+
+    *failed = 0;
+    for (int i = 0; i < count && !*failed; i++) {
+        job_record_t *parent = reg_find(ids[i]);
+
+        if (parent->state == job_queued || parent->state == job_running || parent->state == job_held) {
+            dependent_t *a_dependent = (dependent_t *) malloc(sizeof(dependent_t));
+            if (!a_dependent) {
+                fprintf(stderr, "reg_hold: out of memory\n");
+                rec->parents = 0;
+                pthread_mutex_unlock(&registry_mutex);
+                return hold_invalid;
+            }
+            a_dependent->id = rec->id;
+            a_dependent->any = any[i];
+            a_dependent->next = parent->dependents;
+            parent->dependents = a_dependent;
+            rec->parents++;
+        } else if (!any[i] && (parent->state != job_exited || parent->status != 0)) {
+            *failed = parent->id;
+        }
+    }
+
+    /* the job listed on the jobs it runs after is skipped by them unless it is held */
+    enum reg_hold hold = *failed ? hold_cancelled : rec->parents ? hold_held : hold_ready;
+    if (hold == hold_held) {
+        rec->held = cmd_arg;
+        rec->state = job_held;
+    } else {
+        rec->parents = 0;
+    }
+    pthread_mutex_unlock(&registry_mutex);
+
+    return hold;
+}
+
+/**
+ * set the callback releasing held jobs
+ * @param on_release called once every job a held job runs after ended
+ */
+void reg_on_release(reg_release_t on_release) {
+    release = on_release;
+}
+
+/**
+ * process a wait for a job: a finished job is answered right away, the
+ * client of a queued or running job is parked on its record and answered
+ * by reg_finish, so nothing polls in between
+ * @param id job id
+ * @param client_fd client to send the status
+ * @return
+ *  true: if the client was parked, the registry closes it later
+ *  false: if the client was answered and may be closed
+ */
+bool reg_wait(int id, int client_fd) {
+    char buff[MAX_BUFFER];
+    job_record_t *rec;
+
+    pthread_mutex_lock(&registry_mutex);
+    if (!(rec = reg_find(id))) {
+        pthread_mutex_unlock(&registry_mutex);
+        send_str(client_fd, "error: no such job\n");
+        return false;
+    }
+
+    if (rec->state == job_queued || rec->state == job_running || rec->state == job_held) {
+        waiter_t *a_waiter = (waiter_t *) malloc(sizeof(waiter_t));
+        if (a_waiter) {
+            a_waiter->client_fd = client_fd;
+            a_waiter->next = rec->waiters;
+            rec->waiters = a_waiter;
+        }
+        pthread_mutex_unlock(&registry_mutex);
+
+        if (!a_waiter) {
+            send_str(client_fd, "error: out of memory\n");
+        }
+        return a_waiter != NULL;
+    }
+
+    reg_format(rec, buff);
+    pthread_mutex_unlock(&registry_mutex);
+
+    if (!send_str(client_fd, buff)) {
+        fprintf(stderr, "error sending status of job %d\n", id);
+    }
+    return false;
+}
+
+/**
+ * answer every parked client with an error and drop every record,
+ * called once the workers are stopped
+ */
+void reg_shutdown(void) {
+    pthread_mutex_lock(&registry_mutex);
+    for (int i = 0; i < REG_BUCKETS; i++) {
+        while (buckets[i]) {
+            job_record_t *rec = buckets[i];
+            buckets[i] = rec->hnext;
+
+            while (rec->waiters) {
+                waiter_t *a_waiter = rec->waiters;
+                rec->waiters = a_waiter->next;
+                send_str(a_waiter->client_fd, "error: overseer is shutting down\n");
+                close(a_waiter->client_fd);
+                free(a_waiter);
+            }
+            while (rec->dependents) {
+                dependent_t *a_dependent = rec->dependents;
+                rec->dependents = a_dependent->next;
+                free(a_dependent);
+            }
+            if (rec->held) {
+                release(rec, rec->held, false);
+            }
+            free(rec->sketch);
+            free(rec);
+        }
+    }
+    finished = last_finished = NULL;
+    num_finished = 0;
+    pthread_mutex_unlock(&registry_mutex);
+}
+
+/**
+ * find the record of a job
+ * @param id job id
+ * @return the record or NULL if unknown or already dropped
+ */
+job_record_t *reg_get(int id) {
+    job_record_t *rec;
+
+    pthread_mutex_lock(&registry_mutex);
+    rec = reg_find(id);
+    pthread_mutex_unlock(&registry_mutex);
+
+    return rec;
+}
+
+/**
+ * copy the memory sketch of a finished job
+ * @param id job id
+ * @param sketch receives the sketch
+ * @return
+ *  true: if the job finished after being sampled and its record is kept
+ *  false: otherwise
+ */
+bool reg_sketch(int id, sketch_t *sketch) {
+    job_record_t *rec;
+    bool found;
+
+    pthread_mutex_lock(&registry_mutex);
+    rec = reg_find(id);
+    if ((found = rec && rec->sketch)) {
+        *sketch = *rec->sketch;
+    }
+    pthread_mutex_unlock(&registry_mutex);
+
+    return found;
+}
+
+/**
+ * write one record and the descriptors of its parked clients
+ * @param state hot restart state
+ * @param rec record
+ */
+static void reg_save_record(FILE *state, job_record_t *rec) {
+    int num_waiters = 0, num_dependents = 0;
+
+    ho_put_int(state, rec->id);
+    ho_put_int(state, rec->pid);
+    ho_put_int(state, rec->state);
+    ho_put_int(state, rec->status);
+    ho_put_int(state, rec->start.tv_sec);
+    ho_put_int(state, rec->start.tv_nsec);
+    ho_put_int(state, rec->end.tv_sec);
+    ho_put_int(state, rec->end.tv_nsec);
+    ho_put_int(state, (int64_t) rec->peak_mem);
+    ho_put_int(state, rec->sketch != NULL);
+    if (rec->sketch) {
+        ho_put_sketch(state, rec->sketch);
+    }
+
+    for (waiter_t *a_waiter = rec->waiters; a_waiter; a_waiter = a_waiter->next) num_waiters++;
+    ho_put_int(state, num_waiters);
+    for (waiter_t *a_waiter = rec->waiters; a_waiter; a_waiter = a_waiter->next) {
+        ho_put_fd(state, a_waiter->client_fd);
+    }
+
+    /* a held job keeps its command, the jobs it runs after list it */
+    ho_put_int(state, rec->held != NULL);
+    if (rec->held) {
+        ho_put_int(state, rec->parents);
+        ho_put_cmd(state, rec->held);
+    }
+    for (dependent_t *a_dependent = rec->dependents; a_dependent; a_dependent = a_dependent->next) num_dependents++;
+    ho_put_int(state, num_dependents);
+    for (dependent_t *a_dependent = rec->dependents; a_dependent; a_dependent = a_dependent->next) {
+        ho_put_int(state, a_dependent->id);
+        ho_put_int(state, a_dependent->any);
+    }
+}
+
+/**
+ * write the registry into a hot restart state, once the workers are
+ * stopped: the last id, the queued, held and running records, then the
+ * finished ones oldest first. The parked clients stay open for the new image
+ * @param state hot restart state
+ */
+void reg_save(FILE *state) {
+    int num_active = 0;
+
+    pthread_mutex_lock(&registry_mutex);
+    ho_put_int(state, num_jobs);
+
+    for (int i = 0; i < REG_BUCKETS; i++) {
+        for (job_record_t *rec = buckets[i]; rec; rec = rec->hnext) {
+            if (rec->state == job_queued || rec->state == job_running || rec->state == job_held) num_active++;
+        }
+    }
+    ho_put_int(state, num_active);
+    for (int i = 0; i < REG_BUCKETS; i++) {
+        for (job_record_t *rec = buckets[i]; rec; rec = rec->hnext) {
+            if (rec->state == job_queued || rec->state == job_running || rec->state == job_held) {
+                reg_save_record(state, rec);
+            }
+        }
+    }
+
+    ho_put_int(state, num_finished);
+    for (job_record_t *rec = finished; rec; rec = rec->fnext) {
+        reg_save_record(state, rec);
+    }
+    pthread_mutex_unlock(&registry_mutex);
+}
+
+/**
+ * read one record and register it
+ * @param state hot restart state
+ * @return the record or NULL if out of memory
+ */
+static job_record_t *reg_load_record(FILE *state) {
+    job_record_t *rec = (job_record_t *) calloc(1, sizeof(job_record_t));
+    if (!rec) {
+        fprintf(stderr, "reg_load: out of memory\n");
+        return NULL;
+    }
+
+    rec->id = (int) ho_get_int(state);
+    rec->pid = (pid_t) ho_get_int(state);
+    rec->state = (enum job_state) ho_get_int(state);
+    rec->status = (int) ho_get_int(state);
+    rec->start.tv_sec = ho_get_int(state);
+    rec->start.tv_nsec = ho_get_int(state);
+    rec->end.tv_sec = ho_get_int(state);
+    rec->end.tv_nsec = ho_get_int(state);
+    rec->peak_mem = (uint64_t) ho_get_int(state);
+    if (ho_get_int(state)) {
+        sketch_t sketch;
+        ho_get_sketch(state, &sketch);
+        if ((rec->sketch = (sketch_t *) malloc(sizeof(sketch_t)))) {
+            *rec->sketch = sketch;
+        }
+    }
+
+    for (int n = (int) ho_get_int(state); n > 0; n--) {
+        int client_fd = ho_get_fd(state);
+        waiter_t *a_waiter = (waiter_t *) malloc(sizeof(waiter_t));
+        if (!a_waiter) {
+            close(client_fd);
+            continue;
+        }
+        a_waiter->client_fd = client_fd;
+        a_waiter->next = rec->waiters;
+        rec->waiters = a_waiter;
+    }
+
+    if (ho_get_int(state)) {
+        rec->parents = (int) ho_get_int(state);
+        rec->held = ho_get_cmd(state);
+    }
+    dependent_t **link = &rec->dependents;
+    for (int n = (int) ho_get_int(state); n > 0 && ho_ok(state); n--) {
+        dependent_t *a_dependent = (dependent_t *) malloc(sizeof(dependent_t));
+        int id = (int) ho_get_int(state);
+        bool any = ho_get_int(state) != 0;
+        if (!a_dependent) {
+            continue;
+        }
+        a_dependent->id = id;
+        a_dependent->any = any;
+        a_dependent->next = NULL;
+        *link = a_dependent;
+        link = &a_dependent->next;
+    }
+
+    rec->hnext = buckets[(unsigned) rec->id % REG_BUCKETS];
+    buckets[(unsigned) rec->id % REG_BUCKETS] = rec;
+    return rec;
+}
+
+/**
+ * read the registry written by reg_save, before any job is submitted
+ * @param state hot restart state
+ */
+void reg_load(FILE *state) {
+    pthread_mutex_lock(&registry_mutex);
+    num_jobs = (int) ho_get_int(state);
+
+    for (int n = (int) ho_get_int(state); n > 0 && ho_ok(state); n--) {
+        reg_load_record(state);
+    }
+
+    for (int n = (int) ho_get_int(state); n > 0 && ho_ok(state); n--) {
+        job_record_t *rec = reg_load_record(state);
+        if (!rec) continue;
+
+        if (last_finished) {
+            last_finished->fnext = rec;
+        } else {
+            finished = rec;
+        }
+        last_finished = rec;
+        num_finished++;
+    }
+    pthread_mutex_unlock(&registry_mutex);
+}
@@ -0,0 +1,98 @@
+#ifndef PROCESS_OVERSEER_REGISTRY_H
+#define PROCESS_OVERSEER_REGISTRY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/types.h>
+#include <time.h>
+#include <sketch.h>
+#include <helpers.h>
+
+#define REG_BUCKETS 1024 /* buckets of the job id hash table */
+#define MAX_FINISHED_JOBS 4096 /* finished jobs kept before the oldest is dropped */
+#define REG_MAX_AFTER 32 /* most jobs a job runs after */
+
+/* state of a job in the registry */
+enum job_state {
+    job_queued, job_running, job_exited, job_signaled, job_failed, job_cancelled,
+    job_held /* submitted with -after, waiting for the jobs it runs after */
+};
+
+/* how a job submitted with -after goes on */
+enum reg_hold {
+    hold_invalid, /* the spec is wrong or names an unknown job, nothing is held */
+    hold_ready, /* every job it runs after already ended as asked, it can be queued */
+    hold_held, /* held until the jobs it runs after end */
+    hold_cancelled /* a job it runs after already failed, it must not run */
+};
+
+/* client blocked in wait until a job ends */
+typedef struct waiter {
+    int client_fd; /* socket the status is sent to */
+    struct waiter *next;
+} waiter_t;
+
+/* job held until the job whose record lists it ends */
+typedef struct dependent {
+    int id; /* id of the held job, its record may be gone by then */
+    bool any; /* released however the job ended, otherwise only if it exited with 0 */
+    struct dependent *next;
+} dependent_t;
+
+/* status and timing of one submitted job */
+typedef struct job_record {
+    int id; /* job id returned to the client */
+    pid_t pid; /* pid once running */
+    enum job_state state;
+    int status; /* exit code, signal number, errno or failed job a cancelled job ran after */
+    struct timespec start, end; /* monotonic start and end of the run */
+    uint64_t peak_mem; /* highest memory sample */
+    sketch_t *sketch; /* memory samples of the finished job, NULL if it was never sampled */
+    waiter_t *waiters; /* clients waiting for the job to end */
+    cmd_t *held; /* command of a held job, NULL otherwise */
+    int parents; /* jobs a held job still waits for */
+    dependent_t *dependents; /* held jobs waiting for this one */
+    struct job_record *hnext; /* next record in the hash bucket */
+    struct job_record *fnext; /* next finished record, oldest first */
+} job_record_t;
+
+/* called once every job a held job runs after ended: run it, or drop its
+ * command if one of them failed (the job is then cancelled) */
+typedef void (*reg_release_t)(job_record_t *, cmd_t *held, bool run);
+
+/* register a queued job and give it an id */
+job_record_t *reg_add(void);
+
+/* mark a registered job as running */
+void reg_start(job_record_t *, pid_t);
+
+/* record how a job ended and answer its waiters, the record may be dropped afterwards */
+void reg_finish(job_record_t *, enum job_state, int status, uint64_t peak_mem, const sketch_t *);
+
+/* hold a registered job until the jobs of after, id[:ok|:any][,...], ended; failed receives the id of
+ * a job which already failed */
+enum reg_hold reg_hold(job_record_t *, const char *after, cmd_t *cmd_arg, int *failed);
+
+/* set the callback releasing held jobs, before any job is held */
+void reg_on_release(reg_release_t);
+
+/* answer a wait for the given job id now or once it ends, true if the client was parked */
+bool reg_wait(int id, int client_fd);
+
+/* answer every parked client with an error and drop every record */
+void reg_shutdown(void);
+
+/* find the record of a job id, NULL if unknown */
+job_record_t *reg_get(int id);
+
+/* copy the memory sketch of a finished job, false if unknown, unfinished or never sampled */
+bool reg_sketch(int id, sketch_t *);
+
+/* write every record and its parked clients into a hot restart state */
+void reg_save(FILE *);
+
+/* read the records of a hot restart state */
+void reg_load(FILE *);
+
+#endif //PROCESS_OVERSEER_REGISTRY_H
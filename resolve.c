@@ -0,0 +1,232 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <netdb.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/stat.h>
+#include <resolve.h>
+
+/**
+ * parse an IPv4 or IPv6 literal, the IPv6 one possibly in brackets
+ * @param host address literal
+ * @param port port of the address
+ * @param addr receives the address
+ * @return
+ *  true: if host is a literal
+ *  false: if it is a name
+ */
+static bool rs_numeric(const char *host, uint16_t port, struct sockaddr_storage *addr) {
+    struct sockaddr_in *in = (struct sockaddr_in *) addr;
+    struct sockaddr_in6 *in6 = (struct sockaddr_in6 *) addr;
+    char literal[INET6_ADDRSTRLEN];
+    size_t len = strlen(host);
+
+    memset(addr, 0, sizeof(*addr));
+    if (inet_pton(AF_INET, host, &in->sin_addr) == 1) {
+        in->sin_family = AF_INET;
+        in->sin_port = htons(port);
+        return true;
+    }
+
+    if (host[0] == '[' && len > 2 && host[len - 1] == ']' && len - 2 < sizeof(literal)) {
+        memcpy(literal, host + 1, len - 2);
+        literal[len - 2] = '\0';
+        host = literal;
+    }
+    if (inet_pton(AF_INET6, host, &in6->sin6_addr) == 1) {
+        in6->sin6_family = AF_INET6;
+        in6->sin6_port = htons(port);
+        return true;
+    }
+
+    return false;
+}
+
+/**
+ * find the cache of resolved names of the user
+ * @param path receives the path
+ * @param len size of path
+ * @param create create $HOME/.cache if it is missing
+ * @return
+ *  true: if the user has a place for the cache
+ *  false: if neither $XDG_RUNTIME_DIR nor $HOME is set
+ */
+static bool rs_cache_path(char *path, size_t len, bool create) {
+    const char *dir = getenv("XDG_RUNTIME_DIR");
+
+    if (dir && dir[0]) {
+        return snprintf(path, len, "%s/%s", dir, RS_CACHE_FILE) < (int) len;
+    }
+    if (!(dir = getenv("HOME")) || !dir[0] || snprintf(path, len, "%s/.cache", dir) >= (int) len) {
+        return false;
+    }
+    if (create) {
+        mkdir(path, 0700);
+    }
+    return snprintf(path, len, "%s/.cache/%s", dir, RS_CACHE_FILE) < (int) len;
+}
+
+/**
+ * look a name up in the cache, lines of expiry time, name and address. It
+ * is read with a single read and no stdio, which costs more than the rest
+ * of the lookup on the first use in a process
+ * @param host name
+ * @param port port of the address
+ * @param addr receives the address
+ * @return
+ *  true: if the name was cached and hasn't expired
+ *  false: otherwise
+ */
+static bool rs_cache_get(const char *host, uint16_t port, struct sockaddr_storage *addr) {
+    char path[256], buf[RS_MAX_ENTRIES * 320], *line, *end;
+    size_t host_len = strlen(host);
+    time_t now = time(NULL);
+    ssize_t len;
+    int fd;
+
+    if (!rs_cache_path(path, sizeof(path), false) || (fd = open(path, O_RDONLY | O_CLOEXEC)) == -1) {
+        return false;
+    }
+    len = read(fd, buf, sizeof(buf) - 1);
+    close(fd);
+    if (len <= 0) {
+        return false;
+    }
+    buf[len] = '\0';
+
+    for (line = buf; line && *line; line = end ? end + 1 : NULL) {
+        if ((end = strchr(line, '\n'))) {
+            *end = '\0';
+        }
+
+        char *name = strchr(line, ' '), *literal;
+        if (!name || strtol(line, NULL, 10) <= now || strncmp(++name, host, host_len) != 0 ||
+            name[host_len] != ' ') {
+            continue;
+        }
+        literal = name + host_len + 1;
+        return rs_numeric(literal, port, addr);
+    }
+
+    return false;
+}
+
+/**
+ * add a name to the cache. The live entries of other names are kept, up
+ * to RS_MAX_ENTRIES with the newest, and the cache is replaced at once so
+ * concurrent controllers never read half of it
+ * @param host name
+ * @param addr its address
+ */
+static void rs_cache_put(const char *host, const struct sockaddr_storage *addr) {
+    char path[256], tmp[300], line[512], name[256], literal[RS_ADDRSTRLEN];
+    char *lines[RS_MAX_ENTRIES];
+    int count = 0, fd;
+    time_t now = time(NULL);
+    long expiry;
+    FILE *cache;
+
+    if (strlen(host) >= sizeof(name) || strchr(host, ' ') || !rs_cache_path(path, sizeof(path), true)) {
+        return;
+    }
+
+    if ((cache = fopen(path, "re"))) {
+        while (fgets(line, sizeof(line), cache)) {
+            if (sscanf(line, "%ld %255s", &expiry, name) != 2 || expiry <= now || strcmp(name, host) == 0) {
+                continue;
+            }
+            if (count == RS_MAX_ENTRIES - 1) {
+                free(lines[0]);
+                memmove(lines, lines + 1, sizeof(char *) * --count);
+            }
+            lines[count++] = strdup(line);
+        }
+        fclose(cache);
+    }
+
+    snprintf(tmp, sizeof(tmp), "%s.%d", path, getpid());
+    if ((fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600)) != -1 && (cache = fdopen(fd, "w"))) {
+        for (int i = 0; i < count; i++) {
+            fputs(lines[i], cache);
+        }
+        rs_format(addr, literal);
+        fprintf(cache, "%ld %s %s\n", (long) now + RS_TTL, host, literal);
+        if (fclose(cache) == 0) {
+            rename(tmp, path);
+        } else {
+            unlink(tmp);
+        }
+    } else if (fd != -1) {
+        close(fd);
+        unlink(tmp);
+    }
+
+    for (int i = 0; i < count; i++) {
+        free(lines[i]);
+    }
+}
+
+/**
+ * resolve the address of an overseer. Literals are parsed without asking
+ * the resolver, names are looked up in a cache of the user first, so most
+ * runs of a controller make no NSS or DNS query at all
+ * @param host IPv4 or IPv6 literal, or host name
+ * @param port port of the overseer
+ * @param addr receives the address
+ * @return
+ *  true: if the host was resolved
+ *  false: if it is unknown
+ */
+bool rs_resolve(const char *host, uint16_t port, struct sockaddr_storage *addr) {
+    struct addrinfo hints = {.ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM}, *result;
+
+    if (rs_numeric(host, port, addr) || rs_cache_get(host, port, addr)) {
+        return true;
+    }
+
+    if (getaddrinfo(host, NULL, &hints, &result) != 0) {
+        return false;
+    }
+    memset(addr, 0, sizeof(*addr));
+    memcpy(addr, result->ai_addr, result->ai_addrlen);
+    freeaddrinfo(result);
+
+    if (addr->ss_family == AF_INET6) {
+        ((struct sockaddr_in6 *) addr)->sin6_port = htons(port);
+    } else {
+        ((struct sockaddr_in *) addr)->sin_port = htons(port);
+    }
+    rs_cache_put(host, addr);
+
+    return true;
+}
+
+/**
+ * get the length of an address
+ * @param addr IPv4 or IPv6 address
+ * @return the size of its sockaddr
+ */
+socklen_t rs_len(const struct sockaddr_storage *addr) {
+    return addr->ss_family == AF_INET6 ? sizeof(struct sockaddr_in6) : sizeof(struct sockaddr_in);
+}
+
+/**
+ * write an address without its port
+ * @param addr IPv4 or IPv6 address
+ * @param buf receives the address, RS_ADDRSTRLEN bytes
+ */
+void rs_format(const struct sockaddr_storage *addr, char *buf) {
+    const struct sockaddr_in6 *in6 = (const struct sockaddr_in6 *) addr;
+
+    if (addr->ss_family == AF_INET6 && IN6_IS_ADDR_V4MAPPED(&in6->sin6_addr)) {
+        inet_ntop(AF_INET, in6->sin6_addr.s6_addr + 12, buf, RS_ADDRSTRLEN);
+    } else if (addr->ss_family == AF_INET6) {
+        inet_ntop(AF_INET6, &in6->sin6_addr, buf, RS_ADDRSTRLEN);
+    } else {
+        inet_ntop(AF_INET, &((const struct sockaddr_in *) addr)->sin_addr, buf, RS_ADDRSTRLEN);
+    }
+}
@@ -0,0 +1,23 @@
+#ifndef PROCESS_OVERSEER_RESOLVE_H
+#define PROCESS_OVERSEER_RESOLVE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/socket.h>
+
+#define RS_TTL 300 /* seconds a resolved name is kept in the cache */
+#define RS_MAX_ENTRIES 64 /* names kept in the cache, the oldest are dropped */
+#define RS_CACHE_FILE "overseer-hosts" /* cache in $XDG_RUNTIME_DIR, or in $HOME/.cache */
+#define RS_ADDRSTRLEN 64 /* longest address written by rs_format */
+
+/* resolve an IPv4 or IPv6 literal, then a cached name, then ask the resolver and cache its answer */
+bool rs_resolve(const char *host, uint16_t port, struct sockaddr_storage *addr);
+
+/* length of an address of either family, as given to connect and bind */
+socklen_t rs_len(const struct sockaddr_storage *addr);
+
+/* write an address without its port, an IPv4 mapped address as IPv4 */
+void rs_format(const struct sockaddr_storage *addr, char *buf);
+
+#endif //PROCESS_OVERSEER_RESOLVE_H
@@ -0,0 +1,233 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <inttypes.h>
+#include <sketch.h>
+
+#define LOG_GAMMA 0.028854862672185 /* log2((1 + SK_ACCURACY) / (1 - SK_ACCURACY)) */
+
+/**
+ * get the bucket of a value
+ * @param value value, at least 1
+ * @return the index i with gamma^(i-1) < value <= gamma^i
+ */
+static int sk_index(uint64_t value) {
+    return (int) ceil(log2((double) value) / LOG_GAMMA);
+}
+
+/**
+ * get the value a bucket stands for, within SK_ACCURACY of every value it counts
+ * @param index bucket index
+ * @return the value
+ */
+static uint64_t sk_value(int index) {
+    return (uint64_t) (2.0 * exp2(index * LOG_GAMMA) / (1.0 + exp2(LOG_GAMMA)));
+}
+
+/**
+ * empty a sketch
+ * @param sk sketch
+ */
+void sk_init(sketch_t *sk) {
+    memset(sk, 0, sizeof(sketch_t));
+}
+
+/**
+ * count values in a bucket, moving the buckets when it is out of their
+ * span: up by collapsing the lowest buckets into the first one kept, down
+ * as far as the largest value allows, the values below being counted in the
+ * lowest bucket
+ * @param sk sketch
+ * @param index bucket index
+ * @param n number of values
+ */
+static void sk_put(sketch_t *sk, int index, uint64_t n) {
+    if (sk->count == sk->zeros) {
+        /* first bucket used, room on both sides */
+        memset(sk->counts, 0, sizeof(sk->counts));
+        sk->offset = index - SK_BUCKETS / 2;
+    } else if (index >= sk->offset + SK_BUCKETS) {
+        int shift = index - (sk->offset + SK_BUCKETS - 1);
+        uint64_t low = 0;
+        for (int i = 0; i < SK_BUCKETS && i <= shift; i++) {
+            low += sk->counts[i];
+        }
+        if (shift < SK_BUCKETS) {
+            memmove(sk->counts, sk->counts + shift, (SK_BUCKETS - shift) * sizeof(uint32_t));
+            memset(sk->counts + SK_BUCKETS - shift, 0, shift * sizeof(uint32_t));
+        } else {
+            memset(sk->counts, 0, sizeof(sk->counts));
+        }
+        sk->counts[0] = low > UINT32_MAX ? UINT32_MAX : (uint32_t) low;
+        sk->offset += shift;
+    } else if (index < sk->offset) {
+        int highest = sk_index(sk->max), offset = index;
+        if (offset < highest - SK_BUCKETS + 1) {
+            offset = highest - SK_BUCKETS + 1;
+        }
+        if (offset < sk->offset) {
+            int shift = sk->offset - offset;
+            memmove(sk->counts + shift, sk->counts, (SK_BUCKETS - shift) * sizeof(uint32_t));
+            memset(sk->counts, 0, shift * sizeof(uint32_t));
+            sk->offset = offset;
+        }
+        if (index < sk->offset) {
+            index = sk->offset;
+        }
+    }
+
+    uint64_t count = sk->counts[index - sk->offset] + n;
+    sk->counts[index - sk->offset] = count > UINT32_MAX ? UINT32_MAX : (uint32_t) count;
+    sk->count += n;
+}
+
+/**
+ * add a value
+ * @param sk sketch
+ * @param value value
+ */
+void sk_add(sketch_t *sk, uint64_t value) {
+    if (value == 0) {
+        sk->zeros++;
+        sk->count++;
+    } else {
+        sk_put(sk, sk_index(value), 1);
+    }
+
+    if (sk->count == 1 || value < sk->min) {
+        sk->min = value;
+    }
+    if (value > sk->max) {
+        sk->max = value;
+    }
+}
+
+/**
+ * add every value of a sketch to another, bucket by bucket from the lowest
+ * @param dst sketch receiving the values
+ * @param src sketch whose values are added
+ */
+void sk_merge(sketch_t *dst, const sketch_t *src) {
+    if (!src->count) {
+        return;
+    }
+
+    uint64_t min = dst->count ? (src->min < dst->min ? src->min : dst->min) : src->min;
+    for (int i = 0; i < SK_BUCKETS; i++) {
+        if (src->counts[i]) {
+            sk_put(dst, src->offset + i, src->counts[i]);
+        }
+    }
+    dst->zeros += src->zeros;
+    dst->count += src->zeros;
+    dst->min = min;
+    if (src->max > dst->max) {
+        dst->max = src->max;
+    }
+}
+
+/**
+ * get a quantile, the value with a fraction q of the values below it
+ * @param sk sketch
+ * @param q fraction from 0 to 1
+ * @return the quantile within SK_ACCURACY, the exact min and max at 0 and 1
+ */
+uint64_t sk_quantile(const sketch_t *sk, double q) {
+    if (!sk->count) {
+        return 0;
+    }
+    if (q <= 0) {
+        return sk->min;
+    }
+    if (q >= 1) {
+        return sk->max;
+    }
+
+    double rank = q * (double) (sk->count - 1);
+    uint64_t seen = sk->zeros;
+    if ((double) seen > rank) {
+        return 0;
+    }
+    for (int i = 0; i < SK_BUCKETS; i++) {
+        seen += sk->counts[i];
+        if ((double) seen > rank) {
+            uint64_t value = sk_value(sk->offset + i);
+            return value < sk->min ? sk->min : value > sk->max ? sk->max : value;
+        }
+    }
+
+    return sk->max;
+}
+
+/**
+ * write the summary of a sketch: its median, 95th and 99th percentiles,
+ * largest value and number of values
+ * @param sk sketch
+ * @param buf receives the summary, 128 bytes are enough
+ * @return the length of the summary
+ */
+int sk_summary(const sketch_t *sk, char *buf) {
+    return sprintf(buf, "%" PRIu64 " %" PRIu64 " %" PRIu64 " %" PRIu64 " %" PRIu64, sk_quantile(sk, 0.5),
+                   sk_quantile(sk, 0.95), sk_quantile(sk, 0.99), sk->max, sk->count);
+}
+
+/**
+ * write a sketch as text without spaces: count/zeros/min/max/offset then
+ * index:count of every bucket used, separated by commas
+ * @param sk sketch
+ * @param buf receives the text, SK_ENCODED bytes
+ * @return the length of the text
+ */
+size_t sk_encode(const sketch_t *sk, char *buf) {
+    size_t len = sprintf(buf, "%" PRIu64 "/%" PRIu64 "/%" PRIu64 "/%" PRIu64 "/%" PRId32, sk->count, sk->zeros,
+                         sk->min, sk->max, sk->offset);
+
+    for (int i = 0; i < SK_BUCKETS; i++) {
+        if (sk->counts[i]) {
+            len += sprintf(buf + len, ",%d:%" PRIu32, i, sk->counts[i]);
+        }
+    }
+
+    return len;
+}
+
+/**
+ * read a sketch written by sk_encode
+ * @param sk receives the sketch
+ * @param text text of the sketch
+ * @param end receives the first character after the sketch
+ * @return
+ *  true: if the text is a sketch
+ *  false: otherwise
+ */
+bool sk_decode(sketch_t *sk, const char *text, char **end) {
+    uint64_t *fields[] = {&sk->count, &sk->zeros, &sk->min, &sk->max};
+    char *next = (char *) text;
+
+    sk_init(sk);
+    for (int i = 0; i < 4; i++) {
+        *fields[i] = strtoull(text, &next, 10);
+        if (next == text || *next != '/') {
+            return false;
+        }
+        text = next + 1;
+    }
+    sk->offset = (int32_t) strtol(text, &next, 10);
+    if (next == text) {
+        return false;
+    }
+
+    while (*next == ',') {
+        text = next + 1;
+        long i = strtol(text, &next, 10);
+        if (next == text || *next != ':' || i < 0 || i >= SK_BUCKETS) {
+            return false;
+        }
+        text = next + 1;
+        sk->counts[i] = (uint32_t) strtoul(text, &next, 10);
+    }
+
+    *end = next;
+    return true;
+}
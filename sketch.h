@@ -0,0 +1,46 @@
+#ifndef PROCESS_OVERSEER_SKETCH_H
+#define PROCESS_OVERSEER_SKETCH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define SK_ACCURACY 0.01 /* relative error of a quantile */
+#define SK_BUCKETS 256 /* buckets of a sketch, they span a ratio of about 166 between values */
+#define SK_ENCODED (SK_BUCKETS * 22 + 96) /* longest text form of a sketch */
+
+/* quantile sketch of a stream of values with a fixed size: value v is
+ * counted in the bucket i with gamma^(i-1) < v <= gamma^i, gamma being
+ * (1 + SK_ACCURACY) / (1 - SK_ACCURACY), so every quantile is known within
+ * SK_ACCURACY of its value. The buckets cover the largest values, those
+ * below the lowest bucket are counted in it */
+typedef struct sketch {
+    uint64_t count; /* values added */
+    uint64_t zeros; /* values of 0, kept out of the buckets */
+    uint64_t min, max; /* exact smallest and largest value */
+    int32_t offset; /* bucket index of counts[0] */
+    uint32_t counts[SK_BUCKETS]; /* values per bucket, saturating */
+} sketch_t;
+
+/* empty a sketch */
+void sk_init(sketch_t *);
+
+/* add a value, O(1) */
+void sk_add(sketch_t *, uint64_t value);
+
+/* add every value of src to dst */
+void sk_merge(sketch_t *dst, const sketch_t *src);
+
+/* get the q quantile (0 to 1), 0 if the sketch is empty */
+uint64_t sk_quantile(const sketch_t *, double q);
+
+/* write the p50, p95, p99, peak and count of a sketch separated by spaces, returns the length */
+int sk_summary(const sketch_t *, char *buf);
+
+/* write a sketch as a single word of text into buf of SK_ENCODED bytes, returns its length */
+size_t sk_encode(const sketch_t *, char *buf);
+
+/* read a sketch written by sk_encode, end receives where it stopped */
+bool sk_decode(sketch_t *, const char *text, char **end);
+
+#endif //PROCESS_OVERSEER_SKETCH_H
@@ -0,0 +1,349 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <poll.h>
+#include <memory.h>
+#include <sys/timerfd.h>
+#include <sys/eventfd.h>
+#include <timer_wheel.h>
+
+#define TW_ROOT_MASK (TW_ROOT_SIZE - 1)
+#define TW_LEVEL_MASK (TW_LEVEL_SIZE - 1)
+
+/* wheel thread loop */
+static void *tw_loop(void *);
+
+/**
+ * arm or disarm the timerfd so the wheel only ticks while timers are pending
+ * @param tw timer wheel
+ * @param on true to start ticking, false to stop
+ */
+static void tw_arm(timer_wheel_t *tw, bool on) {
+    struct itimerspec its;
+    memset(&its, 0, sizeof(its));
+
+    if (on) {
+        its.it_interval.tv_nsec = TW_TICK_MS * 1000000L;
+        its.it_value = its.it_interval;
+    }
+
+    if (timerfd_settime(tw->timer_fd, 0, &its, NULL) == -1) {
+        perror("timerfd_settime");
+        return;
+    }
+    tw->armed = on;
+}
+
+/**
+ * link a timer into the slot matching its expiry, caller holds the lock
+ * @param tw timer wheel
+ * @param t timer to link
+ */
+static void tw_link(timer_wheel_t *tw, timer_node_t *t) {
+    uint64_t expires = t->expires;
+    uint64_t idx = expires - tw->now;
+    timer_node_t **slot;
+
+    if ((int64_t) idx < 0) { /* already due, fire on the next tick */
+        slot = &tw->root[tw->now & TW_ROOT_MASK];
+    } else if (idx < TW_ROOT_SIZE) {
+        slot = &tw->root[expires & TW_ROOT_MASK];
+    } else {
+        int lvl = 0;
+        while (lvl < TW_LEVELS - 1 && idx >= 1ULL << (TW_ROOT_BITS + (lvl + 1) * TW_LEVEL_BITS)) {
+            lvl++;
+        }
+        int shift = TW_ROOT_BITS + lvl * TW_LEVEL_BITS;
+        slot = &tw->level[lvl][(expires >> shift) & TW_LEVEL_MASK];
+    }
+
+    t->next = *slot;
+    if (t->next) {
+        t->next->pprev = &t->next;
+    }
+    t->pprev = slot;
+    *slot = t;
+    t->pending = true;
+}
+
+/**
+ * unlink a pending timer from its slot, caller holds the lock
+ * @param t timer to unlink
+ */
+static void tw_unlink(timer_node_t *t) {
+    *t->pprev = t->next;
+    if (t->next) {
+        t->next->pprev = t->pprev;
+    }
+    t->next = NULL;
+    t->pprev = NULL;
+    t->pending = false;
+}
+
+/**
+ * move every timer of an upper level slot down to the level it now belongs to
+ * @param tw timer wheel
+ * @param lvl upper level index
+ * @param index slot index within that level
+ * @return the slot index, a zero means the next level must cascade as well
+ */
+static int tw_cascade(timer_wheel_t *tw, int lvl, int index) {
+    timer_node_t *t = tw->level[lvl][index];
+    tw->level[lvl][index] = NULL;
+
+    while (t) {
+        timer_node_t *next = t->next;
+        tw_link(tw, t);
+        t = next;
+    }
+
+    return index;
+}
+
+/**
+ * advance the wheel by the given number of ticks and fire expired timers
+ * @param tw timer wheel
+ * @param ticks number of elapsed ticks
+ */
+static void tw_advance(timer_wheel_t *tw, uint64_t ticks) {
+    pthread_mutex_lock(&tw->lock);
+
+    while (ticks-- && tw->count) {
+        int index = tw->now & TW_ROOT_MASK;
+
+        /* refill the root level from the levels above when it wraps */
+        if (!index) {
+            for (int lvl = 0; lvl < TW_LEVELS; lvl++) {
+                int shift = TW_ROOT_BITS + lvl * TW_LEVEL_BITS;
+                if (tw_cascade(tw, lvl, (tw->now >> shift) & TW_LEVEL_MASK)) {
+                    break;
+                }
+            }
+        }
+        tw->now++;
+
+        /* fire the slot, callbacks run unlocked so they can re-arm timers */
+        timer_node_t *t;
+        while ((t = tw->root[index])) {
+            tw_unlink(t);
+            tw->count--;
+            tw->running = t;
+            pthread_mutex_unlock(&tw->lock);
+
+            t->cb(t->arg);
+
+            pthread_mutex_lock(&tw->lock);
+            tw->running = NULL;
+            pthread_cond_broadcast(&tw->done);
+        }
+    }
+
+    /* stop ticking once nothing is left to fire */
+    if (!tw->count && tw->armed) {
+        tw_arm(tw, false);
+    }
+
+    pthread_mutex_unlock(&tw->lock);
+}
+
+/**
+ * initialise the wheel and start the thread driving it
+ * @param tw timer wheel
+ * @return
+ *  true: if the wheel is running
+ *  false: if the descriptors or thread could not be created
+ */
+bool tw_start(timer_wheel_t *tw) {
+    memset(tw, 0, sizeof(*tw));
+    pthread_mutex_init(&tw->lock, NULL);
+    pthread_cond_init(&tw->done, NULL);
+
+    if ((tw->timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC)) == -1) {
+        perror("timerfd_create");
+        return false;
+    }
+
+    if ((tw->event_fd = eventfd(0, EFD_CLOEXEC)) == -1) {
+        perror("eventfd");
+        close(tw->timer_fd);
+        return false;
+    }
+
+    if (pthread_create(&tw->thread, NULL, tw_loop, tw)) {
+        fprintf(stderr, "tw_start: could not create wheel thread\n");
+        close(tw->timer_fd);
+        close(tw->event_fd);
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * stop the wheel thread, pending timers are dropped without firing
+ * @param tw timer wheel
+ */
+void tw_stop(timer_wheel_t *tw) {
+    uint64_t one = 1;
+
+    pthread_mutex_lock(&tw->lock);
+    tw->stop = true;
+    pthread_mutex_unlock(&tw->lock);
+
+    if (write(tw->event_fd, &one, sizeof(one)) != sizeof(one)) {
+        perror("write eventfd");
+    }
+    pthread_join(tw->thread, NULL);
+
+    close(tw->timer_fd);
+    close(tw->event_fd);
+}
+
+/**
+ * (re)arm a timer, safe to call from a callback on its own timer
+ * @param tw timer wheel
+ * @param t timer owned by the caller
+ * @param ms delay in milliseconds, clamped to the range of the wheel
+ * @param cb callback to fire
+ * @param arg argument passed to the callback
+ */
+void tw_add(timer_wheel_t *tw, timer_node_t *t, unsigned long ms, timer_cb cb, void *arg) {
+    uint64_t ticks = (ms + TW_TICK_MS - 1) / TW_TICK_MS;
+    if (!ticks) {
+        ticks = 1;
+    } else if (ticks > TW_MAX_TICKS) {
+        ticks = TW_MAX_TICKS;
+    }
+
+    pthread_mutex_lock(&tw->lock);
+
+    if (t->pending) {
+        tw_unlink(t);
+        tw->count--;
+    }
+
+    t->cb = cb;
+    t->arg = arg;
+    t->expires = tw->now + ticks;
+    tw_link(tw, t);
+    tw->count++;
+
+    if (!tw->armed) {
+        tw_arm(tw, true);
+    }
+
+    pthread_mutex_unlock(&tw->lock);
+}
+
+/**
+ * get the time left before a timer fires, once its callback is done if it
+ * is running. Used to carry timers over a hot restart
+ * @param tw wheel
+ * @param t timer
+ * @return milliseconds left, -1 if the timer is not pending
+ */
+long tw_remaining(timer_wheel_t *tw, timer_node_t *t) {
+    long ms = -1;
+
+    pthread_mutex_lock(&tw->lock);
+
+    while (tw->running == t) {
+        pthread_cond_wait(&tw->done, &tw->lock);
+    }
+    if (t->pending) {
+        ms = (long) (t->expires - tw->now) * TW_TICK_MS;
+    }
+
+    pthread_mutex_unlock(&tw->lock);
+    return ms;
+}
+
+/**
+ * cancel a timer, once this returns its callback is neither pending nor
+ * running so the owner may free it. Must not be called from its own callback.
+ * @param tw timer wheel
+ * @param t timer to cancel
+ */
+void tw_cancel(timer_wheel_t *tw, timer_node_t *t) {
+    pthread_mutex_lock(&tw->lock);
+
+    if (t->pending) {
+        tw_unlink(t);
+        tw->count--;
+    }
+
+    while (tw->running == t) {
+        pthread_cond_wait(&tw->done, &tw->lock);
+    }
+
+    /* the callback may have re-armed the timer before returning */
+    if (t->pending) {
+        tw_unlink(t);
+        tw->count--;
+    }
+
+    pthread_mutex_unlock(&tw->lock);
+}
+
+/**
+ * cancel a timer and tell how long it had left, in one go so it can't
+ * fire in between. Its callback and argument are kept, tw_add re-arms it
+ * with them. Must not be called from its own callback.
+ * @param tw timer wheel
+ * @param t timer to pause
+ * @return milliseconds left before it would have fired, -1 if it was not pending
+ */
+long tw_pause(timer_wheel_t *tw, timer_node_t *t) {
+    long ms = -1;
+
+    pthread_mutex_lock(&tw->lock);
+
+    while (tw->running == t) {
+        pthread_cond_wait(&tw->done, &tw->lock);
+    }
+    if (t->pending) {
+        ms = (long) (t->expires - tw->now) * TW_TICK_MS;
+        tw_unlink(t);
+        tw->count--;
+    }
+
+    pthread_mutex_unlock(&tw->lock);
+    return ms;
+}
+
+/**
+ * wait on the timerfd and advance the wheel by the number of elapsed ticks
+ * @param data the timer wheel
+ * @return NULL
+ */
+static void *tw_loop(void *data) {
+    timer_wheel_t *tw = data;
+    struct pollfd fds[2] = {
+            {.fd = tw->timer_fd, .events = POLLIN},
+            {.fd = tw->event_fd, .events = POLLIN}
+    };
+
+    while (true) {
+        if (poll(fds, 2, -1) == -1) {
+            continue; /* interrupted by a signal */
+        }
+
+        if (fds[1].revents & POLLIN) {
+            pthread_mutex_lock(&tw->lock);
+            bool stop = tw->stop;
+            pthread_mutex_unlock(&tw->lock);
+            if (stop) {
+                break;
+            }
+        }
+
+        if (fds[0].revents & POLLIN) {
+            uint64_t ticks;
+            if (read(tw->timer_fd, &ticks, sizeof(ticks)) == sizeof(ticks)) {
+                tw_advance(tw, ticks);
+            }
+        }
+    }
+
+    return NULL;
+}
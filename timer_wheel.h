@@ -0,0 +1,63 @@
+#ifndef PROCESS_OVERSEER_TIMER_WHEEL_H
+#define PROCESS_OVERSEER_TIMER_WHEEL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#define TW_TICK_MS 100 /* resolution of the wheel in milliseconds */
+#define TW_ROOT_BITS 8 /* the first level holds the next 256 ticks */
+#define TW_LEVEL_BITS 6 /* every upper level holds 64 slots */
+#define TW_LEVELS 3 /* number of levels above the first one */
+#define TW_ROOT_SIZE (1 << TW_ROOT_BITS)
+#define TW_LEVEL_SIZE (1 << TW_LEVEL_BITS)
+#define TW_MAX_TICKS ((1ULL << (TW_ROOT_BITS + TW_LEVELS * TW_LEVEL_BITS)) - 1)
+
+/* callback fired from the wheel thread when a timer expires */
+typedef void (*timer_cb)(void *arg);
+
+/* a timer embedded in its owner, the wheel never allocates */
+typedef struct timer_node {
+    uint64_t expires; /* tick at which the timer fires */
+    timer_cb cb; /* function to call */
+    void *arg; /* argument for the callback */
+    bool pending; /* timer is linked into a slot */
+    struct timer_node *next; /* next timer in the slot */
+    struct timer_node **pprev; /* link pointing at this timer */
+} timer_node_t;
+
+/* hierarchical timer wheel driven by a timerfd */
+typedef struct timer_wheel {
+    pthread_mutex_t lock; /* protects every field below */
+    pthread_cond_t done; /* signalled when a callback returns */
+    uint64_t now; /* current tick */
+    size_t count; /* number of pending timers */
+    timer_node_t *root[TW_ROOT_SIZE]; /* first level slots */
+    timer_node_t *level[TW_LEVELS][TW_LEVEL_SIZE]; /* upper level slots */
+    timer_node_t *running; /* timer whose callback is running */
+    int timer_fd; /* ticks while any timer is pending */
+    int event_fd; /* wakes the wheel thread up to stop */
+    bool armed; /* timer_fd is ticking */
+    bool stop; /* wheel thread should exit */
+    pthread_t thread; /* wheel thread */
+} timer_wheel_t;
+
+/* initialise the wheel and start its thread */
+bool tw_start(timer_wheel_t *);
+
+/* stop the wheel thread and release its descriptors */
+void tw_stop(timer_wheel_t *);
+
+/* (re)arm a timer to fire after the given number of milliseconds */
+void tw_add(timer_wheel_t *, timer_node_t *, unsigned long, timer_cb, void *);
+
+/* milliseconds left before a timer fires, -1 if it is not pending */
+long tw_remaining(timer_wheel_t *, timer_node_t *);
+
+/* cancel a timer and wait until its callback is no longer running */
+void tw_cancel(timer_wheel_t *, timer_node_t *);
+
+/* cancel a timer like tw_cancel, returning the milliseconds it had left or -1 if it was not pending */
+long tw_pause(timer_wheel_t *, timer_node_t *);
+
+#endif //PROCESS_OVERSEER_TIMER_WHEEL_H
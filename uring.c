@@ -0,0 +1,154 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <uring.h>
+
+/**
+ * set up a ring and map its queues
+ * @param ring ring to set up
+ * @param entries number of submission queue entries, a power of two
+ * @return
+ *  true: if the ring is ready
+ *  false: if io_uring is unavailable or disabled
+ */
+bool uring_init(uring_t *ring, unsigned entries) {
+    struct io_uring_params params;
+
+    memset(ring, 0, sizeof(*ring));
+    memset(&params, 0, sizeof(params));
+    if ((ring->ring_fd = (int) syscall(__NR_io_uring_setup, entries, &params)) == -1) {
+        return false;
+    }
+    ring->entries = params.sq_entries;
+
+    ring->sq_len = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cq_len = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        ring->sq_len = ring->cq_len = ring->sq_len > ring->cq_len ? ring->sq_len : ring->cq_len;
+    }
+
+    ring->sq_ptr = mmap(NULL, ring->sq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                        ring->ring_fd, IORING_OFF_SQ_RING);
+    if (ring->sq_ptr == MAP_FAILED) {
+        goto failed;
+    }
+
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        ring->cq_ptr = ring->sq_ptr;
+    } else {
+        ring->cq_ptr = mmap(NULL, ring->cq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                            ring->ring_fd, IORING_OFF_CQ_RING);
+        if (ring->cq_ptr == MAP_FAILED) {
+            munmap(ring->sq_ptr, ring->sq_len);
+            goto failed;
+        }
+    }
+
+    ring->sqes_len = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqes_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      ring->ring_fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) {
+        if (ring->cq_ptr != ring->sq_ptr) {
+            munmap(ring->cq_ptr, ring->cq_len);
+        }
+        munmap(ring->sq_ptr, ring->sq_len);
+        goto failed;
+    }
+
+    ring->sq_head = (unsigned *) ((char *) ring->sq_ptr + params.sq_off.head);
+    ring->sq_tail = (unsigned *) ((char *) ring->sq_ptr + params.sq_off.tail);
+    ring->sq_mask = (unsigned *) ((char *) ring->sq_ptr + params.sq_off.ring_mask);
+    ring->sq_array = (unsigned *) ((char *) ring->sq_ptr + params.sq_off.array);
+    ring->cq_head = (unsigned *) ((char *) ring->cq_ptr + params.cq_off.head);
+    ring->cq_tail = (unsigned *) ((char *) ring->cq_ptr + params.cq_off.tail);
+    ring->cq_mask = (unsigned *) ((char *) ring->cq_ptr + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *) ((char *) ring->cq_ptr + params.cq_off.cqes);
+
+    return true;
+
+failed:
+    close(ring->ring_fd);
+    ring->ring_fd = -1;
+    return false;
+}
+
+/**
+ * unmap and close a ring
+ * @param ring ring set up by uring_init
+ */
+void uring_close(uring_t *ring) {
+    munmap(ring->sqes, ring->sqes_len);
+    if (ring->cq_ptr != ring->sq_ptr) {
+        munmap(ring->cq_ptr, ring->cq_len);
+    }
+    munmap(ring->sq_ptr, ring->sq_len);
+    close(ring->ring_fd);
+}
+
+/**
+ * read every fd from offset 0: queue one read per fd, then submit and wait
+ * for all of them with a single io_uring_enter
+ * @param ring ring set up by uring_init
+ * @param fds descriptors to read
+ * @param bufs n buffers of size bytes each
+ * @param size size of every buffer, at most size - 1 bytes are read so the
+ * caller can terminate them
+ * @param results bytes read or -errno for every fd
+ * @param n number of fds, at most the number of ring entries
+ * @return
+ *  true: if every read completed
+ *  false: if the batch failed, the caller reads the fds itself and must
+ *  not use the ring again since completions may still arrive
+ */
+bool uring_pread_batch(uring_t *ring, const int *fds, char *bufs, size_t size, ssize_t *results, unsigned n) {
+    unsigned tail = *ring->sq_tail, mask = *ring->sq_mask;
+
+    if (n > ring->entries) {
+        return false;
+    }
+
+    for (unsigned i = 0; i < n; i++) {
+        unsigned index = (tail + i) & mask;
+        struct io_uring_sqe *sqe = ring->sqes + index;
+
+        memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode = IORING_OP_READ;
+        sqe->fd = fds[i];
+        sqe->addr = (unsigned long) (bufs + i * size);
+        sqe->len = (unsigned) size - 1;
+        sqe->off = 0;
+        sqe->user_data = i;
+        ring->sq_array[index] = index;
+    }
+    __atomic_store_n(ring->sq_tail, tail + n, __ATOMIC_RELEASE);
+
+    /* submit and wait for every completion, retrying on signals */
+    unsigned submitted = 0, completed = 0;
+    while (submitted < n || completed < n) {
+        long ret = syscall(__NR_io_uring_enter, ring->ring_fd, n - submitted, n - completed,
+                           IORING_ENTER_GETEVENTS, NULL, 0);
+        if (ret == -1 && errno != EINTR) {
+            perror("io_uring_enter");
+            return false;
+        }
+        if (ret > 0) {
+            submitted += (unsigned) ret;
+        }
+
+        /* reap what completed so far */
+        unsigned head = *ring->cq_head;
+        while (head != __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE)) {
+            struct io_uring_cqe *cqe = ring->cqes + (head & *ring->cq_mask);
+            results[cqe->user_data] = cqe->res;
+            head++;
+            completed++;
+        }
+        __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+    }
+
+    return true;
+}
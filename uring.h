@@ -0,0 +1,31 @@
+#ifndef PROCESS_OVERSEER_URING_H
+#define PROCESS_OVERSEER_URING_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+#include <linux/io_uring.h>
+
+/* minimal io_uring driven through the raw syscalls, no liburing */
+typedef struct uring {
+    int ring_fd;
+    unsigned entries; /* number of submission queue entries */
+    unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+    void *sq_ptr, *cq_ptr; /* mapped rings, the same mapping when single mmap */
+    size_t sq_len, cq_len, sqes_len;
+} uring_t;
+
+/* set up a ring, false if io_uring is unavailable */
+bool uring_init(uring_t *, unsigned entries);
+
+/* unmap and close a ring */
+void uring_close(uring_t *);
+
+/* read from offset 0 of every fd with one submission, results hold bytes or -errno.
+ * On failure the ring must be closed */
+bool uring_pread_batch(uring_t *, const int *fds, char *bufs, size_t size, ssize_t *results, unsigned n);
+
+#endif //PROCESS_OVERSEER_URING_H